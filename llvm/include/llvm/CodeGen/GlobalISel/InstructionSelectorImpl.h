@@ -250,12 +250,21 @@ bool InstructionSelector::executeMatchTable(
              "Expected G_CONSTANT");
       assert(Predicate > GIPFP_I64_Invalid && "Expected a valid predicate");
       int64_t Value = 0;
-      if (State.MIs[InsnID]->getOperand(1).isCImm())
-        Value = State.MIs[InsnID]->getOperand(1).getCImm()->getSExtValue();
-      else if (State.MIs[InsnID]->getOperand(1).isImm())
+      // TVM local begin
+      // A constant wider than 64 bits doesn't satisfy any I64 predicate.
+      if (State.MIs[InsnID]->getOperand(1).isCImm()) {
+        const ConstantInt *CI = State.MIs[InsnID]->getOperand(1).getCImm();
+        if (CI->getValue().getMinSignedBits() > 64) {
+          if (handleReject() == RejectAndGiveUp)
+            return false;
+          break;
+        }
+        Value = CI->getSExtValue();
+      } else if (State.MIs[InsnID]->getOperand(1).isImm())
         Value = State.MIs[InsnID]->getOperand(1).getImm();
       else
         llvm_unreachable("Expected Imm or CImm operand");
+      // TVM local end
 
       if (!testImmPredicate_I64(Predicate, Value))
         if (handleReject() == RejectAndGiveUp)
@@ -554,7 +563,10 @@ bool InstructionSelector::executeMatchTable(
       if (MO.isReg()) {
         // isOperandImmEqual() will sign-extend to 64-bits, so should we.
         LLT Ty = MRI.getType(MO.getReg());
-        Value = SignExtend64(Value, Ty.getSizeInBits());
+        // TVM local begin: the value is already signed for wider types
+        if (Ty.getSizeInBits() < 64)
+          Value = SignExtend64(Value, Ty.getSizeInBits());
+        // TVM local end
 
         if (!isOperandImmEqual(MO, Value, MRI)) {
           if (handleReject() == RejectAndGiveUp)
@@ -815,8 +827,14 @@ bool InstructionSelector::executeMatchTable(
       assert(OutMIs[NewInsnID] && "Attempted to add to undefined instruction");
       assert(State.MIs[OldInsnID]->getOpcode() == TargetOpcode::G_CONSTANT && "Expected G_CONSTANT");
       if (State.MIs[OldInsnID]->getOperand(1).isCImm()) {
-        OutMIs[NewInsnID].addImm(
-            State.MIs[OldInsnID]->getOperand(1).getCImm()->getSExtValue());
+        // TVM local begin
+        // Wide constants are kept as CImm, as InstrEmitter does.
+        const ConstantInt *CI = State.MIs[OldInsnID]->getOperand(1).getCImm();
+        if (CI->getBitWidth() > 64)
+          OutMIs[NewInsnID].addCImm(CI);
+        else
+          OutMIs[NewInsnID].addImm(CI->getSExtValue());
+        // TVM local end
       } else if (State.MIs[OldInsnID]->getOperand(1).isImm())
         OutMIs[NewInsnID].add(State.MIs[OldInsnID]->getOperand(1));
       else
@@ -1544,7 +1544,10 @@ bool IRTranslator::runOnMachineFunction(MachineFunction &CurMF) {
 
   assert(PendingPHIs.empty() && "stale PHIs");
 
-  if (!DL->isLittleEndian()) {
+  // TVM local begin
+  // TVM memory consists of 257-bit bytes, no value is split into them.
+  if (!DL->isLittleEndian() && !MF->getTarget().getTargetTriple().isTVM()) {
+  // TVM local end
     // Currently we don't properly handle big endian code.
     OptimizationRemarkMissed R("gisel-irtranslator", "GISelFailure",
                                F.getSubprogram(), &F.getEntryBlock());
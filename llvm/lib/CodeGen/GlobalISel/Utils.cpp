@@ -23,6 +23,9 @@
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/CodeGen/TargetRegisterInfo.h"
 #include "llvm/IR/Constants.h"
+// TVM local begin
+#include "llvm/Target/TargetMachine.h"
+// TVM local end
 
 #define DEBUG_TYPE "globalisel-utils"
 
@@ -191,6 +194,18 @@ Optional<int64_t> llvm::getConstantVRegVal(unsigned VReg,
   if (MI->getOperand(1).isImm())
     return MI->getOperand(1).getImm();
 
+  // TVM local begin
+  // TVM has only s257 constants, the ones with small values still match the
+  // immediates of the imported patterns.
+  if (MI->getOperand(1).isCImm() &&
+      MI->getMF()->getTarget().getTargetTriple().isTVM()) {
+    const APInt &Val = MI->getOperand(1).getCImm()->getValue();
+    if (Val.getMinSignedBits() <= 64)
+      return Val.getSExtValue();
+    return None;
+  }
+  // TVM local end
+
   if (MI->getOperand(1).isCImm() &&
       MI->getOperand(1).getCImm()->getBitWidth() <= 64)
     return MI->getOperand(1).getCImm()->getSExtValue();
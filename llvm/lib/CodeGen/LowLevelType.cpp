@@ -27,6 +27,16 @@ LLT llvm::getLLTForType(Type &Ty, const DataLayout &DL) {
     return LLT::vector(NumElements, ScalarTy);
   } else if (auto PTy = dyn_cast<PointerType>(&Ty)) {
     return LLT::pointer(PTy->getAddressSpace(), DL.getTypeSizeInBits(&Ty));
+  // TVM local begin
+  } else if (Ty.isTVMBuiltinTy()) {
+    // Builtin types are opaque references of the same size as integers. Give
+    // each of them its own pointer address space to keep them apart.
+    unsigned AddrSpace = Ty.isTVMSliceTy()     ? 1
+                         : Ty.isTVMBuilderTy() ? 2
+                         : Ty.isTVMCellTy()    ? 3
+                                               : 4;
+    return LLT::pointer(AddrSpace, DL.getTypeSizeInBits(&Ty));
+  // TVM local end
   } else if (Ty.isSized()) {
     // Aggregates are no different from real scalars as far as GlobalISel is
     // concerned.
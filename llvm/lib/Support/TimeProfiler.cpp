@@ -0,0 +1,182 @@
+//===-- TimeProfiler.cpp - Hierarchical Time Profiler ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+/// \file Hierarchical time profiler implementation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace llvm {
+
+TimeTraceProfiler *TimeTraceProfilerInstance = nullptr;
+
+typedef duration<steady_clock::rep, steady_clock::period> DurationType;
+typedef std::pair<size_t, DurationType> CountAndDurationType;
+typedef std::pair<std::string, CountAndDurationType>
+    NameAndCountAndDurationType;
+
+namespace {
+struct Entry {
+  time_point<steady_clock> Start;
+  DurationType Duration;
+  std::string Name;
+  std::string Detail;
+
+  Entry(time_point<steady_clock> S, std::string N, std::string D)
+      : Start(S), Duration(), Name(std::move(N)), Detail(std::move(D)) {}
+};
+} // end anonymous namespace
+
+struct TimeTraceProfiler {
+  TimeTraceProfiler(unsigned Granularity)
+      : StartTime(steady_clock::now()), TimeTraceGranularity(Granularity) {}
+
+  void begin(std::string Name, function_ref<std::string()> Detail) {
+    Stack.emplace_back(steady_clock::now(), std::move(Name), Detail());
+  }
+
+  void end() {
+    assert(!Stack.empty() && "Must call begin() first");
+    Entry &E = Stack.back();
+    E.Duration = steady_clock::now() - E.Start;
+
+    // Only include sections longer than TimeTraceGranularity.
+    if (duration_cast<microseconds>(E.Duration).count() > TimeTraceGranularity)
+      Entries.push_back(E);
+
+    // Track the total time of each name, counting only the outermost of the
+    // nested sections with the same name: a template instantiation triggering
+    // other instantiations is counted once.
+    if (std::find_if(++Stack.rbegin(), Stack.rend(), [&](const Entry &Val) {
+          return Val.Name == E.Name;
+        }) == Stack.rend()) {
+      CountAndDurationType &CountAndTotal = CountAndTotalPerName[E.Name];
+      CountAndTotal.first++;
+      CountAndTotal.second += E.Duration;
+    }
+
+    Stack.pop_back();
+  }
+
+  void write(raw_pwrite_stream &OS) {
+    assert(Stack.empty() &&
+           "All profiler sections should be ended when calling write");
+    json::Array Events;
+    // The Chrome trace format requires a process id.
+    const int64_t Pid = 1;
+
+    // Events of the main flame graph.
+    for (const Entry &E : Entries) {
+      int64_t StartUs = duration_cast<microseconds>(E.Start - StartTime).count();
+      int64_t DurUs = duration_cast<microseconds>(E.Duration).count();
+      Events.push_back(json::Object{
+          {"pid", Pid},
+          {"tid", 0},
+          {"ph", "X"},
+          {"ts", StartUs},
+          {"dur", DurUs},
+          {"name", E.Name},
+          {"args", json::Object{{"detail", E.Detail}}},
+      });
+    }
+
+    // Totals by section name as additional "threads", the longest first.
+    std::vector<NameAndCountAndDurationType> SortedTotals;
+    SortedTotals.reserve(CountAndTotalPerName.size());
+    for (const auto &E : CountAndTotalPerName)
+      SortedTotals.emplace_back(E.getKey(), E.getValue());
+    llvm::sort(SortedTotals.begin(), SortedTotals.end(),
+               [](const NameAndCountAndDurationType &A,
+                  const NameAndCountAndDurationType &B) {
+                 return A.second.second > B.second.second;
+               });
+    int64_t Tid = 1;
+    for (const NameAndCountAndDurationType &E : SortedTotals) {
+      int64_t DurUs = duration_cast<microseconds>(E.second.second).count();
+      int64_t Count = E.second.first;
+      Events.push_back(json::Object{
+          {"pid", Pid},
+          {"tid", Tid},
+          {"ph", "X"},
+          {"ts", 0},
+          {"dur", DurUs},
+          {"name", "Total " + E.first},
+          {"args", json::Object{{"count", Count},
+                                {"avg ms", DurUs / Count / 1000}}},
+      });
+      ++Tid;
+    }
+
+    // Metadata event with the process name.
+    Events.push_back(json::Object{
+        {"cat", ""},
+        {"pid", Pid},
+        {"tid", 0},
+        {"ts", 0},
+        {"ph", "M"},
+        {"name", "process_name"},
+        {"args", json::Object{{"name", "clang"}}},
+    });
+
+    OS << formatv("{0:2}", json::Value(json::Object{
+                               {"traceEvents", std::move(Events)}}));
+  }
+
+  std::vector<Entry> Stack;
+  std::vector<Entry> Entries;
+  StringMap<CountAndDurationType> CountAndTotalPerName;
+  time_point<steady_clock> StartTime;
+  // Minimum time of a section to be written as an event, in microseconds.
+  unsigned TimeTraceGranularity;
+};
+
+void timeTraceProfilerInitialize(unsigned TimeTraceGranularity) {
+  assert(TimeTraceProfilerInstance == nullptr &&
+         "Profiler should not be initialized");
+  TimeTraceProfilerInstance = new TimeTraceProfiler(TimeTraceGranularity);
+}
+
+void timeTraceProfilerCleanup() {
+  delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = nullptr;
+}
+
+void timeTraceProfilerWrite(raw_pwrite_stream &OS) {
+  assert(TimeTraceProfilerInstance != nullptr &&
+         "Profiler object can't be null");
+  TimeTraceProfilerInstance->write(OS);
+}
+
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name, [&]() { return Detail; });
+}
+
+void timeTraceProfilerBegin(StringRef Name,
+                            function_ref<std::string()> Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name, Detail);
+}
+
+void timeTraceProfilerEnd() {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->end();
+}
+
+} // end namespace llvm
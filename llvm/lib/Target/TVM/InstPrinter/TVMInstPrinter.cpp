@@ -22,6 +22,7 @@
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCInstrInfo.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/FormattedStream.h"
 using namespace llvm;
 
@@ -103,6 +104,27 @@ void TVMInstPrinter::printUimm257(const MCInst *MI, unsigned OpNo,
   O << static_cast<uint64_t>(Op.getImm());
 }
 
+void TVMInstPrinter::printSliceConst(const MCInst *MI, unsigned OpNo,
+                                     raw_ostream &O) {
+  const MCOperand &Data = MI->getOperand(OpNo);
+  const MCOperand &Size = MI->getOperand(OpNo + 1);
+  assert(Data.isImm() && Size.isImm() && "Wrong operand type in sliceconst");
+  auto Bits = static_cast<unsigned>(Size.getImm());
+  auto Value = static_cast<uint64_t>(Data.getImm());
+  assert(Bits < 64 && "Slice constant is too long");
+  // Bitstrings with length not divisible by 4 are completed with a single
+  // 1 bit followed by zeroes and marked by trailing '_'.
+  bool Completed = Bits % 4;
+  if (Completed) {
+    unsigned Padding = 4 - Bits % 4;
+    Value = ((Value << 1) | 1) << (Padding - 1);
+    Bits += Padding;
+  }
+  O << "x" << format_hex_no_prefix(Value, Bits / 4);
+  if (Completed)
+    O << "_";
+}
+
 void TVMInstPrinter::printRegisterList(const MCInst *MI, unsigned OpNum,
                                        raw_ostream &O) {
   O << "{";
@@ -35,6 +35,7 @@ public:
   void printInstruction(const MCInst *MI, raw_ostream &O);
   void printOperand(const MCInst *MI, unsigned OpNo, raw_ostream &O);
   void printUimm257(const MCInst *MI, unsigned OpNo, raw_ostream &O);
+  void printSliceConst(const MCInst *MI, unsigned OpNo, raw_ostream &O);
 
   void printRegisterList(const MCInst *MI, unsigned OpNum, raw_ostream &O);
 
@@ -20,13 +20,21 @@
 
 namespace llvm {
 class TVMTargetMachine;
+class TVMSubtarget;
+class TVMRegisterBankInfo;
 class FunctionPass;
+class InstructionSelector;
 class LoopPass;
+class Pass;
 class formatted_raw_ostream;
 
 FunctionPass *createTVMISelDag(TVMTargetMachine &TM,
                                CodeGenOpt::Level OptLevel);
 
+InstructionSelector *
+createTVMInstructionSelector(const TVMSubtarget &STI,
+                             const TVMRegisterBankInfo &RBI);
+
 FunctionPass *createTVMArgumentMove();
 FunctionPass *createTVMControlFlowPrepare();
 FunctionPass *createTVMReplacePhysRegs();
@@ -39,13 +47,24 @@ FunctionPass *createTVMStackModel();
 FunctionPass *createTVMLoopInstructions();
 FunctionPass *createTVMLoopPrepare();
 FunctionPass *createTVMMoveMaterializable();
+FunctionPass *createTVMStackPressure();
 FunctionPass *createTVMContinuationsHoist();
 FunctionPass *createTVMIfConversionTerm();
+FunctionPass *createTVMStateReadCSE();
+FunctionPass *createTVMPersistentStoreElim();
+FunctionPass *createTVMStoreCombine();
+FunctionPass *createTVMLoadCombine();
+FunctionPass *createTVMCodeLayout();
+FunctionPass *createTVMHotColdSplit();
+FunctionPass *createTVMConstGlobalEmbed();
+FunctionPass *createTVMGasEstimate();
 BasicBlockPass *createTVMDefineUndef();
 BasicBlockPass *createTVMLoadStoreReplace();
-BasicBlockPass *createTVMStoreCombine();
 ModulePass *createTVMLowerIntrinsicsPass();
 ModulePass *createTVMReFuncPass();
+ModulePass *createTVMSpecialize();
+Pass *createTVMInliner(const TVMTargetMachine *TM, unsigned OptLevel,
+                       unsigned SizeLevel);
 
 void initializeTVMArgumentMovePass(PassRegistry &);
 void initializeTVMControlFlowPreparePass(PassRegistry &);
@@ -62,10 +81,21 @@ void initializeTVMLoopPreparePass(PassRegistry &);
 void initializeTVMContinuationsHoistPass(PassRegistry &);
 void initializeTVMLoadStoreReplacePass(PassRegistry &);
 void initializeTVMMoveMaterializablePass(PassRegistry &);
+void initializeTVMStackPressurePass(PassRegistry &);
 void initializeTVMIfConversionTermPass(PassRegistry &);
+void initializeTVMStateReadCSEPass(PassRegistry &);
+void initializeTVMPersistentStoreElimPass(PassRegistry &);
+void initializeTVMAAWrapperPassPass(PassRegistry &);
 void initializeTVMStoreCombinePass(PassRegistry &);
+void initializeTVMLoadCombinePass(PassRegistry &);
+void initializeTVMCodeLayoutPass(PassRegistry &);
+void initializeTVMHotColdSplitPass(PassRegistry &);
+void initializeTVMConstGlobalEmbedPass(PassRegistry &);
+void initializeTVMGasEstimatePass(PassRegistry &);
 void initializeTVMLowerIntrinsicsPass(PassRegistry &);
 void initializeTVMReFuncPass(PassRegistry &);
+void initializeTVMSpecializePass(PassRegistry &);
+void initializeTVMInlinerPass(PassRegistry &);
 
 } // namespace llvm
 
@@ -0,0 +1,133 @@
+//===- TVMAliasAnalysis ---------------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This is the TVM alias analysis of the VM state accessed by intrinsics.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVMAliasAnalysis.h"
+#include "TVM.h"
+#include "TVMUtilities.h"
+#include "llvm/IR/Constants.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-aa"
+
+char TVMAAWrapperPass::ID = 0;
+
+INITIALIZE_PASS(TVMAAWrapperPass, "tvm-aa",
+                "TVM VM State Alias Analysis", false, true)
+
+TVMAAWrapperPass::TVMAAWrapperPass() : ImmutablePass(ID) {
+  initializeTVMAAWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+ImmutablePass *llvm::createTVMAAWrapperPass() {
+  return new TVMAAWrapperPass();
+}
+
+ImmutablePass *llvm::createTVMExternalAAWrapperPass() {
+  return createExternalAAWrapperPass([](Pass &P, Function &, AAResults &AAR) {
+    if (auto *WrapperPass = P.getAnalysisIfAvailable<TVMAAWrapperPass>())
+      AAR.addAAResult(WrapperPass->getResult());
+  });
+}
+
+static int64_t getIndex(const Value *V) {
+  if (const auto *C = dyn_cast<ConstantInt>(V))
+    if (C->getValue().getMinSignedBits() <= 64 && !C->isNegative())
+      return C->getSExtValue();
+  return -1;
+}
+
+/// Control registers c4 and c7 hold the persistent data and the globals.
+static TVM::StateAccess getRegisterAccess(const Value *Reg, ModRefInfo MRI) {
+  using TVM::StateLocation;
+  int64_t Idx = getIndex(Reg);
+  if (Idx < 0)
+    return {StateLocation::Unknown, -1, MRI};
+  if (Idx == 4)
+    return {StateLocation::PersistentData, -1, MRI};
+  if (Idx == 7)
+    return {StateLocation::Globals, -1, MRI};
+  return {StateLocation::Register, Idx, MRI};
+}
+
+TVM::StateAccess TVM::getStateAccess(ImmutableCallSite CS) {
+  switch (CS.getIntrinsicID()) {
+  case Intrinsic::tvm_get_persistent_data:
+    return {StateLocation::PersistentData, -1, ModRefInfo::Ref};
+  case Intrinsic::tvm_set_persistent_data:
+    return {StateLocation::PersistentData, -1, ModRefInfo::Mod};
+  case Intrinsic::tvm_getglobal:
+    return {StateLocation::Globals, getIndex(CS.getArgument(0)),
+            ModRefInfo::Ref};
+  case Intrinsic::tvm_setglobal:
+    return {StateLocation::Globals, getIndex(CS.getArgument(0)),
+            ModRefInfo::Mod};
+  case Intrinsic::tvm_getreg:
+    return getRegisterAccess(CS.getArgument(0), ModRefInfo::Ref);
+  case Intrinsic::tvm_setreg:
+    return getRegisterAccess(CS.getArgument(0), ModRefInfo::Mod);
+  case Intrinsic::tvm_commit:
+    // COMMIT saves both c4 and c5.
+    return {StateLocation::Unknown, -1, ModRefInfo::Ref};
+  case Intrinsic::tvm_throw:
+  case Intrinsic::tvm_throwif: {
+    // Exit codes 0 and 1 terminate the transaction successfully, so such a
+    // THROW commits c4 and c5 as COMMIT does. Only a known failure code
+    // reverts the state.
+    unsigned CodeArg = CS.getIntrinsicID() == Intrinsic::tvm_throw ? 0 : 1;
+    if (getIndex(CS.getArgument(CodeArg)) > 1)
+      return {StateLocation::None, -1, ModRefInfo::ModRef};
+    return {StateLocation::Unknown, -1, ModRefInfo::Ref};
+  }
+  case Intrinsic::not_intrinsic:
+    return {StateLocation::Unknown, -1, ModRefInfo::ModRef};
+  default:
+    if (TVM::isStateNeutral(CS.getIntrinsicID()))
+      return {StateLocation::None, -1, ModRefInfo::ModRef};
+    return {StateLocation::Unknown, -1, ModRefInfo::ModRef};
+  }
+}
+
+bool TVM::isPersistentStore(ImmutableCallSite CS) {
+  StateAccess Access = getStateAccess(CS);
+  return Access.Loc == StateLocation::PersistentData &&
+         isModSet(Access.MRI);
+}
+
+/// Test whether \p A and \p B are known to access different pieces of the
+/// state. Calls of state neutral intrinsics may still access other control
+/// registers (e.g. SENDRAWMSG appends an action to c5).
+static bool areDisjoint(const TVM::StateAccess &A, const TVM::StateAccess &B) {
+  using TVM::StateLocation;
+  if (A.Loc == StateLocation::Unknown || B.Loc == StateLocation::Unknown)
+    return false;
+  if (A.Loc == StateLocation::None || B.Loc == StateLocation::None) {
+    StateLocation Other = A.Loc == StateLocation::None ? B.Loc : A.Loc;
+    return Other == StateLocation::PersistentData ||
+           Other == StateLocation::Globals;
+  }
+  if (A.Loc != B.Loc)
+    return true;
+  return A.Loc != StateLocation::PersistentData && A.Index >= 0 &&
+         B.Index >= 0 && A.Index != B.Index;
+}
+
+ModRefInfo TVMAAResult::getModRefInfo(ImmutableCallSite CS1,
+                                      ImmutableCallSite CS2) {
+  TVM::StateAccess A1 = TVM::getStateAccess(CS1);
+  TVM::StateAccess A2 = TVM::getStateAccess(CS2);
+  if (areDisjoint(A1, A2))
+    return ModRefInfo::NoModRef;
+  return AAResultBase::getModRefInfo(CS1, CS2);
+}
@@ -0,0 +1,103 @@
+//===- TVMAliasAnalysis -----------------------------------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This is the TVM alias analysis of the VM state accessed by intrinsics.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_TVM_TVMALIASANALYSIS_H
+#define LLVM_LIB_TARGET_TVM_TVMALIASANALYSIS_H
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/Pass.h"
+#include <memory>
+
+namespace llvm {
+
+namespace TVM {
+
+/// A piece of the VM state accessed by a call.
+enum class StateLocation {
+  None,           ///< Neither the persistent data nor the globals.
+  PersistentData, ///< Persistent data of the contract (c4).
+  Globals,        ///< Global variables (c7), Index is the global number.
+  Register,       ///< Other control register, Index is the register number.
+  Unknown         ///< Anything, e.g. a call of a function.
+};
+
+struct StateAccess {
+  StateLocation Loc;
+  /// Global or register number, -1 if unknown or the whole location.
+  int64_t Index;
+  ModRefInfo MRI;
+};
+
+/// Get the piece of the VM state accessed by \p CS.
+StateAccess getStateAccess(ImmutableCallSite CS);
+
+/// Test whether \p CS overwrites the whole persistent data of the contract.
+bool isPersistentStore(ImmutableCallSite CS);
+
+} // end namespace TVM
+
+/// The VM state accessed by TVM intrinsics is inaccessible memory, so the
+/// generic analysis has to assume that any two of them, e.g. a store of the
+/// persistent data and a read of a global, interfere. The result tells apart
+/// the persistent data, distinct globals and control registers.
+class TVMAAResult : public AAResultBase<TVMAAResult> {
+  friend AAResultBase<TVMAAResult>;
+
+public:
+  TVMAAResult() : AAResultBase() {}
+  TVMAAResult(TVMAAResult &&Arg) : AAResultBase(std::move(Arg)) {}
+
+  /// Handle invalidation events from the new pass manager.
+  ///
+  /// By definition, this result is stateless and so remains valid.
+  bool invalidate(Function &, const PreservedAnalyses &) { return false; }
+
+  using AAResultBase::getModRefInfo;
+  ModRefInfo getModRefInfo(ImmutableCallSite CS1, ImmutableCallSite CS2);
+};
+
+/// Legacy wrapper pass to provide the TVMAAResult object.
+class TVMAAWrapperPass : public ImmutablePass {
+  std::unique_ptr<TVMAAResult> Result;
+
+public:
+  static char ID;
+
+  TVMAAWrapperPass();
+
+  TVMAAResult &getResult() { return *Result; }
+  const TVMAAResult &getResult() const { return *Result; }
+
+  bool doInitialization(Module &M) override {
+    Result.reset(new TVMAAResult());
+    return false;
+  }
+
+  bool doFinalization(Module &M) override {
+    Result.reset();
+    return false;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+};
+
+ImmutablePass *createTVMAAWrapperPass();
+ImmutablePass *createTVMExternalAAWrapperPass();
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_TARGET_TVM_TVMALIASANALYSIS_H
@@ -25,19 +25,31 @@
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCSymbol.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
+#include <map>
 using namespace llvm;
 
 #define DEBUG_TYPE "asm-printer"
 
+static cl::opt<std::string> SizeMapFile(
+    "tvm-size-map", cl::Hidden, cl::value_desc("filename"),
+    cl::desc("Write the estimated code size of every function, broken down "
+             "by the source functions inlined into it and by instruction, to "
+             "the given JSON file (see tvm_size.py)"));
+
 namespace {
 class TVMAsmPrinter : public AsmPrinter {
 public:
@@ -54,20 +66,62 @@ public:
   void EmitBasicBlockStart(const MachineBasicBlock &MBB) const override;
 
   void EmitFunctionHeader() override;
+  void EmitGlobalVariable(const GlobalVariable *GV) override;
 
   /// Print a big LLVM constant int (>64 bit) to the .s file.
   void EmitBigInt(const ConstantInt *CI) override;
 
   bool runOnMachineFunction(MachineFunction &MF) override;
+  bool doFinalization(Module &M) override;
 protected:
   void EmitSubBlockForPushcont(const TVMMCInstLower &lower, const MCInst &Inst,
                                int depth);
   void EmitBBEntry(const MachineBasicBlock &MBB) const;
+  /// Render stack model comments of \p MI.
+  void EmitStackModelComments(const MachineInstr *MI) const;
+  std::string renderComment(const StackModelComment &Comment) const;
+  /// Record the code size of \p MF for the size map. The sizes are the
+  /// estimates of TVMInstrInfo::getCodeBits, not the encoded lengths.
+  void recordSizes(const MachineFunction &MF);
 private:
   TVMFunctionInfo *MFI;
+  /// Functions of the size map written at finalization.
+  json::Array SizeMap;
 };
 } // end of anonymous namespace
 
+/// Whether \p Inst takes a continuation whose body is printed in braces.
+static bool isPushContMBB(const MCInst &Inst) {
+  switch (Inst.getOpcode()) {
+  case TVM::PUSHCONT_MBB_S:
+  case TVM::PUSHREFCONT_MBB:
+  case TVM::IFJMPREF_MBB:
+  case TVM::IFNOTJMPREF_MBB:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Whether \p Opcode is a copy resolved by the stack model, printed as
+/// nothing.
+static bool isStackModelCopy(unsigned Opcode) {
+  switch (Opcode) {
+  case TVM::REG_TO_REG_COPY_S:
+  case TVM::TO_TUPLE_COPY_S:
+  case TVM::TO_SLICE_COPY_S:
+  case TVM::TO_BUILDER_COPY_S:
+  case TVM::TO_CELL_COPY_S:
+  case TVM::FROM_TUPLE_COPY_S:
+  case TVM::FROM_SLICE_COPY_S:
+  case TVM::FROM_BUILDER_COPY_S:
+  case TVM::FROM_CELL_COPY_S:
+    return true;
+  default:
+    return false;
+  }
+}
+
 std::string TVMAsmPrinter::regToString(const MachineOperand &MO) {
   unsigned RegNo = MO.getReg();
   assert(TargetRegisterInfo::isVirtualRegister(RegNo) &&
@@ -99,9 +153,9 @@ void TVMAsmPrinter::printOperand(const MachineInstr *MI, int OpNum,
 void TVMAsmPrinter::EmitInstruction(const MachineInstr *MI) {
   LLVM_DEBUG(dbgs() << "EmitInstruction: " << *MI << '\n');
   if (isVerbose())
-    for (auto Comment : MFI->getStackModelComments(MI)) {
-      OutStreamer->AddComment(Comment);
-    }
+    EmitStackModelComments(MI);
+  if (isStackModelCopy(MI->getOpcode()))
+    return;
   switch (MI->getOpcode()) {
   case TVM::ARGUMENT:
   case TVM::ARGUMENT_SLICE:
@@ -110,16 +164,6 @@ void TVMAsmPrinter::EmitInstruction(const MachineInstr *MI) {
   case TVM::ARGUMENT_TUPLE:
     llvm_unreachable("CG only instruction mustn't reach ASM printer");
     break;
-  case TVM::REG_TO_REG_COPY_S:
-  case TVM::TO_TUPLE_COPY_S:
-  case TVM::TO_SLICE_COPY_S:
-  case TVM::TO_BUILDER_COPY_S:
-  case TVM::TO_CELL_COPY_S:
-  case TVM::FROM_TUPLE_COPY_S:
-  case TVM::FROM_SLICE_COPY_S:
-  case TVM::FROM_BUILDER_COPY_S:
-  case TVM::FROM_CELL_COPY_S:
-    break;
   case TVM::FALLTHROUGH_RETURN:
     if (isVerbose()) {
       OutStreamer->AddComment("fallthrough return");
@@ -147,7 +191,7 @@ void TVMAsmPrinter::EmitInstruction(const MachineInstr *MI) {
     // \t}
     OutStreamer->GetOS() << "\t";
     EmitToStreamer(*OutStreamer, TmpInst);
-    if (TmpInst.getOpcode() == TVM::PUSHCONT_MBB_S) {
+    if (isPushContMBB(TmpInst)) {
       EmitSubBlockForPushcont(MCInstLowering, TmpInst, 0);
     }
   }
@@ -158,7 +202,9 @@ bool TVMAsmPrinter::ShouldPrintNextBlock(const MachineBasicBlock &CurMBB) const
   // Continue if no terminators or fallthrough terminator
   if (Term.begin() == Term.end() ||
       Term.begin()->getOpcode() == TVM::IFJMP_S ||
-      Term.begin()->getOpcode() == TVM::IFNOTJMP_S)
+      Term.begin()->getOpcode() == TVM::IFNOTJMP_S ||
+      Term.begin()->getOpcode() == TVM::IFJMPREF_MBB ||
+      Term.begin()->getOpcode() == TVM::IFNOTJMPREF_MBB)
     return true;
   return false;
 }
@@ -171,13 +217,26 @@ void TVMAsmPrinter::EmitBBEntry(const MachineBasicBlock &MBB) const {
         OutStreamer->GetCommentOS() << '\n';
       }
     }
-    auto BBStackComment = MFI->getStackModelBBComment(&MBB);
-    if (!BBStackComment.empty())
-      OutStreamer->AddComment(BBStackComment, true);
+    if (auto *BBStackComment = MFI->getStackModelBBComment(&MBB))
+      OutStreamer->AddComment(renderComment(*BBStackComment), true);
   }
   OutStreamer->emitRawComment(" %bb." + Twine(MBB.getNumber()) + ":", false);
 }
 
+std::string
+TVMAsmPrinter::renderComment(const StackModelComment &Comment) const {
+  std::string Str;
+  raw_string_ostream OS(Str);
+  Comment.print(OS, *MF->getSubtarget().getInstrInfo(),
+                MF->getSubtarget().getRegisterInfo(), &MF->getRegInfo());
+  return OS.str();
+}
+
+void TVMAsmPrinter::EmitStackModelComments(const MachineInstr *MI) const {
+  for (const auto &Comment : MFI->getStackModelComments(MI))
+    OutStreamer->AddComment(renderComment(Comment));
+}
+
 void TVMAsmPrinter::EmitSubBlockForPushcont(const TVMMCInstLower &lower,
                                             const MCInst &Inst,
                                             int depth) {
@@ -201,9 +260,8 @@ void TVMAsmPrinter::EmitSubBlockForPushcont(const TVMMCInstLower &lower,
       if (isVerbose()) {
         auto MIit = Mapping.find(&curInst);
         // PUSHCONT_MBB comment will be printed later, at closing brace '}'
-        if (MIit != Mapping.end() && curInst.getOpcode() != TVM::PUSHCONT_MBB_S)
-          for (auto &Comment : MFI->getStackModelComments(MIit->second))
-            OutStreamer->AddComment(Comment);
+        if (MIit != Mapping.end() && !isPushContMBB(curInst))
+          EmitStackModelComments(MIit->second);
         if (curInst.getOpcode() == TVM::FALLTHROUGH_RETURN) {
           OutStreamer->AddComment("fallthrough return");
           OutStreamer->AddBlankLine();
@@ -213,7 +271,7 @@ void TVMAsmPrinter::EmitSubBlockForPushcont(const TVMMCInstLower &lower,
       static_cast<formatted_raw_ostream &>(OutStreamer->GetOS()).
           PadToColumn(10 + depth);
       EmitToStreamer(*OutStreamer, curInst);
-      if (curInst.getOpcode() == TVM::PUSHCONT_MBB_S)
+      if (isPushContMBB(curInst))
         EmitSubBlockForPushcont(lower, curInst, depth + 2);
     }
   }
@@ -221,8 +279,7 @@ void TVMAsmPrinter::EmitSubBlockForPushcont(const TVMMCInstLower &lower,
     // Print PUSHCONT_MBB comments at close brace '}'
     auto MIit = Mapping.find(&Inst);
     if (MIit != Mapping.end())
-      for (auto &Comment : MFI->getStackModelComments(MIit->second))
-        OutStreamer->AddComment(Comment);
+      EmitStackModelComments(MIit->second);
   }
   OutStreamer->EmitRawText("\t" + std::string(depth, ' ') + "}\n");
 }
@@ -242,6 +299,26 @@ void TVMAsmPrinter::EmitFunctionHeader() {
   }
 }
 
+/// Return true if the data of \p GV is only read from slices embedded into
+/// the code by TVMConstGlobalEmbed.
+static bool isEmbeddedIntoCode(const GlobalVariable *GV) {
+  if (!GV->hasLocalLinkage() || GV->use_empty())
+    return false;
+  auto IsEmbedding = [](const User *U) {
+    const auto *II = dyn_cast<IntrinsicInst>(U);
+    return II && II->getIntrinsicID() == Intrinsic::tvm_pushslice_data;
+  };
+  return all_of(GV->users(), [&](const User *U) {
+    return isa<ConstantExpr>(U) && all_of(U->users(), IsEmbedding);
+  });
+}
+
+void TVMAsmPrinter::EmitGlobalVariable(const GlobalVariable *GV) {
+  if (isEmbeddedIntoCode(GV))
+    return;
+  AsmPrinter::EmitGlobalVariable(GV);
+}
+
 /// Print a big LLVM constant int (>64 bit) to the .s file.
 void TVMAsmPrinter::EmitBigInt(const ConstantInt *CI) {
   SmallString<80> Str;
@@ -249,11 +326,112 @@ void TVMAsmPrinter::EmitBigInt(const ConstantInt *CI) {
   OutStreamer->EmitRawText(Str);
 }
 
+/// Get the name of \p SP qualified with the namespaces and the classes it's
+/// declared in, e.g. "schema::build<Foo>".
+static std::string getQualifiedName(const DISubprogram *SP) {
+  std::string Name = SP->getName();
+  for (const DIScope *Scope = SP->getScope().resolve(); Scope;
+       Scope = Scope->getScope().resolve()) {
+    if (!isa<DINamespace>(Scope) && !isa<DICompositeType>(Scope))
+      break;
+    if (!Scope->getName().empty())
+      Name = (Scope->getName() + "::" + Name).str();
+  }
+  return Name;
+}
+
+void TVMAsmPrinter::recordSizes(const MachineFunction &MF) {
+  const TargetInstrInfo *TII = MF.getSubtarget().getInstrInfo();
+  const auto &TVMII = static_cast<const TVMInstrInfo &>(*TII);
+
+  // Instructions are grouped by the chain of source functions they have been
+  // inlined from (innermost first) and by opcode.
+  struct Entry {
+    std::vector<std::string> Inlined;
+    StringRef Opcode;
+    unsigned Count = 0;
+    unsigned Bits = 0;
+    unsigned Refs = 0;
+  };
+  std::vector<Entry> Entries;
+  std::map<std::string, unsigned> EntryIdx;
+  unsigned Bits = 0, Refs = 0;
+
+  for (const MachineBasicBlock &MBB : MF)
+    for (const MachineInstr &MI : MBB) {
+      if (MI.isMetaInstruction() || isStackModelCopy(MI.getOpcode()))
+        continue;
+      unsigned InstrRefs = 0;
+      unsigned InstrBits = TVMII.getCodeBits(MI, &InstrRefs);
+      if (!InstrBits && !InstrRefs)
+        continue;
+      std::vector<std::string> Inlined;
+      for (const DILocation *Loc = MI.getDebugLoc(); Loc && Loc->getInlinedAt();
+           Loc = Loc->getInlinedAt())
+        if (const DISubprogram *SP = Loc->getScope()->getSubprogram())
+          Inlined.push_back(getQualifiedName(SP));
+      StringRef Opcode = TII->getName(MI.getOpcode());
+      Opcode.consume_back("_S");
+      std::string Key = Opcode;
+      for (const std::string &Name : Inlined)
+        Key += "|" + Name;
+      auto Ins = EntryIdx.insert({Key, Entries.size()});
+      if (Ins.second) {
+        Entries.emplace_back();
+        Entries.back().Inlined = std::move(Inlined);
+        Entries.back().Opcode = Opcode;
+      }
+      Entry &E = Entries[Ins.first->second];
+      ++E.Count;
+      E.Bits += InstrBits;
+      E.Refs += InstrRefs;
+      Bits += InstrBits;
+      Refs += InstrRefs;
+    }
+
+  json::Array Instrs;
+  for (Entry &E : Entries) {
+    json::Array Inlined;
+    for (std::string &Name : E.Inlined)
+      Inlined.push_back(std::move(Name));
+    Instrs.push_back(json::Object{{"opcode", E.Opcode},
+                                  {"inlined", std::move(Inlined)},
+                                  {"count", E.Count},
+                                  {"bits", E.Bits},
+                                  {"refs", E.Refs}});
+  }
+  const Function &F = MF.getFunction();
+  json::Object Fn{{"name", MF.getName().str()},
+                  {"bits", Bits},
+                  {"refs", Refs},
+                  {"entry", F.hasFnAttribute("tvm_raw_func")},
+                  {"instructions", std::move(Instrs)}};
+  if (const DISubprogram *SP = F.getSubprogram())
+    Fn["source"] = getQualifiedName(SP);
+  SizeMap.push_back(std::move(Fn));
+}
+
 bool TVMAsmPrinter::runOnMachineFunction(MachineFunction &MF) {
   MFI = MF.getInfo<TVMFunctionInfo>();
+  if (!SizeMapFile.empty())
+    recordSizes(MF);
   return AsmPrinter::runOnMachineFunction(MF);
 }
 
+bool TVMAsmPrinter::doFinalization(Module &M) {
+  if (!SizeMapFile.empty()) {
+    std::error_code EC;
+    raw_fd_ostream OS(SizeMapFile, EC, sys::fs::F_Text);
+    if (EC)
+      report_fatal_error("Can't open size map file " + SizeMapFile + ": " +
+                         EC.message());
+    OS << json::Value(json::Object{{"module", M.getModuleIdentifier()},
+                                   {"functions", std::move(SizeMap)}})
+       << '\n';
+  }
+  return AsmPrinter::doFinalization(M);
+}
+
 // Force static initialization.
 extern "C" void LLVMInitializeTVMAsmPrinter() {
   RegisterAsmPrinter<TVMAsmPrinter> X(getTheTVMTarget());
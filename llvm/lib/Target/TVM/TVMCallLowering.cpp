@@ -0,0 +1,201 @@
+//===-- TVMCallLowering.cpp - Call lowering for GlobalISel ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the lowering of LLVM calls, arguments and returns to
+/// TVM machine code for GlobalISel. The instructions built are the same as
+/// TVMTargetLowering produces: ARGUMENT* for the arguments followed by the
+/// saving of c0, POPC c0 and RETURN_N for the returns, CALL* / CALLDICT* for
+/// the calls. The lowering fails (falling back to SelectionDAG) for the types
+/// and the calling conventions TVMTargetLowering doesn't support and for
+/// multiple return values.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVMCallLowering.h"
+#include "MCTargetDesc/TVMMCTargetDesc.h"
+#include "TVMISelLowering.h"
+#include "TVMMachineFunctionInfo.h"
+#include "TVMSubtarget.h"
+#include "llvm/CodeGen/GlobalISel/MachineIRBuilder.h"
+#include "llvm/CodeGen/GlobalISel/RegisterBankInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-call-lowering"
+
+TVMCallLowering::TVMCallLowering(const TVMTargetLowering &TLI)
+    : CallLowering(&TLI) {}
+
+/// Test whether the given calling convention is supported, the same set as
+/// in TVMTargetLowering.
+static bool CallingConvSupported(CallingConv::ID CallConv) {
+  return CallConv == CallingConv::C || CallConv == CallingConv::Fast ||
+         CallConv == CallingConv::Cold ||
+         CallConv == CallingConv::PreserveMost ||
+         CallConv == CallingConv::PreserveAll ||
+         CallConv == CallingConv::CXX_FAST_TLS;
+}
+
+/// Constrain the generic virtual register \p Reg to the register class \p RC
+/// of an operand of a TVM instruction.
+static void constrainReg(MachineIRBuilder &MIRBuilder, unsigned Reg,
+                         const TargetRegisterClass &RC) {
+  MachineFunction &MF = MIRBuilder.getMF();
+  const RegisterBankInfo &RBI = *MF.getSubtarget().getRegBankInfo();
+  RBI.constrainGenericRegister(Reg, RC, MF.getRegInfo());
+}
+
+const TargetRegisterClass *
+TVMCallLowering::getRegClassFor(const DataLayout &DL, Type *Ty) const {
+  const auto &TLI = *getTLI<TVMTargetLowering>();
+  EVT VT = TLI.getValueType(DL, Ty, /*AllowUnknown=*/true);
+  if (!VT.isSimple() || !TLI.isTypeLegal(VT))
+    return nullptr;
+  return TLI.getRegClassFor(VT.getSimpleVT());
+}
+
+bool TVMCallLowering::lowerReturn(MachineIRBuilder &MIRBuilder,
+                                  const Value *Val, unsigned VReg) const {
+  MachineFunction &MF = MIRBuilder.getMF();
+  const Function &F = MF.getFunction();
+  if (!CallingConvSupported(F.getCallingConv()))
+    return false;
+  const TargetRegisterClass *RC = nullptr;
+  if (Val) {
+    RC = getRegClassFor(F.getParent()->getDataLayout(), Val->getType());
+    if (!RC)
+      return false;
+  }
+
+  // Restore c0 for returning to the correct continuation.
+  auto *FI = MF.getInfo<TVMFunctionInfo>();
+  assert(FI->hasC0VirtReg() && "C0 virtual register has not been saved");
+  MIRBuilder.buildInstr(TVM::POPC).addUse(FI->getC0VirtReg()).addImm(0);
+  auto Ret = MIRBuilder.buildInstr(TVM::RETURN_N);
+  if (Val) {
+    constrainReg(MIRBuilder, VReg, *RC);
+    Ret.addUse(VReg);
+  }
+  return true;
+}
+
+bool TVMCallLowering::lowerFormalArguments(MachineIRBuilder &MIRBuilder,
+                                           const Function &F,
+                                           ArrayRef<unsigned> VRegs) const {
+  if (!CallingConvSupported(F.getCallingConv()) || F.isVarArg())
+    return false;
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  for (const Argument &Arg : F.args())
+    if (!getRegClassFor(DL, Arg.getType()) || Arg.hasByValAttr() ||
+        Arg.hasInAllocaAttr() || Arg.hasNestAttr())
+      return false;
+
+  MachineFunction &MF = MIRBuilder.getMF();
+  MF.getRegInfo().addLiveIn(TVM::ARGUMENTS);
+  auto *FI = MF.getInfo<TVMFunctionInfo>();
+  const auto &TLI = *getTLI<TVMTargetLowering>();
+
+  for (const Argument &Arg : F.args()) {
+    unsigned ArgNo = Arg.getArgNo();
+    MVT VT = TLI.getSimpleValueType(DL, Arg.getType());
+    FI->addParam(VT);
+    // Unused arguments are undefined, as in TVMTargetLowering.
+    if (Arg.use_empty())
+      continue;
+    unsigned Opc;
+    switch (VT.SimpleTy) {
+    default:
+      llvm_unreachable("Unexpected argument type");
+    case MVT::i257:       Opc = TVM::ARGUMENT;         break;
+    case MVT::TVMSlice:   Opc = TVM::ARGUMENT_SLICE;   break;
+    case MVT::TVMBuilder: Opc = TVM::ARGUMENT_BUILDER; break;
+    case MVT::TVMCell:    Opc = TVM::ARGUMENT_CELL;    break;
+    case MVT::TVMTuple:   Opc = TVM::ARGUMENT_TUPLE;   break;
+    }
+    constrainReg(MIRBuilder, VRegs[ArgNo], *TLI.getRegClassFor(VT));
+    // The argument number is an i257 constant as SelectionDAG emits it.
+    MIRBuilder.buildInstr(Opc).addDef(VRegs[ArgNo]).addCImm(
+        ConstantInt::get(F.getContext(), APInt(257, ArgNo)));
+  }
+
+  // Save c0 for further return lowering.
+  unsigned C0VirtReg =
+      MF.getRegInfo().createVirtualRegister(&TVM::I257RegClass);
+  MIRBuilder.buildInstr(TVM::PUSHC).addDef(C0VirtReg).addImm(0);
+  FI->setC0VirtReg(C0VirtReg);
+  return true;
+}
+
+bool TVMCallLowering::lowerCall(MachineIRBuilder &MIRBuilder,
+                                CallingConv::ID CallConv,
+                                const MachineOperand &Callee,
+                                const ArgInfo &OrigRet,
+                                ArrayRef<ArgInfo> OrigArgs) const {
+  if (!Callee.isGlobal() || !CallingConvSupported(CallConv))
+    return false;
+  const auto *F = dyn_cast<Function>(Callee.getGlobal());
+  if (!F || F->isVarArg())
+    return false;
+
+  const DataLayout &DL = MIRBuilder.getMF().getDataLayout();
+  for (const ArgInfo &Arg : OrigArgs)
+    if (!getRegClassFor(DL, Arg.Ty) || Arg.Flags.isByVal() ||
+        Arg.Flags.isInAlloca() || Arg.Flags.isNest())
+      return false;
+
+  // A call of a non-recursive internal function doesn't need to go through
+  // the dictionary of functions, see TVMTargetLowering::LowerCall.
+  bool DictCall = !(F->hasInternalLinkage() && F->doesNotRecurse());
+  const TargetRegisterClass *RetRC = nullptr;
+  unsigned Opc;
+  if (OrigRet.Ty->isVoidTy()) {
+    Opc = DictCall ? TVM::CALLDICT_VOID : TVM::CALL_VOID;
+  } else {
+    // Multiple return values are packed into one wide register by the
+    // IRTranslator, leave them to SelectionDAG.
+    RetRC = getRegClassFor(DL, OrigRet.Ty);
+    if (!RetRC)
+      return false;
+    switch (RetRC->getID()) {
+    default:
+      llvm_unreachable("Unexpected register class");
+    case TVM::I257RegClassID:
+      Opc = DictCall ? TVM::CALLDICT_1_INT : TVM::CALL_1_INT;
+      break;
+    case TVM::SliceRegClassID:
+      Opc = DictCall ? TVM::CALLDICT_1_SLICE : TVM::CALL_1_SLICE;
+      break;
+    case TVM::BuilderRegClassID:
+      Opc = DictCall ? TVM::CALLDICT_1_BUILDER : TVM::CALL_1_BUILDER;
+      break;
+    case TVM::CellRegClassID:
+      Opc = DictCall ? TVM::CALLDICT_1_CELL : TVM::CALL_1_CELL;
+      break;
+    case TVM::TupleRegClassID:
+      Opc = DictCall ? TVM::CALLDICT_1_TUPLE : TVM::CALL_1_TUPLE;
+      break;
+    }
+  }
+
+  auto MIB = MIRBuilder.buildInstrNoInsert(Opc);
+  if (RetRC) {
+    constrainReg(MIRBuilder, OrigRet.Reg, *RetRC);
+    MIB.addDef(OrigRet.Reg);
+  }
+  MIB.addGlobalAddress(F);
+  for (const ArgInfo &Arg : OrigArgs) {
+    constrainReg(MIRBuilder, Arg.Reg, *getRegClassFor(DL, Arg.Ty));
+    MIB.addUse(Arg.Reg);
+  }
+  MIRBuilder.insertInstr(MIB);
+  return true;
+}
@@ -0,0 +1,48 @@
+//===-- TVMCallLowering.h - Call lowering for GlobalISel --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file describes how to lower LLVM calls, arguments and returns to TVM
+/// machine code for GlobalISel.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_TVM_TVMCALLLOWERING_H
+#define LLVM_LIB_TARGET_TVM_TVMCALLLOWERING_H
+
+#include "llvm/CodeGen/GlobalISel/CallLowering.h"
+
+namespace llvm {
+
+class TVMTargetLowering;
+
+class TVMCallLowering : public CallLowering {
+public:
+  TVMCallLowering(const TVMTargetLowering &TLI);
+
+  bool lowerReturn(MachineIRBuilder &MIRBuilder, const Value *Val,
+                   unsigned VReg) const override;
+
+  bool lowerFormalArguments(MachineIRBuilder &MIRBuilder, const Function &F,
+                            ArrayRef<unsigned> VRegs) const override;
+
+  bool lowerCall(MachineIRBuilder &MIRBuilder, CallingConv::ID CallConv,
+                 const MachineOperand &Callee, const ArgInfo &OrigRet,
+                 ArrayRef<ArgInfo> OrigArgs) const override;
+
+private:
+  /// Get the register class of values of type \p Ty or nullptr if the type
+  /// isn't legal (i257 or one of the TVM reference types).
+  const TargetRegisterClass *getRegClassFor(const DataLayout &DL,
+                                            Type *Ty) const;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_LIB_TARGET_TVM_TVMCALLLOWERING_H
@@ -0,0 +1,463 @@
+//===------ TVMCodeLayout.cpp - Place continuations into code cells -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Decide which continuation bodies stay inline and which are moved into
+/// separate code cells, so that the hot path of a function touches as few
+/// cells as possible.
+///
+/// TVM code is a tree of cells of at most 1023 bits and 4 references each.
+/// When a body doesn't fit into a cell, the rest of it is continued in a
+/// referenced cell that is loaded (100 gas) once execution gets there.
+/// Continuation bodies pushed with PUSHCONT occupy the space of the parent
+/// cell whether they are executed or not, while PUSHREFCONT keeps the body in
+/// its own cell at the price of loading that cell once it's pushed. A body
+/// entered by IFJMP / IFNOTJMP right after its push is moved with IFJMPREF /
+/// IFNOTJMPREF instead, which loads the cell only if the jump is taken.
+/// TVMHotColdSplit has already moved the bodies ending in an exception this
+/// way.
+///
+/// The pass models the cells of each function using the bit lengths of the
+/// instructions (see TVMInstrInfo::getCodeBits) and block frequencies: a
+/// cell is loaded with the probability of reaching the most frequent block
+/// with code in it. Continuations are kept inline unless moving one of them
+/// to PUSHREFCONT reduces the expected number of cell loads of its parent;
+/// the coldest ones are tried first.
+///
+/// With -tvm-code-layout-report the pass prints the number of cells each
+/// function occupies and the cells touched by its hot path. For externally
+/// visible functions (public methods) the cells of the functions called on
+/// the hot path, transitively, are accounted for as well. Functions are
+/// separate entries of the code dictionary, so the order of functions does
+/// not affect the layout of their cells.
+///
+//===----------------------------------------------------------------------===//
+
+#include <vector>
+
+#include "TVM.h"
+#include "TVMMachineFunctionInfo.h"
+#include "TVMSubtarget.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-code-layout"
+
+static cl::opt<bool>
+    DisableTVMCodeLayout("disable-tvm-code-layout", cl::Hidden,
+                         cl::desc("TVM: Keep all continuations inline."),
+                         cl::init(false));
+static cl::opt<bool> TVMCodeLayoutReport(
+    "tvm-code-layout-report", cl::Hidden,
+    cl::desc("TVM: Report code cells touched by hot paths of functions."),
+    cl::init(false));
+
+STATISTIC(NumRefConts, "Number of continuations moved into separate cells");
+
+/// Code cell limits. One reference is kept for continuing the code in the
+/// next cell.
+static constexpr unsigned CellBits = 1023;
+static constexpr unsigned CellRefs = 3;
+/// A block is on the hot path if it's executed at least this often per
+/// execution of the function.
+static constexpr double HotThreshold = 0.5;
+
+namespace {
+/// A continuation body: the function body or a block pushed by PUSHCONT,
+/// with the blocks it falls through to.
+struct Continuation {
+  SmallVector<MachineBasicBlock *, 4> Blocks;
+  /// The instruction pushing the continuation, nullptr for the function body.
+  MachineInstr *Push = nullptr;
+  /// Continuations pushed by the body, in the order of pushes.
+  SmallVector<unsigned, 4> Children;
+  /// Executions of the body per execution of the parent body.
+  double Weight = 1.0;
+  bool InRef = false;
+  /// Layout of the body, computed by layout().
+  unsigned Bits = 0;
+  unsigned Refs = 0;
+  unsigned Cells = 0;
+  unsigned HotCells = 0;
+  /// Expected number of cells loaded per execution of the body, including
+  /// nested continuations but not the first cell of the body.
+  double Loads = 0;
+};
+
+/// Layout summary of a function for the report.
+struct FunctionLayout {
+  std::string Name;
+  bool Public = false;
+  unsigned Bits = 0;
+  unsigned Cells = 0;
+  unsigned HotCells = 0;
+  double Loads = 0;
+  unsigned RefConts = 0;
+  std::vector<std::string> HotCallees;
+};
+
+class TVMCodeLayout final : public MachineFunctionPass {
+  StringRef getPassName() const override { return "TVM code cells layout"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    AU.addRequired<MachineBlockFrequencyInfo>();
+    AU.addPreserved<MachineBlockFrequencyInfo>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+  bool doFinalization(Module &M) override;
+
+  unsigned collect(MachineBasicBlock *Head, MachineInstr *Push);
+  void layout(unsigned Idx);
+  double frequency(const MachineBasicBlock *MBB) const;
+  void report(MachineFunction &MF);
+
+  const TVMInstrInfo *TII = nullptr;
+  MachineBlockFrequencyInfo *MBFI = nullptr;
+  std::vector<Continuation> Conts;
+  DenseMap<const MachineInstr *, unsigned> PushedConts;
+  std::vector<FunctionLayout> Functions;
+
+public:
+  static char ID;
+  TVMCodeLayout() : MachineFunctionPass(ID) {}
+};
+} // end anonymous namespace
+
+char TVMCodeLayout::ID = 0;
+INITIALIZE_PASS_BEGIN(TVMCodeLayout, DEBUG_TYPE,
+                      "Place TVM continuations into code cells", false, false)
+INITIALIZE_PASS_DEPENDENCY(MachineBlockFrequencyInfo)
+INITIALIZE_PASS_END(TVMCodeLayout, DEBUG_TYPE,
+                    "Place TVM continuations into code cells", false, false)
+
+FunctionPass *llvm::createTVMCodeLayout() { return new TVMCodeLayout(); }
+
+static bool isRefJump(const MachineInstr &MI) {
+  return MI.getOpcode() == TVM::IFJMPREF_MBB ||
+         MI.getOpcode() == TVM::IFNOTJMPREF_MBB;
+}
+
+/// Get the conditional jump entering the body pushed by \p Push right after
+/// the push, the pair can be fused into IFJMPREF / IFNOTJMPREF.
+static MachineInstr *getFusableJump(MachineInstr &Push) {
+  if (Push.getOpcode() != TVM::PUSHCONT_MBB_S)
+    return nullptr;
+  auto Next = std::next(Push.getIterator());
+  if (Next == Push.getParent()->end() ||
+      (Next->getOpcode() != TVM::IFJMP_S &&
+       Next->getOpcode() != TVM::IFNOTJMP_S))
+    return nullptr;
+  return &*Next;
+}
+
+static bool isPushCont(const MachineInstr &MI) {
+  return MI.getOpcode() == TVM::PUSHCONT_MBB_S ||
+         MI.getOpcode() == TVM::PUSHREFCONT_MBB || isRefJump(MI);
+}
+
+/// Whether the asm printer continues the function body with the block
+/// following \p MBB in the layout, see TVMAsmPrinter::ShouldPrintNextBlock.
+static bool continuesWithNextBlock(const MachineBasicBlock &MBB) {
+  auto Term = MBB.terminators();
+  return Term.begin() == Term.end() ||
+         Term.begin()->getOpcode() == TVM::IFJMP_S ||
+         Term.begin()->getOpcode() == TVM::IFNOTJMP_S ||
+         isRefJump(*Term.begin());
+}
+
+double TVMCodeLayout::frequency(const MachineBasicBlock *MBB) const {
+  return static_cast<double>(MBFI->getBlockFreq(MBB).getFrequency()) /
+         MBFI->getEntryFreq();
+}
+
+/// \brief Collect the continuation starting at \p Head with all the
+/// continuations nested into it.
+/// \return index of the continuation in Conts.
+unsigned TVMCodeLayout::collect(MachineBasicBlock *Head, MachineInstr *Push) {
+  unsigned Idx = Conts.size();
+  Conts.emplace_back();
+  Conts[Idx].Push = Push;
+  if (Push)
+    PushedConts[Push] = Idx;
+
+  // Follow the same blocks the body is printed from, see TVMMCInstLower.
+  SmallVector<MachineBasicBlock *, 4> Blocks;
+  if (Push) {
+    for (auto *MBB = Head; MBB; MBB = MBB->getFallThrough())
+      Blocks.push_back(MBB);
+  } else {
+    for (auto It = Head->getIterator(), E = Head->getParent()->end(); It != E;
+         ++It) {
+      Blocks.push_back(&*It);
+      if (!continuesWithNextBlock(*It))
+        break;
+    }
+  }
+
+  SmallVector<unsigned, 4> Children;
+  for (auto *MBB : Blocks)
+    for (auto &MI : *MBB)
+      if (isPushCont(MI))
+        Children.push_back(collect(MI.getOperand(0).getMBB(), &MI));
+
+  Continuation &C = Conts[Idx];
+  C.Blocks = std::move(Blocks);
+  C.Children = std::move(Children);
+  C.InRef = Push && (Push->getOpcode() == TVM::PUSHREFCONT_MBB ||
+                     isRefJump(*Push));
+  double HeadFreq = frequency(Head);
+  for (unsigned Child : C.Children) {
+    double Freq = frequency(Conts[Child].Blocks.front());
+    Conts[Child].Weight = HeadFreq > 0 ? std::min(1.0, Freq / HeadFreq) : 0;
+  }
+  return Idx;
+}
+
+/// Bit length of PUSHCONT with the body of \p Bits and \p Refs: 9x has room
+/// for 15 bytes and no references, 8F_rxx is used otherwise.
+static unsigned getPushContBits(unsigned Bits, unsigned Refs) {
+  return Refs == 0 && Bits <= 15 * 8 ? 8 : 16;
+}
+
+/// \brief Compute layout of the continuation \p Idx given the current
+/// placement of its children.
+void TVMCodeLayout::layout(unsigned Idx) {
+  Continuation &C = Conts[Idx];
+  double HeadFreq = frequency(C.Blocks.front());
+  auto probability = [&](const MachineBasicBlock *MBB) {
+    return HeadFreq > 0 ? std::min(1.0, frequency(MBB) / HeadFreq) : 0;
+  };
+
+  C.Bits = C.Refs = 0;
+  C.Cells = C.HotCells = 1;
+  C.Loads = 0;
+  unsigned CellBitsUsed = 0, CellRefsUsed = 0;
+  // Probability to reach the current cell.
+  double CellProb = 0;
+  auto place = [&](unsigned Bits, unsigned Refs, double Prob) {
+    if (CellBitsUsed + Bits > CellBits || CellRefsUsed + Refs > CellRefs) {
+      if (C.Cells > 1) {
+        C.Loads += CellProb;
+        C.HotCells += CellProb >= HotThreshold;
+      }
+      ++C.Cells;
+      CellBitsUsed = CellRefsUsed = 0;
+      CellProb = 0;
+    }
+    CellBitsUsed += Bits;
+    CellRefsUsed += Refs;
+    CellProb = std::max(CellProb, Prob);
+    C.Bits += Bits;
+    C.Refs += Refs;
+  };
+
+  for (auto *MBB : C.Blocks) {
+    double Prob = probability(MBB);
+    for (auto &MI : *MBB) {
+      if (!isPushCont(MI)) {
+        unsigned Refs = 0;
+        unsigned Bits = TII->getCodeBits(MI, &Refs);
+        place(Bits, Refs, Prob);
+        continue;
+      }
+      const Continuation &Child = Conts[PushedConts[&MI]];
+      if (Child.InRef) {
+        // PUSHREFCONT loads the cell when pushed, IFJMPREF on the jump.
+        bool OnJump = isRefJump(MI) || getFusableJump(MI);
+        double LoadProb = OnJump ? Child.Weight : Prob;
+        place(TII->getCodeBits(MI), 1, Prob);
+        C.Loads += LoadProb;
+        C.HotCells += LoadProb >= HotThreshold;
+      } else {
+        place(getPushContBits(Child.Bits, Child.Refs) + Child.Bits, Child.Refs,
+              Prob);
+        // The first cell of the body is the one of the push.
+      }
+      C.Loads += Child.Weight * Child.Loads;
+      if (Child.Weight >= HotThreshold)
+        C.HotCells += Child.HotCells - 1;
+    }
+  }
+  if (C.Cells > 1) {
+    C.Loads += CellProb;
+    C.HotCells += CellProb >= HotThreshold;
+  }
+  // Code is byte aligned.
+  C.Bits = alignTo(C.Bits, 8);
+}
+
+bool TVMCodeLayout::runOnMachineFunction(MachineFunction &MF) {
+  LLVM_DEBUG(dbgs() << "********** TVM Code Layout **********\n"
+                       "********** Function: "
+                    << MF.getName() << '\n');
+
+  TII = MF.getSubtarget<TVMSubtarget>().getInstrInfo();
+  MBFI = &getAnalysis<MachineBlockFrequencyInfo>();
+  Conts.clear();
+  PushedConts.clear();
+  collect(&MF.front(), nullptr);
+
+  // Children are collected after their parents, so traversing in reverse
+  // order lays out the children first.
+  bool Changed = false;
+  for (unsigned Idx = Conts.size(); Idx-- > 0;) {
+    Continuation &C = Conts[Idx];
+    for (unsigned Child : C.Children)
+      if (!Conts[Child].InRef && Conts[Child].Cells > 1)
+        // Too big to be inline, the assembler puts it into a cell anyway.
+        Conts[Child].InRef = true;
+    layout(Idx);
+    if (DisableTVMCodeLayout || skipFunction(MF.getFunction()))
+      continue;
+
+    SmallVector<unsigned, 4> Candidates;
+    for (unsigned Child : C.Children)
+      if (!Conts[Child].InRef)
+        Candidates.push_back(Child);
+    std::sort(Candidates.begin(), Candidates.end(), [&](unsigned L, unsigned R) {
+      return Conts[L].Weight < Conts[R].Weight;
+    });
+    for (unsigned Child : Candidates) {
+      double Loads = Conts[Idx].Loads;
+      Conts[Child].InRef = true;
+      layout(Idx);
+      if (Conts[Idx].Loads < Loads - 0.01) {
+        MachineInstr *Push = Conts[Child].Push;
+        LLVM_DEBUG(dbgs() << "Moving into a separate cell: " << *Push);
+        auto *MFI = MF.getInfo<TVMFunctionInfo>();
+        MachineInstr *NewPush;
+        if (MachineInstr *Jump = getFusableJump(*Push)) {
+          unsigned Opc = Jump->getOpcode() == TVM::IFJMP_S
+                             ? TVM::IFJMPREF_MBB
+                             : TVM::IFNOTJMPREF_MBB;
+          NewPush = BuildMI(*Push->getParent(), Jump, Jump->getDebugLoc(),
+                            TII->get(Opc))
+                        .add(Push->getOperand(0));
+          // The stack after the fused jump is the one after IFJMP.
+          MFI->cloneMachineInstrIntermediateData(Jump, NewPush);
+          MFI->clearIntermediateData(Jump);
+          Jump->eraseFromParent();
+        } else {
+          NewPush = BuildMI(*Push->getParent(), Push, Push->getDebugLoc(),
+                            TII->get(TVM::PUSHREFCONT_MBB))
+                        .add(Push->getOperand(0));
+          MFI->cloneMachineInstrIntermediateData(Push, NewPush);
+        }
+        MFI->clearIntermediateData(Push);
+        PushedConts.erase(Push);
+        PushedConts[NewPush] = Child;
+        Push->eraseFromParent();
+        Conts[Child].Push = NewPush;
+        ++NumRefConts;
+        Changed = true;
+      } else {
+        Conts[Child].InRef = false;
+        layout(Idx);
+      }
+    }
+  }
+
+  if (TVMCodeLayoutReport)
+    report(MF);
+  return Changed;
+}
+
+static StringRef getCallee(const MachineInstr &MI) {
+  for (const MachineOperand &MO : MI.explicit_operands()) {
+    if (MO.isGlobal())
+      return MO.getGlobal()->getName();
+    if (MO.isSymbol())
+      return MO.getSymbolName();
+  }
+  return {};
+}
+
+/// \brief Record the layout of \p MF for the report printed at finalization.
+void TVMCodeLayout::report(MachineFunction &MF) {
+  const Function &F = MF.getFunction();
+  FunctionLayout FL;
+  FL.Name = MF.getName();
+  FL.Public = !F.hasLocalLinkage() && !F.hasFnAttribute("tvm_raw_func");
+  const Continuation &Root = Conts.front();
+  FL.HotCells = Root.HotCells;
+  FL.Loads = 1 + Root.Loads;
+  for (const Continuation &C : Conts) {
+    if (!C.Push || C.InRef) {
+      FL.Bits += C.Bits;
+      FL.Cells += C.Cells;
+    }
+    FL.RefConts += C.Push && C.InRef;
+  }
+  for (auto &MBB : MF) {
+    if (frequency(&MBB) < HotThreshold)
+      continue;
+    for (auto &MI : MBB) {
+      StringRef Callee = MI.isCall() ? getCallee(MI) : StringRef();
+      if (!Callee.empty())
+        FL.HotCallees.push_back(Callee);
+    }
+  }
+  Functions.push_back(std::move(FL));
+}
+
+bool TVMCodeLayout::doFinalization(Module &M) {
+  if (!TVMCodeLayoutReport || Functions.empty())
+    return false;
+
+  StringMap<const FunctionLayout *> ByName;
+  for (const auto &FL : Functions)
+    ByName[FL.Name] = &FL;
+
+  raw_ostream &OS = errs();
+  OS << "===-- TVM code layout --===\n";
+  for (const auto &FL : Functions) {
+    OS << FL.Name << ": " << FL.Bits << " bits in " << FL.Cells
+       << " cells, hot path touches " << FL.HotCells << " cells, "
+       << format("%.2f", FL.Loads) << " cell loads expected";
+    if (FL.RefConts)
+      OS << ", " << FL.RefConts << " continuations in separate cells";
+    OS << '\n';
+  }
+  // A call loads the cell with CALLREF and then the cells of the callee.
+  for (const auto &FL : Functions) {
+    if (!FL.Public)
+      continue;
+    SmallPtrSet<const FunctionLayout *, 8> Visited;
+    SmallVector<const FunctionLayout *, 8> Worklist{&FL};
+    unsigned Cells = 0;
+    while (!Worklist.empty()) {
+      const FunctionLayout *Cur = Worklist.pop_back_val();
+      if (!Visited.insert(Cur).second)
+        continue;
+      Cells += Cur->HotCells + (Cur != &FL);
+      for (const auto &Callee : Cur->HotCallees) {
+        auto It = ByName.find(Callee);
+        if (It != ByName.end())
+          Worklist.push_back(It->second);
+      }
+    }
+    OS << "method " << FL.Name << ": hot path touches " << Cells
+       << " cells in " << Visited.size() << " functions\n";
+  }
+  Functions.clear();
+  return false;
+}
@@ -0,0 +1,199 @@
+//===-- TVMConstGlobalEmbed.cpp - Embed read-only global data into code ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Read constant global arrays from the code instead of the memory.
+///
+/// A load from the memory is a call of the :load runtime function which looks
+/// the address up in the dictionary of globals (GETGLOB 13 CALLX and a
+/// DICTIGET over the dictionary of all the globals). Constant arrays of
+/// integers (lookup tables, string literals) don't need to be there: the pass
+/// packs the elements of such an array into a slice pushed from the code and
+/// replaces a load of the element with index %i by
+///   PUSHSLICE x{data} ; %i * Width SDSKIPFIRST ; Width PLDU (or PLDI)
+/// The slice is embedded into the code cell if it fits into the short form of
+/// PUSHSLICE or is placed into a referenced cell otherwise (PUSHREFSLICE).
+/// An array whose loads are all replaced is not emitted among the globals.
+///
+/// Each element takes the minimal number of bits to represent all the
+/// elements of the array as unsigned (or, if shorter, signed) integers.
+/// The packed array must fit into a single cell. Loads of elements with
+/// constant indices are folded.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVM.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Local.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-const-global-embed"
+
+STATISTIC(NumEmbedded, "Number of loads from constant globals embedded");
+STATISTIC(NumFolded, "Number of loads from constant globals folded");
+
+namespace {
+class TVMConstGlobalEmbed final : public FunctionPass {
+  StringRef getPassName() const override {
+    return "Embed read-only global data into code";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+public:
+  static char ID;
+  explicit TVMConstGlobalEmbed() : FunctionPass(ID) {}
+};
+
+/// Packing of the elements of a constant array.
+struct EmbeddedArray {
+  unsigned Width = 0;
+  bool Signed = false;
+  bool Embeddable = false;
+};
+} // End anonymous namespace
+
+char TVMConstGlobalEmbed::ID = 0;
+INITIALIZE_PASS(TVMConstGlobalEmbed, DEBUG_TYPE,
+                "Embed read-only global data into code", false, false)
+
+FunctionPass *llvm::createTVMConstGlobalEmbed() {
+  return new TVMConstGlobalEmbed();
+}
+
+/// Bits available in a cell.
+static const unsigned CellBits = 1023;
+/// Width limit of PLDU / PLDI.
+static const unsigned MaxWidth = 256;
+
+static EmbeddedArray analyzeGlobal(const GlobalVariable &GV) {
+  EmbeddedArray Arr;
+  if (!GV.isConstant() || !GV.hasDefinitiveInitializer())
+    return Arr;
+  const Constant *Init = GV.getInitializer();
+  auto *Ty = dyn_cast<ArrayType>(Init->getType());
+  if (!Ty || !Ty->getElementType()->isIntegerTy() ||
+      Ty->getNumElements() == 0 || Ty->getNumElements() > CellBits)
+    return Arr;
+  unsigned UnsignedWidth = 1, SignedWidth = 1;
+  for (unsigned I = 0, E = Ty->getNumElements(); I != E; ++I) {
+    const Constant *Elt = Init->getAggregateElement(I);
+    if (isa<UndefValue>(Elt))
+      continue;
+    const auto *CI = dyn_cast<ConstantInt>(Elt);
+    if (!CI)
+      return Arr;
+    UnsignedWidth = std::max(UnsignedWidth, CI->getValue().getActiveBits());
+    SignedWidth = std::max(SignedWidth, CI->getValue().getMinSignedBits());
+  }
+  Arr.Signed = SignedWidth < UnsignedWidth;
+  Arr.Width = Arr.Signed ? SignedWidth : UnsignedWidth;
+  Arr.Embeddable =
+      Arr.Width <= MaxWidth && Arr.Width * Ty->getNumElements() <= CellBits;
+  return Arr;
+}
+
+/// \brief Get the constant global array \p LI loads an element of.
+/// \return the index of the element or nullptr if \p LI is not such a load.
+static Value *getLoadedElement(LoadInst *LI, GlobalVariable *&GV) {
+  if (!LI->isSimple())
+    return nullptr;
+  auto *GEP = dyn_cast<GEPOperator>(LI->getPointerOperand());
+  if (!GEP || GEP->getNumIndices() != 2)
+    return nullptr;
+  GV = dyn_cast<GlobalVariable>(GEP->getPointerOperand());
+  if (!GV || !GV->getValueType()->isArrayTy() ||
+      GV->getValueType()->getArrayElementType() != LI->getType())
+    return nullptr;
+  auto *First = dyn_cast<ConstantInt>(GEP->getOperand(1));
+  if (!First || !First->isZero())
+    return nullptr;
+  return GEP->getOperand(2);
+}
+
+/// \brief Replace \p LI loading the element \p Idx of \p GV with a read from
+/// the slice embedded into the code.
+static void embedLoad(LoadInst *LI, GlobalVariable *GV, Value *Idx,
+                      const EmbeddedArray &Arr) {
+  IRBuilder<> Builder(LI);
+  Module *M = LI->getModule();
+  Type *Int257Ty = Builder.getIntNTy(257);
+  Value *Width = Builder.getIntN(257, Arr.Width);
+  auto *Push = Intrinsic::getDeclaration(M, Intrinsic::tvm_pushslice_data);
+  auto *Skip = Intrinsic::getDeclaration(M, Intrinsic::tvm_sdskipfirst);
+  auto *Load = Intrinsic::getDeclaration(
+      M, Arr.Signed ? Intrinsic::tvm_pldi : Intrinsic::tvm_pldu);
+
+  Value *Data = Builder.CreateCall(
+      Push, {Builder.CreatePtrToInt(GV, Int257Ty), Width});
+  Value *Offset =
+      Builder.CreateMul(Builder.CreateSExtOrTrunc(Idx, Int257Ty), Width);
+  Data = Builder.CreateCall(Skip, {Data, Offset});
+  Value *Val = Builder.CreateCall(Load, {Data, Width});
+  Val = Builder.CreateTrunc(Val, LI->getType());
+  LLVM_DEBUG(dbgs() << "Embedding " << *LI << "\n");
+  LI->replaceAllUsesWith(Val);
+}
+
+bool TVMConstGlobalEmbed::runOnFunction(Function &F) {
+  if (skipFunction(F))
+    return false;
+
+  DenseMap<const GlobalVariable *, EmbeddedArray> Arrays;
+  SmallVector<LoadInst *, 16> Replaced;
+  for (Instruction &I : instructions(F)) {
+    auto *LI = dyn_cast<LoadInst>(&I);
+    GlobalVariable *GV = nullptr;
+    Value *Idx = LI ? getLoadedElement(LI, GV) : nullptr;
+    if (!Idx)
+      continue;
+    auto It = Arrays.find(GV);
+    if (It == Arrays.end())
+      It = Arrays.insert({GV, analyzeGlobal(*GV)}).first;
+    const EmbeddedArray &Arr = It->second;
+    if (!Arr.Embeddable)
+      continue;
+
+    if (auto *CIdx = dyn_cast<ConstantInt>(Idx)) {
+      // An out of range index is left for the runtime to handle.
+      if (CIdx->getValue().uge(GV->getValueType()->getArrayNumElements()))
+        continue;
+      Constant *Elt =
+          GV->getInitializer()->getAggregateElement(CIdx->getZExtValue());
+      LI->replaceAllUsesWith(Elt);
+      ++NumFolded;
+    } else {
+      embedLoad(LI, GV, Idx, Arr);
+      ++NumEmbedded;
+    }
+    Replaced.push_back(LI);
+  }
+
+  // Remove the loads along with the address computations, so that a global
+  // whose loads are all replaced is left with embedding uses only.
+  for (LoadInst *LI : Replaced)
+    RecursivelyDeleteTriviallyDeadInstructions(LI);
+  for (auto &Arr : Arrays)
+    Arr.first->removeDeadConstantUsers();
+  return !Replaced.empty();
+}
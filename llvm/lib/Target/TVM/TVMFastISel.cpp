@@ -0,0 +1,459 @@
+//===-- TVMFastISel.cpp - TVM FastISel implementation ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file defines the TVM-specific support for the FastISel class.
+///
+/// Every TVM value is i257, so building, legalizing and combining a DAG for
+/// each block dominates -O0 compile time. FastISel selects the common
+/// instructions directly: i257 arithmetic and comparisons, selects, branches,
+/// returns, calls and the cell / slice / builder intrinsics whose operands
+/// are all in registers. Anything else (narrow integer types, memory,
+/// intrinsics with custom lowering) falls back to SelectionDAG.
+///
+/// Arguments are always lowered by SelectionDAG, so that c0 is saved into
+/// TVMFunctionInfo::getC0VirtReg() before any return is selected.
+///
+/// The register forms taking the width in a register (STUX, LDUX, ...) are
+/// used for the intrinsics. They are longer than the forms with an immediate
+/// width SelectionDAG picks for constants, which is fine for -O0.
+///
+//===----------------------------------------------------------------------===//
+
+#include "MCTargetDesc/TVMMCTargetDesc.h"
+#include "TVM.h"
+#include "TVMISelLowering.h"
+#include "TVMMachineFunctionInfo.h"
+#include "TVMSubtarget.h"
+#include "TVMUtilities.h"
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/Analysis.h"
+#include "llvm/CodeGen/FastISel.h"
+#include "llvm/CodeGen/FunctionLoweringInfo.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-fastisel"
+
+namespace {
+
+class TVMFastISel final : public FastISel {
+public:
+  TVMFastISel(FunctionLoweringInfo &FuncInfo, const TargetLibraryInfo *LibInfo)
+      : FastISel(FuncInfo, LibInfo) {}
+
+  bool fastSelectInstruction(const Instruction *I) override;
+  bool fastLowerCall(CallLoweringInfo &CLI) override;
+  bool fastLowerIntrinsicCall(const IntrinsicInst *II) override;
+  unsigned fastMaterializeConstant(const Constant *C) override;
+
+private:
+  /// Get the value type of \p Ty if it is legal (i257 or one of the TVM
+  /// reference types), or MVT::INVALID_SIMPLE_VALUE_TYPE otherwise.
+  MVT getLegalType(Type *Ty) const;
+
+  bool selectBinaryOp(const Instruction *I);
+  bool selectICmp(const Instruction *I);
+  bool selectSelect(const Instruction *I);
+  bool selectExt(const Instruction *I);
+  bool selectBr(const Instruction *I);
+  bool selectRet(const Instruction *I);
+};
+
+} // end anonymous namespace
+
+/// Test whether the given calling convention is supported, the same set as
+/// in TVMTargetLowering.
+static bool CallingConvSupported(CallingConv::ID CallConv) {
+  return CallConv == CallingConv::C || CallConv == CallingConv::Fast ||
+         CallConv == CallingConv::Cold ||
+         CallConv == CallingConv::PreserveMost ||
+         CallConv == CallingConv::PreserveAll ||
+         CallConv == CallingConv::CXX_FAST_TLS;
+}
+
+MVT TVMFastISel::getLegalType(Type *Ty) const {
+  EVT VT = TLI.getValueType(DL, Ty, /*AllowUnknown=*/true);
+  if (!VT.isSimple() || !TLI.isTypeLegal(VT))
+    return MVT::INVALID_SIMPLE_VALUE_TYPE;
+  return VT.getSimpleVT();
+}
+
+unsigned TVMFastISel::fastMaterializeConstant(const Constant *C) {
+  // Booleans are zero extended as SelectionDAG promotes i1 constants, other
+  // narrow integers are left to SelectionDAG.
+  const auto *CI = dyn_cast<ConstantInt>(C);
+  if (!CI || (CI->getBitWidth() != 1 &&
+              getLegalType(CI->getType()) != MVT::i257))
+    return 0;
+  const ConstantInt *Imm = CI;
+  if (CI->getBitWidth() == 1)
+    Imm = ConstantInt::get(C->getContext(), CI->getValue().zext(257));
+  unsigned ResultReg = createResultReg(&TVM::I257RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TVM::CONST_I257),
+          ResultReg)
+      .addCImm(Imm);
+  return ResultReg;
+}
+
+bool TVMFastISel::selectBinaryOp(const Instruction *I) {
+  if (getLegalType(I->getType()) != MVT::i257)
+    return false;
+  unsigned Opc;
+  switch (I->getOpcode()) {
+  default:
+    return false;
+  case Instruction::Add:  Opc = TVM::ADD; break;
+  case Instruction::Sub:  Opc = TVM::SUB; break;
+  case Instruction::Mul:  Opc = TVM::MUL; break;
+  case Instruction::And:  Opc = TVM::AND; break;
+  case Instruction::Or:   Opc = TVM::OR; break;
+  case Instruction::Xor:  Opc = TVM::XOR; break;
+  case Instruction::Shl:  Opc = TVM::SHL; break;
+  case Instruction::AShr: Opc = TVM::SHR; break;
+  // Unsigned i257 values are non-negative, see UintBinopPat.
+  case Instruction::SDiv:
+  case Instruction::UDiv: Opc = TVM::DIV; break;
+  case Instruction::SRem:
+  case Instruction::URem: Opc = TVM::MOD; break;
+  }
+  unsigned LHS = getRegForValue(I->getOperand(0));
+  unsigned RHS = getRegForValue(I->getOperand(1));
+  if (!LHS || !RHS)
+    return false;
+  unsigned ResultReg = createResultReg(&TVM::I257RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(Opc), ResultReg)
+      .addReg(LHS)
+      .addReg(RHS);
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+bool TVMFastISel::selectICmp(const Instruction *I) {
+  const auto *ICmp = cast<ICmpInst>(I);
+  if (getLegalType(ICmp->getOperand(0)->getType()) != MVT::i257)
+    return false;
+  // Unsigned i257 values are non-negative, see ComparisonUint.
+  unsigned Opc;
+  switch (ICmp->getPredicate()) {
+  default:
+    return false;
+  case ICmpInst::ICMP_EQ:  Opc = TVM::EQ; break;
+  case ICmpInst::ICMP_NE:  Opc = TVM::NE; break;
+  case ICmpInst::ICMP_SLT:
+  case ICmpInst::ICMP_ULT: Opc = TVM::SLT; break;
+  case ICmpInst::ICMP_SGT:
+  case ICmpInst::ICMP_UGT: Opc = TVM::SGT; break;
+  case ICmpInst::ICMP_SLE:
+  case ICmpInst::ICMP_ULE: Opc = TVM::SLE; break;
+  case ICmpInst::ICMP_SGE:
+  case ICmpInst::ICMP_UGE: Opc = TVM::SGE; break;
+  }
+  unsigned LHS = getRegForValue(ICmp->getOperand(0));
+  unsigned RHS = getRegForValue(ICmp->getOperand(1));
+  if (!LHS || !RHS)
+    return false;
+  unsigned ResultReg = createResultReg(&TVM::I257RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(Opc), ResultReg)
+      .addReg(LHS)
+      .addReg(RHS);
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+bool TVMFastISel::selectSelect(const Instruction *I) {
+  const auto *Select = cast<SelectInst>(I);
+  unsigned Opc;
+  switch (getLegalType(Select->getType()).SimpleTy) {
+  default:
+    return false;
+  case MVT::i257:       Opc = TVM::CONDSEL_I; break;
+  case MVT::TVMSlice:   Opc = TVM::CONDSEL_S; break;
+  case MVT::TVMBuilder: Opc = TVM::CONDSEL_B; break;
+  case MVT::TVMCell:    Opc = TVM::CONDSEL_C; break;
+  case MVT::TVMTuple:   Opc = TVM::CONDSEL_T; break;
+  }
+  // Keep min / max / abs idioms as compact as SelectionDAG does, the
+  // comparison becomes dead then.
+  Value *LHS, *RHS;
+  SelectPatternResult SPR =
+      matchSelectPattern(const_cast<SelectInst *>(Select), LHS, RHS);
+  if (Opc == TVM::CONDSEL_I &&
+      (SPR.Flavor == SPF_SMIN || SPR.Flavor == SPF_SMAX ||
+       SPR.Flavor == SPF_ABS)) {
+    unsigned LHSReg = getRegForValue(LHS);
+    if (!LHSReg)
+      return false;
+    unsigned ResultReg = createResultReg(&TVM::I257RegClass);
+    if (SPR.Flavor == SPF_ABS) {
+      BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TVM::ABS),
+              ResultReg)
+          .addReg(LHSReg);
+    } else {
+      unsigned RHSReg = getRegForValue(RHS);
+      if (!RHSReg)
+        return false;
+      BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+              TII.get(SPR.Flavor == SPF_SMIN ? TVM::MIN : TVM::MAX), ResultReg)
+          .addReg(LHSReg)
+          .addReg(RHSReg);
+    }
+    updateValueMap(I, ResultReg);
+    return true;
+  }
+
+  // CONDSEL takes any non-zero condition as true.
+  unsigned Cond = getRegForValue(Select->getCondition());
+  unsigned TrueReg = getRegForValue(Select->getTrueValue());
+  unsigned FalseReg = getRegForValue(Select->getFalseValue());
+  if (!Cond || !TrueReg || !FalseReg)
+    return false;
+  unsigned ResultReg = createResultReg(MRI.getRegClass(TrueReg));
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(Opc), ResultReg)
+      .addReg(Cond)
+      .addReg(TrueReg)
+      .addReg(FalseReg);
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+bool TVMFastISel::selectExt(const Instruction *I) {
+  // Only extension of booleans is selected here. A promoted i1 has arbitrary
+  // upper bits, so the low bit is extracted first.
+  if (!I->getOperand(0)->getType()->isIntegerTy(1) ||
+      getLegalType(I->getType()) != MVT::i257)
+    return false;
+  unsigned Reg = getRegForValue(I->getOperand(0));
+  unsigned One = getRegForValue(ConstantInt::get(I->getType(), 1));
+  if (!Reg || !One)
+    return false;
+  unsigned ResultReg = createResultReg(&TVM::I257RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TVM::AND),
+          ResultReg)
+      .addReg(Reg)
+      .addReg(One);
+  if (isa<SExtInst>(I)) {
+    unsigned Bit = ResultReg;
+    ResultReg = createResultReg(&TVM::I257RegClass);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TVM::NEGATE),
+            ResultReg)
+        .addReg(Bit);
+  }
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+bool TVMFastISel::selectBr(const Instruction *I) {
+  const auto *Br = cast<BranchInst>(I);
+  if (Br->isUnconditional())
+    return false;
+  MachineBasicBlock *TBB = FuncInfo.MBBMap[Br->getSuccessor(0)];
+  MachineBasicBlock *FBB = FuncInfo.MBBMap[Br->getSuccessor(1)];
+  unsigned Cond = getRegForValue(Br->getCondition());
+  if (!Cond)
+    return false;
+  // The same IFELSE as TVMTargetLowering::LowerBR produces.
+  MachineOperand CondOps[] = {MachineOperand::CreateImm(0),
+                              MachineOperand::CreateReg(Cond, false)};
+  TII.insertBranch(*FuncInfo.MBB, TBB, FBB, CondOps, DbgLoc);
+  // IFELSE leaves the block to both successors, unlike finishCondBranch no
+  // branch to the false one may follow it.
+  for (MachineBasicBlock *Succ : {TBB, FBB}) {
+    if (FuncInfo.MBB->isSuccessor(Succ))
+      continue;
+    if (FuncInfo.BPI)
+      FuncInfo.MBB->addSuccessor(
+          Succ, FuncInfo.BPI->getEdgeProbability(Br->getParent(),
+                                                 Succ->getBasicBlock()));
+    else
+      FuncInfo.MBB->addSuccessorWithoutProb(Succ);
+  }
+  return true;
+}
+
+bool TVMFastISel::selectRet(const Instruction *I) {
+  const auto *Ret = cast<ReturnInst>(I);
+  if (!FuncInfo.CanLowerReturn ||
+      !CallingConvSupported(FuncInfo.Fn->getCallingConv()))
+    return false;
+  unsigned RetReg = 0;
+  if (Ret->getNumOperands()) {
+    const Value *RV = Ret->getOperand(0);
+    if (getLegalType(RV->getType()) == MVT::INVALID_SIMPLE_VALUE_TYPE)
+      return false;
+    RetReg = getRegForValue(RV);
+    if (!RetReg)
+      return false;
+  }
+
+  // Restore c0 for returning to the correct continuation. As in
+  // TVMTargetLowering::RestoreC0, it isn't needed in the block c0 is saved
+  // in.
+  auto *FI = MF->getInfo<TVMFunctionInfo>();
+  assert(FI->hasC0VirtReg() && "C0 virtual register has not been saved");
+  if (FuncInfo.MBB != &MF->front())
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TVM::POPC))
+        .addReg(FI->getC0VirtReg())
+        .addImm(0);
+  auto MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+                     TII.get(TVM::RETURN_N));
+  if (RetReg)
+    MIB.addReg(RetReg);
+  return true;
+}
+
+bool TVMFastISel::fastLowerCall(CallLoweringInfo &CLI) {
+  const auto *F = dyn_cast_or_null<Function>(CLI.Callee);
+  if (!F || CLI.IsVarArg || CLI.IsPatchPoint ||
+      !CallingConvSupported(CLI.CallConv) ||
+      (CLI.CS && CLI.CS->isMustTailCall()))
+    return false;
+
+  SmallVector<MVT, 4> RetVTs;
+  for (const ISD::InputArg &In : CLI.Ins) {
+    if (!TLI.isTypeLegal(In.ArgVT))
+      return false;
+    RetVTs.push_back(In.VT);
+  }
+
+  SmallVector<unsigned, 8> ArgRegs;
+  for (unsigned I = 0, E = CLI.OutVals.size(); I != E; ++I) {
+    ISD::ArgFlagsTy Flags = CLI.OutFlags[I];
+    if (Flags.isByVal() || Flags.isInAlloca() || Flags.isNest() ||
+        getLegalType(CLI.OutVals[I]->getType()) ==
+            MVT::INVALID_SIMPLE_VALUE_TYPE)
+      return false;
+    unsigned Reg = getRegForValue(CLI.OutVals[I]);
+    if (!Reg)
+      return false;
+    ArgRegs.push_back(Reg);
+  }
+
+  // A call of a non-recursive internal function doesn't need to go through
+  // the dictionary of functions, see TVMTargetLowering::LowerCall.
+  bool DictCall = !(F->hasInternalLinkage() && F->doesNotRecurse());
+  unsigned Opc;
+  switch (RetVTs.size()) {
+  case 0:
+    Opc = DictCall ? TVM::CALLDICT_VOID : TVM::CALL_VOID;
+    break;
+  case 1:
+    switch (RetVTs[0].SimpleTy) {
+    default:
+      return false;
+    case MVT::i257:
+      Opc = DictCall ? TVM::CALLDICT_1_INT : TVM::CALL_1_INT;
+      break;
+    case MVT::TVMSlice:
+      Opc = DictCall ? TVM::CALLDICT_1_SLICE : TVM::CALL_1_SLICE;
+      break;
+    case MVT::TVMBuilder:
+      Opc = DictCall ? TVM::CALLDICT_1_BUILDER : TVM::CALL_1_BUILDER;
+      break;
+    case MVT::TVMCell:
+      Opc = DictCall ? TVM::CALLDICT_1_CELL : TVM::CALL_1_CELL;
+      break;
+    case MVT::TVMTuple:
+      Opc = DictCall ? TVM::CALLDICT_1_TUPLE : TVM::CALL_1_TUPLE;
+      break;
+    }
+    break;
+  default:
+    Opc = DictCall ? TVM::CALLDICT_N : TVM::CALL_N;
+    break;
+  }
+
+  // The result registers are consecutive as updateValueMap expects.
+  auto MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(Opc));
+  unsigned ResultReg = 0;
+  for (MVT VT : RetVTs) {
+    unsigned Reg = createResultReg(TLI.getRegClassFor(VT));
+    if (!ResultReg)
+      ResultReg = Reg;
+    MIB.addReg(Reg, RegState::Define);
+  }
+  MIB.addGlobalAddress(F);
+  for (unsigned Reg : ArgRegs)
+    MIB.addReg(Reg);
+
+  CLI.ResultReg = ResultReg;
+  CLI.NumResultRegs = RetVTs.size();
+  CLI.Call = MIB;
+  return true;
+}
+
+bool TVMFastISel::fastLowerIntrinsicCall(const IntrinsicInst *II) {
+  unsigned Opc = TVM::getIntrinsicOpcode(II->getIntrinsicID());
+  if (!Opc)
+    return false;
+
+  SmallVector<EVT, 2> RetVTs;
+  ComputeValueVTs(TLI, DL, II->getType(), RetVTs);
+  const MCInstrDesc &Desc = TII.get(Opc);
+  if (Desc.getNumDefs() != RetVTs.size() ||
+      Desc.getNumOperands() != RetVTs.size() + II->getNumArgOperands())
+    return false;
+  for (EVT VT : RetVTs)
+    if (!TLI.isTypeLegal(VT))
+      return false;
+
+  SmallVector<unsigned, 4> ArgRegs;
+  for (const Value *Arg : II->arg_operands()) {
+    unsigned Reg = getRegForValue(Arg);
+    if (!Reg)
+      return false;
+    ArgRegs.push_back(Reg);
+  }
+
+  auto MIB = BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, Desc);
+  unsigned ResultReg = 0;
+  for (EVT VT : RetVTs) {
+    unsigned Reg = createResultReg(TLI.getRegClassFor(VT.getSimpleVT()));
+    if (!ResultReg)
+      ResultReg = Reg;
+    MIB.addReg(Reg, RegState::Define);
+  }
+  for (unsigned Reg : ArgRegs)
+    MIB.addReg(Reg);
+
+  if (ResultReg)
+    updateValueMap(II, ResultReg, RetVTs.size());
+  return true;
+}
+
+bool TVMFastISel::fastSelectInstruction(const Instruction *I) {
+  switch (I->getOpcode()) {
+  case Instruction::ICmp:
+    return selectICmp(I);
+  case Instruction::Select:
+    return selectSelect(I);
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    return selectExt(I);
+  case Instruction::Br:
+    return selectBr(I);
+  case Instruction::Ret:
+    return selectRet(I);
+  default:
+    break;
+  }
+  if (I->isBinaryOp())
+    return selectBinaryOp(I);
+  return false;
+}
+
+FastISel *TVM::createFastISel(FunctionLoweringInfo &FuncInfo,
+                              const TargetLibraryInfo *LibInfo) {
+  return new TVMFastISel(FuncInfo, LibInfo);
+}
@@ -24,6 +24,8 @@
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Regex.h"
 #include "llvm/Target/TargetOptions.h"
 
 using namespace llvm;
@@ -31,10 +33,50 @@ using namespace llvm;
 //===----------------------------------------------------------------------===//
 // Command line options for TVM
 //===----------------------------------------------------------------------===//
-// Enable debug trace for function calls
+// Enable debug trace for function calls. A traced function reports its
+// numeric id at the entry and at each return with DEBUGSTR, a no-op in
+// production, see tools/tvm-prof/tvm-trace.py for decoding the trace.
 static cl::opt<bool> TraceCalls("tvm-trace-calls", cl::Hidden,
-                                cl::desc("Trace function calls"),
+                                cl::desc("Trace calls of all functions"),
                                 cl::init(false));
+static cl::list<std::string>
+    TraceFunctions("tvm-trace-functions", cl::Hidden, cl::CommaSeparated,
+                   cl::value_desc("regex"),
+                   cl::desc("Trace calls of the functions matching the "
+                            "regular expressions"));
+
+/// Get the trace id of \p F, or 0 if it isn't traced. Functions are traced
+/// with -tvm-trace-calls, -tvm-trace-functions or the "tvm_trace" attribute.
+/// The id is the 1-based position of \p F among the function definitions of
+/// the module.
+unsigned TVMFrameLowering::getTraceId(const Function &F) const {
+  const Module *M = F.getParent();
+  if (M == TracedModule && TraceIds.count(&F))
+    return TraceIds.lookup(&F);
+
+  std::vector<Regex> Patterns;
+  for (const std::string &Pattern : TraceFunctions) {
+    Regex R(Pattern);
+    std::string Error;
+    if (!R.isValid(Error))
+      report_fatal_error("Invalid -tvm-trace-functions pattern '" + Pattern +
+                         "': " + Error);
+    Patterns.push_back(std::move(R));
+  }
+  TracedModule = M;
+  TraceIds.clear();
+  unsigned Id = 0;
+  for (const Function &Fn : *M) {
+    if (Fn.isDeclaration())
+      continue;
+    ++Id;
+    bool Traced = TraceCalls || Fn.hasFnAttribute("tvm_trace") ||
+                  any_of(Patterns,
+                         [&](Regex &R) { return R.match(Fn.getName()); });
+    TraceIds[&Fn] = Traced ? Id : 0;
+  }
+  return TraceIds.lookup(&F);
+}
 
 bool TVMFrameLowering::hasFP(const MachineFunction &MF) const { return false; }
 
@@ -52,7 +94,8 @@ void TVMFrameLowering::emitPrologue(MachineFunction &MF,
   auto &MFI = MF.getFrameInfo();
   auto &MRI = MF.getRegInfo();
   uint64_t StackSize = MFI.getStackSize();
-  if (StackSize == 0 && !TraceCalls)
+  unsigned TraceId = getTraceId(MF.getFunction());
+  if (StackSize == 0 && !TraceId)
     return;
   if (MF.getFunction().hasFnAttribute("tvm_raw_func") && StackSize) {
     report_fatal_error("Raw function requires stack");
@@ -63,11 +106,13 @@ void TVMFrameLowering::emitPrologue(MachineFunction &MF,
       llvm::find_if(MBB, [&](auto &pt) { return !TVM::isArgument(pt); });
 
   DebugLoc DL;
-  if (TraceCalls) {
+  if (TraceId) {
     const Function &Fn = MF.getFunction();
     if (MBB.getBasicBlock() == &Fn.getEntryBlock())
-      BuildMI(MBB, InsertPt, DL, TII->get(TVM::LOGSTR)).addGlobalAddress(&Fn);
+      BuildMI(MBB, InsertPt, DL, TII->get(TVM::TRACE_ENTER)).addImm(TraceId);
   }
+  if (StackSize == 0)
+    return;
 
   // %RegFrameBase:i257 = GETGLOB i257 5
   unsigned RegFrameBase = MRI.createVirtualRegister(&TVM::I257RegClass);
@@ -104,7 +149,8 @@ void TVMFrameLowering::emitEpilogue(MachineFunction &MF,
   auto &MFI = MF.getFrameInfo();
   auto &MRI = MF.getRegInfo();
   uint64_t StackSize = MFI.getStackSize();
-  if (StackSize == 0 && !TraceCalls)
+  unsigned TraceId = getTraceId(MF.getFunction());
+  if (StackSize == 0 && !TraceId)
     return;
 
   auto InsertPt = MBB.getFirstTerminator();
@@ -113,6 +159,11 @@ void TVMFrameLowering::emitEpilogue(MachineFunction &MF,
   if (InsertPt != MBB.end())
     DL = InsertPt->getDebugLoc();
 
+  if (TraceId)
+    BuildMI(MBB, InsertPt, DL, TII->get(TVM::TRACE_EXIT)).addImm(TraceId);
+  if (StackSize == 0)
+    return;
+
   // %RegFrameBase:i257 = GETGLOB i257 5
   unsigned RegFrameBase = MRI.createVirtualRegister(&TVM::I257RegClass);
   BuildMI(MBB, InsertPt, DL, TII->get(TVM::GETGLOB), RegFrameBase)
@@ -15,6 +15,7 @@
 #define LLVM_LIB_TARGET_TVM_TVMFRAMELOWERING_H
 
 #include "TVM.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/CodeGen/TargetFrameLowering.h"
 
 namespace llvm {
@@ -30,6 +31,14 @@ public:
 
   bool hasFP(const MachineFunction &MF) const override;
   bool hasReservedCallFrame(const MachineFunction &MF) const override;
+
+private:
+  unsigned getTraceId(const Function &F) const;
+
+  /// Trace ids of the functions of the module being compiled, computed once
+  /// per module.
+  mutable const Module *TracedModule = nullptr;
+  mutable DenseMap<const Function *, unsigned> TraceIds;
 };
 
 } // End llvm namespace
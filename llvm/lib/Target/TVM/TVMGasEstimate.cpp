@@ -0,0 +1,373 @@
+//===-- TVMGasEstimate.cpp - Static gas estimates of TVM functions --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Estimate the gas a function consumes: an upper bound and the expected
+/// value, with the number of dictionary operations and of cells created
+/// reported separately since those dominate the price of most contracts.
+///
+/// The pass runs on the final stack form code, so stack manipulations and
+/// the loads of continuations kept in separate cells are accounted for. The
+/// price of an instruction is taken from TVMInstrInfo::getGasCost.
+///
+/// The upper bound is the most expensive path through the CFG where a loop
+/// counts as its most expensive iteration times the maximal trip count that
+/// scalar evolution computes for the corresponding IR loop. A loop with an
+/// unknown trip count or a call taking part in recursion makes the bound
+/// unlimited. The expected value weights blocks by their frequencies.
+///
+/// Calls add the estimates of their callees. Those are combined over the
+/// call graph once all the functions of the module are processed; functions
+/// not defined in the module are counted as free.
+///
+//===----------------------------------------------------------------------===//
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "TVM.h"
+#include "TVMSubtarget.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-gas-estimator"
+
+namespace {
+/// Upper bounds of the resources consumed, Unlimited if there is none.
+struct Bound {
+  static constexpr uint64_t Unlimited = std::numeric_limits<uint64_t>::max();
+  uint64_t Gas = 0;
+  uint64_t DictOps = 0;
+  uint64_t Cells = 0;
+
+  Bound &operator+=(const Bound &B) {
+    Gas = SaturatingAdd(Gas, B.Gas);
+    DictOps = SaturatingAdd(DictOps, B.DictOps);
+    Cells = SaturatingAdd(Cells, B.Cells);
+    return *this;
+  }
+  Bound &operator*=(uint64_t N) {
+    Gas = scale(Gas, N);
+    DictOps = scale(DictOps, N);
+    Cells = scale(Cells, N);
+    return *this;
+  }
+  void maximize(const Bound &B) {
+    Gas = std::max(Gas, B.Gas);
+    DictOps = std::max(DictOps, B.DictOps);
+    Cells = std::max(Cells, B.Cells);
+  }
+  static Bound unlimited() { return {Unlimited, Unlimited, Unlimited}; }
+
+private:
+  static uint64_t scale(uint64_t X, uint64_t N) {
+    return X == 0 ? 0 : SaturatingMultiply(X, N);
+  }
+};
+
+/// Expected values of the resources consumed.
+struct Expected {
+  double Gas = 0;
+  double DictOps = 0;
+  double Cells = 0;
+
+  Expected &operator+=(const Expected &E) {
+    Gas += E.Gas;
+    DictOps += E.DictOps;
+    Cells += E.Cells;
+    return *this;
+  }
+  Expected operator*(double Freq) const {
+    return {Gas * Freq, DictOps * Freq, Cells * Freq};
+  }
+};
+
+struct BlockSummary {
+  /// The instructions of the block, callees excluded.
+  Bound Own;
+  /// Executions per execution of the function.
+  double Freq = 0;
+  /// Predecessors in the block list, back edges excluded.
+  SmallVector<unsigned, 2> Preds;
+  /// Callee names, one per call.
+  std::vector<std::string> Callees;
+  /// Innermost loop, -1 if none.
+  int Loop = -1;
+};
+
+struct LoopSummary {
+  unsigned Header = 0;
+  int Parent = -1;
+  /// Maximal number of executions of the header, 0 if unknown.
+  unsigned MaxTrips = 0;
+};
+
+struct FunctionSummary {
+  std::string Name;
+  bool EntryPoint = false;
+  /// Blocks in reverse post-order, the entry block first.
+  std::vector<BlockSummary> Blocks;
+  /// Loops, outer loops before the inner ones.
+  std::vector<LoopSummary> Loops;
+  /// Estimates including the callees, computed at finalization.
+  enum { NotVisited, InProgress, Done } State = NotVisited;
+  Bound Max;
+  Expected Typical;
+};
+
+class TVMGasEstimate final : public MachineFunctionPass {
+  StringRef getPassName() const override { return "TVM gas estimate"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+    AU.addRequired<MachineLoopInfo>();
+    AU.addRequired<MachineBlockFrequencyInfo>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+  bool doFinalization(Module &M) override;
+
+  unsigned getMaxTrips(const MachineLoop &ML, LoopInfo &LI,
+                       ScalarEvolution &SE) const;
+  void compute(FunctionSummary &FS);
+  Bound computeRegion(const FunctionSummary &FS,
+                      const std::vector<Bound> &BlockMax,
+                      const std::vector<Bound> &LoopMax, int Region) const;
+
+  std::vector<FunctionSummary> Functions;
+  StringMap<unsigned> FunctionIdx;
+
+public:
+  static char ID;
+  TVMGasEstimate() : MachineFunctionPass(ID) {}
+};
+} // end anonymous namespace
+
+char TVMGasEstimate::ID = 0;
+INITIALIZE_PASS_BEGIN(TVMGasEstimate, DEBUG_TYPE,
+                      "Estimate gas consumption of TVM functions", false, true)
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo)
+INITIALIZE_PASS_DEPENDENCY(MachineBlockFrequencyInfo)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
+INITIALIZE_PASS_END(TVMGasEstimate, DEBUG_TYPE,
+                    "Estimate gas consumption of TVM functions", false, true)
+
+FunctionPass *llvm::createTVMGasEstimate() { return new TVMGasEstimate(); }
+
+static StringRef getCallee(const MachineInstr &MI) {
+  for (const MachineOperand &MO : MI.explicit_operands()) {
+    if (MO.isGlobal())
+      return MO.getGlobal()->getName();
+    if (MO.isSymbol())
+      return MO.getSymbolName();
+  }
+  return {};
+}
+
+/// Maximal trip count of the IR loop \p ML is built from, 0 if unknown.
+unsigned TVMGasEstimate::getMaxTrips(const MachineLoop &ML, LoopInfo &LI,
+                                     ScalarEvolution &SE) const {
+  const BasicBlock *BB = ML.getHeader()->getBasicBlock();
+  if (!BB)
+    return 0;
+  Loop *L = LI.getLoopFor(BB);
+  if (!L || L->getHeader() != BB)
+    return 0;
+  return SE.getSmallConstantMaxTripCount(L);
+}
+
+bool TVMGasEstimate::runOnMachineFunction(MachineFunction &MF) {
+  const auto &TII = *MF.getSubtarget<TVMSubtarget>().getInstrInfo();
+  auto &MLI = getAnalysis<MachineLoopInfo>();
+  auto &MBFI = getAnalysis<MachineBlockFrequencyInfo>();
+  auto &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  auto &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+
+  FunctionSummary FS;
+  FS.Name = MF.getName();
+  FS.EntryPoint = MF.getFunction().hasFnAttribute("tvm_raw_func");
+
+  DenseMap<const MachineLoop *, int> LoopIdx;
+  SmallVector<const MachineLoop *, 8> Worklist(MLI.begin(), MLI.end());
+  while (!Worklist.empty()) {
+    const MachineLoop *ML = Worklist.pop_back_val();
+    LoopIdx[ML] = FS.Loops.size();
+    LoopSummary LS;
+    LS.Parent = ML->getParentLoop() ? LoopIdx[ML->getParentLoop()] : -1;
+    LS.MaxTrips = getMaxTrips(*ML, LI, SE);
+    FS.Loops.push_back(LS);
+    Worklist.append(ML->begin(), ML->end());
+  }
+
+  ReversePostOrderTraversal<MachineFunction *> RPOT(&MF);
+  DenseMap<const MachineBasicBlock *, unsigned> BlockIdx;
+  unsigned NumBlocks = 0;
+  for (MachineBasicBlock *MBB : RPOT)
+    BlockIdx[MBB] = NumBlocks++;
+
+  double EntryFreq = MBFI.getEntryFreq();
+  for (MachineBasicBlock *MBB : RPOT) {
+    BlockSummary BS;
+    BS.Freq = MBFI.getBlockFreq(MBB).getFrequency() / EntryFreq;
+    const MachineLoop *ML = MLI.getLoopFor(MBB);
+    if (ML) {
+      BS.Loop = LoopIdx[ML];
+      if (ML->getHeader() == MBB)
+        FS.Loops[BS.Loop].Header = BlockIdx[MBB];
+    }
+    for (const MachineBasicBlock *Pred : MBB->predecessors()) {
+      auto It = BlockIdx.find(Pred);
+      bool BackEdge = MLI.isLoopHeader(MBB) && ML->contains(Pred);
+      if (It != BlockIdx.end() && !BackEdge)
+        BS.Preds.push_back(It->second);
+    }
+    for (const MachineInstr &MI : *MBB) {
+      BS.Own.Gas += TII.getGasCost(MI);
+      if (MI.isCall())
+        BS.Callees.push_back(getCallee(MI));
+      if (TII.getName(MI.getOpcode()).startswith("DICT"))
+        ++BS.Own.DictOps;
+      if (MI.getOpcode() == TVM::ENDC || MI.getOpcode() == TVM::ENDC_S)
+        ++BS.Own.Cells;
+    }
+    FS.Blocks.push_back(std::move(BS));
+  }
+
+  FunctionIdx[FS.Name] = Functions.size();
+  Functions.push_back(std::move(FS));
+  return false;
+}
+
+/// \brief Compute the most expensive path through the blocks of the loop
+/// \p Region, starting at its header, or through the function if \p Region is
+/// -1. Inner loops are accounted for as a whole at their headers.
+Bound TVMGasEstimate::computeRegion(const FunctionSummary &FS,
+                                    const std::vector<Bound> &BlockMax,
+                                    const std::vector<Bound> &LoopMax,
+                                    int Region) const {
+  // The block representing \p Idx in the region: the block itself, the header
+  // of the inner loop containing it, or -1 if it's outside of the region.
+  auto getNode = [&](unsigned Idx) -> int {
+    int L = FS.Blocks[Idx].Loop;
+    if (L == Region)
+      return Idx;
+    while (L != -1 && FS.Loops[L].Parent != Region)
+      L = FS.Loops[L].Parent;
+    return L == -1 ? -1 : FS.Loops[L].Header;
+  };
+
+  // Blocks are in reverse post-order, so predecessors are visited first.
+  std::vector<Bound> PathMax(FS.Blocks.size());
+  Bound Result;
+  for (unsigned Idx = 0, E = FS.Blocks.size(); Idx != E; ++Idx) {
+    if (getNode(Idx) != static_cast<int>(Idx))
+      continue;
+    Bound In;
+    bool IsHeader = Region != -1 && FS.Loops[Region].Header == Idx;
+    if (!IsHeader)
+      for (unsigned Pred : FS.Blocks[Idx].Preds) {
+        int Node = getNode(Pred);
+        if (Node != -1)
+          In.maximize(PathMax[Node]);
+      }
+    int L = FS.Blocks[Idx].Loop;
+    if (L != Region)
+      while (FS.Loops[L].Parent != Region)
+        L = FS.Loops[L].Parent;
+    In += L == Region ? BlockMax[Idx] : LoopMax[L];
+    PathMax[Idx] = In;
+    Result.maximize(In);
+  }
+  return Result;
+}
+
+/// \brief Compute the estimates of \p FS including the callees.
+void TVMGasEstimate::compute(FunctionSummary &FS) {
+  FS.State = FunctionSummary::InProgress;
+
+  std::vector<Bound> BlockMax;
+  for (const BlockSummary &BS : FS.Blocks) {
+    Bound Max = BS.Own;
+    Expected Typical{static_cast<double>(BS.Own.Gas),
+                     static_cast<double>(BS.Own.DictOps),
+                     static_cast<double>(BS.Own.Cells)};
+    for (const std::string &Name : BS.Callees) {
+      auto It = FunctionIdx.find(Name);
+      if (It == FunctionIdx.end())
+        continue;
+      FunctionSummary &Callee = Functions[It->second];
+      if (Callee.State == FunctionSummary::NotVisited)
+        compute(Callee);
+      // The callee is being computed: the call is recursive.
+      Max += Callee.State == FunctionSummary::Done ? Callee.Max
+                                                   : Bound::unlimited();
+      Typical += Callee.Typical;
+    }
+    BlockMax.push_back(Max);
+    FS.Typical += Typical * BS.Freq;
+  }
+
+  // Inner loops come after the outer ones.
+  std::vector<Bound> LoopMax(FS.Loops.size());
+  for (int L = FS.Loops.size() - 1; L >= 0; --L) {
+    LoopMax[L] = computeRegion(FS, BlockMax, LoopMax, L);
+    unsigned Trips = FS.Loops[L].MaxTrips;
+    LoopMax[L] *= Trips ? Trips : Bound::Unlimited;
+  }
+  FS.Max = computeRegion(FS, BlockMax, LoopMax, -1);
+  FS.State = FunctionSummary::Done;
+}
+
+static void printBound(raw_ostream &OS, uint64_t Value) {
+  if (Value == Bound::Unlimited)
+    OS << "unbounded";
+  else
+    OS << Value;
+}
+
+bool TVMGasEstimate::doFinalization(Module &M) {
+  if (Functions.empty())
+    return false;
+
+  for (FunctionSummary &FS : Functions)
+    if (FS.State == FunctionSummary::NotVisited)
+      compute(FS);
+
+  raw_ostream &OS = errs();
+  OS << "===-- TVM gas estimate --===\n";
+  for (const FunctionSummary &FS : Functions) {
+    OS << FS.Name << (FS.EntryPoint ? " (entry point)" : "") << ": max ";
+    printBound(OS, FS.Max.Gas);
+    OS << " gas, typical " << format("%.0f", FS.Typical.Gas)
+       << " gas; dictionary operations: max ";
+    printBound(OS, FS.Max.DictOps);
+    OS << ", typical " << format("%.2f", FS.Typical.DictOps)
+       << "; cells created: max ";
+    printBound(OS, FS.Max.Cells);
+    OS << ", typical " << format("%.2f", FS.Typical.Cells) << '\n';
+  }
+  Functions.clear();
+  FunctionIdx.clear();
+  return false;
+}
@@ -0,0 +1,186 @@
+//===------ TVMHotColdSplit.cpp - Move failure paths into cold cells ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Move continuations which always end in an exception out of the cells of
+/// the hot path.
+///
+/// A failure path of a method (building an error message, logging, sending
+/// a bounce before THROW) is a continuation pushed by PUSHCONT and entered by
+/// IFJMP. TVMIfConversionTerm turns a bare THROW into THROWIF, but longer
+/// bodies stay inline and occupy the cell of the success path, pushing the
+/// rest of it into the next cells. Blocks post-dominated by a THROW or an
+/// unreachable are cold: the pass replaces PUSHCONT { cold } IFJMP with
+/// IFJMPREF { cold }, so the body is placed into a separate cell which is
+/// loaded only if the jump is taken. The remaining continuations are placed
+/// by TVMCodeLayout.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVM.h"
+#include "TVMMachineFunctionInfo.h"
+#include "TVMSubtarget.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/Support/Debug.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-hot-cold-split"
+
+static cl::opt<bool>
+    DisableTVMHotColdSplit("disable-tvm-hot-cold-split", cl::Hidden,
+                           cl::desc("TVM: Keep failure paths inline."),
+                           cl::init(false));
+static cl::opt<unsigned> ColdMinBits(
+    "tvm-hot-cold-split-min-bits", cl::Hidden, cl::init(48),
+    cl::desc("TVM: Minimal bit length of a failure path to move it into a "
+             "separate cell"));
+
+STATISTIC(NumColdConts, "Number of failure paths moved into separate cells");
+
+namespace {
+class TVMHotColdSplit final : public MachineFunctionPass {
+  StringRef getPassName() const override {
+    return "TVM hot/cold splitting";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+
+  void computeColdBlocks(MachineFunction &MF);
+  unsigned getBodyBits(MachineBasicBlock *Head) const;
+
+  const TVMInstrInfo *TII = nullptr;
+  SmallPtrSet<const MachineBasicBlock *, 16> ColdBlocks;
+
+public:
+  static char ID;
+  TVMHotColdSplit() : MachineFunctionPass(ID) {}
+};
+} // end anonymous namespace
+
+char TVMHotColdSplit::ID = 0;
+INITIALIZE_PASS(TVMHotColdSplit, DEBUG_TYPE,
+                "Move TVM failure paths into cold cells", false, false)
+
+FunctionPass *llvm::createTVMHotColdSplit() { return new TVMHotColdSplit(); }
+
+/// Whether the execution ends in an exception at the end of \p MBB: the block
+/// ends in a THROW or in an unreachable (e.g. after a noreturn call).
+static bool isColdExit(const MachineBasicBlock &MBB) {
+  if (!MBB.succ_empty())
+    return false;
+  auto Term = MBB.getFirstTerminator();
+  if (Term == MBB.end())
+    return true;
+  switch (Term->getOpcode()) {
+  case TVM::THROW:
+  case TVM::THROW_S:
+  case TVM::THROWANY:
+  case TVM::THROWANY_S:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Find the blocks all paths from which end in an exception.
+void TVMHotColdSplit::computeColdBlocks(MachineFunction &MF) {
+  ColdBlocks.clear();
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (const MachineBasicBlock &MBB : reverse(MF)) {
+      if (ColdBlocks.count(&MBB))
+        continue;
+      bool Cold = MBB.succ_empty()
+                      ? isColdExit(MBB)
+                      : all_of(MBB.successors(),
+                               [&](const MachineBasicBlock *Succ) {
+                                 return ColdBlocks.count(Succ) != 0;
+                               });
+      if (Cold) {
+        ColdBlocks.insert(&MBB);
+        Changed = true;
+      }
+    }
+  }
+}
+
+/// Bit length of the body starting at \p Head as printed inline, with the
+/// blocks it falls through to and the continuations pushed by it.
+unsigned TVMHotColdSplit::getBodyBits(MachineBasicBlock *Head) const {
+  unsigned Bits = 0;
+  for (auto *MBB = Head; MBB; MBB = MBB->getFallThrough()) {
+    for (const MachineInstr &MI : *MBB) {
+      if (MI.getOpcode() == TVM::PUSHCONT_MBB_S)
+        Bits += 16 + getBodyBits(MI.getOperand(0).getMBB());
+      else
+        Bits += TII->getCodeBits(MI);
+    }
+  }
+  return Bits;
+}
+
+bool TVMHotColdSplit::runOnMachineFunction(MachineFunction &MF) {
+  if (DisableTVMHotColdSplit || skipFunction(MF.getFunction()))
+    return false;
+
+  LLVM_DEBUG(dbgs() << "********** TVM Hot/Cold Splitting **********\n"
+                       "********** Function: "
+                    << MF.getName() << '\n');
+
+  TII = MF.getSubtarget<TVMSubtarget>().getInstrInfo();
+  auto *MFI = MF.getInfo<TVMFunctionInfo>();
+  computeColdBlocks(MF);
+
+  bool Changed = false;
+  for (MachineBasicBlock &MBB : MF) {
+    // Only the boundary of the hot and the cold code is split.
+    if (ColdBlocks.count(&MBB))
+      continue;
+    for (auto It = MBB.begin(), E = MBB.end(); It != E; ++It) {
+      MachineInstr &Push = *It;
+      if (Push.getOpcode() != TVM::PUSHCONT_MBB_S)
+        continue;
+      auto Next = std::next(It);
+      if (Next == E || (Next->getOpcode() != TVM::IFJMP_S &&
+                        Next->getOpcode() != TVM::IFNOTJMP_S))
+        continue;
+      MachineBasicBlock *Body = Push.getOperand(0).getMBB();
+      if (!ColdBlocks.count(Body) || getBodyBits(Body) < ColdMinBits)
+        continue;
+
+      MachineInstr &Jump = *Next;
+      LLVM_DEBUG(dbgs() << "Moving into a cold cell: " << Push);
+      unsigned Opc = Jump.getOpcode() == TVM::IFJMP_S ? TVM::IFJMPREF_MBB
+                                                      : TVM::IFNOTJMPREF_MBB;
+      MachineInstr *RefJump =
+          BuildMI(MBB, Jump, Jump.getDebugLoc(), TII->get(Opc))
+              .add(Push.getOperand(0));
+      // The stack after the fused jump is the one after IFJMP.
+      MFI->cloneMachineInstrIntermediateData(&Jump, RefJump);
+      MFI->clearIntermediateData(&Push);
+      MFI->clearIntermediateData(&Jump);
+      It = RefJump->getIterator();
+      Push.eraseFromParent();
+      Jump.eraseFromParent();
+      ++NumColdConts;
+      Changed = true;
+    }
+  }
+  return Changed;
+}
@@ -13,6 +13,7 @@
 
 #include "TVM.h"
 #include "TVMTargetMachine.h"
+#include "TVMUtilities.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
@@ -140,6 +141,23 @@ void TVMDAGToDAGISel::Select(SDNode *Node) {
   }
   case ISD::INTRINSIC_WO_CHAIN: {
     unsigned IntNo = cast<ConstantSDNode>(Node->getOperand(0))->getZExtValue();
+    if (IntNo == Intrinsic::tvm_pushslice_data) {
+      SDValue Addr = Node->getOperand(1);
+      assert(Addr.getOpcode() == TVMISD::GLOBAL_ADDRESS_WRAPPER);
+      SDValue Data = Addr.getOperand(0); // unwrap the address
+      unsigned Width =
+          cast<ConstantSDNode>(Node->getOperand(2))->getZExtValue();
+      // The short form of PUSHSLICE holds up to 123 data bits, longer data
+      // is placed into a referenced cell.
+      const auto *GA = cast<GlobalAddressSDNode>(Data);
+      unsigned Opc = TVM::getEmbeddedDataBits(GA->getGlobal(), Width) <= 123
+                         ? TVM::PUSHSLICE_DATA
+                         : TVM::PUSHREFSLICE_DATA;
+      SDValue Ops[] = {Data, CurDAG->getTargetConstant(Width, dl, MVT::i257)};
+      ReplaceNode(Node,
+                  CurDAG->getMachineNode(Opc, dl, MVT::TVMSlice, Ops));
+      return;
+    }
     // Common lambda to process both untupleN and unpackfirstN intrinsics
     auto processUntuple = [&](ArrayRef<unsigned> Table, unsigned CmsSingle,
                               unsigned CmdSmall, unsigned CmdBig) -> bool {
@@ -241,6 +241,12 @@ SDValue TVMTargetLowering::LowerCall(CallLoweringInfo &CLI,
   return Chain;
 }
 
+FastISel *
+TVMTargetLowering::createFastISel(FunctionLoweringInfo &FuncInfo,
+                                  const TargetLibraryInfo *LibInfo) const {
+  return TVM::createFastISel(FuncInfo, LibInfo);
+}
+
 bool TVMTargetLowering::CanLowerReturn(
     CallingConv::ID /*CallConv*/, MachineFunction & /*MF*/, bool /*IsVarArg*/,
     const SmallVectorImpl<ISD::OutputArg> &/*Outs*/,
@@ -329,13 +335,16 @@ SDValue TVMTargetLowering::SaveC0(SDValue Chain, const SDLoc &DL,
 
   // Save c0 for further return lowering
   SDValue GetC0Ops[] = {
-      DAG.getTargetConstant(Intrinsic::tvm_getreg, DL, MVT::i257),
+      Chain, DAG.getTargetConstant(Intrinsic::tvm_getreg, DL, MVT::i257),
       DAG.getConstant(0, DL, MVT::i257)};
-  SDValue GetC0 = DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i257, GetC0Ops);
+  SDValue GetC0 =
+      DAG.getNode(ISD::INTRINSIC_W_CHAIN, DL,
+                  DAG.getVTList(MVT::i257, MVT::Other), GetC0Ops);
 
   MachineRegisterInfo &MRI = MF.getRegInfo();
   unsigned C0VirtReg = MRI.createVirtualRegister(&TVM::I257RegClass);
-  SDValue C0VirtRegNode = DAG.getCopyToReg(Chain, DL, C0VirtReg, GetC0);
+  SDValue C0VirtRegNode =
+      DAG.getCopyToReg(GetC0.getValue(1), DL, C0VirtReg, GetC0);
 
   FI->setC0VirtReg(C0VirtReg);
   C0VirtRegNode.getNode()->setNodeId(PUSH_C0_FUNCTION_UNIQUE_ID);
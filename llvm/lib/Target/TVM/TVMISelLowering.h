@@ -75,6 +75,9 @@ public:
 
   SDValue PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI) const override;
 
+  FastISel *createFastISel(FunctionLoweringInfo &FuncInfo,
+                           const TargetLibraryInfo *LibInfo) const override;
+
   EVT getOptimalMemOpType(uint64_t Size, unsigned DstAlign, unsigned SrcAlign,
                           bool IsMemset, bool ZeroMemset, bool MemcpyStrSrc,
                           MachineFunction &MF) const override;
@@ -121,6 +124,12 @@ private:
   bool hasPushC0Predecessor(SDNode *Node) const;
   mutable std::set<int> HasNoPushC0PredecessorCache;
 };
+
+namespace TVM {
+FastISel *createFastISel(FunctionLoweringInfo &FuncInfo,
+                         const TargetLibraryInfo *LibInfo);
+} // namespace TVM
+
 } // namespace llvm
 
 #endif // LLVM_LIB_TARGET_TVM_TVMISELLOWERING_H
@@ -0,0 +1,169 @@
+//===-- TVMInliner.cpp - TVM specific function inlining -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This is the TVM replacement of the standard inliner. The generic cost
+/// model weighs the size of the callee against a threshold tuned for native
+/// targets, where a call is cheap. On TVM a call costs a dictionary lookup or
+/// a cell load, and the arguments and the results have to be shuffled into
+/// place on the stack at both sides of the call boundary. The threshold of a
+/// call site is raised by the gas (or, for functions optimized for size, the
+/// code bits) inlining saves at the boundary, expressed in units of the
+/// generic cost model.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVM.h"
+#include "TVMInstrInfo.h"
+#include "TVMSubtarget.h"
+#include "TVMTargetMachine.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/InlineCost.h"
+#include "llvm/Analysis/OptimizationRemarkEmitter.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/IPO/Inliner.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "inline"
+
+namespace {
+class TVMInliner final : public LegacyInlinerBase {
+public:
+  static char ID;
+
+  explicit TVMInliner(const TVMTargetMachine *TM = nullptr,
+                      unsigned OptLevel = 2, unsigned SizeLevel = 0)
+      : LegacyInlinerBase(ID), TM(TM),
+        Params(llvm::getInlineParams(OptLevel, SizeLevel)) {}
+
+  StringRef getPassName() const override { return "TVM Function Inlining"; }
+
+  InlineCost getInlineCost(CallSite CS) override;
+
+  bool runOnSCC(CallGraphSCC &SCC) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+
+private:
+  int getCallBoundaryBonus(CallSite CS, const Function &Callee) const;
+
+  const TVMTargetMachine *TM;
+  TargetTransformInfoWrapperPass *TTIWP = nullptr;
+  InlineParams Params;
+};
+} // end anonymous namespace
+
+char TVMInliner::ID = 0;
+INITIALIZE_PASS_BEGIN(TVMInliner, "tvm-inline", "TVM Function Inlining",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
+INITIALIZE_PASS_DEPENDENCY(CallGraphWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ProfileSummaryInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
+INITIALIZE_PASS_END(TVMInliner, "tvm-inline", "TVM Function Inlining", false,
+                    false)
+
+Pass *llvm::createTVMInliner(const TVMTargetMachine *TM, unsigned OptLevel,
+                             unsigned SizeLevel) {
+  return new TVMInliner(TM, OptLevel, SizeLevel);
+}
+
+bool TVMInliner::runOnSCC(CallGraphSCC &SCC) {
+  TTIWP = &getAnalysis<TargetTransformInfoWrapperPass>();
+  return LegacyInlinerBase::runOnSCC(SCC);
+}
+
+void TVMInliner::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<TargetTransformInfoWrapperPass>();
+  LegacyInlinerBase::getAnalysisUsage(AU);
+}
+
+/// Number of stack slots the result of type \p Ty occupies.
+static unsigned getNumResults(Type *Ty) {
+  if (Ty->isVoidTy())
+    return 0;
+  if (auto *STy = dyn_cast<StructType>(Ty))
+    return STy->getNumElements();
+  return 1;
+}
+
+/// Get the threshold increase for inlining the call \p CS of \p Callee. The
+/// call boundary costs the call itself, the return, and about one stack
+/// primitive per argument and per result to bring the value into place,
+/// where the inlined code would mostly consume them in place. A call of
+/// a non-recursive internal function is a CALLREF loading the cell of the
+/// callee, other calls go through the dictionary of functions, see
+/// TVMTargetLowering::LowerCall.
+int TVMInliner::getCallBoundaryBonus(CallSite CS,
+                                     const Function &Callee) const {
+  const TVMInstrInfo *TII = TM->getSubtargetImpl(Callee)->getInstrInfo();
+  bool DictCall = !(Callee.hasInternalLinkage() && Callee.doesNotRecurse());
+  unsigned Values = CS.arg_size() + getNumResults(Callee.getReturnType());
+
+  // The generic cost model counts InstrCost per instruction, a typical TVM
+  // instruction is 16 bits long.
+  if (CS.getCaller()->optForSize()) {
+    // CALLDICT is 16 bits, CALLREF { CALL } 32 bits, most of the stack
+    // primitives are 8 bits.
+    unsigned Halves = (DictCall ? 2 : 4) + Values;
+    return InlineConstants::InstrCost * Halves / 2;
+  }
+  unsigned Gas =
+      TII->getGasCost(DictCall ? TVM::CALLDICT_VOID : TVM::CALL_VOID) +
+      Values * TII->getGasCost(TVM::PUSH);
+  return InlineConstants::InstrCost * Gas / TII->getGasCost(TVM::XCHG);
+}
+
+InlineCost TVMInliner::getInlineCost(CallSite CS) {
+  Function *Callee = CS.getCalledFunction();
+  Function *Caller = CS.getCaller();
+  if (!Callee || Callee->isDeclaration() || CS.isNoInline())
+    return llvm::InlineCost::getNever();
+  TargetTransformInfo &TTI = TTIWP->getTTI(*Callee);
+  if (!TTI.areInlineCompatible(Caller, Callee))
+    return llvm::InlineCost::getNever();
+
+  if (CS.hasFnAttr(Attribute::AlwaysInline)) {
+    if (isInlineViable(*Callee))
+      return llvm::InlineCost::getAlways();
+    return llvm::InlineCost::getNever();
+  }
+
+  InlineParams LocalParams = Params;
+  if (TM) {
+    int Bonus = getCallBoundaryBonus(CS, *Callee);
+    LLVM_DEBUG(dbgs() << "    Call boundary bonus of " << Callee->getName()
+                      << ": " << Bonus << '\n');
+    LocalParams.DefaultThreshold += Bonus;
+    if (LocalParams.HintThreshold)
+      LocalParams.HintThreshold = *LocalParams.HintThreshold + Bonus;
+    if (LocalParams.OptSizeThreshold)
+      LocalParams.OptSizeThreshold = *LocalParams.OptSizeThreshold + Bonus;
+    if (LocalParams.OptMinSizeThreshold)
+      LocalParams.OptMinSizeThreshold =
+          *LocalParams.OptMinSizeThreshold + Bonus;
+  }
+
+  OptimizationRemarkEmitter ORE(Caller);
+  std::function<AssumptionCache &(Function &)> GetAssumptionCache =
+      [this](Function &F) -> AssumptionCache & {
+    return ACT->getAssumptionCache(F);
+  };
+  return llvm::getInlineCost(CS, Callee, LocalParams, TTI, GetAssumptionCache,
+                             None, PSI, &ORE);
+}
@@ -15,12 +15,17 @@
 #include "TVM.h"
 #include "TVMMachineFunctionInfo.h"
 #include "TVMTargetMachine.h"
+#include "TVMUtilities.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/TargetRegistry.h"
+#include <numeric>
 
 using namespace llvm;
 
@@ -62,6 +67,292 @@ unsigned TVMInstrInfo::getInstSizeInBytes(const MachineInstr &MI) const {
   return 8;
 }
 
+// TVM gas price list, see TVM whitepaper A.1.
+static constexpr unsigned GasBasePrice = 10;
+static constexpr unsigned GasRefPrice = 5;
+static constexpr unsigned GasCellCreatePrice = 500;
+static constexpr unsigned GasCellLoadPrice = 100;
+static constexpr unsigned GasExceptionPrice = 50;
+static constexpr unsigned GasImplicitRetPrice = 5;
+
+#define TVM_BOTH_FORMS(Opc) TVM::Opc: case TVM::Opc##_S
+
+unsigned TVMInstrInfo::getGasCost(unsigned Opcode) const {
+  switch (Opcode) {
+  case TargetOpcode::IMPLICIT_DEF:
+  case TargetOpcode::KILL:
+  case TargetOpcode::DBG_VALUE:
+  case TargetOpcode::CFI_INSTRUCTION:
+  case TargetOpcode::EH_LABEL:
+  case TVM_BOTH_FORMS(ARGUMENT):
+  case TVM_BOTH_FORMS(ARGUMENT_SLICE):
+  case TVM_BOTH_FORMS(ARGUMENT_BUILDER):
+  case TVM_BOTH_FORMS(ARGUMENT_CELL):
+  case TVM_BOTH_FORMS(ARGUMENT_TUPLE):
+  case TVM_BOTH_FORMS(ARGUMENT_NUM):
+  case TVM_BOTH_FORMS(ADJCALLSTACKDOWN):
+  case TVM_BOTH_FORMS(ADJCALLSTACKUP):
+  case TVM_BOTH_FORMS(REG_TO_REG_COPY):
+  case TVM_BOTH_FORMS(TO_TUPLE_COPY):
+  case TVM_BOTH_FORMS(TO_SLICE_COPY):
+  case TVM_BOTH_FORMS(TO_BUILDER_COPY):
+  case TVM_BOTH_FORMS(TO_CELL_COPY):
+  case TVM_BOTH_FORMS(FROM_TUPLE_COPY):
+  case TVM_BOTH_FORMS(FROM_SLICE_COPY):
+  case TVM_BOTH_FORMS(FROM_BUILDER_COPY):
+  case TVM_BOTH_FORMS(FROM_CELL_COPY):
+  case TVM::HIDDENSTACK:
+    return 0;
+  case TVM::FALLTHROUGH_RETURN:
+    return GasImplicitRetPrice;
+
+  // 8-bit stack primitives.
+  case TVM::PUSH:
+  case TVM::POP:
+  case TVM::XCHG_TOP:
+  case TVM::DUP2:
+  case TVM::OVER2:
+  case TVM::TUCK:
+  case TVM::DROP2:
+  case TVM::DROPX:
+  case TVM::ROT:
+  case TVM::ROTREV:
+  case TVM::BLKSWX:
+  case TVM::ROLLX:
+  case TVM::ROLLREVX:
+  case TVM::REVX:
+    return GasBasePrice + 8;
+  // 16-bit stack primitives.
+  case TVM::XCHG_TOP_DEEP:
+  case TVM::XCHG:
+  case TVM::XCHG2:
+  case TVM::XCPU:
+  case TVM::PUXC:
+  case TVM::PUSH2:
+  case TVM::XCHG3:
+  case TVM::BLKPUSH:
+  case TVM::BLKDROP:
+  case TVM::BLKSWAP:
+  case TVM::ROLL:
+  case TVM::ROLLREV:
+  case TVM::REVERSE:
+    return GasBasePrice + 16;
+  // 24-bit stack primitives.
+  case TVM::XC2PU:
+  case TVM::XCPUXC:
+  case TVM::XCPU2:
+  case TVM::PUXC2:
+  case TVM::PUXCPU:
+  case TVM::PU2XC:
+  case TVM::PUSH3:
+    return GasBasePrice + 24;
+
+  case TVM_BOTH_FORMS(CONST_I257):
+  case TVM_BOTH_FORMS(CONST_U257):
+  case TVM_BOTH_FORMS(NEWC):
+  case TVM_BOTH_FORMS(ENDS):
+  case TVM_BOTH_FORMS(STREF):
+  case TVM_BOTH_FORMS(STSLICE):
+  case TVM_BOTH_FORMS(LDREF):
+  case TVM_BOTH_FORMS(SBITS):
+  case TVM_BOTH_FORMS(SREFS):
+  case TVM_BOTH_FORMS(ADD):
+  case TVM_BOTH_FORMS(SUB):
+  case TVM_BOTH_FORMS(SUBR):
+  case TVM_BOTH_FORMS(NEGATE):
+  case TVM_BOTH_FORMS(INC):
+  case TVM_BOTH_FORMS(DEC):
+  case TVM_BOTH_FORMS(MUL):
+  case TVM_BOTH_FORMS(AND):
+  case TVM_BOTH_FORMS(OR):
+  case TVM_BOTH_FORMS(XOR):
+  case TVM_BOTH_FORMS(NOT):
+  case TVM_BOTH_FORMS(EQ):
+  case TVM_BOTH_FORMS(NE):
+  case TVM_BOTH_FORMS(SLT):
+  case TVM_BOTH_FORMS(SGT):
+  case TVM_BOTH_FORMS(SLE):
+  case TVM_BOTH_FORMS(SGE):
+  case TVM_BOTH_FORMS(ISZERO):
+  case TVM_BOTH_FORMS(PUSHNULL):
+  case TVM_BOTH_FORMS(ISNULL):
+  case TVM_BOTH_FORMS(IFJMP):
+  case TVM_BOTH_FORMS(IFNOTJMP):
+  case TVM_BOTH_FORMS(IFELSE):
+  case TVM_BOTH_FORMS(IF):
+  case TVM_BOTH_FORMS(IFNOT):
+  case TVM_BOTH_FORMS(JMPX):
+    return GasBasePrice + 8;
+
+  case TVM_BOTH_FORMS(ENDC):
+    return GasBasePrice + 8 + GasCellCreatePrice;
+  case TVM_BOTH_FORMS(CTOS):
+  case TVM_BOTH_FORMS(LDREFRTOS):
+    return GasBasePrice + 8 + GasCellLoadPrice;
+  case TVM_BOTH_FORMS(PUSHREF):
+    return GasBasePrice + 8 + GasRefPrice;
+  case TVM_BOTH_FORMS(PUSHREFSLICE):
+  case TVM_BOTH_FORMS(PUSHREFSLICE_DATA):
+  case TVM::PUSHREFCONT_MBB:
+    return GasBasePrice + 8 + GasRefPrice + GasCellLoadPrice;
+  case TVM::IFJMPREF_MBB:
+  case TVM::IFNOTJMPREF_MBB:
+    // The cell is loaded on the jump only.
+    return GasBasePrice + 16 + GasRefPrice;
+
+  case TVM_BOTH_FORMS(THROW):
+  case TVM_BOTH_FORMS(THROWANY):
+    return GasBasePrice + 16 + GasExceptionPrice;
+
+  case TVM_BOTH_FORMS(CALL_VOID):
+  case TVM_BOTH_FORMS(CALL_1_INT):
+  case TVM_BOTH_FORMS(CALL_1_SLICE):
+  case TVM_BOTH_FORMS(CALL_1_BUILDER):
+  case TVM_BOTH_FORMS(CALL_1_CELL):
+  case TVM_BOTH_FORMS(CALL_1_TUPLE):
+  case TVM_BOTH_FORMS(CALL_N):
+    // CALLREF { CALL $callee }: the reference cell is loaded on each call.
+    return 2 * GasBasePrice + 16 + 16 + GasRefPrice + GasCellLoadPrice +
+           GasImplicitRetPrice;
+  case TVM_BOTH_FORMS(CALLDICT_VOID):
+  case TVM_BOTH_FORMS(CALLDICT_1_INT):
+  case TVM_BOTH_FORMS(CALLDICT_1_SLICE):
+  case TVM_BOTH_FORMS(CALLDICT_1_BUILDER):
+  case TVM_BOTH_FORMS(CALLDICT_1_CELL):
+  case TVM_BOTH_FORMS(CALLDICT_1_TUPLE):
+  case TVM_BOTH_FORMS(CALLDICT_N):
+    return GasBasePrice + 16 + GasImplicitRetPrice;
+  }
+
+  // The majority of the remaining TVM instructions have 16-bit opcodes.
+  return GasBasePrice + 16;
+}
+
+// Bit length of the shortest PUSHINT encoding the value.
+static unsigned getPushIntLength(const APInt &Value) {
+  if (Value.sge(-5) && Value.sle(10))
+    return 8;
+  unsigned Bits = Value.getMinSignedBits();
+  if (Bits <= 8)
+    return 16;
+  if (Bits <= 16)
+    return 24;
+  // PUSHINT lxxx: 5-bit length l followed by 8l+19 bits of the value.
+  unsigned L = Bits <= 19 ? 0 : (Bits - 19 + 7) / 8;
+  return 13 + 8 * L + 19;
+}
+
+unsigned TVMInstrInfo::getGasCost(const MachineInstr &MI) const {
+  switch (MI.getOpcode()) {
+  case TVM::CONST_I257:
+  case TVM::CONST_I257_S:
+  case TVM::CONST_U257:
+  case TVM::CONST_U257_S:
+    for (const MachineOperand &MO : MI.explicit_operands()) {
+      if (MO.isCImm())
+        return GasBasePrice + getPushIntLength(MO.getCImm()->getValue());
+      if (MO.isImm())
+        return GasBasePrice + getPushIntLength(APInt(64, MO.getImm(), true));
+    }
+    break;
+  case TVM::PUSH:
+  case TVM::POP:
+    // PUSH s(i) and POP s(i) have a short form for i < 16 only.
+    if (MI.getOperand(0).getImm() > 15)
+      return GasBasePrice + 16;
+    break;
+  case TVM::STSLICECONST:
+  case TVM::STSLICECONST_S: {
+    // CFC0_xysss: 16 bits of opcode and 8 * y bits of data, y = 0..7.
+    const MachineOperand &MO = MI.getOperand(MI.getNumExplicitOperands() - 1);
+    uint64_t Bits = MO.isCImm() ? MO.getCImm()->getZExtValue() : MO.getImm();
+    return GasBasePrice + 16 + 8 * alignTo(Bits > 0 ? Bits - 1 : 0, 8) / 8;
+  }
+  case TVM_BOTH_FORMS(TRACE_ENTER):
+  case TVM_BOTH_FORMS(TRACE_EXIT): {
+    // FEFn_ssss: 16 bits of opcode and length, the event kind and the
+    // decimal id as the n + 1 bytes of the string.
+    unsigned Digits = utostr(MI.getOperand(0).getImm()).size();
+    return GasBasePrice + 16 + 8 * (1 + Digits);
+  }
+  case TVM::PUSHSLICE_DATA:
+  case TVM::PUSHSLICE_DATA_S: {
+    // 8Bxsss: 12 bits of opcode and length, 8 * x + 4 bits of data.
+    unsigned NumOps = MI.getNumExplicitOperands();
+    unsigned Bits = TVM::getEmbeddedDataBits(
+        MI.getOperand(NumOps - 2).getGlobal(),
+        TVM::getImmValue(MI.getOperand(NumOps - 1)));
+    return GasBasePrice + 16 + alignTo(Bits > 4 ? Bits - 4 : 0, 8);
+  }
+  }
+  return getGasCost(MI.getOpcode());
+}
+
+unsigned TVMInstrInfo::getCodeBits(const MachineInstr &MI,
+                                   unsigned *Refs) const {
+  unsigned NumRefs = 0;
+  unsigned Surcharge = 0;
+  switch (MI.getOpcode()) {
+  case TVM::FALLTHROUGH_RETURN:
+    if (Refs)
+      *Refs = 0;
+    return 0;
+  case TVM_BOTH_FORMS(ENDC):
+    Surcharge = GasCellCreatePrice;
+    break;
+  case TVM_BOTH_FORMS(CTOS):
+  case TVM_BOTH_FORMS(LDREFRTOS):
+    Surcharge = GasCellLoadPrice;
+    break;
+  case TVM_BOTH_FORMS(PUSHREF):
+    NumRefs = 1;
+    Surcharge = GasRefPrice;
+    break;
+  case TVM_BOTH_FORMS(PUSHREFSLICE):
+  case TVM_BOTH_FORMS(PUSHREFSLICE_DATA):
+  case TVM::PUSHREFCONT_MBB:
+    NumRefs = 1;
+    Surcharge = GasRefPrice + GasCellLoadPrice;
+    break;
+  case TVM::IFJMPREF_MBB:
+  case TVM::IFNOTJMPREF_MBB:
+    NumRefs = 1;
+    Surcharge = GasRefPrice;
+    break;
+  case TVM_BOTH_FORMS(THROW):
+  case TVM_BOTH_FORMS(THROWANY):
+    Surcharge = GasExceptionPrice;
+    break;
+  case TVM_BOTH_FORMS(CALL_VOID):
+  case TVM_BOTH_FORMS(CALL_1_INT):
+  case TVM_BOTH_FORMS(CALL_1_SLICE):
+  case TVM_BOTH_FORMS(CALL_1_BUILDER):
+  case TVM_BOTH_FORMS(CALL_1_CELL):
+  case TVM_BOTH_FORMS(CALL_1_TUPLE):
+  case TVM_BOTH_FORMS(CALL_N):
+    // CALLREF, the CALL itself lives in the referenced cell.
+    if (Refs)
+      *Refs = 1;
+    return 16;
+  case TVM_BOTH_FORMS(CALLDICT_VOID):
+  case TVM_BOTH_FORMS(CALLDICT_1_INT):
+  case TVM_BOTH_FORMS(CALLDICT_1_SLICE):
+  case TVM_BOTH_FORMS(CALLDICT_1_BUILDER):
+  case TVM_BOTH_FORMS(CALLDICT_1_CELL):
+  case TVM_BOTH_FORMS(CALLDICT_1_TUPLE):
+  case TVM_BOTH_FORMS(CALLDICT_N):
+    Surcharge = GasImplicitRetPrice;
+    break;
+  }
+  if (Refs)
+    *Refs = NumRefs;
+  // Pseudo instructions emitting nothing are free.
+  unsigned Gas = getGasCost(MI);
+  return Gas ? Gas - GasBasePrice - Surcharge : 0;
+}
+
+#undef TVM_BOTH_FORMS
+
 // Predication support
 /// Returns true if the instruction is already predicated.
 bool TVMInstrInfo::isPredicated(const MachineInstr &MI) const {
@@ -410,3 +701,102 @@ bool TVMInstrInfo::canFallthrough(MachineBasicBlock &,
   // We can fallthrough only to block with single predecessor.
   return To.pred_size() == 1;
 }
+
+// MachineOutliner support.
+//
+// The outliner runs after TVMStackModel. Stack form instructions have no
+// register operands and address stack entries relative to its top, while
+// CALLDICT passes the whole data stack to the callee and leaves it as is, so a
+// sequence computes the same in a function of its own and the stack layout
+// doesn't need any fixup on either side of the call. Only the instructions
+// bound to the continuation they are executed in can't be outlined: returns,
+// branches, continuations of basic blocks and accesses to c0, which holds the
+// return continuation of the outlined function rather than of the original
+// one.
+
+enum MachineOutlinerClass {
+  MachineOutlinerDictCall ///< Call with CALLDICT, implicit return at the end.
+};
+
+/// Approximate size of a function in the dictionary of functions beyond its
+/// body: the label of the 32-bit function id and a fork node referring to the
+/// body.
+static constexpr unsigned OutlinedFunctionDictOverhead = 64;
+
+outliner::OutlinedFunction TVMInstrInfo::getOutliningCandidateInfo(
+    std::vector<outliner::Candidate> &RepeatedSequenceLocs) const {
+  // Sizes are measured in code bits.
+  outliner::Candidate &First = RepeatedSequenceLocs.front();
+  unsigned SequenceSize = std::accumulate(
+      First.front(), std::next(First.back()), 0u,
+      [this](unsigned Sum, const MachineInstr &MI) {
+        return Sum + getCodeBits(MI);
+      });
+  // CALL $name$ with an 8-bit function id.
+  unsigned CallOverhead =
+      getGasCost(TVM::CALLDICT_VOID_S) - GasBasePrice - GasImplicitRetPrice;
+  for (outliner::Candidate &C : RepeatedSequenceLocs)
+    C.setCallInfo(MachineOutlinerDictCall, CallOverhead);
+  return outliner::OutlinedFunction(RepeatedSequenceLocs, SequenceSize,
+                                    OutlinedFunctionDictOverhead,
+                                    MachineOutlinerDictCall);
+}
+
+outliner::InstrType
+TVMInstrInfo::getOutliningType(MachineBasicBlock::iterator &MIT,
+                               unsigned Flags) const {
+  MachineInstr &MI = *MIT;
+  if (MI.isDebugInstr() || MI.isKill() || MI.isImplicitDef())
+    return outliner::InstrType::Invisible;
+
+  if (MI.isTerminator() || MI.isReturn() || MI.isBranch() ||
+      MI.isPosition() || MI.isInlineAsm())
+    return outliner::InstrType::Illegal;
+
+  switch (MI.getOpcode()) {
+  case TVM::PUSHC_S:
+  case TVM::POPC_S: {
+    const MachineOperand &RegNo = MI.getOperand(0);
+    if ((RegNo.isImm() && RegNo.getImm() == 0) ||
+        (RegNo.isCImm() && RegNo.getCImm()->isZero()))
+      return outliner::InstrType::Illegal;
+    break;
+  }
+  }
+
+  for (const MachineOperand &MO : MI.operands()) {
+    // Register operands mean the stack model hasn't been applied.
+    if (MO.isReg() || MO.isMBB() || MO.isBlockAddress() || MO.isJTI() ||
+        MO.isCPI() || MO.isFI() || MO.isMCSymbol())
+      return outliner::InstrType::Illegal;
+  }
+  return outliner::InstrType::Legal;
+}
+
+void TVMInstrInfo::buildOutlinedFrame(
+    MachineBasicBlock &MBB, MachineFunction &MF,
+    const outliner::OutlinedFunction &OF) const {
+  // The body is a continuation of its own, it returns implicitly at the end.
+  BuildMI(MBB, MBB.end(), DebugLoc(), get(TVM::FALLTHROUGH_RETURN));
+}
+
+MachineBasicBlock::iterator TVMInstrInfo::insertOutlinedCall(
+    Module &M, MachineBasicBlock &MBB, MachineBasicBlock::iterator &It,
+    MachineFunction &MF, const outliner::Candidate &C) const {
+  It = MBB.insert(It, BuildMI(MF, DebugLoc(), get(TVM::CALLDICT_VOID_S))
+                          .addGlobalAddress(M.getNamedValue(MF.getName())));
+  return It;
+}
+
+bool TVMInstrInfo::isFunctionSafeToOutlineFrom(
+    MachineFunction &MF, bool OutlineFromLinkOnceODRs) const {
+  const Function &F = MF.getFunction();
+  return OutlineFromLinkOnceODRs || !F.hasLinkOnceODRLinkage();
+}
+
+bool TVMInstrInfo::shouldOutlineFromFunctionByDefault(
+    MachineFunction &MF) const {
+  // Every outlined call costs CALLDICT and a dictionary lookup in gas, so
+  // trade gas for code size only where size matters most.
+  return MF.getFunction().optForMinSize();
+}
@@ -40,6 +40,21 @@ public:
 
   unsigned getInstSizeInBytes(const MachineInstr &MI) const override;
 
+  /// Approximate gas price of a single execution of \p MI according to the
+  /// TVM price list: 10 + bit length of the instruction + 5 per reference,
+  /// plus cell creation, cell loading and exception surcharges. Both register
+  /// and stack forms are supported; the callee part of calls isn't counted.
+  unsigned getGasCost(const MachineInstr &MI) const;
+
+  /// Same as above for an instruction with the shortest encoding of its
+  /// immediate operands.
+  unsigned getGasCost(unsigned Opcode) const;
+
+  /// Approximate bit length of \p MI in a code cell, derived from its gas
+  /// price. The number of references to other cells it occupies is returned
+  /// in \p Refs. Bodies of continuations pushed inline aren't counted.
+  unsigned getCodeBits(const MachineInstr &MI, unsigned *Refs = nullptr) const;
+
   int64_t getFramePoppedByCallee(const MachineInstr &I) const {
     assert(isFrameInstr(I) && "Not a frame instruction");
     assert(I.getOperand(1).getImm() >= 0 && "Size must not be negative");
@@ -126,6 +141,24 @@ public:
                               MachineBasicBlock *New) const override;
   bool canFallthrough(MachineBasicBlock &From,
                       MachineBasicBlock &To) const override;
+
+  // MachineOutliner support. Outlining is done on the stack form produced by
+  // TVMStackModel, outlined sequences become dictionary functions called with
+  // CALLDICT.
+  outliner::OutlinedFunction getOutliningCandidateInfo(
+      std::vector<outliner::Candidate> &RepeatedSequenceLocs) const override;
+  outliner::InstrType getOutliningType(MachineBasicBlock::iterator &MIT,
+                                       unsigned Flags) const override;
+  void buildOutlinedFrame(MachineBasicBlock &MBB, MachineFunction &MF,
+                          const outliner::OutlinedFunction &OF) const override;
+  MachineBasicBlock::iterator
+  insertOutlinedCall(Module &M, MachineBasicBlock &MBB,
+                     MachineBasicBlock::iterator &It, MachineFunction &MF,
+                     const outliner::Candidate &C) const override;
+  bool isFunctionSafeToOutlineFrom(MachineFunction &MF,
+                                   bool OutlineFromLinkOnceODRs) const override;
+  bool shouldOutlineFromFunctionByDefault(MachineFunction &MF) const override;
+
 private:
   const TVMRegisterInfo RI;
   virtual void anchor();
@@ -0,0 +1,424 @@
+//===-- TVMInstructionSelector.cpp - Instruction selector for TVM ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the targeting of the InstructionSelector class for
+/// TVM.
+///
+/// The patterns of TVMInstrInfo.td imported by TableGen cover the i257
+/// arithmetic and the intrinsics on integers. The rest is selected here the
+/// way TVMTargetLowering and TVMFastISel do it: constants are CONST_I257 with
+/// a CImm operand, comparisons map to the signed instructions (unsigned i257
+/// values are non-negative), selects to CONDSEL of the register bank of the
+/// result, branches to IFELSE / JMPX built by TVMInstrInfo::insertBranch and
+/// the cell / slice / builder intrinsics to the instructions with register
+/// operands only.
+///
+//===----------------------------------------------------------------------===//
+
+#include "MCTargetDesc/TVMMCTargetDesc.h"
+#include "TVM.h"
+#include "TVMRegisterBankInfo.h"
+#include "TVMSubtarget.h"
+#include "TVMUtilities.h"
+#include "llvm/CodeGen/GlobalISel/InstructionSelector.h"
+#include "llvm/CodeGen/GlobalISel/InstructionSelectorImpl.h"
+#include "llvm/CodeGen/GlobalISel/Utils.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "tvm-isel"
+
+using namespace llvm;
+
+namespace {
+
+#define GET_GLOBALISEL_PREDICATE_BITSET
+#include "TVMGenGlobalISel.inc"
+#undef GET_GLOBALISEL_PREDICATE_BITSET
+
+class TVMInstructionSelector : public InstructionSelector {
+public:
+  TVMInstructionSelector(const TVMSubtarget &STI,
+                         const TVMRegisterBankInfo &RBI);
+
+  bool select(MachineInstr &I, CodeGenCoverage &CoverageInfo) const override;
+  static const char *getName() { return DEBUG_TYPE; }
+
+private:
+  bool selectImpl(MachineInstr &I, CodeGenCoverage &CoverageInfo) const;
+
+  /// Constrain the virtual register \p Reg to the register class of its
+  /// register bank.
+  bool constrainToBank(unsigned Reg, MachineRegisterInfo &MRI) const;
+
+  /// Build a CONST_I257 of \p Val before \p I.
+  unsigned buildConstant(MachineInstr &I, const APInt &Val,
+                         MachineRegisterInfo &MRI) const;
+
+  /// Build a binary instruction \p Opc of \p LHS and \p RHS before \p I.
+  unsigned buildBinary(MachineInstr &I, unsigned Opc, unsigned LHS,
+                       unsigned RHS, MachineRegisterInfo &MRI) const;
+
+  bool selectCopy(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectConstant(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectICmp(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectSelect(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectExt(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectBr(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectBrCond(MachineInstr &I, MachineRegisterInfo &MRI) const;
+  bool selectIntrinsic(MachineInstr &I, MachineRegisterInfo &MRI) const;
+
+  const TVMInstrInfo &TII;
+  const TargetRegisterInfo &TRI;
+  const TVMRegisterBankInfo &RBI;
+  const TVMSubtarget &STI;
+
+#define GET_GLOBALISEL_PREDICATES_DECL
+#include "TVMGenGlobalISel.inc"
+#undef GET_GLOBALISEL_PREDICATES_DECL
+
+// We declare the temporaries used by selectImpl() in the class to minimize the
+// cost of constructing placeholder values.
+#define GET_GLOBALISEL_TEMPORARIES_DECL
+#include "TVMGenGlobalISel.inc"
+#undef GET_GLOBALISEL_TEMPORARIES_DECL
+};
+} // end anonymous namespace
+
+#define GET_GLOBALISEL_IMPL
+#include "TVMGenGlobalISel.inc"
+#undef GET_GLOBALISEL_IMPL
+
+TVMInstructionSelector::TVMInstructionSelector(const TVMSubtarget &STI,
+                                               const TVMRegisterBankInfo &RBI)
+    : InstructionSelector(), TII(*STI.getInstrInfo()),
+      TRI(*STI.getRegisterInfo()), RBI(RBI), STI(STI),
+#define GET_GLOBALISEL_PREDICATES_INIT
+#include "TVMGenGlobalISel.inc"
+#undef GET_GLOBALISEL_PREDICATES_INIT
+#define GET_GLOBALISEL_TEMPORARIES_INIT
+#include "TVMGenGlobalISel.inc"
+#undef GET_GLOBALISEL_TEMPORARIES_INIT
+{
+}
+
+InstructionSelector *
+llvm::createTVMInstructionSelector(const TVMSubtarget &STI,
+                                   const TVMRegisterBankInfo &RBI) {
+  return new TVMInstructionSelector(STI, RBI);
+}
+
+/// Return true if \p Reg is defined by a comparison, which produces -1 for
+/// true. Booleans of other origins have only the low bit defined.
+static bool isComparison(unsigned Reg, const MachineRegisterInfo &MRI) {
+  const MachineInstr *Def = MRI.getVRegDef(Reg);
+  if (!Def)
+    return false;
+  switch (Def->getOpcode()) {
+  case TargetOpcode::G_ICMP:
+  case TVM::EQ:
+  case TVM::NE:
+  case TVM::SLT:
+  case TVM::SGT:
+  case TVM::SLE:
+  case TVM::SGE:
+    return true;
+  }
+  return false;
+}
+
+bool TVMInstructionSelector::constrainToBank(unsigned Reg,
+                                             MachineRegisterInfo &MRI) const {
+  if (TargetRegisterInfo::isPhysicalRegister(Reg) ||
+      MRI.getRegClassOrNull(Reg))
+    return true;
+  const RegisterBank *RB = RBI.getRegBank(Reg, MRI, TRI);
+  if (!RB)
+    return false;
+  return RBI.constrainGenericRegister(
+      Reg, *TVMRegisterBankInfo::getRegClassForBank(*RB), MRI);
+}
+
+unsigned TVMInstructionSelector::buildConstant(MachineInstr &I,
+                                               const APInt &Val,
+                                               MachineRegisterInfo &MRI) const {
+  LLVMContext &Ctx = I.getMF()->getFunction().getContext();
+  unsigned Reg = MRI.createVirtualRegister(&TVM::I257RegClass);
+  BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(TVM::CONST_I257), Reg)
+      .addCImm(ConstantInt::get(Ctx, Val.sextOrTrunc(257)));
+  return Reg;
+}
+
+unsigned TVMInstructionSelector::buildBinary(MachineInstr &I, unsigned Opc,
+                                             unsigned LHS, unsigned RHS,
+                                             MachineRegisterInfo &MRI) const {
+  unsigned Reg = MRI.createVirtualRegister(&TVM::I257RegClass);
+  BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(Opc), Reg)
+      .addReg(LHS)
+      .addReg(RHS);
+  return Reg;
+}
+
+bool TVMInstructionSelector::selectCopy(MachineInstr &I,
+                                        MachineRegisterInfo &MRI) const {
+  for (const MachineOperand &MO : I.operands())
+    if (MO.isReg() && !constrainToBank(MO.getReg(), MRI))
+      return false;
+  return true;
+}
+
+bool TVMInstructionSelector::selectConstant(MachineInstr &I,
+                                            MachineRegisterInfo &MRI) const {
+  const MachineOperand &Val = I.getOperand(1);
+  if (!Val.isCImm())
+    return false;
+  unsigned Dst = I.getOperand(0).getReg();
+  unsigned Reg = buildConstant(I, Val.getCImm()->getValue(), MRI);
+  BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(TargetOpcode::COPY), Dst)
+      .addReg(Reg);
+  I.eraseFromParent();
+  // The users in the blocks selected earlier didn't constrain Dst.
+  return constrainToBank(Reg, MRI) && constrainToBank(Dst, MRI);
+}
+
+bool TVMInstructionSelector::selectICmp(MachineInstr &I,
+                                        MachineRegisterInfo &MRI) const {
+  // Unsigned i257 values are non-negative, see ComparisonUint.
+  unsigned Opc;
+  switch (I.getOperand(1).getPredicate()) {
+  default:
+    return false;
+  case CmpInst::ICMP_EQ:  Opc = TVM::EQ; break;
+  case CmpInst::ICMP_NE:  Opc = TVM::NE; break;
+  case CmpInst::ICMP_SLT:
+  case CmpInst::ICMP_ULT: Opc = TVM::SLT; break;
+  case CmpInst::ICMP_SGT:
+  case CmpInst::ICMP_UGT: Opc = TVM::SGT; break;
+  case CmpInst::ICMP_SLE:
+  case CmpInst::ICMP_ULE: Opc = TVM::SLE; break;
+  case CmpInst::ICMP_SGE:
+  case CmpInst::ICMP_UGE: Opc = TVM::SGE; break;
+  }
+  auto MIB = BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(Opc))
+                 .add(I.getOperand(0))
+                 .add(I.getOperand(2))
+                 .add(I.getOperand(3));
+  I.eraseFromParent();
+  return constrainSelectedInstRegOperands(*MIB, TII, TRI, RBI);
+}
+
+bool TVMInstructionSelector::selectSelect(MachineInstr &I,
+                                          MachineRegisterInfo &MRI) const {
+  unsigned Dst = I.getOperand(0).getReg();
+  unsigned Cond = I.getOperand(1).getReg();
+  unsigned TrueReg = I.getOperand(2).getReg();
+  unsigned FalseReg = I.getOperand(3).getReg();
+  unsigned Opc;
+  switch (RBI.getRegBank(Dst, MRI, TRI)->getID()) {
+  default:
+    return false;
+  case TVM::IntRegBankID:     Opc = TVM::CONDSEL_I; break;
+  case TVM::SliceRegBankID:   Opc = TVM::CONDSEL_S; break;
+  case TVM::BuilderRegBankID: Opc = TVM::CONDSEL_B; break;
+  case TVM::CellRegBankID:    Opc = TVM::CONDSEL_C; break;
+  case TVM::TupleRegBankID:   Opc = TVM::CONDSEL_T; break;
+  }
+
+  // Keep min / max idioms as compact as SelectionDAG does, the comparison
+  // becomes dead then.
+  const MachineInstr *Cmp = MRI.getVRegDef(Cond);
+  if (Opc == TVM::CONDSEL_I && Cmp &&
+      Cmp->getOpcode() == TargetOpcode::G_ICMP && MRI.hasOneUse(Cond)) {
+    unsigned LHS = Cmp->getOperand(2).getReg();
+    unsigned RHS = Cmp->getOperand(3).getReg();
+    bool Same = LHS == TrueReg && RHS == FalseReg;
+    bool Swapped = LHS == FalseReg && RHS == TrueReg;
+    unsigned MinMax = 0;
+    switch (Cmp->getOperand(1).getPredicate()) {
+    default:
+      break;
+    case CmpInst::ICMP_SGT:
+    case CmpInst::ICMP_SGE:
+      MinMax = Same ? TVM::MAX : Swapped ? TVM::MIN : 0;
+      break;
+    case CmpInst::ICMP_SLT:
+    case CmpInst::ICMP_SLE:
+      MinMax = Same ? TVM::MIN : Swapped ? TVM::MAX : 0;
+      break;
+    }
+    if (MinMax) {
+      auto MIB = BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(MinMax),
+                         Dst)
+                     .addReg(TrueReg)
+                     .addReg(FalseReg);
+      I.eraseFromParent();
+      return constrainSelectedInstRegOperands(*MIB, TII, TRI, RBI);
+    }
+  }
+
+  // CONDSEL takes any non-zero condition as true.
+  auto MIB = BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(Opc), Dst)
+                 .addReg(Cond)
+                 .addReg(TrueReg)
+                 .addReg(FalseReg);
+  I.eraseFromParent();
+  return constrainSelectedInstRegOperands(*MIB, TII, TRI, RBI);
+}
+
+bool TVMInstructionSelector::selectExt(MachineInstr &I,
+                                       MachineRegisterInfo &MRI) const {
+  unsigned Dst = I.getOperand(0).getReg();
+  unsigned Src = I.getOperand(1).getReg();
+  unsigned SrcSize = MRI.getType(Src).getSizeInBits();
+  unsigned DstSize = MRI.getType(Dst).getSizeInBits();
+  if (!constrainToBank(Src, MRI))
+    return false;
+
+  // Narrow values are kept in i257 registers with undefined high bits: any
+  // extension or truncation is a copy, except for the truncation to a
+  // boolean, which is tested for non-zero.
+  unsigned Opc = I.getOpcode();
+  unsigned Res = Src;
+  if (Opc == TargetOpcode::G_TRUNC && DstSize == 1) {
+    unsigned One = buildConstant(I, APInt(257, 1), MRI);
+    Res = buildBinary(I, TVM::AND, Src, One, MRI);
+  } else if (Opc == TargetOpcode::G_ZEXT && SrcSize < 257) {
+    unsigned Mask = buildConstant(I, APInt::getLowBitsSet(257, SrcSize), MRI);
+    Res = buildBinary(I, TVM::AND, Src, Mask, MRI);
+  } else if (Opc == TargetOpcode::G_SEXT && SrcSize < 257 &&
+             !(SrcSize == 1 && isComparison(Src, MRI))) {
+    // ((Src & Mask) ^ SignBit) - SignBit doesn't overflow unlike the shifts.
+    unsigned Mask = buildConstant(I, APInt::getLowBitsSet(257, SrcSize), MRI);
+    unsigned SignBit =
+        buildConstant(I, APInt::getOneBitSet(257, SrcSize - 1), MRI);
+    Res = buildBinary(I, TVM::AND, Src, Mask, MRI);
+    Res = buildBinary(I, TVM::XOR, Res, SignBit, MRI);
+    Res = buildBinary(I, TVM::SUB, Res, SignBit, MRI);
+  }
+  BuildMI(*I.getParent(), I, I.getDebugLoc(), TII.get(TargetOpcode::COPY), Dst)
+      .addReg(Res);
+  I.eraseFromParent();
+  return constrainToBank(Dst, MRI);
+}
+
+bool TVMInstructionSelector::selectBr(MachineInstr &I,
+                                      MachineRegisterInfo &MRI) const {
+  MachineBasicBlock &MBB = *I.getParent();
+  MachineBasicBlock *TBB = I.getOperand(0).getMBB();
+  DebugLoc DL = I.getDebugLoc();
+  // A conditional branch before builds IFELSE for both of the successors.
+  bool AfterCondBr = I.getIterator() != MBB.begin() &&
+                     std::prev(I.getIterator())->getOpcode() ==
+                         TargetOpcode::G_BRCOND;
+  I.eraseFromParent();
+  if (!AfterCondBr)
+    TII.insertBranch(MBB, TBB, nullptr, {}, DL);
+  return true;
+}
+
+bool TVMInstructionSelector::selectBrCond(MachineInstr &I,
+                                          MachineRegisterInfo &MRI) const {
+  MachineBasicBlock &MBB = *I.getParent();
+  unsigned Cond = I.getOperand(0).getReg();
+  MachineBasicBlock *TBB = I.getOperand(1).getMBB();
+  DebugLoc DL = I.getDebugLoc();
+  // The false destination is either the target of the G_BR removed by
+  // selectBr or the layout successor, the other successor in both cases.
+  if (MBB.succ_size() > 2)
+    return false;
+  MachineBasicBlock *FBB = TBB;
+  for (MachineBasicBlock *Succ : MBB.successors())
+    if (Succ != TBB)
+      FBB = Succ;
+  if (!constrainToBank(Cond, MRI))
+    return false;
+  I.eraseFromParent();
+  if (FBB == TBB) {
+    TII.insertBranch(MBB, TBB, nullptr, {}, DL);
+    return true;
+  }
+  // The same IFELSE as TVMTargetLowering::LowerBR produces.
+  MachineOperand CondOps[] = {MachineOperand::CreateImm(0),
+                              MachineOperand::CreateReg(Cond, false)};
+  TII.insertBranch(MBB, TBB, FBB, CondOps, DL);
+  return true;
+}
+
+bool TVMInstructionSelector::selectIntrinsic(MachineInstr &I,
+                                             MachineRegisterInfo &MRI) const {
+  unsigned NumDefs = I.getNumExplicitDefs();
+  unsigned Opc = TVM::getIntrinsicOpcode(
+      static_cast<Intrinsic::ID>(I.getOperand(NumDefs).getIntrinsicID()));
+  if (!Opc)
+    return false;
+  const MCInstrDesc &Desc = TII.get(Opc);
+  if (Desc.getNumDefs() != NumDefs ||
+      Desc.getNumOperands() != I.getNumExplicitOperands() - 1)
+    return false;
+  auto MIB = BuildMI(*I.getParent(), I, I.getDebugLoc(), Desc);
+  for (unsigned Idx = 0, E = I.getNumExplicitOperands(); Idx != E; ++Idx)
+    if (Idx != NumDefs)
+      MIB.add(I.getOperand(Idx));
+  I.eraseFromParent();
+  return constrainSelectedInstRegOperands(*MIB, TII, TRI, RBI);
+}
+
+bool TVMInstructionSelector::select(MachineInstr &I,
+                                    CodeGenCoverage &CoverageInfo) const {
+  MachineRegisterInfo &MRI = I.getMF()->getRegInfo();
+
+  if (!isPreISelGenericOpcode(I.getOpcode())) {
+    // The instructions built by TVMCallLowering are already selected.
+    if (I.isCopy())
+      return selectCopy(I, MRI);
+    return true;
+  }
+
+  switch (I.getOpcode()) {
+  case TargetOpcode::G_PHI:
+    // Blocks are selected in post order, so the incoming values of a loop
+    // header may be defined by instructions not selected yet.
+    I.setDesc(TII.get(TargetOpcode::PHI));
+    return selectCopy(I, MRI);
+  case TargetOpcode::G_IMPLICIT_DEF:
+    I.setDesc(TII.get(TargetOpcode::IMPLICIT_DEF));
+    return constrainToBank(I.getOperand(0).getReg(), MRI);
+  case TargetOpcode::G_CONSTANT:
+    return selectConstant(I, MRI);
+  case TargetOpcode::G_ICMP:
+    return selectICmp(I, MRI);
+  case TargetOpcode::G_SELECT:
+    return selectSelect(I, MRI);
+  case TargetOpcode::G_ZEXT:
+  case TargetOpcode::G_SEXT:
+  case TargetOpcode::G_ANYEXT:
+  case TargetOpcode::G_TRUNC:
+    return selectExt(I, MRI);
+  case TargetOpcode::G_BR:
+    return selectBr(I, MRI);
+  case TargetOpcode::G_BRCOND:
+    return selectBrCond(I, MRI);
+  case TargetOpcode::G_LSHR:
+    // Logical shifts are only applied to non-negative values, so they are
+    // arithmetic ones as for SelectionDAG (see the srl pattern).
+    I.setDesc(TII.get(TargetOpcode::G_ASHR));
+    break;
+  case TargetOpcode::G_INTRINSIC:
+  case TargetOpcode::G_INTRINSIC_W_SIDE_EFFECTS:
+    if (selectIntrinsic(I, MRI))
+      return true;
+    break;
+  default:
+    break;
+  }
+
+  return selectImpl(I, CoverageInfo);
+}
@@ -0,0 +1,77 @@
+//===-- TVMLegalizerInfo.cpp - Legalizer rules for TVM --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the targeting of the MachineLegalizer class for TVM.
+///
+/// The rules mirror the type legalization of TVMTargetLowering: integers are
+/// widened to 257 bits (narrow values in registers have undefined high bits,
+/// G_ZEXT and G_SEXT clear or set them) and the only values of the reference
+/// types are copied, selected and passed around. Booleans are kept as s1 for
+/// the conditions of G_SELECT and G_BRCOND. Memory, globals and aggregates are
+/// not supported, so such functions fall back to SelectionDAG.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVMLegalizerInfo.h"
+#include "TVMSubtarget.h"
+#include "llvm/CodeGen/TargetOpcodes.h"
+
+using namespace llvm;
+using namespace LegalityPredicates;
+
+TVMLegalizerInfo::TVMLegalizerInfo(const TVMSubtarget &ST) {
+  using namespace TargetOpcode;
+
+  const LLT s1 = LLT::scalar(1);
+  const LLT s257 = LLT::scalar(257);
+  const LLT Slice = LLT::pointer(1, 257);
+  const LLT Builder = LLT::pointer(2, 257);
+  const LLT Cell = LLT::pointer(3, 257);
+  const LLT Tuple = LLT::pointer(4, 257);
+
+  getActionDefinitionsBuilder({G_ADD, G_SUB, G_MUL, G_AND, G_OR, G_XOR, G_SDIV,
+                               G_UDIV, G_SREM, G_UREM})
+      .legalFor({s257})
+      .clampScalar(0, s257, s257);
+
+  // The shift amount has the type of the shifted value.
+  getActionDefinitionsBuilder({G_SHL, G_ASHR, G_LSHR})
+      .legalFor({s257})
+      .clampScalar(0, s257, s257);
+
+  getActionDefinitionsBuilder(G_CONSTANT)
+      .legalFor({s257})
+      .clampScalar(0, s257, s257);
+
+  getActionDefinitionsBuilder(G_IMPLICIT_DEF)
+      .legalFor({Slice, Builder, Cell, Tuple})
+      .legalIf(isScalar(0));
+
+  getActionDefinitionsBuilder({G_ZEXT, G_SEXT, G_ANYEXT, G_TRUNC})
+      .legalIf(all(isScalar(0), isScalar(1)));
+
+  getActionDefinitionsBuilder(G_ICMP)
+      .legalFor({{s1, s257}})
+      .clampScalar(1, s257, s257);
+
+  getActionDefinitionsBuilder(G_SELECT)
+      .legalFor({{s257, s1}, {Slice, s1}, {Builder, s1}, {Cell, s1},
+                 {Tuple, s1}})
+      .clampScalar(0, s257, s257);
+
+  getActionDefinitionsBuilder(G_PHI)
+      .legalFor({s257, Slice, Builder, Cell, Tuple})
+      .clampScalar(0, s257, s257);
+
+  getActionDefinitionsBuilder(G_BRCOND).legalFor({s1});
+
+  computeTables();
+  verify(*ST.getInstrInfo());
+}
@@ -0,0 +1,32 @@
+//===-- TVMLegalizerInfo.h - Legalizer rules for TVM ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the targeting of the MachineLegalizer class for TVM.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_TVM_TVMLEGALIZERINFO_H
+#define LLVM_LIB_TARGET_TVM_TVMLEGALIZERINFO_H
+
+#include "llvm/CodeGen/GlobalISel/LegalizerInfo.h"
+
+namespace llvm {
+
+class TVMSubtarget;
+
+/// This class provides the legalization rules for TVM: everything is
+/// computed in 257-bit integers, booleans are only kept as conditions.
+class TVMLegalizerInfo : public LegalizerInfo {
+public:
+  TVMLegalizerInfo(const TVMSubtarget &ST);
+};
+} // end namespace llvm
+
+#endif // LLVM_LIB_TARGET_TVM_TVMLEGALIZERINFO_H
@@ -0,0 +1,250 @@
+//===------ TVMLoadCombine.cpp - Combine sequential LDU / LDI of a slice --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Optimize chains of LDU / LDI with constant width parsing fixed-layout data
+/// from a slice, the mirror of TVMStoreCombine.
+///
+/// The pass walks def-use chains of slices: a load belongs to a chain if it
+/// is the only user of the remainder slice of the preceding load, the slice
+/// flows linearly between them and no instruction with side effects lies in
+/// between (loads throw cell underflow). Along a chain:
+///  * consecutive fields whose values are unused are skipped at once with
+///    LDSLICE (dropping the subslice) or SDSKIPFIRST if they are wider than
+///    256 bits;
+///  * the last load whose remainder is unused becomes PLDU / PLDI, which
+///    saves dropping the remainder.
+///
+/// Loading several used fields with a single wide LDU is not done: splitting
+/// the result costs at least one RSHIFT or MODPOW2 per field, each of them is
+/// as expensive as LDU.
+///
+//===----------------------------------------------------------------------===//
+
+#include <vector>
+
+#include "TVM.h"
+#include "TVMUtilities.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-load-combine"
+
+STATISTIC(NumSkipped, "Number of unused field loads removed");
+STATISTIC(NumPreloads, "Number of loads replaced with PLDU / PLDI");
+
+namespace {
+class TVMLoadCombine final : public FunctionPass {
+  StringRef getPassName() const override {
+    return "Combine LDU / LDI instructions";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+public:
+  static char ID;
+  explicit TVMLoadCombine() : FunctionPass(ID) {}
+};
+
+/// A field load of a chain along with the users of its results.
+struct FieldLoad {
+  IntrinsicInst *Load = nullptr;
+  unsigned Width = 0;
+  SmallVector<ExtractValueInst *, 1> Values;
+  SmallVector<ExtractValueInst *, 1> Remainders;
+
+  bool isValueUsed() const {
+    return any_of(Values, [](ExtractValueInst *V) { return !V->use_empty(); });
+  }
+  bool isRemainderUsed() const {
+    return any_of(Remainders,
+                  [](ExtractValueInst *V) { return !V->use_empty(); });
+  }
+};
+} // End anonymous namespace
+
+char TVMLoadCombine::ID = 0;
+INITIALIZE_PASS(TVMLoadCombine, DEBUG_TYPE, "Combine LDU and LDI intrinsics",
+                false, false)
+
+FunctionPass *llvm::createTVMLoadCombine() { return new TVMLoadCombine(); }
+
+/// Size limit for LDSLICE.
+static const unsigned SizeLimit = 256;
+
+/// \brief Analyze LDU / LDI with constant width \p I.
+/// \return false if \p I is not such a load or its results are used other
+/// than through extractvalue.
+static bool analyzeLoad(Instruction *I, FieldLoad &Field) {
+  auto *II = dyn_cast<IntrinsicInst>(I);
+  if (!II || (II->getIntrinsicID() != Intrinsic::tvm_ldu &&
+              II->getIntrinsicID() != Intrinsic::tvm_ldi))
+    return false;
+  auto *Width = dyn_cast<ConstantInt>(II->getArgOperand(1));
+  if (!Width || Width->isZero() || Width->getValue().ugt(SizeLimit))
+    return false;
+  Field = FieldLoad();
+  Field.Load = II;
+  Field.Width = Width->getZExtValue();
+  for (User *U : II->users()) {
+    auto *EV = dyn_cast<ExtractValueInst>(U);
+    if (!EV || EV->getNumIndices() != 1)
+      return false;
+    if (*EV->idx_begin() == 0)
+      Field.Values.push_back(EV);
+    else
+      Field.Remainders.push_back(EV);
+  }
+  return true;
+}
+
+/// \brief Find the load next in the chain after \p Field. A load may throw
+/// cell underflow, so the chain ends at an instruction with side effects:
+/// the combined load is placed instead of the first one.
+static bool nextInChain(const FieldLoad &Field, FieldLoad &Next) {
+  if (Field.Remainders.size() != 1 || !Field.Remainders[0]->hasOneUse())
+    return false;
+  auto *User = cast<Instruction>(*Field.Remainders[0]->user_begin());
+  if (!analyzeLoad(User, Next) ||
+      Next.Load->getArgOperand(0) != Field.Remainders[0])
+    return false;
+  return TVM::flowsLinearly(Field.Load->getParent(), User->getParent()) &&
+         !TVM::hasSideEffectsBetween(Field.Load, User);
+}
+
+static void eraseLoad(FieldLoad &Field) {
+  for (auto *EV : Field.Values)
+    EV->eraseFromParent();
+  for (auto *EV : Field.Remainders)
+    EV->eraseFromParent();
+  Field.Load->eraseFromParent();
+}
+
+/// \brief Replace loads of unused fields \p Run with a single skip of all
+/// their bits placed instead of the first load.
+static void skipFields(MutableArrayRef<FieldLoad> Run, unsigned Size) {
+  IntrinsicInst *First = Run.front().Load;
+  IRBuilder<> Builder(First);
+  Module *M = First->getModule();
+  Value *Slice = First->getArgOperand(0);
+  Value *Remainder;
+  if (Size <= SizeLimit) {
+    auto *Fn = Intrinsic::getDeclaration(M, Intrinsic::tvm_ldslice);
+    auto *Load = Builder.CreateCall(Fn, {Slice, Builder.getIntN(257, Size)});
+    Remainder = Builder.CreateExtractValue(Load, 1);
+  } else {
+    auto *Fn = Intrinsic::getDeclaration(M, Intrinsic::tvm_sdskipfirst);
+    Remainder = Builder.CreateCall(Fn, {Slice, Builder.getIntN(257, Size)});
+  }
+  LLVM_DEBUG(dbgs() << "Skipped " << Run.size() << " fields with "
+                    << *Remainder << "\n");
+  for (auto *EV : Run.back().Remainders)
+    EV->replaceAllUsesWith(Remainder);
+  for (auto It = Run.rbegin(), E = Run.rend(); It != E; ++It)
+    eraseLoad(*It);
+  NumSkipped += Run.size();
+}
+
+/// \brief Replace the load of \p Field with PLDU / PLDI.
+static void preload(FieldLoad &Field) {
+  IntrinsicInst *Load = Field.Load;
+  Intrinsic::ID ID = Load->getIntrinsicID() == Intrinsic::tvm_ldu
+                         ? Intrinsic::tvm_pldu
+                         : Intrinsic::tvm_pldi;
+  IRBuilder<> Builder(Load);
+  auto *Fn = Intrinsic::getDeclaration(Load->getModule(), ID);
+  auto *Value =
+      Builder.CreateCall(Fn, {Load->getArgOperand(0), Load->getArgOperand(1)});
+  LLVM_DEBUG(dbgs() << "Preloading " << *Value << "\n");
+  for (auto *EV : Field.Values)
+    EV->replaceAllUsesWith(Value);
+  eraseLoad(Field);
+  ++NumPreloads;
+}
+
+/// \brief Optimize the chain of loads starting at \p Head.
+static bool combineChain(FieldLoad Head) {
+  std::vector<FieldLoad> Chain{Head};
+  FieldLoad Next;
+  while (nextInChain(Chain.back(), Next))
+    Chain.push_back(Next);
+
+  bool Changed = false;
+  if (!Chain.back().isRemainderUsed() && Chain.back().isValueUsed()) {
+    preload(Chain.back());
+    Chain.pop_back();
+    Changed = true;
+  }
+
+  // Skipping a single field doesn't pay off: LDSLICE + DROP costs as much as
+  // LDU + DROP.
+  auto flush = [&Changed](MutableArrayRef<FieldLoad> Run, unsigned Size) {
+    if (Run.size() > 1) {
+      skipFields(Run, Size);
+      Changed = true;
+    }
+  };
+  MutableArrayRef<FieldLoad> Fields(Chain);
+  size_t RunStart = 0;
+  unsigned Size = 0;
+  for (size_t I = 0, E = Fields.size(); I != E; ++I) {
+    if (Fields[I].isValueUsed()) {
+      flush(Fields.slice(RunStart, I - RunStart), Size);
+      RunStart = I + 1;
+      Size = 0;
+      continue;
+    }
+    Size += Fields[I].Width;
+  }
+  // A tail of unused fields is dead if the remainder isn't used either.
+  if (!Fields.empty() && Fields.back().isRemainderUsed())
+    flush(Fields.slice(RunStart), Size);
+  return Changed;
+}
+
+bool TVMLoadCombine::runOnFunction(Function &F) {
+  if (skipFunction(F))
+    return false;
+
+  // A load dominates the next one in its chain, so visiting blocks in RPO
+  // guarantees that a chain is first met at its head.
+  SmallPtrSet<Instruction *, 16> Visited;
+  std::vector<FieldLoad> Heads;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT)
+    for (Instruction &I : *BB) {
+      FieldLoad Field;
+      if (!analyzeLoad(&I, Field) || !Visited.insert(&I).second)
+        continue;
+      Heads.push_back(Field);
+      FieldLoad Next;
+      while (nextInChain(Field, Next)) {
+        Visited.insert(Next.Load);
+        Field = Next;
+      }
+    }
+
+  bool Changed = false;
+  for (FieldLoad &Head : Heads)
+    Changed |= combineChain(Head);
+  return Changed;
+}
@@ -16,6 +16,7 @@
 #include "InstPrinter/TVMInstPrinter.h"
 #include "TVMMCExpr.h"
 #include "TVMTargetMachine.h"
+#include "TVMUtilities.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/CodeGen/AsmPrinter.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
@@ -127,6 +128,15 @@ void TVMMCInstLower::lower(const MachineInstr *MI, MCInst &OutMI) {
 
         break;
       }
+      case TVM::PUSHSLICE_DATA_S:
+      case TVM::PUSHREFSLICE_DATA_S: {
+        std::string Literal = TVM::getEmbeddedDataLiteral(
+            MO.getGlobal(), TVM::getImmValue(MI->getOperand(1)));
+        auto *Str = static_cast<char *>(Ctx.allocate(Literal.size()));
+        llvm::copy(Literal, Str);
+        Expr = TVMImmStringMCExpr::create(StringRef(Str, Literal.size()), Ctx);
+        break;
+      }
       default:
         Expr = MCSymbolRefExpr::create(Printer.getSymbol(MO.getGlobal()), Ctx);
 
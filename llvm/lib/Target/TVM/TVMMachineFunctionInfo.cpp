@@ -14,14 +14,95 @@
 
 #include "TVMMachineFunctionInfo.h"
 #include "TVMISelLowering.h"
+#include "TVMStack.h"
 #include "TVMSubtarget.h"
 #include "llvm/CodeGen/Analysis.h"
+#include "llvm/CodeGen/TargetInstrInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/Target/TargetMachine.h"
 using namespace llvm;
 
-TVMFunctionInfo::TVMFunctionInfo(MachineFunction &MF) : MF(MF) {
-  StackModelComments[nullptr]; // Empty vector reservation
+StackModelComment::StackModelComment(const Stack &After)
+    : Slots(After.begin(), After.end()) {}
+
+StackModelComment::StackModelComment(const Stack *Required,
+                                     const Stack &After)
+    : Kind(Transition) {
+  if (Required) {
+    Slots.append(Required->begin(), Required->end());
+    NumRequired = Required->size();
+  }
+  Slots.append(After.begin(), After.end());
+}
+
+StackModelComment::StackModelComment(
+    const MachineInstr &RegFormMI,
+    function_ref<const DILocalVariable *(unsigned)> DebugVariable)
+    : Kind(Operands), RegFormMI(&RegFormMI) {
+  for (const MachineOperand &MO : RegFormMI.operands())
+    if (MO.isReg())
+      Slots.emplace_back(MO.getReg(), DebugVariable(MO.getReg()));
+}
+
+void StackModelComment::print(raw_ostream &OS, const TargetInstrInfo &TII,
+                              const TargetRegisterInfo *TRI,
+                              const MachineRegisterInfo *MRI) const {
+  switch (Kind) {
+  case StackAfter:
+    Stack::print(OS, Slots, TRI, MRI);
+    return;
+  case Transition: {
+    ArrayRef<StackVreg> After(Slots);
+    if (NumRequired != -1u) {
+      Stack::print(OS, After.take_front(NumRequired), TRI, MRI);
+      After = After.drop_front(NumRequired);
+    }
+    OS << " => ";
+    Stack::print(OS, After, TRI, MRI);
+    return;
+  }
+  case Operands:
+    break;
+  }
+
+  if (!RegFormMI->getNumExplicitDefs())
+    return;
+  const StackVreg *Reg = Slots.begin();
+  auto OpPrinter = [&OS, &Reg](const MachineOperand &Operand) {
+    if (Operand.isReg()) {
+      if (Operand.isUndef())
+        OS << "x";
+      else
+        OS << printReg(Operand.getReg());
+      if (Reg->DbgVar)
+        OS << "(" << Reg->DbgVar->getName() << ")";
+      ++Reg;
+    } else {
+      OS << Operand;
+    }
+  };
+  auto CommaOpPrinter = [&OS, &OpPrinter](const MachineOperand &Operand) {
+    OS << ", ";
+    OpPrinter(Operand);
+  };
+
+  OS << ">";
+  OpPrinter(*RegFormMI->defs().begin());
+  llvm::for_each(drop_begin(RegFormMI->defs(), 1), CommaOpPrinter);
+
+  OS << " = " << TII.getName(RegFormMI->getOpcode()) << " ";
+
+  auto Uses = RegFormMI->uses();
+  if (Uses.begin() != Uses.end()) {
+    OpPrinter(*Uses.begin());
+    llvm::for_each(drop_begin(Uses, 1), CommaOpPrinter);
+  }
 }
 
+TVMFunctionInfo::TVMFunctionInfo(MachineFunction &MF)
+    : MF(MF), EmitStackModelComments(
+                  MF.getTarget().Options.MCOptions.AsmVerbose) {}
+
 TVMFunctionInfo::~TVMFunctionInfo() = default;
 
 void TVMFunctionInfo::initTVMRegs() {
@@ -16,11 +16,47 @@
 #define LLVM_LIB_TARGET_TVM_TVMMACHINEFUNCTIONINFO_H
 
 #include "MCTargetDesc/TVMMCTargetDesc.h"
+#include "TVMStackVreg.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 
 namespace llvm {
 
+class Stack;
+
+/// Stack model annotation of an instruction or a basic block.
+/// Annotations are generated only when the assembly is printed with comments
+/// and are kept in a compact form until the printer renders them.
+class StackModelComment {
+public:
+  StackModelComment() = default;
+  /// The stack after an instruction or at the entry of a block.
+  explicit StackModelComment(const Stack &After);
+  /// The stack a terminator requires (if known) and the stack after it.
+  StackModelComment(const Stack *Required, const Stack &After);
+  /// Defs and uses of \p RegFormMI, an instruction in register form removed
+  /// (but not deleted) by the stack model, with debug variables of registers.
+  StackModelComment(
+      const MachineInstr &RegFormMI,
+      function_ref<const DILocalVariable *(unsigned)> DebugVariable);
+
+  void print(raw_ostream &OS, const TargetInstrInfo &TII,
+             const TargetRegisterInfo *TRI,
+             const MachineRegisterInfo *MRI) const;
+
+private:
+  enum KindTy { StackAfter, Transition, Operands };
+  KindTy Kind = StackAfter;
+  /// Stack slots from the top; for Transition the required stack is followed
+  /// by the stack after the terminator. For Operands - registers of
+  /// RegFormMI operands.
+  SmallVector<StackVreg, 8> Slots;
+  /// Number of slots in the required stack, or -1u if it is unknown.
+  unsigned NumRequired = -1u;
+  const MachineInstr *RegFormMI = nullptr;
+};
+
 /// This class is derived from MachineFunctionInfo and contains private
 /// TVM-specific information for each MachineFunction.
 class TVMFunctionInfo final : public MachineFunctionInfo {
@@ -33,17 +69,22 @@ class TVMFunctionInfo final : public MachineFunctionInfo {
   /// A mapping from CodeGen vreg index to TVM register number.
   std::vector<unsigned> TVMRegs;
 
+  /// Whether stack model comments are generated, i.e. the assembly is
+  /// printed with comments.
+  bool EmitStackModelComments;
+
   /// A mapping from MachineInstr to stack model commentaries
   ///  (for stack model after this instruction)
-  std::map<const MachineInstr *, std::vector<std::string>> StackModelComments;
+  DenseMap<const MachineInstr *, SmallVector<StackModelComment, 2>>
+      StackModelComments;
 
   /// A mapping from MachineInstr after stack model to list of operand registers
   /// which have been used in the instruction before stack model
-  std::map<const MachineInstr *, std::vector<unsigned>> StackModelSourceRegs;
+  DenseMap<const MachineInstr *, std::vector<unsigned>> StackModelSourceRegs;
 
   /// A mapping from MachineBasicBlock to starting stack model comment
   ///  (incoming stack model for this block)
-  std::map<const MachineBasicBlock *, std::string> StackModelBBComments;
+  DenseMap<const MachineBasicBlock *, StackModelComment> StackModelBBComments;
 
   /// A mapping from CodeGen vreg index to a boolean value indicating whether
   /// the given register is considered to be "stackified", meaning it has been
@@ -106,31 +147,29 @@ public:
     return TVMRegs[I];
   }
 
-  void addStackModelComment(const MachineInstr *MI, const std::string &val) {
-    StackModelComments[MI].push_back(val);
-  }
-  void resetStackModelComment(const MachineInstr *MI, const std::string &val) {
-    StackModelComments[MI].clear();
+  bool hasStackModelComments() const { return EmitStackModelComments; }
+  void addStackModelComment(const MachineInstr *MI,
+                            const StackModelComment &val) {
+    assert(EmitStackModelComments && "Stack model comments are disabled");
     StackModelComments[MI].push_back(val);
   }
-  const std::vector<std::string> &
+  ArrayRef<StackModelComment>
   getStackModelComments(const MachineInstr *MI) const {
     auto it = StackModelComments.find(MI);
     if (it != StackModelComments.end())
       return it->second;
-    it = StackModelComments.find(nullptr);
-    assert(it != StackModelComments.end());
-    return it->second; // empty vector
+    return {};
   }
 
   void setStackModelBBComment(const MachineBasicBlock *MBB,
-                              const std::string &val) {
+                              const StackModelComment &val) {
+    assert(EmitStackModelComments && "Stack model comments are disabled");
     StackModelBBComments[MBB] = val;
   }
-  StringRef getStackModelBBComment(const MachineBasicBlock *MBB) const {
+  const StackModelComment *
+  getStackModelBBComment(const MachineBasicBlock *MBB) const {
     auto it = StackModelBBComments.find(MBB);
-    return (it != StackModelBBComments.end()) ? StringRef(it->second)
-                                              : StringRef("");
+    return (it != StackModelBBComments.end()) ? &it->second : nullptr;
   }
 
   // Add mapping of instructions before stack model
@@ -153,13 +192,18 @@ public:
   // Clone machine instruction intermediate data
   void cloneMachineInstrIntermediateData(const MachineInstr *Source,
                                          const MachineInstr *Destination) {
-    StackModelComments[Destination].clear();
-    for (const auto &Comment : getStackModelComments(Source)) {
-      addStackModelComment(Destination, Comment);
-    }
+    // Copy the data first, the maps may grow on insertion.
+    ArrayRef<StackModelComment> SourceComments =
+        getStackModelComments(Source);
+    SmallVector<StackModelComment, 2> Comments(SourceComments.begin(),
+                                               SourceComments.end());
+    StackModelComments.erase(Destination);
+    if (!Comments.empty())
+      StackModelComments[Destination] = std::move(Comments);
 
     if (const auto *Regs = getStackModelSourceRegs(Source)) {
-      setStackModelSourceRegs(Destination, *Regs);
+      std::vector<unsigned> RegsCopy(*Regs);
+      setStackModelSourceRegs(Destination, std::move(RegsCopy));
     }
   }
 
@@ -171,7 +215,7 @@ public:
   }
 
   const MachineInstr *clearIntermediateData(const MachineInstr *MI) {
-    StackModelComments[MI].clear();
+    StackModelComments.erase(MI);
     StackModelSourceRegs.erase(MI);
     return MI;
   }
@@ -141,7 +141,8 @@ bool TVMMoveMaterializable::processInstruction(MachineInstr &MI) {
   MachineInstr *InsertBefore = &MI;
   MachineBasicBlock *MBB = MI.getParent();
   for (MachineOperand &Use : Uses) {
-    if (Use.isReg()) {
+    // DBG_VALUE has a $noreg operand.
+    if (Use.isReg() && TargetRegisterInfo::isVirtualRegister(Use.getReg())) {
       unsigned Reg = Use.getReg();
       MachineInstr *Def = GetVRegDef(Reg, &MI, *MRI, *LIS);
       if (Def) {
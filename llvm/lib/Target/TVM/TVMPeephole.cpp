@@ -99,7 +99,10 @@ static bool MaybeOptimizeReturn(MachineInstr &MI, const TargetInstrInfo &TII) {
 
   // If we don't need to clean up stack on return, we could omit this
   // instruction in the exit BB.
-  BuildMI(&MI, TII.get(TVM::FALLTHROUGH_RETURN));
+  TVMFunctionInfo *MFI = MF->getInfo<TVMFunctionInfo>();
+  MFI->cloneMachineInstrIntermediateData(
+      &MI, BuildMI(&MI, TII.get(TVM::FALLTHROUGH_RETURN)));
+  MFI->clearIntermediateData(&MI);
   MI.eraseFromParent();
 
   return true;
@@ -107,6 +110,7 @@ static bool MaybeOptimizeReturn(MachineInstr &MI, const TargetInstrInfo &TII) {
 
 bool TVMPeephole::runBlkDropCombine(MachineBasicBlock &MBB,
                                     const TargetInstrInfo &TII) {
+  TVMFunctionInfo *MFI = MBB.getParent()->getInfo<TVMFunctionInfo>();
   bool Changed = false;
   std::vector<MachineInstr *> MIRemove;
   for (auto It = std::begin(MBB), E = std::end(MBB); It != E; ++It) {
@@ -123,18 +127,22 @@ bool TVMPeephole::runBlkDropCombine(MachineBasicBlock &MBB,
       for (auto RmIt = It; RmIt != DropIt; ++RmIt)
         MIRemove.push_back(&*RmIt);
       It = BuildMI(&*DropIt, TII.get(TVM::BLKDROP)).addImm(count);
+      MFI->cloneMachineInstrIntermediateData(&*std::prev(It), &*It);
       LLVM_DEBUG(dbgs() << "Replaced " << count << "DROPs with BLKDROP");
       Changed = true;
     }
     count = 0;
   }
-  for (auto *I : MIRemove)
+  for (auto *I : MIRemove) {
+    MFI->clearIntermediateData(I);
     I->eraseFromParent();
+  }
   return Changed;
 }
 
 bool TVMPeephole::runBlkPushCombine(MachineBasicBlock &MBB,
                                     const TargetInstrInfo &TII) {
+  TVMFunctionInfo *MFI = MBB.getParent()->getInfo<TVMFunctionInfo>();
   bool Changed = false;
   std::vector<MachineInstr *> MIRemove;
   for (auto It = std::begin(MBB), E = std::end(MBB); It != E; ++It) {
@@ -181,42 +189,48 @@ bool TVMPeephole::runBlkPushCombine(MachineBasicBlock &MBB,
       It = BuildMI(&*PushIt, TII.get(TVM::BLKPUSH))
                .addImm(MaybeRemove.size())
                .addImm((Reg == TVMFunctionInfo::UnusedReg) ? 0 : Reg);
+      MFI->cloneMachineInstrIntermediateData(MaybeRemove.back(), &*It);
       LLVM_DEBUG(dbgs() << "Replaced " << MaybeRemove.size()
                         << " PUSH/PUSHINT with BLKPUSH");
       Changed = true;
     }
   }
-  for (auto *I : MIRemove)
+  for (auto *I : MIRemove) {
+    MFI->clearIntermediateData(I);
     I->eraseFromParent();
+  }
   return Changed;
 }
 
 bool TVMPeephole::runReplaceWithShorterForm(MachineBasicBlock &MBB,
                                             const TargetInstrInfo &TII) {
-  DenseMap<MachineInstr *, unsigned> MIReplace;
+  TVMFunctionInfo *MFI = MBB.getParent()->getInfo<TVMFunctionInfo>();
+  SmallVector<std::pair<MachineInstr *, unsigned>, 8> MIReplace;
   for (auto It = std::begin(MBB), E = std::end(MBB); It != E; ++It) {
     if (It->getOpcode() == TVM::BLKDROP && It->getOperand(0).getImm() == 2)
-      MIReplace.insert({&*It, TVM::DROP2});
+      MIReplace.push_back({&*It, TVM::DROP2});
     if (It->getOpcode() == TVM::PUSH2 && It->getOperand(0).getImm() == 1 &&
         It->getOperand(1).getImm() == 0)
-      MIReplace.insert({&*It, TVM::DUP2});
+      MIReplace.push_back({&*It, TVM::DUP2});
     if (It->getOpcode() == TVM::PUSH2 && It->getOperand(0).getImm() == 3 &&
         It->getOperand(1).getImm() == 2)
-      MIReplace.insert({&*It, TVM::OVER2});
+      MIReplace.push_back({&*It, TVM::OVER2});
     if (It->getOpcode() == TVM::BLKSWAP && It->getOperand(0).getImm() == 1 &&
         It->getOperand(1).getImm() == 2)
-      MIReplace.insert({&*It, TVM::ROT});
+      MIReplace.push_back({&*It, TVM::ROT});
     if (It->getOpcode() == TVM::BLKSWAP && It->getOperand(0).getImm() == 2 &&
         It->getOperand(1).getImm() == 1)
-      MIReplace.insert({&*It, TVM::ROTREV});
+      MIReplace.push_back({&*It, TVM::ROTREV});
     if (It->getOpcode() == TVM::ROLLREV && It->getOperand(0).getImm() == 2)
-      MIReplace.insert({&*It, TVM::ROTREV});
+      MIReplace.push_back({&*It, TVM::ROTREV});
     if (It->getOpcode() == TVM::XC2PU && It->getOperand(0).getImm() == 0 &&
         It->getOperand(1).getImm() == 0 && It->getOperand(2).getImm() == 1)
-      MIReplace.insert({&*It, TVM::TUCK});
+      MIReplace.push_back({&*It, TVM::TUCK});
   }
   for (auto I : MIReplace) {
-    BuildMI(I.first, TII.get(I.second));
+    MFI->cloneMachineInstrIntermediateData(
+        I.first, BuildMI(I.first, TII.get(I.second)));
+    MFI->clearIntermediateData(I.first);
     I.first->eraseFromParent();
   }
   return !MIReplace.empty();
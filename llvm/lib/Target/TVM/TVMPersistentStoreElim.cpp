@@ -0,0 +1,237 @@
+//===-- TVMPersistentStoreElim.cpp - Optimize persistent data stores ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Eliminate dead stores of the persistent data (c4) and sink the partially
+/// dead ones towards the exits of the function.
+///
+/// The persistent data is only observed after the function returns (or by a
+/// COMMIT), and an exception reverts it to the value committed last. So a
+/// store is dead if it is overwritten on every path before the data is read,
+/// and on paths ending in a THROW with a failure code (greater than 1) or an
+/// unreachable. THROW 0 and THROW 1 are successful terminations, they and
+/// a THROW with an unknown code read c4 as COMMIT does. The pass computes the
+/// liveness of c4 backwards from the returns, erases the dead stores and
+/// moves a store which is the last access of c4 in its block to the
+/// successors where c4 is live if it is dead in some other successor.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVM.h"
+#include "TVMAliasAnalysis.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-persistent-store-elim"
+
+STATISTIC(NumDeadStores, "Number of dead persistent data stores erased");
+STATISTIC(NumSunkStores, "Number of persistent data stores sunk");
+
+namespace {
+class TVMPersistentStoreElim final : public FunctionPass {
+public:
+  static char ID;
+  TVMPersistentStoreElim() : FunctionPass(ID) {}
+
+  StringRef getPassName() const override {
+    return "TVM persistent data store elimination";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AAResultsWrapperPass>();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  enum class Access { None, Read, Kill };
+
+  Access getAccess(const Instruction &I) const;
+  void computeLiveness(Function &F);
+  /// Whether c4 is live right after \p Store.
+  bool isLiveAfter(const Instruction &Store) const;
+  bool isLiveOut(const BasicBlock &BB) const;
+  bool sink(Instruction &Store);
+
+  AAResults *AA = nullptr;
+  DenseMap<const BasicBlock *, bool> LiveIn;
+};
+} // end anonymous namespace
+
+char TVMPersistentStoreElim::ID = 0;
+INITIALIZE_PASS_BEGIN(TVMPersistentStoreElim, DEBUG_TYPE,
+                      "TVM persistent data store elimination", false, false)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_END(TVMPersistentStoreElim, DEBUG_TYPE,
+                    "TVM persistent data store elimination", false, false)
+
+FunctionPass *llvm::createTVMPersistentStoreElim() {
+  return new TVMPersistentStoreElim();
+}
+
+TVMPersistentStoreElim::Access
+TVMPersistentStoreElim::getAccess(const Instruction &I) const {
+  // Memory is emulated with a dictionary in a global variable.
+  ImmutableCallSite CS(&I);
+  if (!CS)
+    return Access::None;
+  TVM::StateAccess State = TVM::getStateAccess(CS);
+  switch (State.Loc) {
+  case TVM::StateLocation::PersistentData:
+    return isModSet(State.MRI) ? Access::Kill : Access::Read;
+  case TVM::StateLocation::None:
+  case TVM::StateLocation::Globals:
+  case TVM::StateLocation::Register:
+    return Access::None;
+  case TVM::StateLocation::Unknown:
+    break;
+  }
+  if (AAResults::onlyAccessesArgPointees(AA->getModRefBehavior(CS)))
+    return Access::None;
+  return Access::Read;
+}
+
+bool TVMPersistentStoreElim::isLiveOut(const BasicBlock &BB) const {
+  const TerminatorInst *Term = BB.getTerminator();
+  if (isa<ReturnInst>(Term))
+    return true;
+  return any_of(successors(&BB), [&](const BasicBlock *Succ) {
+    auto It = LiveIn.find(Succ);
+    return It == LiveIn.end() || It->second;
+  });
+}
+
+void TVMPersistentStoreElim::computeLiveness(Function &F) {
+  // Start with c4 dead everywhere and grow the live set to the fixpoint.
+  // Blocks ending in an unreachable (THROW is a noreturn call) stay dead
+  // unless the THROW may be a successful termination, which reads c4.
+  LiveIn.clear();
+  for (BasicBlock &BB : F)
+    LiveIn[&BB] = false;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (BasicBlock &BB : reverse(F.getBasicBlockList())) {
+      bool Live = isLiveOut(BB);
+      for (const Instruction &I : reverse(BB)) {
+        Access A = getAccess(I);
+        if (A != Access::None)
+          Live = A == Access::Read;
+      }
+      if (Live && !LiveIn[&BB]) {
+        LiveIn[&BB] = true;
+        Changed = true;
+      }
+    }
+  }
+}
+
+bool TVMPersistentStoreElim::isLiveAfter(const Instruction &Store) const {
+  const BasicBlock &BB = *Store.getParent();
+  for (auto It = std::next(Store.getIterator()); It != BB.end(); ++It) {
+    Access A = getAccess(*It);
+    if (A != Access::None)
+      return A == Access::Read;
+  }
+  return isLiveOut(BB);
+}
+
+/// Move \p Store, the last access of c4 in its block, to the successors
+/// where c4 is live. The stored value dominates the new positions, the
+/// successors with other predecessors are reached through new blocks.
+bool TVMPersistentStoreElim::sink(Instruction &Store) {
+  BasicBlock *BB = Store.getParent();
+  TerminatorInst *Term = BB->getTerminator();
+  if (!isa<BranchInst>(Term) && !isa<SwitchInst>(Term))
+    return false;
+  SmallVector<BasicBlock *, 4> LiveSuccs;
+  bool HasDeadSucc = false;
+  for (BasicBlock *Succ : successors(BB)) {
+    if (Succ == BB || !LiveIn.count(Succ))
+      return false;
+    if (!LiveIn.lookup(Succ))
+      HasDeadSucc = true;
+    else if (!is_contained(LiveSuccs, Succ))
+      LiveSuccs.push_back(Succ);
+  }
+  if (!HasDeadSucc)
+    return false;
+
+  for (BasicBlock *Succ : LiveSuccs) {
+    BasicBlock *Dest = Succ;
+    if (!Succ->getSinglePredecessor()) {
+      unsigned SuccNum = 0;
+      while (Term->getSuccessor(SuccNum) != Succ)
+        ++SuccNum;
+      Dest = SplitCriticalEdge(
+          Term, SuccNum, CriticalEdgeSplittingOptions().setMergeIdenticalEdges());
+      assert(Dest && "Failed to split a critical edge");
+    }
+    Instruction *Copy = Store.clone();
+    Copy->insertBefore(&*Dest->getFirstInsertionPt());
+    LLVM_DEBUG(dbgs() << "Sinking " << Store << " to " << Dest->getName()
+                      << "\n");
+  }
+  Store.eraseFromParent();
+  ++NumSunkStores;
+  return true;
+}
+
+bool TVMPersistentStoreElim::runOnFunction(Function &F) {
+  if (skipFunction(F))
+    return false;
+  AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
+
+  bool Changed = false;
+  // Sinking a store may expose another one as dead or sinkable, the number
+  // of rounds is bounded by the depth of the CFG.
+  for (unsigned Round = 0; Round < 8; ++Round) {
+    SmallVector<Instruction *, 8> Stores;
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB)
+        if (ImmutableCallSite CS = ImmutableCallSite(&I))
+          if (TVM::isPersistentStore(CS))
+            Stores.push_back(&I);
+    if (Stores.empty())
+      break;
+
+    computeLiveness(F);
+    bool RoundChanged = false;
+    // Erasing a dead store or sinking the last store of a block keeps the
+    // liveness of c4 at the other stores.
+    for (Instruction *Store : Stores) {
+      if (!isLiveAfter(*Store)) {
+        LLVM_DEBUG(dbgs() << "Erasing dead " << *Store << "\n");
+        Store->eraseFromParent();
+        ++NumDeadStores;
+        RoundChanged = true;
+        continue;
+      }
+      BasicBlock *BB = Store->getParent();
+      bool IsLastAccess = std::all_of(
+          std::next(Store->getIterator()), BB->end(),
+          [&](const Instruction &I) { return getAccess(I) == Access::None; });
+      if (IsLastAccess && sink(*Store))
+        RoundChanged = true;
+    }
+    if (!RoundChanged)
+      break;
+    Changed = true;
+  }
+  return Changed;
+}
@@ -88,6 +88,21 @@ bool TVMPrepareForLiveIntervals::runOnMachineFunction(MachineFunction &MF) {
     }
   }
 
+  // Reads of the VM state are not pure (they may not be moved across the
+  // writes), so DeadMachineInstructionElim keeps them even if unused. Erase
+  // such reads, e.g. the c0 saved for a return lowering which turned out to
+  // need no restore.
+  for (MachineBasicBlock &MBB : MF)
+    for (auto MII = MBB.begin(), MIE = MBB.end(); MII != MIE;) {
+      MachineInstr &MI = *MII++;
+      if (TVM::isRepeatableStateRead(MI) &&
+          MRI.use_nodbg_empty(MI.getOperand(0).getReg())) {
+        LLVM_DEBUG(dbgs() << "Erasing unused state read " << MI);
+        MI.eraseFromParent();
+        Changed = true;
+      }
+    }
+
   // Ok, we're now ready to run the LiveIntervals analysis again.
   MF.getProperties().set(MachineFunctionProperties::Property::TracksLiveness);
 
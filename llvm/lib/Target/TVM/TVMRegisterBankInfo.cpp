@@ -0,0 +1,114 @@
+//===-- TVMRegisterBankInfo.cpp - Register bank info for TVM --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the targeting of the RegisterBankInfo class for TVM.
+/// The register bank of a value is determined by its type only, so
+/// RegBankSelect never has to insert cross-bank copies.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVMRegisterBankInfo.h"
+#include "MCTargetDesc/TVMMCTargetDesc.h"
+#include "TVMRegisterInfo.h"
+#include "llvm/CodeGen/GlobalISel/RegisterBank.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/TargetRegisterInfo.h"
+
+#define GET_TARGET_REGBANK_IMPL
+#include "TVMGenRegisterBank.inc"
+
+using namespace llvm;
+
+TVMRegisterBankInfo::TVMRegisterBankInfo(const TargetRegisterInfo &TRI)
+    : TVMGenRegisterBankInfo() {}
+
+const RegisterBank &TVMRegisterBankInfo::getRegBankFromRegClass(
+    const TargetRegisterClass &RC) const {
+  switch (RC.getID()) {
+  case TVM::I257RegClassID:
+    return getRegBank(TVM::IntRegBankID);
+  case TVM::SliceRegClassID:
+    return getRegBank(TVM::SliceRegBankID);
+  case TVM::BuilderRegClassID:
+    return getRegBank(TVM::BuilderRegBankID);
+  case TVM::CellRegClassID:
+    return getRegBank(TVM::CellRegBankID);
+  case TVM::TupleRegClassID:
+    return getRegBank(TVM::TupleRegBankID);
+  default:
+    llvm_unreachable("Unsupported register class");
+  }
+}
+
+const RegisterBank &TVMRegisterBankInfo::getRegBankForType(LLT Ty) const {
+  if (Ty.isPointer()) {
+    switch (Ty.getAddressSpace()) {
+    case 1:
+      return getRegBank(TVM::SliceRegBankID);
+    case 2:
+      return getRegBank(TVM::BuilderRegBankID);
+    case 3:
+      return getRegBank(TVM::CellRegBankID);
+    case 4:
+      return getRegBank(TVM::TupleRegBankID);
+    default:
+      break;
+    }
+  }
+  return getRegBank(TVM::IntRegBankID);
+}
+
+const TargetRegisterClass *
+TVMRegisterBankInfo::getRegClassForBank(const RegisterBank &RB) {
+  switch (RB.getID()) {
+  case TVM::IntRegBankID:
+    return &TVM::I257RegClass;
+  case TVM::SliceRegBankID:
+    return &TVM::SliceRegClass;
+  case TVM::BuilderRegBankID:
+    return &TVM::BuilderRegClass;
+  case TVM::CellRegBankID:
+    return &TVM::CellRegClass;
+  case TVM::TupleRegBankID:
+    return &TVM::TupleRegClass;
+  default:
+    llvm_unreachable("Unsupported register bank");
+  }
+}
+
+const RegisterBankInfo::InstructionMapping &
+TVMRegisterBankInfo::getInstrMapping(const MachineInstr &MI) const {
+  // Try the default logic for non-generic instructions that are either copies
+  // or already have some operands assigned to banks.
+  if (!isPreISelGenericOpcode(MI.getOpcode()) ||
+      MI.getOpcode() == TargetOpcode::G_PHI) {
+    const InstructionMapping &Mapping = getInstrMappingImpl(MI);
+    if (Mapping.isValid())
+      return Mapping;
+  }
+
+  const MachineRegisterInfo &MRI = MI.getMF()->getRegInfo();
+  unsigned NumOperands = MI.getNumOperands();
+  SmallVector<const ValueMapping *, 4> OperandsMapping(NumOperands);
+  for (unsigned Idx = 0; Idx < NumOperands; ++Idx) {
+    const MachineOperand &MO = MI.getOperand(Idx);
+    if (!MO.isReg() || !MO.getReg())
+      continue;
+    LLT Ty = MRI.getType(MO.getReg());
+    if (!Ty.isValid())
+      continue;
+    OperandsMapping[Idx] =
+        &getValueMapping(0, Ty.getSizeInBits(), getRegBankForType(Ty));
+  }
+
+  return getInstructionMapping(DefaultMappingID, /*Cost=*/1,
+                               getOperandsMapping(OperandsMapping),
+                               NumOperands);
+}
@@ -0,0 +1,54 @@
+//===-- TVMRegisterBankInfo.h - Register bank info for TVM ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the targeting of the RegisterBankInfo class for TVM.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_TVM_TVMREGISTERBANKINFO_H
+#define LLVM_LIB_TARGET_TVM_TVMREGISTERBANKINFO_H
+
+#include "llvm/CodeGen/GlobalISel/RegisterBankInfo.h"
+
+#define GET_REGBANK_DECLARATIONS
+#include "TVMGenRegisterBank.inc"
+
+namespace llvm {
+
+class LLT;
+class TargetRegisterInfo;
+
+class TVMGenRegisterBankInfo : public RegisterBankInfo {
+#define GET_TARGET_REGBANK_CLASS
+#include "TVMGenRegisterBank.inc"
+};
+
+/// There is a register bank for each register class: integers and the TVM
+/// reference types. The reference types are given pointer LLTs in the address
+/// spaces 1 (slice), 2 (builder), 3 (cell) and 4 (tuple), see getLLTForType.
+class TVMRegisterBankInfo final : public TVMGenRegisterBankInfo {
+public:
+  TVMRegisterBankInfo(const TargetRegisterInfo &TRI);
+
+  const RegisterBank &
+  getRegBankFromRegClass(const TargetRegisterClass &RC) const override;
+
+  const InstructionMapping &
+  getInstrMapping(const MachineInstr &MI) const override;
+
+  /// Get the register bank of values of type \p Ty.
+  const RegisterBank &getRegBankForType(LLT Ty) const;
+
+  /// Get the register class of the register bank \p RB.
+  static const TargetRegisterClass *getRegClassForBank(const RegisterBank &RB);
+};
+} // end namespace llvm
+
+#endif // LLVM_LIB_TARGET_TVM_TVMREGISTERBANKINFO_H
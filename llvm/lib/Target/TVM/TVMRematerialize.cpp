@@ -10,6 +10,12 @@
 /// \file
 /// This file implements a cheap definition rematerializtion pass.
 ///
+/// Trivially rematerializable definitions are cloned at each use. Repeatable
+/// state reads (GETGLOB, GETPARAM, PUSH c4, ...) are cloned at each use when
+/// that is cheaper in gas than carrying the value on the stack through the
+/// joins of the stack model roads, and nothing in between may modify the
+/// state they read.
+///
 //===----------------------------------------------------------------------===//
 
 #include "TVM.h"
@@ -24,12 +30,19 @@
 #include "llvm/CodeGen/MachineModuleInfoImpls.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
 
 #define DEBUG_TYPE "tvm-rematerialize"
 
+static cl::opt<bool> RematStateReads(
+    "tvm-remat-state-reads", cl::Hidden,
+    cl::desc("Rematerialize state reads when it is cheaper than carrying "
+             "the value on the stack"),
+    cl::init(true));
+
 namespace {
 class TVMRematerialize final : public MachineFunctionPass {
   StringRef getPassName() const override {
@@ -42,6 +55,8 @@ class TVMRematerialize final : public MachineFunctionPass {
     AU.addRequired<LiveIntervals>();
     AU.addPreserved<LiveIntervals>();
     AU.addPreservedID(LiveVariablesID);
+    AU.addRequired<MachineBlockFrequencyInfo>();
+    AU.addPreserved<MachineBlockFrequencyInfo>();
     MachineFunctionPass::getAnalysisUsage(AU);
   }
 
@@ -67,6 +82,46 @@ static bool ShouldRematerialize(const MachineInstr &Def, AliasAnalysis &AA,
   return Def.isAsCheapAsAMove() && TII->isTriviallyReMaterializable(Def, &AA);
 }
 
+static double getRelativeFreq(const MachineBasicBlock &MBB,
+                              const MachineBlockFrequencyInfo &MBFI) {
+  return static_cast<double>(MBFI.getBlockFreq(&MBB).getFrequency()) /
+         MBFI.getEntryFreq();
+}
+
+// Test whether Def is a state read which is safe and profitable to repeat at
+// each use of Reg. A value carried on the stack has to be put in place at
+// each join of the stack model roads it lives through and to be copied at
+// each use; a repeated read costs its gas price at each use instead.
+static bool ShouldReread(unsigned Reg, const MachineInstr &Def,
+                         const MachineFunction &MF,
+                         const MachineRegisterInfo &MRI,
+                         const LiveIntervals &LIS,
+                         const MachineBlockFrequencyInfo &MBFI,
+                         const TVMInstrInfo *TII) {
+  if (!RematStateReads || !TVM::isRepeatableStateRead(Def) ||
+      MRI.getUniqueVRegDef(Reg) != &Def)
+    return false;
+
+  const LiveInterval &LI = LIS.getInterval(Reg);
+  unsigned ReadGas = TII->getGasCost(Def);
+  double RereadCost = -getRelativeFreq(*Def.getParent(), MBFI) * ReadGas;
+  double CarryCost = 0;
+  for (const MachineInstr &Use : MRI.use_nodbg_instructions(Reg)) {
+    double Freq = getRelativeFreq(*Use.getParent(), MBFI);
+    RereadCost += Freq * ReadGas;
+    CarryCost += Freq * TII->getGasCost(TVM::PUSH);
+  }
+  for (const MachineBasicBlock &MBB : MF)
+    if (LIS.isLiveInToMBB(LI, &MBB))
+      CarryCost += getRelativeFreq(MBB, MBFI) * TII->getGasCost(TVM::XCHG);
+  if (RereadCost > CarryCost)
+    return false;
+
+  return !TVM::anyInstrInLiveRange(MF, LI, LIS, [&](const MachineInstr &MI) {
+    return &MI != &Def && TVM::mayClobberStateRead(MI, Def);
+  });
+}
+
 // Shrink LI to its uses, cleaning up LI.
 static void ShrinkToUses(LiveInterval &LI, LiveIntervals &LIS) {
   if (LIS.shrinkToUses(&LI)) {
@@ -147,6 +202,11 @@ bool TVMRematerialize::runOnMachineFunction(MachineFunction &MF) {
   const auto *TRI = MF.getSubtarget<TVMSubtarget>().getRegisterInfo();
   AliasAnalysis &AA = getAnalysis<AAResultsWrapperPass>().getAAResults();
   LiveIntervals &LIS = getAnalysis<LiveIntervals>();
+  auto &MBFI = getAnalysis<MachineBlockFrequencyInfo>();
+
+  // Whether to repeat a state read is decided once for all its uses, before
+  // the live interval starts to shrink.
+  DenseMap<unsigned, bool> Rereads;
 
   // Walk the instructions from the bottom up. Currently we don't look past
   // block boundaries, and the blocks aren't ordered so the block visitation
@@ -187,7 +247,14 @@ bool TVMRematerialize::runOnMachineFunction(MachineFunction &MF) {
         if (TVM::isArgument(*Def))
           continue;
 
-        if (ShouldRematerialize(*Def, AA, TII)) {
+        auto It = Rereads.find(Reg);
+        if (It == Rereads.end())
+          It = Rereads
+                   .insert({Reg, ShouldReread(Reg, *Def, MF, MRI, LIS, MBFI,
+                                              TII)})
+                   .first;
+
+        if (ShouldRematerialize(*Def, AA, TII) || It->second) {
           RematerializeCheapDef(Reg, Op, *Def, MBB, MI.getIterator(), LIS, MFI,
                                 MRI, TII, TRI);
           Changed = true;
@@ -0,0 +1,263 @@
+//===-- TVMSpecialize.cpp - Specialize functions for constant arguments ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Clone internal functions for the constant arguments they are called with.
+///
+/// Generic helpers (e.g. serialization with the bit width as an argument) are
+/// only cheap on TVM when the argument is known: the intrinsics get their
+/// immediate forms, comparisons and branches fold. Without inlining every
+/// call site, the pass groups the direct calls of a function by the constants
+/// passed to the arguments which would fold, and redirects each group to a
+/// clone with these arguments replaced by the constants and removed from the
+/// signature. The most frequent groups are specialized first, up to a limit
+/// of clones per function.
+///
+/// A clone is simplified right away and kept only if it saves enough
+/// instructions compared to the original function: folded instructions and
+/// branches, and uses of the constants which get immediate forms. Functions
+/// optimized for size are not specialized, the clones duplicate code.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVM.h"
+#include "llvm/ADT/SmallBitVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-specialize"
+
+STATISTIC(NumSpecialized, "Number of function specializations created");
+
+static cl::opt<unsigned> MaxSize(
+    "tvm-specialize-max-size", cl::Hidden, cl::init(400),
+    cl::desc("Maximal number of instructions of a function to specialize"));
+
+static cl::opt<unsigned>
+    MaxClones("tvm-specialize-max-clones", cl::Hidden, cl::init(4),
+              cl::desc("Maximal number of specializations of a function"));
+
+static cl::opt<unsigned> MinSavings(
+    "tvm-specialize-min-savings", cl::Hidden, cl::init(10),
+    cl::desc("Minimal percentage of the instructions of a function a "
+             "specialization must save"));
+
+namespace {
+class TVMSpecialize final : public ModulePass {
+public:
+  static char ID;
+  TVMSpecialize() : ModulePass(ID) {}
+
+  StringRef getPassName() const override {
+    return "TVM function specialization";
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  bool specialize(Function &F);
+};
+} // end anonymous namespace
+
+char TVMSpecialize::ID = 0;
+INITIALIZE_PASS(TVMSpecialize, DEBUG_TYPE,
+                "Specialize functions for constant arguments", false, false)
+
+ModulePass *llvm::createTVMSpecialize() { return new TVMSpecialize(); }
+
+/// Whether the argument used by \p U becomes an immediate operand when it is
+/// a constant: the widths of cell primitives and the shift amounts.
+static bool isImmediateUse(const Use &U) {
+  const User *I = U.getUser();
+  if (isa<IntrinsicInst>(I))
+    return true;
+  if (const auto *BO = dyn_cast<BinaryOperator>(I))
+    return Instruction::isShift(BO->getOpcode()) && U.getOperandNo() == 1;
+  return false;
+}
+
+/// Whether \p U of an argument folds or gets cheaper when the argument is a
+/// constant.
+static bool isFoldableUse(const Use &U) {
+  if (isImmediateUse(U))
+    return true;
+  const User *I = U.getUser();
+  if (isa<ICmpInst>(I) || isa<BinaryOperator>(I))
+    return isa<Constant>(I->getOperand(1 - U.getOperandNo()));
+  if (const auto *SI = dyn_cast<SwitchInst>(I))
+    return SI->getCondition() == U.get();
+  if (const auto *SI = dyn_cast<SelectInst>(I))
+    return SI->getCondition() == U.get();
+  if (const auto *BI = dyn_cast<BranchInst>(I))
+    return BI->isConditional() && BI->getCondition() == U.get();
+  return false;
+}
+
+static unsigned getNumInstructions(const Function &F) {
+  unsigned Size = 0;
+  for (const BasicBlock &BB : F)
+    Size += BB.size();
+  return Size;
+}
+
+static bool isCandidate(const Function &F) {
+  if (F.isDeclaration() || !F.hasLocalLinkage() || F.isVarArg() ||
+      F.hasFnAttribute(Attribute::OptimizeNone) || F.optForSize() ||
+      F.hasFnAttribute("tvm_raw_func") || F.hasAddressTaken())
+    return false;
+  return getNumInstructions(F) <= MaxSize;
+}
+
+/// Fold the constant arguments through \p F: simplify instructions, fold
+/// branches on constants and remove the blocks which become unreachable.
+static void simplify(Function &F) {
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (BasicBlock &BB : F) {
+      Changed |= SimplifyInstructionsInBlock(&BB);
+      Changed |= ConstantFoldTerminator(&BB, /*DeleteDeadConditions=*/true);
+    }
+    Changed |= removeUnreachableBlocks(F);
+  }
+}
+
+bool TVMSpecialize::runOnModule(Module &M) {
+  if (skipModule(M))
+    return false;
+  SmallVector<Function *, 16> Candidates;
+  for (Function &F : M)
+    if (isCandidate(F))
+      Candidates.push_back(&F);
+  bool Changed = false;
+  for (Function *F : Candidates)
+    Changed |= specialize(*F);
+  return Changed;
+}
+
+bool TVMSpecialize::specialize(Function &F) {
+  SmallBitVector Foldable(F.arg_size());
+  for (Argument &Arg : F.args())
+    Foldable[Arg.getArgNo()] = any_of(Arg.uses(), isFoldableUse);
+  if (Foldable.none())
+    return false;
+
+  // Group the calls by the constants passed to the foldable arguments.
+  using Key = SmallVector<Constant *, 4>;
+  SmallVector<std::pair<Key, SmallVector<CallInst *, 4>>, 8> Groups;
+  for (User *U : F.users()) {
+    auto *Call = dyn_cast<CallInst>(U);
+    if (!Call || Call->getCalledFunction() != &F)
+      continue;
+    Key K(F.arg_size(), nullptr);
+    bool HasConstant = false;
+    for (unsigned I = 0, E = F.arg_size(); I != E; ++I) {
+      auto *C = dyn_cast<ConstantInt>(Call->getArgOperand(I));
+      if (C && Foldable[I]) {
+        K[I] = C;
+        HasConstant = true;
+      }
+    }
+    if (!HasConstant)
+      continue;
+    auto It = find_if(Groups, [&](const auto &G) { return G.first == K; });
+    if (It == Groups.end()) {
+      Groups.emplace_back(K, SmallVector<CallInst *, 4>());
+      It = std::prev(Groups.end());
+    }
+    It->second.push_back(Call);
+  }
+  if (Groups.empty())
+    return false;
+
+  std::stable_sort(Groups.begin(), Groups.end(),
+                   [](const auto &L, const auto &R) {
+                     return L.second.size() > R.second.size();
+                   });
+
+  // Compare the clones with a simplified copy of the function, so that only
+  // the simplifications enabled by the constants count.
+  ValueToValueMapTy BaseVMap;
+  Function *Base = CloneFunction(&F, BaseVMap);
+  simplify(*Base);
+  unsigned Size = getNumInstructions(*Base);
+  Base->eraseFromParent();
+
+  unsigned NumClones = 0;
+  bool Changed = false;
+  for (auto &G : Groups) {
+    if (NumClones == MaxClones)
+      break;
+    const Key &K = G.first;
+    ValueToValueMapTy VMap;
+    unsigned ImmediateUses = 0;
+    for (Argument &Arg : F.args())
+      if (Constant *C = K[Arg.getArgNo()]) {
+        VMap[&Arg] = C;
+        ImmediateUses += count_if(Arg.uses(), isImmediateUse);
+      }
+    // Arguments mapped in VMap are removed from the signature of the clone.
+    Function *Clone = CloneFunction(&F, VMap);
+    simplify(*Clone);
+    unsigned CloneSize = getNumInstructions(*Clone);
+    unsigned Savings =
+        (Size > CloneSize ? Size - CloneSize : 0) + ImmediateUses;
+    if (Savings == 0 || Savings * 100 < Size * MinSavings) {
+      LLVM_DEBUG(dbgs() << "Specializing " << F.getName() << " saves only "
+                        << Savings << " of " << Size << " instructions\n");
+      Clone->eraseFromParent();
+      continue;
+    }
+    Clone->setName(F.getName() + ".spec");
+    ++NumClones;
+    ++NumSpecialized;
+    Changed = true;
+    LLVM_DEBUG(dbgs() << "Specialized " << F.getName() << " as "
+                      << Clone->getName() << " for " << G.second.size()
+                      << " calls, saving " << Savings << " instructions\n");
+
+    for (CallInst *Call : G.second) {
+      SmallVector<Value *, 8> Args;
+      SmallVector<AttributeSet, 8> ArgAttrs;
+      AttributeList Attrs = Call->getAttributes();
+      for (unsigned I = 0, E = F.arg_size(); I != E; ++I) {
+        if (K[I])
+          continue;
+        Args.push_back(Call->getArgOperand(I));
+        ArgAttrs.push_back(Attrs.getParamAttributes(I));
+      }
+      auto *NewCall = CallInst::Create(Clone, Args, "", Call);
+      NewCall->setAttributes(AttributeList::get(
+          F.getContext(), Attrs.getFnAttributes(), Attrs.getRetAttributes(),
+          ArgAttrs));
+      NewCall->setCallingConv(Call->getCallingConv());
+      NewCall->setTailCallKind(Call->getTailCallKind());
+      NewCall->setDebugLoc(Call->getDebugLoc());
+      NewCall->takeName(Call);
+      Call->replaceAllUsesWith(NewCall);
+      Call->eraseFromParent();
+    }
+  }
+
+  if (F.use_empty())
+    F.eraseFromParent();
+  return Changed;
+}
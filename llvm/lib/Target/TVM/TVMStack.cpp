@@ -27,8 +27,71 @@ namespace llvm {
 
 Stack::Stack(MachineFunction &MF, size_t Size)
     : TRI(MF.getSubtarget<TVMSubtarget>().getRegisterInfo()),
-      MRI(&MF.getRegInfo()),
-      Data(Size, StackVreg(TVMFunctionInfo::UnusedReg)) {}
+      MRI(&MF.getRegInfo()), Impl(std::make_shared<Storage>()) {
+  Impl->Slots.assign(Size, StackVreg(TVMFunctionInfo::UnusedReg));
+  Impl->NumUnused = Size;
+}
+
+void Stack::Storage::countSlot(unsigned Reg) {
+  if (Reg == TVMFunctionInfo::UnusedReg)
+    ++NumUnused;
+  else
+    ++Counts[Reg];
+}
+
+void Stack::Storage::uncountSlot(unsigned Reg) {
+  if (Reg == TVMFunctionInfo::UnusedReg) {
+    --NumUnused;
+    return;
+  }
+  auto It = Counts.find(Reg);
+  assert(It != Counts.end() && "Stack counts are out of sync");
+  if (!--It->second)
+    Counts.erase(It);
+}
+
+void Stack::Storage::push(const StackVreg &Elem) {
+  Slots.push_back(Elem);
+  countSlot(Elem.VirtReg);
+}
+
+void Stack::Storage::pop() {
+  assert(!Slots.empty() && "Pop from empty stack");
+  uncountSlot(Slots.back().VirtReg);
+  Slots.pop_back();
+}
+
+void Stack::Storage::assign(unsigned Phys, const StackVreg &Elem) {
+  uncountSlot(Slots[Phys].VirtReg);
+  countSlot(Elem.VirtReg);
+  Slots[Phys] = Elem;
+}
+
+Stack::Storage &Stack::mutableImpl() {
+  if (Impl.use_count() > 1)
+    Impl = std::make_shared<Storage>(*Impl);
+  return *Impl;
+}
+
+size_t Stack::position(size_t From, const StackVreg &Elem) const {
+  assert(From < size() && "Out of range access");
+  return std::distance(begin(), find_or_fail(drop_begin(*this, From), Elem));
+}
+
+size_t Stack::positionNrev(const StackVreg &Elem, int N) const {
+  assert(N >= 0 && static_cast<size_t>(N) < count(Elem));
+  auto It = std::find_if(Impl->Slots.begin(), Impl->Slots.end(),
+                         [&](const StackVreg &CurElem) {
+                           return (Elem == CurElem) && (N-- == 0);
+                         });
+  return physical(std::distance(Impl->Slots.begin(), It));
+}
+
+size_t Stack::count(const StackVreg &Elem) const {
+  if (Elem.VirtReg == TVMFunctionInfo::UnusedReg)
+    return Impl->NumUnused;
+  return Impl->Counts.lookup(Elem.VirtReg);
+}
 
 /// If \par MO is no longer used after \par MI.
 static bool isKilled(const MachineInstr &MI, unsigned Register,
@@ -57,19 +120,21 @@ MIArgs::MIArgs(MachineInstr &MI, const LiveIntervals &LIS, SlotIndex LIIndex) {
 
 Stack Stack::withArgs(const MIArgs &Args) const {
   Stack rv(*this);
+  Storage &S = rv.mutableImpl();
   for (auto Arg : Args.getArgs())
-    rv.Data.push_front(Arg.Vreg);
+    S.push(Arg.Vreg);
   return rv;
 }
 
 Stack Stack::filteredByLiveIns(MachineBasicBlock &MBB,
                                const LiveIntervals &LIS) const {
   Stack rv(*this);
-  for (StackVreg &vreg : rv.Data) {
-    if (!LIS.hasInterval(vreg.VirtReg) ||
-        !LIS.isLiveInToMBB(LIS.getInterval(vreg.VirtReg), &MBB)) {
-      vreg = StackVreg(TVMFunctionInfo::UnusedReg);
-    }
+  for (size_t I = 0, E = rv.size(); I < E; ++I) {
+    unsigned Reg = rv.reg(I);
+    if (Reg != TVMFunctionInfo::UnusedReg &&
+        (!LIS.hasInterval(Reg) ||
+         !LIS.isLiveInToMBB(LIS.getInterval(Reg), &MBB)))
+      rv.set(I, StackVreg(TVMFunctionInfo::UnusedReg));
   }
   return rv;
 }
@@ -77,11 +142,12 @@ Stack Stack::filteredByLiveIns(MachineBasicBlock &MBB,
 Stack Stack::filteredByLiveOuts(MachineBasicBlock &MBB,
                                 const LiveIntervals &LIS) const {
   Stack rv(*this);
-  for (StackVreg &vreg : rv.Data) {
-    if (!LIS.hasInterval(vreg.VirtReg) ||
-        !LIS.isLiveOutOfMBB(LIS.getInterval(vreg.VirtReg), &MBB)) {
-      vreg = StackVreg(TVMFunctionInfo::UnusedReg);
-    }
+  for (size_t I = 0, E = rv.size(); I < E; ++I) {
+    unsigned Reg = rv.reg(I);
+    if (Reg != TVMFunctionInfo::UnusedReg &&
+        (!LIS.hasInterval(Reg) ||
+         !LIS.isLiveOutOfMBB(LIS.getInterval(Reg), &MBB)))
+      rv.set(I, StackVreg(TVMFunctionInfo::UnusedReg));
   }
   return rv;
 }
@@ -102,7 +168,7 @@ Stack Stack::filteredByMIdefs(const MachineInstr &MI) const {
     });
     bool Used = (it != MI.uses().end());
     if (!Used)
-      rv.Data[rv.position(Vreg)] = StackVreg(TVMFunctionInfo::UnusedReg);
+      rv.set(rv.position(Vreg), StackVreg(TVMFunctionInfo::UnusedReg));
   }
   return rv;
 }
@@ -110,81 +176,88 @@ Stack Stack::filteredByMIdefs(const MachineInstr &MI) const {
 void Stack::filterByDeadDefs(MachineInstr &MI) {
   for (const auto &MO : MI.defs()) {
     if (MO.isReg() && MO.isDead()) {
-      for (auto &Vreg : Data) {
-        if (Vreg.VirtReg == MO.getReg())
-          Vreg.VirtReg = TVMFunctionInfo::UnusedReg;
+      StackVreg Vreg(MO.getReg());
+      while (exist(Vreg)) {
+        size_t Slot = position(Vreg);
+        set(Slot, StackVreg(TVMFunctionInfo::UnusedReg, (*this)[Slot].DbgVar));
       }
     }
   }
 }
 
 void Stack::filterByImpDefs(const Stack &TheStack) {
-  for (auto &Vreg : Data) {
+  for (size_t I = 0, E = size(); I < E; ++I) {
+    const StackVreg &Vreg = (*this)[I];
     if (Vreg.VirtReg != TVMFunctionInfo::UnusedReg && !TheStack.exist(Vreg))
-      Vreg.VirtReg = TVMFunctionInfo::UnusedReg;
+      set(I, StackVreg(TVMFunctionInfo::UnusedReg, Vreg.DbgVar));
   }
 }
 
 void Stack::fillUnusedRegs(SmallVector<StackVreg, 16> &Regs) {
-  for (StackVreg &VR : Data) {
+  if (!count(StackVreg(TVMFunctionInfo::UnusedReg)))
+    return;
+  for (size_t I = 0, E = size(); I < E; ++I) {
     if (Regs.empty())
-        return;
-    if (VR.VirtReg == TVMFunctionInfo::UnusedReg) {
-      VR = Regs.pop_back_val();
-    }
+      return;
+    if (reg(I) == TVMFunctionInfo::UnusedReg)
+      set(I, Regs.pop_back_val());
   }
 }
 
 void Stack::addDef(unsigned Reg, const DILocalVariable *DbgVar) {
-  Data.push_front(StackVreg(Reg, DbgVar));
+  mutableImpl().push(StackVreg(Reg, DbgVar));
 }
 
 Stack& Stack::operator += (const StackFixup::Change &change) {
+  Storage &S = mutableImpl();
+  unsigned Sz = S.Slots.size();
   std::visit(
       overloaded{
-          [this](StackFixup::pop v) {
-            assert(Data.size() >= v.i && "Wrong stack slot for pop");
-            Data[v.i] = Data[0];
-            Data.erase(std::begin(Data));
+          [&](StackFixup::pop v) {
+            assert(Sz > v.i && "Wrong stack slot for pop");
+            S.assign(physical(v.i), S.Slots.back());
+            S.pop();
+          },
+          [&](StackFixup::xchgTop v) {
+            std::swap(S.Slots[physical(0)], S.Slots[physical(v.i)]);
+          },
+          [&](StackFixup::xchg v) {
+            std::swap(S.Slots[physical(v.i)], S.Slots[physical(v.j)]);
+          },
+          [&](StackFixup::pushI v) {
+            StackVreg Elem = S.Slots[physical(v.i)];
+            S.push(Elem);
           },
-          [this](StackFixup::xchgTop v) { std::swap(Data[0], Data[v.i]); },
-          [this](StackFixup::xchg v) { std::swap(Data[v.i], Data[v.j]); },
-          [this](StackFixup::pushI v) { Data.push_front(Data[v.i]); },
           [](StackFixup::pushHidden v) {},
-          [this](StackFixup::pushUndef) {
-            Data.push_front(StackVreg(TVMFunctionInfo::UnusedReg));
+          [&](StackFixup::pushUndef) {
+            S.push(StackVreg(TVMFunctionInfo::UnusedReg));
           },
-          [this](StackFixup::blkswap v) {
-            assert(v.deepSz + v.topSz <= Data.size() && "Wrong blkswap");
-            decltype(Data) topCopy(Data.begin(), Data.begin() + v.topSz);
-            Data.erase(Data.begin(), Data.begin() + v.topSz);
-            Data.insert(Data.begin() + v.deepSz, topCopy.begin(),
-                        topCopy.end());
+          [&](StackFixup::blkswap v) {
+            assert(v.deepSz + v.topSz <= Sz && "Wrong blkswap");
+            std::rotate(S.Slots.end() - v.deepSz - v.topSz,
+                        S.Slots.end() - v.topSz, S.Slots.end());
           },
-          [this](StackFixup::roll v) {
-            assert((unsigned)std::abs(v.i) < Data.size() && "Wrong blkswap");
-            if (v.i > 0) {
-              auto deepElem = Data[v.i];
-              Data.erase(Data.begin() + v.i);
-              Data.push_front(deepElem);
-            } else {
-              auto topElem = Data.front();
-              Data.pop_front();
-              Data.insert(Data.begin() + (-v.i), topElem);
-            }
+          [&](StackFixup::roll v) {
+            assert((unsigned)std::abs(v.i) < Sz && "Wrong blkswap");
+            auto B = S.Slots.begin() + physical(std::abs(v.i));
+            if (v.i > 0)
+              std::rotate(B, B + 1, S.Slots.end());
+            else
+              std::rotate(B, S.Slots.end() - 1, S.Slots.end());
           },
-          [this](StackFixup::reverse v) {
-            assert(v.topIdx + v.deepSz <= Data.size() && "Wrong reverse");
-            std::reverse(Data.begin() + v.topIdx,
-                         Data.begin() + v.topIdx + v.deepSz);
+          [&](StackFixup::reverse v) {
+            assert(v.topIdx + v.deepSz <= Sz && "Wrong reverse");
+            std::reverse(S.Slots.end() - v.topIdx - v.deepSz,
+                         S.Slots.end() - v.topIdx);
           },
-          [this](StackFixup::blkdrop v) {
-            assert(v.sz <= Data.size() && "Wrong blkdrop");
-            Data.erase(Data.begin(), Data.begin() + v.sz);
+          [&](StackFixup::blkdrop v) {
+            assert(v.sz <= Sz && "Wrong blkdrop");
+            for (unsigned I = 0; I < v.sz; ++I)
+              S.pop();
           },
           [&](const StackFixup::doubleChange &v) {
             for ([[maybe_unused]] unsigned Arg : v.args)
-              assert(Arg < Data.size() && "Bad doubleChange");
+              assert(Arg < size() && "Bad doubleChange");
             if (v.isPush(0) && v.isPush(1)) {
               (*this) += StackFixup::pushI(v.args[0], false);
               (*this) += StackFixup::pushI(v.args[1] + 1, false);
@@ -202,7 +275,7 @@ Stack& Stack::operator += (const StackFixup::Change &change) {
           },
           [&](const StackFixup::tripleChange &v) {
             for ([[maybe_unused]] unsigned Arg : v.args)
-              assert(Arg < Data.size() && "Bad tripleChange");
+              assert(Arg < size() && "Bad tripleChange");
             if (v.isPush(0) && v.isPush(1) && v.isPush(2)) {
               (*this) += StackFixup::pushI(v.args[0], false);
               (*this) += StackFixup::pushI(v.args[1] + 1, false);
@@ -254,12 +327,21 @@ Stack Stack::operator + (const StackFixup &fixup) const {
 
 void Stack::print(raw_ostream &OS) const {
   OS << "{ ";
-  if (!Data.empty()) {
-    llvm::for_each(reverse(Data), [&OS, this](const StackVreg &Elem) {
-      printElement(OS, Elem);
-      OS << " | ";
-    });
-  }
+  llvm::for_each(Impl->Slots, [&OS, this](const StackVreg &Elem) {
+    printElement(OS, Elem);
+    OS << " | ";
+  });
+  OS << "- }";
+}
+
+void Stack::print(raw_ostream &OS, ArrayRef<StackVreg> Slots,
+                  const TargetRegisterInfo *TRI,
+                  const MachineRegisterInfo *MRI) {
+  OS << "{ ";
+  llvm::for_each(reverse(Slots), [&](const StackVreg &Elem) {
+    printElement(OS, Elem, TRI, MRI);
+    OS << " | ";
+  });
   OS << "- }";
 }
 
@@ -281,6 +363,12 @@ void Stack::dump() const {
 #endif
 
 void Stack::printElement(raw_ostream &OS, const StackVreg &Vreg) const {
+  printElement(OS, Vreg, TRI, MRI);
+}
+
+void Stack::printElement(raw_ostream &OS, const StackVreg &Vreg,
+                         const TargetRegisterInfo *TRI,
+                         const MachineRegisterInfo *MRI) {
   if (Vreg.VirtReg == TVMFunctionInfo::UnusedReg) {
     OS << "x";
     return;
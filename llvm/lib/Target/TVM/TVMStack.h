@@ -15,9 +15,11 @@
 #ifndef LLVM_LIB_TARGET_TVM_TVMSTACK_H
 #define LLVM_LIB_TARGET_TVM_TVMSTACK_H
 
-#include <deque>
+#include <memory>
 #include <variant>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/CodeGen/LiveIntervals.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/Support/Debug.h"
@@ -52,22 +54,34 @@ private:
 /// with the emitted code.
 /// Provide interfaces to track positions of local variables and mutate the
 /// stack.
+///
+/// Slots are numbered from the top of the stack (slot 0 is the top). They are
+/// kept in a contiguous vector in reverse order, so that pushes and pops don't
+/// move the rest of the stack, along with the number of slots each register
+/// occupies, so that count() and exist() don't scan the stack. Copies of a
+/// stack share the storage until one of them is modified, which makes the
+/// speculative copies taken while computing fixups cheap.
 class Stack {
-public:
-  typedef std::deque<StackVreg> StackDeq;
+  using SlotVector = SmallVector<StackVreg, 16>;
 
+public:
   Stack(MachineFunction &MF, size_t Size);
 
   Stack &operator += (const StackFixup::Change &change);
 
   Stack operator + (const StackFixup &fixup) const;
 
-  auto size() const { return Data.size(); }
+  size_t size() const { return Impl->Slots.size(); }
 
-  bool operator == (const Stack &v) const { return Data == v.Data; }
-  bool operator != (const Stack &v) const { return Data != v.Data; }
+  bool operator == (const Stack &v) const {
+    return Impl == v.Impl || Impl->Slots == v.Impl->Slots;
+  }
+  bool operator != (const Stack &v) const { return !(*this == v); }
 
-  const StackVreg &operator[](unsigned i) const { return Data[i]; }
+  const StackVreg &operator[](unsigned i) const {
+    assert(i < size() && "Out of range access");
+    return Impl->Slots[physical(i)];
+  }
 
   /// Return a copy of stack with \par Args added on top.
   /// When fixup is calculated we need to compare the stack after final
@@ -95,66 +109,55 @@ public:
   /// Regs.
   void fillUnusedRegs(SmallVector<StackVreg, 16> &Regs);
 
-  auto begin() { return Data.begin(); }
-  auto begin() const { return Data.begin(); }
-  auto end() { return Data.end(); }
-  auto end() const { return Data.end(); }
+  /// Iterate the stack from the top to the bottom.
+  auto begin() const { return Impl->Slots.rbegin(); }
+  auto end() const { return Impl->Slots.rend(); }
 
   /// Return position of \par Elem in the stack.
   /// Precondition: \par Elem is in the stack.
   size_t position(const StackVreg& Elem) const {
-    return std::distance(std::begin(Data), llvm::find_or_fail(Data, Elem));
-  }
-  size_t position(size_t From, const StackVreg& Elem) const {
-    return std::distance(std::begin(Data),
-                         find_or_fail(drop_begin(Data, From), Elem));
-  }
-  size_t position(unsigned Reg) const {
-    return std::distance(std::begin(Data), llvm::find_or_fail(Data, Reg));
+    return position(0, Elem);
   }
+  /// Return position of the first \par Elem found starting from \p From.
+  size_t position(size_t From, const StackVreg& Elem) const;
+  size_t position(unsigned Reg) const { return position(StackVreg(Reg)); }
   /// Return position of \par N occurrence of \par Elem from stack deep
   /// \par N - starts from 0
-  size_t positionNrev(const StackVreg &Elem, int N) const {
-    auto it = std::find_if(Data.rbegin(), Data.rend(),
-                           [&](const StackVreg &CurElem) {
-      return (Elem == CurElem) && (N-- == 0);
-    });
-    assert(it != Data.rend());
-    return Data.size() - 1 - (it - Data.rbegin());
-  }
+  size_t positionNrev(const StackVreg &Elem, int N) const;
   /// Return register for \par Slot in the stack.
-  /// Precondition: Slot < Data.size() && Data[Slot] is a register.
-  unsigned reg(size_t Slot) const {
-    assert(Slot < Data.size() && "Out of range access");
-    return Data[Slot].VirtReg;
-  }
+  /// Precondition: Slot < size() && the slot is a register.
+  unsigned reg(size_t Slot) const { return (*this)[Slot].VirtReg; }
   /// Fill the specified \p Slot with \p Elem.
   void set(size_t Slot, const StackVreg &Elem) {
-    assert(Slot < Data.size() && "Out of range access");
-    Data[Slot] = Elem;
+    assert(Slot < size() && "Out of range access");
+    mutableImpl().assign(physical(Slot), Elem);
   }
   /// Remove arguments an instruction consumed from the stack.
   /// Precondition: Stack has enough Slots to consume.
   void consumeArguments(size_t NumSlots) {
-    assert(NumSlots <= Data.size());
-    Data.erase(std::begin(Data), std::begin(Data) + NumSlots);
+    assert(NumSlots <= size());
+    Storage &S = mutableImpl();
+    while (NumSlots--)
+      S.pop();
   }
   /// Pushes result of an instruction to the stack.
   void addDef(unsigned Reg, const DILocalVariable *DbgVar);
   /// Checks if specified \p Slot contains specified \p Elem.
   bool slotContains(size_t Slot, const StackVreg &Elem) const {
-    assert(Slot < Data.size() && "Out of range access");
-    return Data[Slot] == Elem;
+    return (*this)[Slot] == Elem;
   }
   /// Checks if specified \p Elem present.
-  bool exist(const StackVreg &Elem) const {
-    return llvm::exist(Data, Elem);
-  }
-  size_t count(const StackVreg &Elem) const {
-    return llvm::count(Data, Elem);
-  }
+  bool exist(const StackVreg &Elem) const { return count(Elem) != 0; }
+  size_t count(const StackVreg &Elem) const;
   void print(raw_ostream &OS) const;
   void printElement(raw_ostream &OS, const StackVreg &Vreg) const;
+  /// Print a stack given by its \p Slots from the top.
+  static void print(raw_ostream &OS, ArrayRef<StackVreg> Slots,
+                    const TargetRegisterInfo *TRI,
+                    const MachineRegisterInfo *MRI);
+  static void printElement(raw_ostream &OS, const StackVreg &Vreg,
+                           const TargetRegisterInfo *TRI,
+                           const MachineRegisterInfo *MRI);
   std::string toString() const;
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_DUMP)
   /// Allow easy printing of the stack from the debugger.
@@ -163,10 +166,30 @@ public:
 
   StackFixup operator-(const Stack &v) const;
 private:
-  friend class StackFixup;
+  /// Slots of the stack, the top is the last one, and the number of slots
+  /// each register occupies. Reordering slots doesn't change the counts.
+  /// The unused register isn't a valid map key, it is counted separately.
+  struct Storage {
+    SlotVector Slots;
+    DenseMap<unsigned, unsigned> Counts;
+    unsigned NumUnused = 0;
+
+    void countSlot(unsigned Reg);
+    void uncountSlot(unsigned Reg);
+
+    void push(const StackVreg &Elem);
+    void pop();
+    void assign(unsigned Phys, const StackVreg &Elem);
+  };
+
+  /// Convert position of a slot from the top to the index in Storage::Slots.
+  unsigned physical(size_t Slot) const { return size() - 1 - Slot; }
+  /// Get the storage for modification, detaching it from other copies.
+  Storage &mutableImpl();
+
   const TargetRegisterInfo *TRI;
   const MachineRegisterInfo *MRI;
-  StackDeq Data;
+  std::shared_ptr<Storage> Impl;
 };
 
 //===----------------------------------------------------------------------===//
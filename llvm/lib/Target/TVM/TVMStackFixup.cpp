@@ -16,6 +16,7 @@
 #include "TVMStackPatterns.h"
 #include "TVMSubtarget.h"
 #include "TVMUtilities.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/TargetInstrInfo.h"
 #include "llvm/IR/DebugInfoMetadata.h"
@@ -55,10 +56,10 @@ struct Deleter {
     while (auto Bl = extractBlock()) {
       auto sz = 1 + Bl->second - Bl->first;
       if (Bl->first != 0)
-        fixup(curStack += fixup(fixup.makeBlkSwap(sz, Bl->first)));
+        curStack += fixup(fixup.makeBlkSwap(sz, Bl->first));
     }
     if (auto delSz = static_cast<unsigned>(DelIndices.size()))
-      fixup(curStack += fixup(fixup.makeBlkdrop(delSz)));
+      curStack += fixup(fixup.makeBlkdrop(delSz));
   }
 
   unsigned i = 0;
@@ -66,60 +67,67 @@ struct Deleter {
 };
 }
 
+/// Compute the registers \p From holds more times than \p Keep tells (the
+/// multiset difference), sorted by register.
+/// Occurrences are counted by the stack, so neither of the stacks is copied
+/// and sorted.
+static SmallVector<StackVreg, 16>
+regsDifference(const Stack &From,
+               function_ref<size_t(const StackVreg &)> Keep) {
+  SmallVector<StackVreg, 16> Rv;
+  SmallDenseSet<unsigned, 16> Seen;
+  bool UnusedSeen = false;
+  for (const StackVreg &Vreg : From) {
+    // Visit each register once.
+    if (Vreg.VirtReg == TVMFunctionInfo::UnusedReg) {
+      if (UnusedSeen)
+        continue;
+      UnusedSeen = true;
+    } else if (!Seen.insert(Vreg.VirtReg).second) {
+      continue;
+    }
+    size_t Count = From.count(Vreg);
+    size_t Kept = std::min(Count, Keep(Vreg));
+    Rv.append(Count - Kept, Vreg);
+  }
+  llvm::sort(Rv.begin(), Rv.end());
+  return Rv;
+}
+
 StackFixup StackFixup::Diff(const Stack &to, const Stack &from) {
   StackFixup rv;
 
   Stack curStack(from);
 
-  SmallVector<StackVreg, 16> fromRegs(from.begin(), from.end());
-  SmallVector<StackVreg, 16> toRegs(to.begin(), to.end());
-
-  llvm::sort(fromRegs.begin(), fromRegs.end());
-  llvm::erase_if(fromRegs, [](const StackVreg &vreg) {
+  auto isUnused = [](const StackVreg &vreg) {
     return vreg.VirtReg == TVMFunctionInfo::UnusedReg;
-  });
-  llvm::sort(toRegs.begin(), toRegs.end());
-  llvm::erase_if(toRegs, [](const StackVreg &vreg) {
-    return vreg.VirtReg == TVMFunctionInfo::UnusedReg;
-  });
-
-  SmallVector<StackVreg, 16> delVregs;
-  std::set_difference(fromRegs.begin(), fromRegs.end(),
-                      toRegs.begin(), toRegs.end(),
-                      std::back_inserter(delVregs));
+  };
+  SmallVector<StackVreg, 16> delVregs =
+      regsDifference(from, [&](const StackVreg &vreg) {
+        return isUnused(vreg) ? from.size() : to.count(vreg);
+      });
   Stack unmaskedTo(to);
   unmaskedTo.fillUnusedRegs(delVregs);
 
-  fromRegs = SmallVector<StackVreg, 16>(curStack.begin(), curStack.end());
-  toRegs = SmallVector<StackVreg, 16>(unmaskedTo.begin(), unmaskedTo.end());
-
-  llvm::sort(fromRegs.begin(), fromRegs.end());
-  llvm::sort(toRegs.begin(), toRegs.end());
-  SmallVector<StackVreg, 16> fromRegs2;
-  std::set_difference(fromRegs.begin(), fromRegs.end(),
-                      delVregs.begin(), delVregs.end(),
-                      std::back_inserter(fromRegs2));
-  fromRegs.swap(fromRegs2);
-
-  std::set_difference(fromRegs.begin(), fromRegs.end(),
-                      toRegs.begin(), toRegs.end(),
-                      std::back_inserter(delVregs));
+  // Registers not placed into unused slots of the destination are deleted
+  // along with the ones missing in the unmasked destination.
+  DenseMap<unsigned, unsigned> Unplaced;
+  for (const StackVreg &vreg : delVregs)
+    ++Unplaced[vreg.VirtReg];
+  auto moreDelVregs = regsDifference(curStack, [&](const StackVreg &vreg) {
+    size_t NumUnplaced = isUnused(vreg) ? 0 : Unplaced.lookup(vreg.VirtReg);
+    return NumUnplaced + unmaskedTo.count(vreg);
+  });
+  delVregs.append(moreDelVregs.begin(), moreDelVregs.end());
   if (!delVregs.empty()) {
     Deleter del(curStack, delVregs);
     del.deleteBlocks(rv, curStack);
   }
 
-
-  fromRegs = SmallVector<StackVreg, 16>(curStack.begin(), curStack.end());
-  toRegs = SmallVector<StackVreg, 16>(unmaskedTo.begin(), unmaskedTo.end());
-
-  llvm::sort(fromRegs.begin(), fromRegs.end());
-  llvm::sort(toRegs.begin(), toRegs.end());
-
-  SmallVector<StackVreg, 16> addVregs;
-  std::set_difference(toRegs.begin(), toRegs.end(),
-                      fromRegs.begin(), fromRegs.end(),
-                      std::back_inserter(addVregs));
+  SmallVector<StackVreg, 16> addVregs =
+      regsDifference(unmaskedTo, [&](const StackVreg &vreg) {
+        return curStack.count(vreg);
+      });
 
   // Generate changes to insert copies (pushes)
   // TODO: It's not always the optimal sequence of stack manipulations.
@@ -127,11 +135,11 @@ StackFixup StackFixup::Diff(const Stack &to, const Stack &from) {
   // XCHG s0, s3 first.
   auto addElem = [&](const StackVreg &vreg) {
     if (vreg.VirtReg == TVMFunctionInfo::UnusedReg) {
-      rv(curStack += rv(pushUndef()));
+      curStack += rv(pushUndef());
       return;
     }
     auto i = curStack.position(vreg);
-    rv(curStack += rv(pushI(i)));
+    curStack += rv(pushI(i));
   };
   llvm::for_each(addVregs, addElem);
 
@@ -275,7 +283,7 @@ void StackFixup::generateVagonXchgs(StackFixup &rv, const Stack &from,
     auto V = *restVagons.begin();
     unsigned VagonSz = V.DeepIdx + 1 - V.TopIdx;
     if (V.TopIdx) {
-      rv(curStack += rv(makeBlkSwap(VagonSz, V.TopIdx)));
+      curStack += rv(makeBlkSwap(VagonSz, V.TopIdx));
       for (auto &V2 : restVagons)
         if (V2.TopIdx < V.TopIdx) {
           V2.TopIdx += VagonSz;
@@ -283,7 +291,7 @@ void StackFixup::generateVagonXchgs(StackFixup &rv, const Stack &from,
         }
     }
     if (V.Inverted)
-      rv(curStack += rv(makeReverse(VagonSz)));
+      curStack += rv(makeReverse(VagonSz));
 
     restVagons = drop_begin(restVagons, 1);
   }
@@ -300,7 +308,7 @@ StackFixup StackFixup::DiffForReturn(const Stack &from,
     size_t i = j;
     if (*Preserved == TVMFunctionInfo::UnusedReg) {
       if (!numPops) {
-        rv(curStack += rv(pushUndef()));
+        curStack += rv(pushUndef());
       }
     } else {
       i = from.position(StackVreg(*Preserved));
@@ -310,32 +318,30 @@ StackFixup StackFixup::DiffForReturn(const Stack &from,
       --numPops;
     if (i != j) {
       if (i == 0) {
-        rv(curStack += rv(xchgTop(j)));
+        curStack += rv(xchgTop(j));
       } else if (j == 0) {
-        rv(curStack += rv(xchgTop(i)));
+        curStack += rv(xchgTop(i));
       } else if (i <= XchgLimit && j <= XchgLimit) {
-        rv(curStack += rv(xchg(i, j)));
+        curStack += rv(xchg(i, j));
       } else {
-        rv(curStack += rv(xchgTop(i)));
-        rv(curStack += rv(xchgTop(j)));
-        rv(curStack += rv(xchgTop(i)));
+        curStack += rv(xchgTop(i));
+        curStack += rv(xchgTop(j));
+        curStack += rv(xchgTop(i));
       }
     }
   }
   if (numPops)
-    rv(curStack += rv(makeBlkdrop(numPops)));
+    curStack += rv(makeBlkdrop(numPops));
   rv.optimize();
-  rv.annotate(from);
   return rv;
 }
 
 StackFixup StackFixup::DiffForReturnMulti(const Stack &Src,
                                           ArrayRef<unsigned> RetRegs) {
   Stack Dst(Src);
-  unsigned Sz = RetRegs.size();
-  Dst.Data.resize(Sz, StackVreg(TVMFunctionInfo::UnusedReg));
-  for (unsigned i = 0; i < Sz; ++i)
-    Dst.Data[i] = StackVreg(RetRegs[Sz - i - 1]);
+  Dst.consumeArguments(Dst.size());
+  for (unsigned Reg : RetRegs)
+    Dst.addDef(Reg, nullptr);
   // TODO: maybe implement more optimal way to prepare return regs
   return Diff(Dst, Src);
 }
@@ -354,7 +360,7 @@ StackFixup StackFixup::DiffForArgs(const Stack &From, const MIArgs &Args,
     ++TopUnused;
   }
   if (TopUnused)
-    rv(CurStack += rv(makeBlkdrop(TopUnused)));
+    CurStack += rv(makeBlkdrop(TopUnused));
 
   const auto &Ar = Args.getArgs();
   struct argInfo {
@@ -405,7 +411,6 @@ StackFixup StackFixup::DiffForArgs(const Stack &From, const MIArgs &Args,
   }
   // If all args already in place and no pushes required
   if (AlreadyGood) {
-    rv.annotate(From);
     return rv;
   }
 
@@ -414,9 +419,9 @@ StackFixup StackFixup::DiffForArgs(const Stack &From, const MIArgs &Args,
     StackVreg Vreg(Ar[0].Vreg);
     unsigned Pos = CurStack.position(Vreg);
     if (ArgInfo[0].Push)
-      rv(CurStack += rv(pushI(Pos)));
+      CurStack += rv(pushI(Pos));
     else if (Pos != 0)
-      rv(CurStack += rv(xchgTop(Pos)));
+      CurStack += rv(xchgTop(Pos));
   } else if (Ar.size() == 2 && !CantBeOptimized) {
     auto Pos0 = ArgInfo[0].SrcPos;
     auto Pos1 = ArgInfo[1].SrcPos;
@@ -471,18 +476,17 @@ StackFixup StackFixup::DiffForArgs(const Stack &From, const MIArgs &Args,
       StackVreg Vreg(Ar[i].Vreg);
       if (ArgInfo[i].Push) {
         if (Vreg.VirtReg == TVMFunctionInfo::UnusedReg)
-          rv(CurStack += rv(pushUndef()));
+          CurStack += rv(pushUndef());
         else
-          rv(CurStack += rv(pushI(CurStack.position(Vreg))));
+          CurStack += rv(pushI(CurStack.position(Vreg)));
         ++Offset;
       } else if (auto Pos = CurStack.position(Offset, Vreg)) {
-        rv(CurStack += rv(makeRoll(Pos)));
+        CurStack += rv(makeRoll(Pos));
         ++Offset;
       }
     }
   }
   rv.optimize(IsCommutative);
-  rv.annotate(From);
   return rv;
 }
 
@@ -490,33 +494,25 @@ StackFixup StackFixup::DiffForHiddenStack(const Stack &Src, size_t Element,
                                           unsigned OutRegister) {
   Stack CurrentStack(Src);
   StackFixup rv;
-  rv(CurrentStack += rv(pushHidden(Src.size() + Element, OutRegister)));
+  CurrentStack += rv(pushHidden(Src.size() + Element, OutRegister));
   return rv;
 }
 
 void StackFixup::apply(Stack &stack) const {
-  for (auto p : Changes)
-    stack += p.first;
-}
-
-void StackFixup::annotate(const Stack &stack) {
-  Stack curStack(stack);
-  for (auto &p : Changes) {
-    curStack += p.first;
-    p.second = curStack.toString();
-  }
+  for (const auto &change : Changes)
+    stack += change;
 }
 
 void StackFixup::removeElem(Stack &stack, const StackVreg &vreg) {
   auto &rv = (*this);
   auto i = stack.position(vreg);
   if (i == 0) {
-    rv(stack += rv(pop(0)));
+    stack += rv(pop(0));
   } else if (i == 1) {
-    rv(stack += rv(pop(1)));
+    stack += rv(pop(1));
   } else {
-    rv(stack += rv(makeRoll(i)));
-    rv(stack += rv(pop(0)));
+    stack += rv(makeRoll(i));
+    stack += rv(pop(0));
   }
 }
 
@@ -586,8 +582,8 @@ void StackFixup::optimizeEqualXchgs() {
       continue;
     }
     auto prevIt = std::prev(it);
-    auto cur = it->first;
-    auto prev = prevIt->first;
+    auto cur = *it;
+    auto prev = *prevIt;
 
     if (auto curXchg = std::get_if<xchgTop>(&cur)) {
       if (auto topXchg = std::get_if<xchgTop>(&prev)) {
@@ -610,15 +606,15 @@ void StackFixup::optimize(bool IsCommutative) {
   // TODO: we can do more for commutative instructions.
   if (IsCommutative) {
     if (Changes.size() == 1u) {
-      auto &Change = Changes[0].first;
+      auto &Change = Changes[0];
       if (auto *Xchg = std::get_if<xchgTop>(&Change)) {
         if (Xchg->i == 1u)
           Changes.clear();
       }
     } else if (Changes.size() == 2u &&
-               (std::holds_alternative<pushI>(Changes[0].first) ||
-                std::holds_alternative<pushUndef>(Changes[0].first))) {
-      auto &Change = Changes[1].first;
+               (std::holds_alternative<pushI>(Changes[0]) ||
+                std::holds_alternative<pushUndef>(Changes[0]))) {
+      auto &Change = Changes[1];
       if (auto *Xchg = std::get_if<xchgTop>(&Change)) {
         if (Xchg->i == 1u)
           Changes.pop_back();
@@ -627,10 +623,6 @@ void StackFixup::optimize(bool IsCommutative) {
   }
 }
 
-void StackFixup::operator()(const Stack &stack) {
-  setLastComment(stack.toString());
-}
-
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_DUMP)
 void StackFixup::printElem(raw_ostream &OS, const Change &change) const {
   visit(
@@ -662,9 +654,9 @@ void StackFixup::printElem(raw_ostream &OS, const Change &change) const {
 }
 
 void StackFixup::print(raw_ostream &OS) const {
-  llvm::for_each(Changes, [&](const std::pair<Change, std::string> &v) {
-    printElem(OS, v.first);
-    OS << "; " << v.second << "\n";
+  llvm::for_each(Changes, [&](const Change &v) {
+    printElem(OS, v);
+    OS << "\n";
   });
 }
 
@@ -673,7 +665,7 @@ void StackFixup::dump() const { print(dbgs()); }
 #endif
 
 MachineInstr *StackFixup::InstructionGenerator::
-operator()(const std::pair<Change, std::string> &pair) const {
+operator()(const Change &change) const {
   MachineInstr *MI = nullptr;
   LLVMContext &C = MBB->getParent()->getFunction().getContext();
   visit(
@@ -795,16 +787,20 @@ operator()(const std::pair<Change, std::string> &pair) const {
                      .addImm(v.args[2])
                      .getInstr();
           }},
-      pair.first);
+      change);
 
   assert(MI && "MI is not generated");
-
-  MFI->addStackModelComment(MI, pair.second);
   return MI;
 }
 
-void StackFixup::InstructionGenerator::operator()(const StackFixup &v) const {
-  llvm::for_each(v.getChanges(), *this);
+void StackFixup::InstructionGenerator::operator()(const StackFixup &v,
+                                                  Stack &TheStack) const {
+  for (const auto &change : v.getChanges()) {
+    MachineInstr *MI = (*this)(change);
+    TheStack += change;
+    if (MFI->hasStackModelComments())
+      MFI->addStackModelComment(MI, StackModelComment(TheStack));
+  }
 }
 
 } // namespace llvm
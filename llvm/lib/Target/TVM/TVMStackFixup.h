@@ -252,7 +252,7 @@ public:
   using Change =
       std::variant<pop, xchgTop, xchg, pushI, pushHidden, pushUndef, blkswap,
                    blkdrop, roll, reverse, doubleChange, tripleChange>;
-  using ChangesVec = std::vector<std::pair<Change, std::string>>;
+  using ChangesVec = std::vector<Change>;
 
 #if !defined(NDEBUG) || defined(LLVM_ENABLE_DUMP)
   void dump() const;
@@ -285,9 +285,11 @@ public:
       if (InsertPt != MBB->end())
         DL = InsertPt->getDebugLoc();
     }
-    MachineInstr *operator()(const std::pair<Change, std::string> &v) const;
+    MachineInstr *operator()(const Change &change) const;
 
-    void operator()(const StackFixup &v) const;
+    /// Insert instructions of \p v and apply it to \p TheStack. Annotate
+    /// the instructions with the resulting stacks if comments are enabled.
+    void operator()(const StackFixup &v, Stack &TheStack) const;
 
   private:
     const TargetInstrInfo *TII;
@@ -299,13 +301,9 @@ public:
 
   const ChangesVec &getChanges() const { return Changes; }
   Change operator()(const Change &change) {
-    Changes.push_back(make_pair(change, std::string()));
+    Changes.push_back(change);
     return change;
   }
-  void operator()(const Stack &stack);
-
-  void annotate(const Stack &stack);
-
   static Change makeRoll(unsigned deepElem);
   static Change makeRollRev(unsigned toDeepElem);
   static Change makeBlkSwap(unsigned deepElems, unsigned topElems);
@@ -320,9 +318,6 @@ private:
   static void generateVagonXchgs(StackFixup &rv, const Stack &from,
                                  const Stack &to);
 
-  void setLastComment(const std::string &comment) {
-    Changes.back().second = comment;
-  }
   ChangesVec Changes;
 }; // namespace llvm
 
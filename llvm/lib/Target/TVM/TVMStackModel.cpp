@@ -13,6 +13,7 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include <optional>
 #include <unordered_map>
 
 #include "MCTargetDesc/TVMMCTargetDesc.h"
@@ -81,9 +82,11 @@ public:
   /// (e.g. SUBR, STIR, STUXR), it stores LI SlotIndex of the original
   /// definition while the rest parts of the modelling work generated by the
   /// pass SUBR, STIR and so on.
+  /// \par RequiredStack receives the stack a terminator requires if it is
+  /// known.
   StackFixup prepareStackFor(MachineInstr &MI, const Stack &StackBefore,
                              SlotIndex Index,
-                             std::string *DebugMessage = nullptr);
+                             std::optional<Stack> *RequiredStack = nullptr);
 
   /// Calculate stack after \par MI execution.
   /// This fixup is not supposed to be code generated.
@@ -107,7 +110,8 @@ private:
 
   /// Rewrite an instruction in Reg-form to S-form.
   /// \see TVMInstructionInfo.td to learn more.
-  void rewriteToSForm(MachineInstr &MI, std::string &PreTermStackString,
+  void rewriteToSForm(MachineInstr &MI,
+                      const std::optional<Stack> &PreTermStack,
                       Stack &TheStack);
 
   /// Append \par MMB live-ins to \par vregs
@@ -115,9 +119,11 @@ private:
   /// Append \par MMB live-outs to \par vregs
   void gatherBlockLiveOuts(MachineBasicBlock &MBB, std::set<unsigned> &vregs);
 
+  /// Map registers of each block to the variables the first DBG_VALUE of the
+  /// register in the block describes.
+  void collectDebugValues(MachineFunction &MF);
   const DILocalVariable *findDebugValue(const MachineInstr &MI,
                                         unsigned Vreg) const;
-  std::string prepareInstructionComment(const MachineInstr &MI) const;
 
   /// Returns true if From -> To branch is a backedge
   bool isBackEdge(const MachineBasicBlock *From,
@@ -131,6 +137,9 @@ private:
 
   /// Store requirements on for BB stack configurations
   DenseMap<MachineBasicBlock *, TVMStackBlockInfo> BBInfo;
+  DenseMap<const MachineBasicBlock *,
+           DenseMap<unsigned, const DILocalVariable *>>
+      DebugValues;
   unsigned MaxRoads = 0;
   unsigned MaxRoadWidth = 0;
 };
@@ -143,53 +152,21 @@ INITIALIZE_PASS(TVMStackModel, DEBUG_TYPE, "Stackify register instructions",
 
 FunctionPass *llvm::createTVMStackModel() { return new TVMStackModel(); }
 
-const DILocalVariable *TVMStackModel::findDebugValue(const MachineInstr &MI,
-                                                     unsigned Vreg) const {
-  auto it = llvm::find_if(*MI.getParent(), [Vreg](const MachineInstr &DI) {
-    return DI.isDebugValue() &&
-           (DI.getOperand(0).isReg() && DI.getOperand(0).getReg() == Vreg);
-  });
-  return (it != MI.getParent()->end()) ? it->getDebugVariable() : nullptr;
+void TVMStackModel::collectDebugValues(MachineFunction &MF) {
+  DebugValues.clear();
+  for (const MachineBasicBlock &MBB : MF)
+    for (const MachineInstr &DI : MBB)
+      if (DI.isDebugValue() && DI.getOperand(0).isReg())
+        DebugValues[&MBB].insert(
+            {DI.getOperand(0).getReg(), DI.getDebugVariable()});
 }
 
-std::string
-TVMStackModel::prepareInstructionComment(const MachineInstr &MI) const {
-  if (!MI.getNumExplicitDefs())
-    return std::string();
-
-  std::string rv;
-  raw_string_ostream OS(rv);
-
-  auto OpPrinter = [&OS, &MI, this](const MachineOperand &Operand) {
-    if (Operand.isReg()) {
-      if (Operand.isUndef())
-        OS << "x";
-      else
-        OS << printReg(Operand.getReg());
-      if (auto DbgVar = findDebugValue(MI, Operand.getReg()))
-        OS << "(" << DbgVar->getName() << ")";
-    } else {
-      OS << Operand;
-    }
-  };
-  auto CommaOpPrinter = [&OS, &OpPrinter](const MachineOperand &Operand) {
-    OS << ", ";
-    OpPrinter(Operand);
-  };
-
-  OS << ">";
-  OpPrinter(*MI.defs().begin());
-  llvm::for_each(drop_begin(MI.defs(), 1), CommaOpPrinter);
-
-  OS << " = " << TII->getName(MI.getOpcode()) << " ";
-
-  auto Uses = MI.uses();
-  if (Uses.begin() != Uses.end()) {
-    OpPrinter(*MI.uses().begin());
-    llvm::for_each(drop_begin(MI.uses(), 1), CommaOpPrinter);
-  }
-  OS.flush();
-  return OS.str();
+const DILocalVariable *TVMStackModel::findDebugValue(const MachineInstr &MI,
+                                                     unsigned Vreg) const {
+  auto It = DebugValues.find(MI.getParent());
+  if (It == DebugValues.end())
+    return nullptr;
+  return It->second.lookup(Vreg);
 }
 
 MachineInstr *TVMStackModel::optimizeReversible(MachineInstr &MI,
@@ -284,14 +261,12 @@ bool TVMStackModel::processInstruction(MachineInstr &MI, Stack &TheStack) {
   MachineInstr &CurrentMI = NewMI ? *NewMI : MI;
   auto *MBB = CurrentMI.getParent();
   StackFixup::InstructionGenerator InsertMIs(TII, MFI, MBB, CurrentMI);
-  std::string PreTermStackStr;
-  StackFixup Fix =
-      prepareStackFor(CurrentMI, TheStack, Index, &PreTermStackStr);
-  InsertMIs(Fix);
-  Fix.apply(TheStack);
+  std::optional<Stack> PreTermStack;
+  StackFixup Fix = prepareStackFor(CurrentMI, TheStack, Index, &PreTermStack);
+  InsertMIs(Fix, TheStack);
 
   modelInstructionExecution(CurrentMI, TheStack);
-  rewriteToSForm(CurrentMI, PreTermStackStr, TheStack);
+  rewriteToSForm(CurrentMI, PreTermStack, TheStack);
   return true;
 }
 
@@ -482,6 +457,7 @@ bool TVMStackModel::runOnMachineFunction(MachineFunction &MF) {
   MaxRoadWidth = 0;
 
   prepareRoads(MF);
+  collectDebugValues(MF);
 
   MachineBasicBlock &FirstBB = MF.front();
   if (!FirstBB.empty()) {
@@ -514,7 +490,8 @@ bool TVMStackModel::runOnMachineFunction(MachineFunction &MF) {
     Changed = true;
   }
 
-  MFI->setStackModelBBComment(&MF.front(), StartStack.toString());
+  if (MFI->hasStackModelComments())
+    MFI->setStackModelBBComment(&MF.front(), StackModelComment(StartStack));
 
   if (runOnBasicBlocks(MF, StartStack))
     Changed = true;
@@ -579,7 +556,9 @@ void TVMStackModel::computeRoadPattern(MachineFunction &MF, unsigned RoadIdx,
     auto &Info = BBInfo[MBB];
     if (Info.roadBegin() == RoadIdx) {
       Info.setFixedBegin(RoadPattern.filteredByLiveIns(*MBB, *LIS));
-      MFI->setStackModelBBComment(MBB, Info.fixedBegin().toString());
+      if (MFI->hasStackModelComments())
+        MFI->setStackModelBBComment(MBB,
+                                    StackModelComment(Info.fixedBegin()));
     }
     if (Info.roadEnd() == RoadIdx)
       Info.setFixedEnd(RoadPattern);
@@ -587,10 +566,10 @@ void TVMStackModel::computeRoadPattern(MachineFunction &MF, unsigned RoadIdx,
 }
 
 /// Model stack for a single instruction.
-StackFixup TVMStackModel::prepareStackFor(MachineInstr &MI,
-                                          const Stack &StackBefore,
-                                          SlotIndex Index,
-                                          std::string *DebugMessage) {
+StackFixup
+TVMStackModel::prepareStackFor(MachineInstr &MI, const Stack &StackBefore,
+                               SlotIndex Index,
+                               std::optional<Stack> *RequiredStack) {
   if (MI.isImplicitDef())
     return {};
 
@@ -674,8 +653,8 @@ StackFixup TVMStackModel::prepareStackFor(MachineInstr &MI,
     auto NeedStack = AfterTermStack.withArgs(MIArgs(MI, *LIS, Index));
     NeedStack.filterByImpDefs(TheStack);
     auto Fix = NeedStack - TheStack;
-    if (DebugMessage)
-      *DebugMessage = NeedStack.toString();
+    if (RequiredStack && MFI->hasStackModelComments())
+      *RequiredStack = NeedStack;
     return Fix;
   } else {
     return StackFixup::DiffForArgs(TheStack, MIArgs(MI, *LIS, Index),
@@ -726,7 +705,7 @@ void TVMStackModel::modelInstructionExecution(const MachineInstr &MI,
 }
 
 void TVMStackModel::rewriteToSForm(MachineInstr &MI,
-                                   std::string &PreTermStackString,
+                                   const std::optional<Stack> &PreTermStack,
                                    Stack &TheStack) {
   size_t NumDefs = MI.getNumDefs();
   size_t NumOperands = MI.getNumOperands();
@@ -808,14 +787,23 @@ void TVMStackModel::rewriteToSForm(MachineInstr &MI,
 
     TheStack.filterByDeadDefs(MI);
 
-    if (NumDefs)
-      MFI->addStackModelComment(MIB.getInstr(), prepareInstructionComment(MI));
-
-    if (MI.isTerminator())
-      MFI->addStackModelComment(MIB.getInstr(), PreTermStackString + " => " +
-                                                    TheStack.toString());
-    else
-      MFI->addStackModelComment(MIB.getInstr(), TheStack.toString());
+    if (MFI->hasStackModelComments()) {
+      // MI is removed from the block below but not deleted, so the comment
+      // may refer to it.
+      if (NumDefs)
+        MFI->addStackModelComment(
+            MIB.getInstr(), StackModelComment(MI, [&](unsigned Reg) {
+              return findDebugValue(MI, Reg);
+            }));
+
+      if (MI.isTerminator())
+        MFI->addStackModelComment(
+            MIB.getInstr(),
+            StackModelComment(PreTermStack ? &*PreTermStack : nullptr,
+                              TheStack));
+      else
+        MFI->addStackModelComment(MIB.getInstr(), StackModelComment(TheStack));
+    }
   }
 
   MI.removeFromParent();
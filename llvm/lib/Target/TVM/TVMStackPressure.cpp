@@ -0,0 +1,488 @@
+//===-------- TVMStackPressure.cpp - Keep hot stack regions shallow -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements a pass reducing the number of values carried through
+/// hot blocks.
+///
+/// The stack model reaches a value with an immediate-encoded stack primitive
+/// only while it is not deeper than XchgLimit (BlkswapImmLimit, RollImmLimit),
+/// deeper values are shuffled with PUSHINT + ROLLX / BLKSWX. A loop carrying
+/// many values it never touches (e.g. fields of a large parsed argument
+/// struct used only after the loop) pays for that on every iteration.
+///
+/// For every block executed more often than the function entry in which the
+/// number of simultaneously live virtual registers exceeds the limit, values
+/// living through the block without being used in it are moved out of the
+/// way:
+///  - a value produced by a repeatable state read (GETGLOB, GETPARAM,
+///    PUSH c4) is read again right before each of its uses;
+///  - a value whose def and uses are executed rarely enough is spilled to a
+///    global variable: SETGLOB after the def and GETGLOB before each use.
+///
+//===----------------------------------------------------------------------===//
+
+#include "TVM.h"
+#include "TVMMachineFunctionInfo.h"
+#include "TVMStackFixup.h"
+#include "TVMSubtarget.h"
+#include "TVMUtilities.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/LiveIntervals.h"
+#include "llvm/CodeGen/MachineBlockFrequencyInfo.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-stack-pressure"
+
+STATISTIC(NumRereads, "Number of state reads repeated at uses");
+STATISTIC(NumSpilled, "Number of values spilled to globals");
+
+static cl::opt<bool>
+    DisableStackPressure("disable-tvm-stack-pressure", cl::Hidden,
+                         cl::desc("Disable TVM stack pressure reduction"),
+                         cl::init(false));
+
+static cl::opt<unsigned> StackPressureLimit(
+    "tvm-stack-pressure-limit", cl::Hidden,
+    cl::desc("Number of values a hot block may keep on the stack"),
+    cl::init(StackFixup::XchgLimit + 1));
+
+// The runtime (stdlib_c.tvm, cpp-sdk tvm/globals.hpp) uses GLOB 1-7 and
+// 12-14, GLOB 5 is the frame base (TVMFrameLowering). Spills take the top of
+// the range addressable by the immediate of GETGLOB / SETGLOB (uimm1_31).
+static const unsigned MaxImmGlobal = 31;
+
+static cl::opt<unsigned> SpillGlobalNum(
+    "tvm-spill-global-num", cl::Hidden,
+    cl::desc("Number of global variables reserved for stack spills"),
+    cl::init(8));
+
+static cl::opt<unsigned> SpillGlobalBaseOpt(
+    "tvm-spill-global-base", cl::Hidden,
+    cl::desc("First global variable index reserved for stack spills "
+             "(default: the top of the GETGLOB immediate range)"),
+    cl::init(0));
+
+static unsigned getSpillGlobalBase() {
+  if (SpillGlobalBaseOpt)
+    return SpillGlobalBaseOpt;
+  return MaxImmGlobal + 1 - std::min<unsigned>(SpillGlobalNum, MaxImmGlobal);
+}
+
+namespace {
+class TVMStackPressure final : public MachineFunctionPass {
+  StringRef getPassName() const override {
+    return "TVM Stack Pressure Reduction";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    AU.addRequired<LiveIntervals>();
+    AU.addPreserved<LiveIntervals>();
+    AU.addPreserved<SlotIndexes>();
+    AU.addPreservedID(LiveVariablesID);
+    AU.addRequired<MachineBlockFrequencyInfo>();
+    AU.addPreserved<MachineBlockFrequencyInfo>();
+    MachineFunctionPass::getAnalysisUsage(AU);
+  }
+
+  bool doInitialization(Module &M) override;
+  bool runOnMachineFunction(MachineFunction &MF) override;
+
+  unsigned computePressure(MachineBasicBlock &MBB,
+                           SmallVectorImpl<unsigned> &LiveThrough);
+  bool isLiveRangeClobbering(unsigned Reg, const MachineInstr &Def,
+                             bool StateOnly);
+  double getRelativeFreq(const MachineBasicBlock &MBB) const;
+  bool isProfitableToSpill(unsigned Reg, const MachineInstr &Def,
+                           const MachineBasicBlock &Hot) const;
+  void rereadAtUses(unsigned Reg, MachineInstr &Def);
+  void spillToGlobal(unsigned Reg, MachineInstr &Def, unsigned Global);
+
+  MachineFunction *MF = nullptr;
+  MachineRegisterInfo *MRI = nullptr;
+  const TVMInstrInfo *TII = nullptr;
+  const TargetRegisterInfo *TRI = nullptr;
+  LiveIntervals *LIS = nullptr;
+  MachineBlockFrequencyInfo *MBFI = nullptr;
+
+  // Set by doInitialization() for the module being compiled.
+  bool ModuleAccessesSpillGlobals = false;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  TVMStackPressure() : MachineFunctionPass(ID) {}
+};
+} // end anonymous namespace
+
+char TVMStackPressure::ID = 0;
+INITIALIZE_PASS(TVMStackPressure, DEBUG_TYPE,
+                "Reduce stack pressure in hot blocks", false, false)
+
+FunctionPass *llvm::createTVMStackPressure() { return new TVMStackPressure(); }
+
+// Shrink LI to its uses, cleaning up LI.
+static void ShrinkToUses(LiveInterval &LI, LiveIntervals &LIS) {
+  if (LIS.shrinkToUses(&LI)) {
+    SmallVector<LiveInterval *, 4> SplitLIs;
+    LIS.splitSeparateComponents(LI, SplitLIs);
+  }
+}
+
+// Casts between I257 and the other register classes, which are no-ops for
+// the machine.
+static unsigned getCastToI257Opcode(const TargetRegisterClass *RC) {
+  if (RC == &TVM::SliceRegClass)
+    return TVM::FROM_SLICE_COPY;
+  if (RC == &TVM::BuilderRegClass)
+    return TVM::FROM_BUILDER_COPY;
+  if (RC == &TVM::CellRegClass)
+    return TVM::FROM_CELL_COPY;
+  if (RC == &TVM::TupleRegClass)
+    return TVM::FROM_TUPLE_COPY;
+  llvm_unreachable("Unexpected register class");
+}
+
+static unsigned getCastFromI257Opcode(const TargetRegisterClass *RC) {
+  if (RC == &TVM::SliceRegClass)
+    return TVM::TO_SLICE_COPY;
+  if (RC == &TVM::BuilderRegClass)
+    return TVM::TO_BUILDER_COPY;
+  if (RC == &TVM::CellRegClass)
+    return TVM::TO_CELL_COPY;
+  if (RC == &TVM::TupleRegClass)
+    return TVM::TO_TUPLE_COPY;
+  llvm_unreachable("Unexpected register class");
+}
+
+static bool IsSpillGlobal(int64_t Idx) {
+  unsigned Base = getSpillGlobalBase();
+  return Idx >= Base && Idx < Base + SpillGlobalNum;
+}
+
+// Test whether any function of M may access a global reserved for spills.
+// A value a caller keeps in such a global across a call would be overwritten
+// by a spill in the callee, so spilling is only safe if no code of the
+// contract touches the range.
+static bool ModuleMayAccessSpillGlobals(const Module &M) {
+  for (const Function &F : M)
+    for (const BasicBlock &BB : F)
+      for (const Instruction &I : BB) {
+        ImmutableCallSite CS(&I);
+        if (!CS)
+          continue;
+        if (CS.isInlineAsm()) {
+          const auto *IA = cast<InlineAsm>(CS.getCalledValue());
+          if (IA->getAsmString().find("GLOB") != std::string::npos)
+            return true;
+          continue;
+        }
+        switch (CS.getIntrinsicID()) {
+        case Intrinsic::tvm_getglobal:
+        case Intrinsic::tvm_setglobal: {
+          const auto *Idx = dyn_cast<ConstantInt>(CS.getArgument(0));
+          if (!Idx || Idx->getValue().getMinSignedBits() > 64 ||
+              IsSpillGlobal(Idx->getSExtValue()))
+            return true;
+          break;
+        }
+        default:
+          break;
+        }
+      }
+  return false;
+}
+
+// Test whether an instruction of MF may access a global reserved for spills
+// or transfer control to code that might do so, so that spilling is unsafe.
+static bool MayAccessSpillGlobals(const MachineFunction &MF) {
+  for (const MachineBasicBlock &MBB : MF)
+    for (const MachineInstr &MI : MBB) {
+      switch (MI.getOpcode()) {
+      case TVM::GETGLOBVAR:
+      case TVM::SETGLOBVAR:
+      case TVM::PUSHCONT_FUNC:
+        return true;
+      case TVM::GETGLOB:
+      case TVM::SETGLOB: {
+        const MachineOperand &MO = MI.getOperand(1);
+        int64_t Idx = MO.isCImm() ? MO.getCImm()->getSExtValue() : MO.getImm();
+        if (IsSpillGlobal(Idx))
+          return true;
+        break;
+      }
+      }
+    }
+  return false;
+}
+
+/// Compute the maximal number of virtual registers simultaneously live in
+/// MBB and collect the ones living through MBB without being referenced in
+/// it.
+unsigned
+TVMStackPressure::computePressure(MachineBasicBlock &MBB,
+                                  SmallVectorImpl<unsigned> &LiveThrough) {
+  SlotIndex Start = LIS->getMBBStartIdx(&MBB);
+  SlotIndex End = LIS->getMBBEndIdx(&MBB);
+
+  DenseSet<unsigned> Referenced;
+  for (const MachineInstr &MI : MBB)
+    for (const MachineOperand &MO : MI.operands())
+      if (MO.isReg() && TargetRegisterInfo::isVirtualRegister(MO.getReg()))
+        Referenced.insert(MO.getReg());
+
+  SmallVector<const LiveInterval *, 32> Overlapping;
+  for (unsigned I = 0, E = MRI->getNumVirtRegs(); I < E; ++I) {
+    unsigned Reg = TargetRegisterInfo::index2VirtReg(I);
+    if (MRI->reg_nodbg_empty(Reg) || !LIS->hasInterval(Reg))
+      continue;
+    const LiveInterval &LI = LIS->getInterval(Reg);
+    if (!LI.overlaps(Start, End))
+      continue;
+    Overlapping.push_back(&LI);
+    if (!Referenced.count(Reg) && LI.liveAt(Start) &&
+        LIS->isLiveOutOfMBB(LI, &MBB))
+      LiveThrough.push_back(Reg);
+  }
+
+  auto LiveAt = [&](SlotIndex Idx) {
+    return static_cast<unsigned>(llvm::count_if(
+        Overlapping, [&](const LiveInterval *LI) { return LI->liveAt(Idx); }));
+  };
+
+  unsigned Pressure = LiveAt(Start);
+  for (const MachineInstr &MI : MBB) {
+    if (MI.isDebugInstr())
+      continue;
+    Pressure =
+        std::max(Pressure, LiveAt(LIS->getInstructionIndex(MI).getRegSlot()));
+  }
+  return Pressure;
+}
+
+/// Test whether the live range of Reg contains an instruction which either
+/// modifies the state Def reads (StateOnly) or may touch the spill globals.
+bool TVMStackPressure::isLiveRangeClobbering(unsigned Reg,
+                                             const MachineInstr &Def,
+                                             bool StateOnly) {
+  return TVM::anyInstrInLiveRange(
+      *MF, LIS->getInterval(Reg), *LIS, [&](const MachineInstr &MI) {
+        if (&MI == &Def)
+          return false;
+        if (StateOnly)
+          return TVM::mayClobberStateRead(MI, Def);
+        return MI.isCall() || MI.isInlineAsm();
+      });
+}
+
+double TVMStackPressure::getRelativeFreq(const MachineBasicBlock &MBB) const {
+  return static_cast<double>(MBFI->getBlockFreq(&MBB).getFrequency()) /
+         MBFI->getEntryFreq();
+}
+
+/// A spill costs a SETGLOB at the def and a GETGLOB at each use, it saves
+/// at least the non-immediate operand of a deep stack manipulation on each
+/// execution of the hot block.
+bool TVMStackPressure::isProfitableToSpill(
+    unsigned Reg, const MachineInstr &Def, const MachineBasicBlock &Hot) const {
+  double Cost =
+      getRelativeFreq(*Def.getParent()) * TII->getGasCost(TVM::SETGLOB);
+  for (const MachineInstr &Use : MRI->use_nodbg_instructions(Reg))
+    Cost += getRelativeFreq(*Use.getParent()) * TII->getGasCost(TVM::GETGLOB);
+  double Saving = getRelativeFreq(Hot) * (TII->getGasCost(TVM::ROLLX) +
+                                          TII->getGasCost(TVM::CONST_I257) -
+                                          TII->getGasCost(TVM::ROLL));
+  return Cost < Saving;
+}
+
+/// Repeat the state read Def right before each use of Reg and delete Def.
+void TVMStackPressure::rereadAtUses(unsigned Reg, MachineInstr &Def) {
+  LLVM_DEBUG(dbgs() << "Repeating state read at uses: "; Def.dump());
+
+  SmallVector<MachineOperand *, 4> Uses, DbgUses;
+  for (MachineOperand &Op : MRI->use_operands(Reg))
+    (Op.getParent()->isDebugValue() ? DbgUses : Uses).push_back(&Op);
+
+  for (MachineOperand *Op : Uses) {
+    MachineInstr *UseMI = Op->getParent();
+    unsigned NewReg = MRI->createVirtualRegister(MRI->getRegClass(Reg));
+    TII->reMaterialize(*UseMI->getParent(), UseMI->getIterator(), NewReg, 0,
+                       Def, *TRI);
+    Op->setReg(NewReg);
+    LIS->InsertMachineInstrInMaps(*std::prev(UseMI->getIterator()));
+    LIS->createAndComputeVirtRegInterval(NewReg);
+  }
+
+  // The original value is gone, so are its debug locations.
+  for (MachineOperand *Op : DbgUses)
+    Op->setReg(0);
+
+  LIS->removeInterval(Reg);
+  LIS->RemoveMachineInstrFromMaps(Def);
+  Def.eraseFromParent();
+  ++NumRereads;
+}
+
+/// Store Reg to a global right after Def and load it back before each use.
+void TVMStackPressure::spillToGlobal(unsigned Reg, MachineInstr &Def,
+                                     unsigned Global) {
+  LLVM_DEBUG(dbgs() << "Spilling to GLOB " << Global << ": "; Def.dump());
+
+  const TargetRegisterClass *RC = MRI->getRegClass(Reg);
+  bool NeedsCast = RC != &TVM::I257RegClass;
+
+  SmallVector<MachineInstr *, 4> Users;
+  for (MachineInstr &Use : MRI->use_nodbg_instructions(Reg))
+    if (!is_contained(Users, &Use))
+      Users.push_back(&Use);
+
+  MachineBasicBlock &DefMBB = *Def.getParent();
+  auto InsertPt = std::next(Def.getIterator());
+  while (InsertPt != DefMBB.end() && TVM::isArgument(*InsertPt))
+    ++InsertPt;
+  DebugLoc DL = Def.getDebugLoc();
+
+  unsigned Value = Reg;
+  if (NeedsCast) {
+    Value = MRI->createVirtualRegister(&TVM::I257RegClass);
+    MachineInstr *Cast =
+        BuildMI(DefMBB, InsertPt, DL, TII->get(getCastToI257Opcode(RC)), Value)
+            .addReg(Reg);
+    LIS->InsertMachineInstrInMaps(*Cast);
+  }
+  MachineInstr *Store = BuildMI(DefMBB, InsertPt, DL, TII->get(TVM::SETGLOB))
+                            .addReg(Value)
+                            .addImm(Global);
+  LIS->InsertMachineInstrInMaps(*Store);
+  if (NeedsCast)
+    LIS->createAndComputeVirtRegInterval(Value);
+
+  for (MachineInstr *UseMI : Users) {
+    MachineBasicBlock &MBB = *UseMI->getParent();
+    DebugLoc UseDL = UseMI->getDebugLoc();
+    unsigned Loaded = MRI->createVirtualRegister(&TVM::I257RegClass);
+    MachineInstr *Load = BuildMI(MBB, UseMI, UseDL, TII->get(TVM::GETGLOB),
+                                 Loaded)
+                             .addImm(Global);
+    LIS->InsertMachineInstrInMaps(*Load);
+    unsigned NewReg = Loaded;
+    if (NeedsCast) {
+      NewReg = MRI->createVirtualRegister(RC);
+      MachineInstr *Cast = BuildMI(MBB, UseMI, UseDL,
+                                   TII->get(getCastFromI257Opcode(RC)), NewReg)
+                               .addReg(Loaded);
+      LIS->InsertMachineInstrInMaps(*Cast);
+      LIS->createAndComputeVirtRegInterval(Loaded);
+    }
+    for (MachineOperand &MO : UseMI->uses())
+      if (MO.isReg() && MO.getReg() == Reg)
+        MO.setReg(NewReg);
+    LIS->createAndComputeVirtRegInterval(NewReg);
+  }
+
+  ShrinkToUses(LIS->getInterval(Reg), *LIS);
+  ++NumSpilled;
+}
+
+bool TVMStackPressure::doInitialization(Module &M) {
+  ModuleAccessesSpillGlobals = ModuleMayAccessSpillGlobals(M);
+  return false;
+}
+
+bool TVMStackPressure::runOnMachineFunction(MachineFunction &MF) {
+  LLVM_DEBUG(dbgs() << "********** Stack Pressure Reduction **********\n"
+                       "********** Function: "
+                    << MF.getName() << '\n');
+
+  if (DisableStackPressure)
+    return false;
+
+  this->MF = &MF;
+  MRI = &MF.getRegInfo();
+  TII = MF.getSubtarget<TVMSubtarget>().getInstrInfo();
+  TRI = MF.getSubtarget<TVMSubtarget>().getRegisterInfo();
+  LIS = &getAnalysis<LiveIntervals>();
+  MBFI = &getAnalysis<MachineBlockFrequencyInfo>();
+
+  // Spill globals are shared by all the functions, a value stays in one only
+  // while no other code can be executed, see isLiveRangeClobbering().
+  bool CanSpill = SpillGlobalNum > 0 && !ModuleAccessesSpillGlobals &&
+                  !MayAccessSpillGlobals(MF);
+  unsigned NextGlobal = getSpillGlobalBase();
+  unsigned EndGlobal = NextGlobal + SpillGlobalNum;
+
+  bool Changed = false;
+  for (MachineBasicBlock &MBB : MF) {
+    if (getRelativeFreq(MBB) <= 1.0)
+      continue;
+
+    SmallVector<unsigned, 16> LiveThrough;
+    unsigned Pressure = computePressure(MBB, LiveThrough);
+    if (Pressure <= StackPressureLimit)
+      continue;
+
+    LLVM_DEBUG(dbgs() << "Stack pressure " << Pressure << " in "
+                      << printMBBReference(MBB) << '\n');
+
+    // Move the cheapest values first: repeatable state reads, then the values
+    // defined in the coldest blocks.
+    std::stable_sort(LiveThrough.begin(), LiveThrough.end(),
+                     [&](unsigned L, unsigned R) {
+                       const MachineInstr *LDef = MRI->getUniqueVRegDef(L);
+                       const MachineInstr *RDef = MRI->getUniqueVRegDef(R);
+                       if (!LDef || !RDef)
+                         return LDef != nullptr;
+                       bool LReread = TVM::isRepeatableStateRead(*LDef);
+                       bool RReread = TVM::isRepeatableStateRead(*RDef);
+                       if (LReread != RReread)
+                         return LReread;
+                       return getRelativeFreq(*LDef->getParent()) <
+                              getRelativeFreq(*RDef->getParent());
+                     });
+
+    unsigned Excess = Pressure - StackPressureLimit;
+    for (unsigned Reg : LiveThrough) {
+      if (!Excess)
+        break;
+      MachineInstr *Def = MRI->getUniqueVRegDef(Reg);
+      if (!Def || Def->getOpcode() == TargetOpcode::INLINEASM)
+        continue;
+      if (llvm::any_of(MRI->use_operands(Reg), [](const MachineOperand &MO) {
+            return MO.isImplicit();
+          }))
+        continue;
+
+      if (TVM::isRepeatableStateRead(*Def) &&
+          !isLiveRangeClobbering(Reg, *Def, /* StateOnly */ true)) {
+        rereadAtUses(Reg, *Def);
+      } else if (CanSpill && NextGlobal < EndGlobal &&
+                 isProfitableToSpill(Reg, *Def, MBB) &&
+                 !isLiveRangeClobbering(Reg, *Def, /* StateOnly */ false)) {
+        spillToGlobal(Reg, *Def, NextGlobal++);
+      } else {
+        continue;
+      }
+      --Excess;
+      Changed = true;
+    }
+  }
+
+  return Changed;
+}
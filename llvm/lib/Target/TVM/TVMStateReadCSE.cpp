@@ -0,0 +1,208 @@
+//===---- TVMStateReadCSE.cpp - Eliminate redundant TVM state reads -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Eliminate repeated reads of globals (c7), persistent data (c4) and other
+/// control registers.
+///
+/// The intrinsics reading this state are modelled as reading inaccessible
+/// memory, so generic CSE assumes any call writing inaccessible memory (e.g.
+/// SENDRAWMSG or SETGLOB of another global) invalidates them. The pass walks
+/// the dominator tree and reuses a read, or a value just written by the
+/// corresponding set intrinsic, until an instruction which may actually
+/// modify that piece of state is met.
+///
+//===----------------------------------------------------------------------===//
+
+#include <map>
+
+#include "TVM.h"
+#include "TVMUtilities.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Debug.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "tvm-state-read-cse"
+
+namespace {
+class TVMStateReadCSE final : public FunctionPass {
+  StringRef getPassName() const override {
+    return "Eliminate redundant TVM state reads";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+public:
+  static char ID;
+  explicit TVMStateReadCSE() : FunctionPass(ID) {}
+};
+} // End anonymous namespace
+
+char TVMStateReadCSE::ID = 0;
+INITIALIZE_PASS_BEGIN(TVMStateReadCSE, DEBUG_TYPE,
+                      "Eliminate redundant TVM state reads", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_END(TVMStateReadCSE, DEBUG_TYPE,
+                    "Eliminate redundant TVM state reads", false, false)
+
+FunctionPass *llvm::createTVMStateReadCSE() { return new TVMStateReadCSE(); }
+
+namespace {
+/// A piece of the VM state: a global variable, a control register or the
+/// persistent data cell (c4 read as a cell). Index is -1 if unknown.
+enum class StateKind { Global, Register, PersistentData };
+using StateKey = std::pair<StateKind, int64_t>;
+/// Values known to be held by pieces of the state at a program point.
+using AvailableState = std::map<StateKey, Value *>;
+} // End anonymous namespace
+
+static int64_t getIndex(const Value *V) {
+  if (const auto *C = dyn_cast<ConstantInt>(V))
+    if (C->getValue().getMinSignedBits() <= 64)
+      return C->getSExtValue();
+  return -1;
+}
+
+static void forgetKind(AvailableState &State, StateKind Kind) {
+  for (auto It = State.begin(); It != State.end();)
+    if (It->first.first == Kind)
+      It = State.erase(It);
+    else
+      ++It;
+}
+
+static void forgetRegister(AvailableState &State, int64_t Reg) {
+  if (Reg < 0) {
+    State.clear();
+    return;
+  }
+  State.erase({StateKind::Register, Reg});
+  if (Reg == 4)
+    State.erase({StateKind::PersistentData, 0});
+  if (Reg == 7)
+    forgetKind(State, StateKind::Global);
+}
+
+/// Process a single instruction, return true if it is erased.
+static bool processInstruction(Instruction &I, AvailableState &State) {
+  CallSite CS(&I);
+  if (!CS) {
+    // Memory is emulated with a dictionary in a global variable.
+    if (I.mayWriteToMemory())
+      State.clear();
+    return false;
+  }
+
+  StateKey Key;
+  switch (CS.getIntrinsicID()) {
+  case Intrinsic::tvm_getglobal:
+    Key = {StateKind::Global, getIndex(CS.getArgument(0))};
+    break;
+  case Intrinsic::tvm_getreg:
+    Key = {StateKind::Register, getIndex(CS.getArgument(0))};
+    break;
+  case Intrinsic::tvm_get_persistent_data:
+    Key = {StateKind::PersistentData, 0};
+    break;
+  case Intrinsic::tvm_setglobal: {
+    int64_t Idx = getIndex(CS.getArgument(0));
+    State.erase({StateKind::Register, 7});
+    if (Idx < 0) {
+      forgetKind(State, StateKind::Global);
+      return false;
+    }
+    State[{StateKind::Global, Idx}] = CS.getArgument(1);
+    return false;
+  }
+  case Intrinsic::tvm_setreg: {
+    int64_t Reg = getIndex(CS.getArgument(0));
+    forgetRegister(State, Reg);
+    if (Reg >= 0)
+      State[{StateKind::Register, Reg}] = CS.getArgument(1);
+    return false;
+  }
+  case Intrinsic::tvm_set_persistent_data:
+    forgetRegister(State, 4);
+    State[{StateKind::PersistentData, 0}] = CS.getArgument(0);
+    return false;
+  default:
+    if (!I.mayWriteToMemory())
+      return false;
+    if (!TVM::isStateNeutral(CS.getIntrinsicID())) {
+      State.clear();
+      return false;
+    }
+    // State neutral intrinsics keep c4 and c7, but may write other control
+    // registers (e.g. SENDRAWMSG appends an action to c5).
+    for (auto It = State.begin(); It != State.end();)
+      if (It->first.first == StateKind::Register && It->first.second != 4 &&
+          It->first.second != 7)
+        It = State.erase(It);
+      else
+        ++It;
+    return false;
+  }
+
+  if (Key.second < 0)
+    return false;
+
+  auto It = State.find(Key);
+  if (It == State.end() || It->second->getType() != I.getType()) {
+    State[Key] = &I;
+    return false;
+  }
+
+  LLVM_DEBUG(dbgs() << "Replacing " << I << " with " << *It->second << "\n");
+  I.replaceAllUsesWith(It->second);
+  I.eraseFromParent();
+  return true;
+}
+
+bool TVMStateReadCSE::runOnFunction(Function &F) {
+  if (skipFunction(F))
+    return false;
+
+  auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  bool Changed = false;
+
+  // The state at the end of a block is only valid at the beginning of its
+  // dominator tree child if the child has no other predecessors.
+  SmallVector<std::pair<DomTreeNode *, AvailableState>, 16> Worklist;
+  Worklist.push_back({DT.getRootNode(), AvailableState()});
+  while (!Worklist.empty()) {
+    DomTreeNode *Node = Worklist.back().first;
+    AvailableState State = std::move(Worklist.back().second);
+    Worklist.pop_back();
+
+    BasicBlock *BB = Node->getBlock();
+    if (!BB->getSinglePredecessor())
+      State.clear();
+
+    for (auto It = BB->begin(), E = BB->end(); It != E;) {
+      Instruction &I = *It++;
+      Changed |= processInstruction(I, State);
+    }
+
+    for (DomTreeNode *Child : Node->getChildren())
+      Worklist.push_back({Child, State});
+  }
+
+  return Changed;
+}
@@ -9,42 +9,53 @@
 ///
 /// \file
 /// Implement pass for merging multiple STU / STI with const argument into
-/// a bigger STU / STI.
+/// a bigger STU.
+///
+/// The pass walks def-use chains of builders: a constant store is appended to
+/// the preceding one if it is the only user of the builder the preceding store
+/// produced. Such chains are allowed to cross basic blocks as long as the
+/// builder flows linearly, i.e. the block with the preceding store always
+/// continues to the block with the next one. A store throws if the builder
+/// overflows, so a chain ends at an instruction with side effects between
+/// two stores. The merged store is placed at the position of the first store
+/// of the chain, so constant prefixes of a builder are computed as early as
+/// possible. Stores of at most 57 bits are selected into STSLICECONST
+/// afterwards.
 ///
 //===----------------------------------------------------------------------===//
 
 #include <vector>
 
 #include "TVM.h"
-#include "llvm/Analysis/LoopInfo.h"
-#include "llvm/Analysis/LoopPass.h"
+#include "TVMUtilities.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
-#include "llvm/IR/Operator.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Debug.h"
-#include "llvm/Transforms/Utils/Local.h"
-#include "llvm/Transforms/Utils/ModuleUtils.h"
 using namespace llvm;
 
 #define DEBUG_TYPE "tvm-store-combine"
 
 namespace {
-class TVMStoreCombine final : public BasicBlockPass {
+class TVMStoreCombine final : public FunctionPass {
   StringRef getPassName() const override {
     return "Combine STU / STI instructions";
   }
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
-    AU.setPreservesAll();
+    AU.setPreservesCFG();
   }
 
-  bool runOnBasicBlock(BasicBlock &BB) override;
+  bool runOnFunction(Function &F) override;
 
 public:
   static char ID;
-  explicit TVMStoreCombine() : BasicBlockPass(ID) {}
+  explicit TVMStoreCombine() : FunctionPass(ID) {}
 };
 } // End anonymous namespace
 
@@ -52,7 +63,7 @@ char TVMStoreCombine::ID = 0;
 INITIALIZE_PASS(TVMStoreCombine, DEBUG_TYPE, "Combine STU and STI intrinsics",
                 false, false)
 
-BasicBlockPass *llvm::createTVMStoreCombine() { return new TVMStoreCombine(); }
+FunctionPass *llvm::createTVMStoreCombine() { return new TVMStoreCombine(); }
 
 /// Size limit for single Store.
 /// Note that 257-bit stores are possible, but they need 2 instructions to be
@@ -73,107 +84,106 @@ static CallSite storeConstCallSite(Instruction *I) {
   return {};
 }
 
-enum class CanCombine {
-  No,
-  Yes,
-  Last // Can combine, but no more stores can be added.
-};
+/// \brief Compute bits stored by constant STU / STI \p CS.
+/// \return false if the store can't be merged, e.g. if the value doesn't fit
+/// into the given number of bits and the instruction is going to throw.
+static bool getStoredBits(CallSite CS, APInt &Data, unsigned &Size) {
+  const APInt &Val = cast<ConstantInt>(CS.getArgument(0))->getValue();
+  const APInt &Sz = cast<ConstantInt>(CS.getArgument(2))->getValue();
+  if (Sz.isNullValue() || Sz.ugt(SizeLimit))
+    return false;
+  Size = Sz.getZExtValue();
+  bool Fits = CS.getIntrinsicID() == Intrinsic::tvm_stu
+                  ? Val.isIntN(Size)
+                  : Val.isSignedIntN(Size);
+  if (!Fits)
+    return false;
+  Data = Val.trunc(Size).zext(Val.getBitWidth());
+  return true;
+}
 
-/// \brief Determine whether current STI / STU instruction can be merged with
-/// previous ones.
-/// \param size total size of STI / STU arguments preceeding \p CS that are
-/// supposed to be merged.
-/// \return flag if the instruction can be merged.
-static CanCombine canCombine(unsigned Size, CallSite &CS) {
-  auto *Op0 = dyn_cast<ConstantInt>(CS.getArgument(0));
-  if (!Op0)
-    return CanCombine::No;
-  auto *Op2 = dyn_cast<ConstantInt>(CS.getArgument(2));
-  if (!Op2)
-    return CanCombine::No;
-  if (Size + Op2->getZExtValue() > SizeLimit)
-    return CanCombine::No;
-  if (CS.getInstruction()->getNumUses() > 1u)
-    return CanCombine::Last;
-  return CanCombine::Yes;
+/// \brief Find the constant store next in the chain after \p Store.
+/// \return nullptr if the chain ends at \p Store.
+static Instruction *nextInChain(Instruction *Store) {
+  if (!Store->hasOneUse())
+    return nullptr;
+  auto *User = cast<Instruction>(*Store->user_begin());
+  auto CS = storeConstCallSite(User);
+  if (!CS || CS.getArgument(1) != Store)
+    return nullptr;
+  if (!TVM::flowsLinearly(Store->getParent(), User->getParent()) ||
+      TVM::hasSideEffectsBetween(Store, User))
+    return nullptr;
+  return User;
 }
 
-/// \brief Combine STU / STI instructions in the given range.
-static void combine(BasicBlock::iterator Start, BasicBlock::iterator End) {
-  unsigned Size = 0;
-  APInt Data(257, 0, false);
-  auto It = Start;
-  std::vector<Instruction *> RemoveInst;
-  for (; It != End; ++It) {
-    auto CS = CallSite(&*It);
-    APInt Val = cast<ConstantInt>(CS.getArgument(0))->getValue();
-    unsigned Sz = cast<ConstantInt>(CS.getArgument(2))->getZExtValue();
-    if (Val.slt(0)) {
-      APInt Pow2(257, 0, false);
-      Pow2.setBit(Sz + 1);
-      Val = Pow2 - Val.abs();
-    }
-    Data <<= Sz;
-    Size += Sz;
-    Data |= Val;
-    RemoveInst.push_back(&*It);
-  }
-  auto *BuilderArg = CallSite(&*Start).getArgument(1);
-  IRBuilder<> Builder(&*It);
-  std::vector<Value *> Args{Builder.getInt(Data), BuilderArg,
-                            Builder.getIntN(257, Size)};
-  auto *Fn = Intrinsic::getDeclaration(It->getModule(), Intrinsic::tvm_stu);
+/// \brief Combine STU / STI instructions of the given chain into a single STU
+/// placed instead of the first one.
+static void combine(ArrayRef<Instruction *> Chain, const APInt &Data,
+                    unsigned Size) {
+  Instruction *First = Chain.front();
+  auto *BuilderArg = CallSite(First).getArgument(1);
+  IRBuilder<> Builder(First);
+  Value *Args[] = {Builder.getInt(Data), BuilderArg,
+                   Builder.getIntN(257, Size)};
+  auto *Fn = Intrinsic::getDeclaration(First->getModule(), Intrinsic::tvm_stu);
   auto *Inst = Builder.CreateCall(Fn, Args);
-  std::prev(std::prev(It))->replaceAllUsesWith(Inst);
-  for (auto It = RemoveInst.rbegin(), E = RemoveInst.rend(); It != E; ++It) {
+  LLVM_DEBUG(dbgs() << "Merged " << Chain.size() << " stores into " << *Inst
+                    << "\n");
+  Chain.back()->replaceAllUsesWith(Inst);
+  for (auto It = Chain.rbegin(), E = Chain.rend(); It != E; ++It)
     (*It)->eraseFromParent();
-  }
 }
 
-/// Try merge STU / STI calls starting from It.
-/// \param It iterator of STI or STU intrinsic call.
-/// \return iterator pointing at one instruction after the merged STI or STU.
-/// TODO: better is to implement not as a peephole, but as def-use walk.
-static BasicBlock::iterator tryCombine(BasicBlock::iterator Start,
-                                       BasicBlock::iterator End) {
-  assert(Start != End);
-  auto CS = CallSite(&*Start);
-  unsigned Size = cast<ConstantInt>(CS.getArgument(2))->getZExtValue();
-  auto It = std::next(Start), Prev = Start;
-  bool Combinable = false;
-  for (; It != End; Prev = It++) {
-    if (auto CurrentCS = storeConstCallSite(&*It)) {
-      CanCombine Status = canCombine(Size, CurrentCS);
-      if (Status != CanCombine::No && CallSite(&*It).getArgument(1) == &*Prev) {
-        Combinable = true;
-        Size += cast<ConstantInt>(CurrentCS.getArgument(2))->getZExtValue();
-        if (Status == CanCombine::Last || !It->hasOneUse()) {
-          ++It;
-          break;
-        }
+bool TVMStoreCombine::runOnFunction(Function &F) {
+  if (skipFunction(F))
+    return false;
+
+  // A store dominates the next one in its chain, so visiting blocks in RPO
+  // guarantees that a chain is first met at its head.
+  SmallPtrSet<Instruction *, 16> Visited;
+  std::vector<Instruction *> Heads;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT)
+    for (Instruction &I : *BB) {
+      if (!storeConstCallSite(&I) || !Visited.insert(&I).second)
         continue;
-      }
+      Heads.push_back(&I);
+      for (Instruction *Next = nextInChain(&I); Next;
+           Next = nextInChain(Next))
+        Visited.insert(Next);
     }
-    break;
-  }
-  if (Combinable && std::next(Start) != It)
-    combine(Start, It);
-  return It;
-}
 
-bool TVMStoreCombine::runOnBasicBlock(BasicBlock &BB) {
   bool Changed = false;
-  auto It = BB.begin(), End = BB.end();
-  do {
-    It = std::find_if(It, End, [](Instruction &I) {
-      return static_cast<bool>(I.hasOneUse() && storeConstCallSite(&I));
-    });
-    if (It == End)
-      break;
-    auto Next = std::next(It);
-    It = tryCombine(It, End);
-    if (It != Next)
+  for (Instruction *Head : Heads) {
+    SmallVector<Instruction *, 8> Chain;
+    APInt Data(257, 0, false);
+    unsigned Size = 0;
+    for (Instruction *Store = Head; Store; Store = nextInChain(Store)) {
+      APInt Bits;
+      unsigned Sz = 0;
+      if (!getStoredBits(CallSite(Store), Bits, Sz) ||
+          Size + Sz > SizeLimit) {
+        // The chain continues after the store, start a new one from there.
+        if (Chain.size() > 1) {
+          combine(Chain, Data, Size);
+          Changed = true;
+        }
+        Chain.clear();
+        Data = 0;
+        Size = 0;
+        if (!getStoredBits(CallSite(Store), Bits, Sz))
+          continue;
+      }
+      Chain.push_back(Store);
+      Data <<= Sz;
+      Data |= Bits;
+      Size += Sz;
+    }
+    if (Chain.size() > 1) {
+      combine(Chain, Data, Size);
       Changed = true;
-  } while (true);
+    }
+  }
   return Changed;
 }
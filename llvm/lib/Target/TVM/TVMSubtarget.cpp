@@ -13,6 +13,9 @@
 
 #include "TVMSubtarget.h"
 #include "TVM.h"
+#include "TVMCallLowering.h"
+#include "TVMLegalizerInfo.h"
+#include "TVMRegisterBankInfo.h"
 #include "llvm/Support/TargetRegistry.h"
 
 using namespace llvm;
@@ -40,4 +43,11 @@ TVMSubtarget &TVMSubtarget::initializeSubtargetDependencies(StringRef CPU,
 TVMSubtarget::TVMSubtarget(const Triple &TT, const std::string &CPU,
                            const std::string &FS, const TargetMachine &TM)
     : TVMGenSubtargetInfo(TT, CPU, FS), FrameLowering(),
-      InstrInfo(initializeSubtargetDependencies(CPU, FS)), TLInfo(TM, *this) {}
+      InstrInfo(initializeSubtargetDependencies(CPU, FS)), TLInfo(TM, *this) {
+  CallLoweringInfo.reset(new TVMCallLowering(*getTargetLowering()));
+  Legalizer.reset(new TVMLegalizerInfo(*this));
+
+  auto *RBI = new TVMRegisterBankInfo(*getRegisterInfo());
+  InstSelector.reset(createTVMInstructionSelector(*this, *RBI));
+  RegBankInfo.reset(RBI);
+}
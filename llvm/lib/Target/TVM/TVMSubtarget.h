@@ -18,9 +18,14 @@
 #include "TVMISelLowering.h"
 #include "TVMInstrInfo.h"
 #include "TVMRegisterInfo.h"
+#include "llvm/CodeGen/GlobalISel/CallLowering.h"
+#include "llvm/CodeGen/GlobalISel/InstructionSelector.h"
+#include "llvm/CodeGen/GlobalISel/LegalizerInfo.h"
+#include "llvm/CodeGen/GlobalISel/RegisterBankInfo.h"
 #include "llvm/CodeGen/SelectionDAGTargetInfo.h"
 #include "llvm/CodeGen/TargetSubtargetInfo.h"
 #include "llvm/IR/DataLayout.h"
+#include <memory>
 #include <string>
 
 #define GET_SUBTARGETINFO_HEADER
@@ -52,12 +57,31 @@ public:
     return &TSInfo;
   }
 
+  const CallLowering *getCallLowering() const override {
+    return CallLoweringInfo.get();
+  }
+  const InstructionSelector *getInstructionSelector() const override {
+    return InstSelector.get();
+  }
+  const LegalizerInfo *getLegalizerInfo() const override {
+    return Legalizer.get();
+  }
+  const RegisterBankInfo *getRegBankInfo() const override {
+    return RegBankInfo.get();
+  }
+
 private:
   virtual void anchor();
   TVMFrameLowering FrameLowering;
   TVMInstrInfo InstrInfo;
   TVMTargetLowering TLInfo;
   SelectionDAGTargetInfo TSInfo;
+
+  /// GlobalISel related APIs.
+  std::unique_ptr<CallLowering> CallLoweringInfo;
+  std::unique_ptr<InstructionSelector> InstSelector;
+  std::unique_ptr<LegalizerInfo> Legalizer;
+  std::unique_ptr<RegisterBankInfo> RegBankInfo;
 };
 } // namespace llvm
 
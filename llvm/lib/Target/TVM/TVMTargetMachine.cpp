@@ -13,12 +13,18 @@
 
 #include "TVMTargetMachine.h"
 #include "TVM.h"
+#include "TVMAliasAnalysis.h"
 
+#include "llvm/CodeGen/GlobalISel/IRTranslator.h"
+#include "llvm/CodeGen/GlobalISel/InstructionSelect.h"
+#include "llvm/CodeGen/GlobalISel/Legalizer.h"
+#include "llvm/CodeGen/GlobalISel/RegBankSelect.h"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/CodeGen/TargetLoweringObjectFileImpl.h"
 #include "llvm/CodeGen/TargetPassConfig.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Transforms/Utils.h"
 #include "llvm/Transforms/IPO.h"
@@ -26,6 +32,34 @@
 
 namespace llvm {
 
+static cl::opt<bool>
+    EnableGasEstimate("tvm-gas-estimate",
+                      cl::desc("TVM: Print static gas estimates of functions "
+                               "(upper bound and typical)."),
+                      cl::init(false));
+
+static cl::opt<bool>
+    EnableTVMInliner("tvm-inliner",
+                     cl::desc("TVM: Use the inliner accounting for the gas "
+                              "and the code size of the call boundary."),
+                     cl::init(true));
+
+static cl::opt<bool>
+    EnableSpecialization("tvm-specialization",
+                         cl::desc("TVM: Specialize internal functions for "
+                                  "constant arguments."),
+                         cl::init(true));
+
+static cl::opt<bool> EnablePersistentStoreElim(
+    "tvm-elim-persistent-stores",
+    cl::desc("TVM: Eliminate and sink dead stores of the persistent data."),
+    cl::init(true));
+
+static cl::opt<bool> EnableLoadCombine(
+    "tvm-combine-loads",
+    cl::desc("TVM: Skip unused fields of chains of slice loads at once."),
+    cl::init(true));
+
 extern "C" void LLVMInitializeTVMTarget() {
   RegisterTargetMachine<TVMTargetMachine> X(getTheTVMTarget());
   auto &PR = *PassRegistry::getPassRegistry();
@@ -44,8 +78,19 @@ extern "C" void LLVMInitializeTVMTarget() {
   initializeTVMContinuationsHoistPass(PR);
   initializeTVMLoadStoreReplacePass(PR);
   initializeTVMMoveMaterializablePass(PR);
+  initializeTVMStackPressurePass(PR);
   initializeTVMStoreCombinePass(PR);
+  initializeTVMLoadCombinePass(PR);
+  initializeTVMCodeLayoutPass(PR);
+  initializeTVMHotColdSplitPass(PR);
+  initializeTVMConstGlobalEmbedPass(PR);
+  initializeTVMGasEstimatePass(PR);
+  initializeTVMStateReadCSEPass(PR);
+  initializeTVMPersistentStoreElimPass(PR);
+  initializeTVMAAWrapperPassPass(PR);
   initializeTVMLowerIntrinsicsPass(PR);
+  initializeTVMSpecializePass(PR);
+  initializeTVMInlinerPass(PR);
 }
 
 static Reloc::Model getEffectiveRelocModel(Optional<Reloc::Model> RM) {
@@ -84,9 +129,27 @@ TVMTargetMachine::TVMTargetMachine(const Target &T, const Triple &TT,
   // Adjust TargetLoweringObjectFile::getKindForGlobal() behavior by overriding
   // the corresponding target option.
   this->Options.NoZerosInBSS = true;
+
+  // Repeated stack form sequences can be outlined into dictionary functions,
+  // by default from functions optimized for size only.
+  setMachineOutliner(true);
+  setSupportsDefaultOutlining(true);
 }
 
 void TVMTargetMachine::adjustPassManager(PassManagerBuilder &Builder) {
+  // Replace the standard inliner, the always inliner used at lower
+  // optimization levels is kept.
+  if (EnableTVMInliner && Builder.Inliner && Builder.OptLevel > 1) {
+    delete Builder.Inliner;
+    Builder.Inliner =
+        createTVMInliner(this, Builder.OptLevel, Builder.SizeLevel);
+  }
+  Builder.addExtension(
+    PassManagerBuilder::EP_ModuleOptimizerEarly,
+    [](const PassManagerBuilder &, legacy::PassManagerBase &PM) {
+      PM.add(createTVMAAWrapperPass());
+      PM.add(createTVMExternalAAWrapperPass());
+  });
   Builder.addExtension(
     PassManagerBuilder::EP_CGSCCOptimizerLate,
     [](const PassManagerBuilder &, legacy::PassManagerBase &PM) {
@@ -97,6 +160,8 @@ void TVMTargetMachine::adjustPassManager(PassManagerBuilder &Builder) {
     PassManagerBuilder::EP_ModuleOptimizerEarly,
     [](const PassManagerBuilder &, legacy::PassManagerBase &PM) {
       PM.add(createTVMLowerIntrinsicsPass());
+      if (EnableSpecialization)
+        PM.add(createTVMSpecialize());
   });
 }
 
@@ -117,8 +182,13 @@ public:
 
   void addIRPasses() override;
   bool addInstSelector() override;
+  bool addIRTranslator() override;
+  bool addLegalizeMachineIR() override;
+  bool addRegBankSelect() override;
+  bool addGlobalInstructionSelect() override;
   bool addILPOpts() override;
   void addPreEmitPass() override;
+  void addPreEmitPass2() override;
   void addPreRegAlloc() override;
   void addPostRegAlloc() override;
 };
@@ -134,6 +204,14 @@ TargetPassConfig *TVMTargetMachine::createPassConfig(PassManagerBase &PM) {
 
 void TVMPassConfig::addIRPasses() {
   addPass(createTVMLowerIntrinsicsPass());
+  if (getOptLevel() != CodeGenOpt::None) {
+    addPass(createTVMAAWrapperPass());
+    addPass(createTVMExternalAAWrapperPass());
+    addPass(createTVMStateReadCSE());
+    if (EnablePersistentStoreElim)
+      addPass(createTVMPersistentStoreElim());
+    addPass(createTVMConstGlobalEmbed());
+  }
   // TODO: once setcc is supported, we need to remove it.
   addPass(createLowerSwitchPass());
   addPass(createTVMLoopPrepare());
@@ -141,6 +219,8 @@ void TVMPassConfig::addIRPasses() {
   addPass(createTVMDefineUndef());
   addPass(createTVMReFuncPass());
   addPass(createTVMStoreCombine());
+  if (EnableLoadCombine && getOptLevel() != CodeGenOpt::None)
+    addPass(createTVMLoadCombine());
 }
 
 bool TVMPassConfig::addInstSelector() {
@@ -154,6 +234,29 @@ bool TVMPassConfig::addInstSelector() {
   return false;
 }
 
+bool TVMPassConfig::addIRTranslator() {
+  addPass(new IRTranslator());
+  return false;
+}
+
+bool TVMPassConfig::addLegalizeMachineIR() {
+  addPass(new Legalizer());
+  return false;
+}
+
+bool TVMPassConfig::addRegBankSelect() {
+  addPass(new RegBankSelect());
+  return false;
+}
+
+bool TVMPassConfig::addGlobalInstructionSelect() {
+  addPass(new InstructionSelect());
+  // addInstSelector isn't called when GlobalISel is used without a fallback,
+  // ARGUMENT instructions are to be moved to the entry here as well.
+  addPass(createTVMArgumentMove());
+  return false;
+}
+
 bool TVMPassConfig::addILPOpts() {
   addPass(createTVMIfConversionTerm());
   return true;
@@ -173,14 +276,33 @@ void TVMPassConfig::addPreEmitPass() {
   addPass(createTVMRegStackify());
   addPass(createTVMLoopInstructions());
   addPass(createTVMMoveMaterializable());
+
+  // Keep values carried through hot blocks within the immediate stack
+  // primitives reach.
+  if (getOptLevel() != CodeGenOpt::None)
+    addPass(createTVMStackPressure());
+
   addPass(createTVMStackModel());
 
   // Perform the very last peephole optimizations on the code.
   if (getOptLevel() != CodeGenOpt::None)
     addPass(createTVMPeephole());
+}
+
+void TVMPassConfig::addPreEmitPass2() {
+  // Keep hot paths within as few code cells as possible, failure paths are
+  // moved out of them first. The MachineOutliner has run by now, so the cells
+  // are laid out for the code that is emitted, outlined functions included.
+  if (getOptLevel() != CodeGenOpt::None) {
+    addPass(createTVMHotColdSplit());
+    addPass(createTVMCodeLayout());
+  }
 
   // Create a mapping from LLVM CodeGen virtual registers to tvm registers.
   addPass(createTVMRegNumbering());
+
+  if (EnableGasEstimate)
+    addPass(createTVMGasEstimate());
 }
 
 void TVMPassConfig::addPreRegAlloc() {
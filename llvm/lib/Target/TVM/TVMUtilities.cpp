@@ -14,8 +14,14 @@
 
 #include "TVMUtilities.h"
 #include "TVMMachineFunctionInfo.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/CodeGen/LiveIntervals.h"
 #include "llvm/CodeGen/MachineInstr.h"
 #include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/Support/MathExtras.h"
 
 using namespace llvm;
 
@@ -36,9 +42,226 @@ bool TVM::isConstInt(const MachineInstr &MI) {
          || MI.getOpcode() == TVM::CONST_U257;
 }
 
+unsigned TVM::getIntrinsicOpcode(Intrinsic::ID IID) {
+  switch (IID) {
+  default:
+    return 0;
+  case Intrinsic::tvm_newc:        return TVM::NEWC;
+  case Intrinsic::tvm_endc:        return TVM::ENDC;
+  case Intrinsic::tvm_ctos:        return TVM::CTOS;
+  case Intrinsic::tvm_ends:        return TVM::ENDS;
+  case Intrinsic::tvm_sti:         return TVM::STIX;
+  case Intrinsic::tvm_stu:         return TVM::STUX;
+  case Intrinsic::tvm_stslice:     return TVM::STSLICE;
+  case Intrinsic::tvm_stref:       return TVM::STREF;
+  case Intrinsic::tvm_ldi:         return TVM::LDIX;
+  case Intrinsic::tvm_ldu:         return TVM::LDUX;
+  case Intrinsic::tvm_pldi:        return TVM::PLDIX;
+  case Intrinsic::tvm_pldu:        return TVM::PLDUX;
+  case Intrinsic::tvm_ldref:       return TVM::LDREF;
+  case Intrinsic::tvm_ldslice:     return TVM::LDSLICEX;
+  case Intrinsic::tvm_sdskipfirst: return TVM::SDSKIPFIRST;
+  case Intrinsic::tvm_sbits:       return TVM::SBITS;
+  case Intrinsic::tvm_srefs:       return TVM::SREFS;
+  case Intrinsic::tvm_sbitrefs:    return TVM::SBITREFS;
+  case Intrinsic::tvm_bbits:       return TVM::BBITS;
+  case Intrinsic::tvm_brefs:       return TVM::BREFS;
+  case Intrinsic::tvm_sempty:      return TVM::SEMPTY;
+  case Intrinsic::tvm_sdempty:     return TVM::SDEMPTY;
+  case Intrinsic::tvm_srempty:     return TVM::SREMPTY;
+  case Intrinsic::tvm_sdeq:        return TVM::SDEQ;
+  case Intrinsic::tvm_hashcu:      return TVM::HASHCU;
+  case Intrinsic::tvm_hashsu:      return TVM::HASHSU;
+  case Intrinsic::tvm_sendrawmsg:  return TVM::SENDRAWMSG;
+  }
+}
+
+int64_t TVM::getImmValue(const MachineOperand &MO) {
+  if (MO.isCImm())
+    return MO.getCImm()->getSExtValue();
+  return MO.getImm();
+}
+
+bool TVM::isRepeatableStateRead(const MachineInstr &MI) {
+  switch (MI.getOpcode()) {
+  case TVM::GETGLOB:
+  case TVM::GETPARAM:
+  case TVM::PUSHC:
+  case TVM::PUSHROOT:
+    return true;
+  }
+  return false;
+}
+
+bool TVM::mayClobberStateRead(const MachineInstr &MI,
+                              const MachineInstr &Read) {
+  assert(isRepeatableStateRead(Read) && "Unexpected state read");
+
+  // Nothing is known about a callee or an inline asm. Load and store
+  // subroutines of the runtime use globals as well.
+  if (MI.isCall() || MI.isInlineAsm())
+    return true;
+
+  // Globals and configuration parameters live in c7, persistent data in c4.
+  unsigned ReadReg = 7;
+  if (Read.getOpcode() == TVM::PUSHROOT)
+    ReadReg = 4;
+  else if (Read.getOpcode() == TVM::PUSHC)
+    ReadReg = getImmValue(Read.getOperand(1));
+
+  switch (MI.getOpcode()) {
+  case TVM::CALL_LOAD_INT:
+  case TVM::CALL_LOAD_BUILDER:
+  case TVM::CALL_LOAD_SLICE:
+  case TVM::CALL_LOAD_CELL:
+  case TVM::CALL_STORE_INT:
+  case TVM::CALL_STORE_BUILDER:
+  case TVM::CALL_STORE_SLICE:
+  case TVM::CALL_STORE_CELL:
+    return ReadReg == 7;
+  case TVM::POPROOT:
+    return ReadReg == 4;
+  case TVM::POPC:
+    return getImmValue(MI.getOperand(1)) == ReadReg;
+  case TVM::SETGLOBVAR:
+    return ReadReg == 7;
+  case TVM::SETGLOB:
+    // Configuration parameters are in GLOB 0 which SETGLOB can't address.
+    if (Read.getOpcode() == TVM::GETGLOB)
+      return getImmValue(MI.getOperand(1)) == getImmValue(Read.getOperand(1));
+    return Read.getOpcode() == TVM::PUSHC && ReadReg == 7;
+  }
+  return false;
+}
+
+bool TVM::anyInstrInLiveRange(const MachineFunction &MF,
+                              const LiveInterval &LI, const LiveIntervals &LIS,
+                              function_ref<bool(const MachineInstr &)> Pred) {
+  for (const MachineBasicBlock &MBB : MF) {
+    if (!LI.overlaps(LIS.getMBBStartIdx(&MBB), LIS.getMBBEndIdx(&MBB)))
+      continue;
+    for (const MachineInstr &MI : MBB)
+      if (!MI.isDebugInstr() && LI.liveAt(LIS.getInstructionIndex(MI)) &&
+          Pred(MI))
+        return true;
+  }
+  return false;
+}
+
+bool TVM::flowsLinearly(const BasicBlock *From, const BasicBlock *To,
+                        unsigned Limit) {
+  for (unsigned I = 0; I < Limit && From != To; ++I) {
+    From = From->getSingleSuccessor();
+    if (!From)
+      return false;
+  }
+  return From == To;
+}
+
+bool TVM::hasSideEffectsBetween(const Instruction *From,
+                                const Instruction *To) {
+  const BasicBlock *BB = From->getParent();
+  auto It = std::next(From->getIterator());
+  while (true) {
+    if (It == BB->end()) {
+      BB = BB->getSingleSuccessor();
+      It = BB->begin();
+      continue;
+    }
+    if (&*It == To)
+      return false;
+    if (It->mayHaveSideEffects())
+      return true;
+    ++It;
+  }
+}
+
+static const Constant *getEmbeddedData(const GlobalValue *GV) {
+  const auto *GVar = cast<GlobalVariable>(GV);
+  assert(GVar->hasDefinitiveInitializer() && GVar->getValueType()->isArrayTy() &&
+         "Embedded data must be a constant array");
+  return GVar->getInitializer();
+}
+
+unsigned TVM::getEmbeddedDataBits(const GlobalValue *GV, unsigned Width) {
+  return getEmbeddedData(GV)->getType()->getArrayNumElements() * Width;
+}
+
+std::string TVM::getEmbeddedDataLiteral(const GlobalValue *GV,
+                                        unsigned Width) {
+  const Constant *Init = getEmbeddedData(GV);
+  unsigned NumElts = Init->getType()->getArrayNumElements();
+  unsigned Bits = NumElts * Width;
+  // Bitstrings with length not divisible by 4 are completed with a single
+  // 1 bit followed by zeroes and marked by trailing '_'.
+  unsigned Padded = alignTo(Bits, 4);
+  APInt Data(std::max(Padded, 1u), 0);
+  for (unsigned I = 0; I < NumElts; ++I) {
+    // Undefined elements are zeroes.
+    if (const auto *CI = dyn_cast<ConstantInt>(Init->getAggregateElement(I)))
+      Data.insertBits(CI->getValue().zextOrTrunc(Width),
+                      Padded - (I + 1) * Width);
+  }
+  if (Padded != Bits)
+    Data.setBit(Padded - Bits - 1);
+
+  std::string Literal = "x";
+  for (unsigned Pos = Padded; Pos > 0; Pos -= 4)
+    Literal += hexdigit(Data.extractBits(4, Pos - 4).getZExtValue(),
+                        /*LowerCase=*/true);
+  if (Padded != Bits)
+    Literal += "_";
+  return Literal;
+}
+
 // A shortcut overload for BuildMI() function
 MachineInstrBuilder llvm::BuildMI(MachineInstr *InsertPoint,
                                   const MCInstrDesc &InstrDesc) {
   return BuildMI(*InsertPoint->getParent(), InsertPoint,
                  InsertPoint->getDebugLoc(), InstrDesc);
 }
+
+bool TVM::isStateNeutral(Intrinsic::ID ID) {
+  switch (ID) {
+  case Intrinsic::tvm_accept:
+  case Intrinsic::tvm_commit:
+  case Intrinsic::tvm_setgaslimit:
+  case Intrinsic::tvm_buygas:
+  case Intrinsic::tvm_sendrawmsg:
+  case Intrinsic::tvm_rawreserve:
+  case Intrinsic::tvm_setcode:
+  case Intrinsic::tvm_setcp:
+  case Intrinsic::tvm_ends:
+  case Intrinsic::tvm_chktuple:
+  case Intrinsic::tvm_throw:
+  case Intrinsic::tvm_throwif:
+  case Intrinsic::tvm_nop:
+  case Intrinsic::tvm_dumpstk:
+  case Intrinsic::tvm_dumpstktop:
+  case Intrinsic::tvm_dump:
+  case Intrinsic::tvm_print:
+  case Intrinsic::tvm_dump_value:
+  case Intrinsic::tvm_print_value:
+  case Intrinsic::tvm_logstr:
+  case Intrinsic::tvm_printstr:
+  case Intrinsic::tvm_logflush:
+  // Dictionary lookups only throw on a malformed dictionary cell.
+  case Intrinsic::tvm_dictget:
+  case Intrinsic::tvm_dictgetref:
+  case Intrinsic::tvm_dictiget:
+  case Intrinsic::tvm_dictigetref:
+  case Intrinsic::tvm_dictuget:
+  case Intrinsic::tvm_dictugetref:
+  case Intrinsic::tvm_dictgetnext:
+  case Intrinsic::tvm_dictmin:
+  case Intrinsic::tvm_dictugetnext:
+  case Intrinsic::tvm_dictumin:
+  case Intrinsic::tvm_dictuminref:
+  case Intrinsic::tvm_dictugetprev:
+  case Intrinsic::tvm_dictumax:
+  case Intrinsic::tvm_dictumaxref:
+    return true;
+  default:
+    return false;
+  }
+}
@@ -16,11 +16,19 @@
 #define LLVM_LIB_TARGET_TVM_TVMUTILITIES_H
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include <string>
 
 namespace llvm {
 
+class BasicBlock;
+class GlobalValue;
+class Instruction;
+class LiveInterval;
+class LiveIntervals;
 class TVMFunctionInfo;
 
 // A shortcut overload for BuildMI() function
@@ -32,6 +40,55 @@ namespace TVM {
 bool isArgument(const MachineInstr &MI);
 bool isArgumentNum(const MachineInstr &MI);
 bool isConstInt(const MachineInstr &MI);
+
+/// Return the value of the immediate operand \p MO. Immediate operands
+/// selected from i257 constants are CImm, the ones created by the backend
+/// itself are Imm.
+int64_t getImmValue(const MachineOperand &MO);
+
+/// Return the instruction with register operands only implementing the
+/// intrinsic \p IID or 0 if there is none. The operands of the instruction are
+/// in the order of the intrinsic arguments, the results are in the order of
+/// the intrinsic results.
+unsigned getIntrinsicOpcode(Intrinsic::ID IID);
+
+/// Return true if \p MI reads a piece of the VM state (a global variable, a
+/// control register or a configuration parameter) and thus may be repeated to
+/// get the same value as long as nothing in between modifies that state.
+bool isRepeatableStateRead(const MachineInstr &MI);
+
+/// Return true if \p MI may modify the state read by \p Read, which must be a
+/// repeatable state read.
+bool mayClobberStateRead(const MachineInstr &MI, const MachineInstr &Read);
+
+/// Test whether a TVM intrinsic is known to modify none of c4 and c7.
+bool isStateNeutral(Intrinsic::ID ID);
+
+/// Return true if \p Pred holds for a non-debug instruction of \p MF at which
+/// \p LI is live.
+bool anyInstrInLiveRange(const MachineFunction &MF, const LiveInterval &LI,
+                         const LiveIntervals &LIS,
+                         function_ref<bool(const MachineInstr &)> Pred);
+
+/// Return true if every path starting at \p From reaches \p To passing at
+/// most \p Limit blocks, each of them with a single successor. Values of
+/// cell primitives (builders, slices) are chained along such paths.
+bool flowsLinearly(const BasicBlock *From, const BasicBlock *To,
+                   unsigned Limit = 16);
+
+/// Return true if an instruction between \p From and \p To may have side
+/// effects. \p From must flow linearly to \p To. Cell primitives which may
+/// throw must not be moved across such instructions.
+bool hasSideEffectsBetween(const Instruction *From, const Instruction *To);
+
+/// Return the number of data bits of the constant integer array \p GV
+/// embedded into the code with \p Width bits per element.
+unsigned getEmbeddedDataBits(const GlobalValue *GV, unsigned Width);
+
+/// Return the bitstring literal of the constant integer array \p GV
+/// embedded into the code with \p Width bits per element: the elements are
+/// truncated to \p Width bits and printed in hex, the first one first.
+std::string getEmbeddedDataLiteral(const GlobalValue *GV, unsigned Width);
 } // end namespace TVM
 
 } // end namespace llvm
@@ -22,6 +22,10 @@ struct big_dict_traits {
     dict.dictusetref(build_chain(to_std_tuple(val)).make_cell(), idx, KeyLen);
   }
   __always_inline
+  static void add(dictionary::bulk_builder& bb, unsigned idx, Element val) {
+    bb.addref(build_chain(to_std_tuple(val)).make_cell(), idx);
+  }
+  __always_inline
   static std::tuple<unsigned, Element, bool> min(const dictionary& dict) {
     auto [cell, idx, succ] = dict.dictuminref(KeyLen);
     if (succ)
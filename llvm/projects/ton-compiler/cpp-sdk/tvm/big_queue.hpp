@@ -2,6 +2,9 @@
 
 #include <optional>
 #include <tvm/schema/make_parser.hpp>
+#include <tvm/schema/chain_tuple_printer.hpp>
+#include <tvm/dictionary_const_iterator.hpp>
+#include <tvm/indexed_queue_base.hpp>
 
 namespace tvm {
 
@@ -162,7 +165,7 @@ public:
   }
 
   __always_inline
-  cell build_val(value_type val) const {
+  static cell build_val(value_type val) {
     using namespace schema;
     auto data_tup = to_std_tuple(val);
     auto chain_tup = make_chain_tuple(data_tup);
@@ -170,7 +173,7 @@ public:
   }
 
   __always_inline
-  value_type parse_val(cell cl) const {
+  static value_type parse_val(cell cl) {
     using namespace schema;
     using data_tup_t = to_std_tuple_t<value_type>;
     using LinearTup = decltype(make_chain_tuple(data_tup_t{}));
@@ -183,5 +186,37 @@ public:
   dictionary dict_;
 };
 
+// Reference-stored elements of indexed_big_queue, encoded as in big_queue
+template<class Element>
+struct indexed_big_queue_traits {
+  static constexpr unsigned KeyLen = 64;
+  using const_iterator = big_dictionary_const_iterator<Element, KeyLen>;
+
+  __always_inline
+  static void set(dictionary& dict, queue_index_t idx, Element val) {
+    dict.dictusetref(big_queue<Element>::build_val(val), idx, KeyLen);
+  }
+  __always_inline
+  static std::optional<Element> lookup(const dictionary& dict, queue_index_t idx) {
+    auto [cl, succ] = dict.dictugetref(idx, KeyLen);
+    if (succ)
+      return big_queue<Element>::parse_val(cl);
+    return {};
+  }
+  __always_inline
+  static std::optional<Element> rem_min(dictionary& dict) {
+    auto [cl, idx, succ] = dict.dicturemminref(KeyLen);
+    if (succ)
+      return big_queue<Element>::parse_val(cl);
+    return {};
+  }
+};
+
+// big_queue persisting its head and tail indexes, see indexed_queue_base
+template<class Element>
+class indexed_big_queue
+  : public indexed_queue_base<Element, indexed_big_queue_traits<Element>> {
+};
+
 } // namespace tvm
 
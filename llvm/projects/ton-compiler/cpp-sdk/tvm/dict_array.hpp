@@ -54,11 +54,21 @@ public:
     return *this;
   }
 
+  // Builds the dictionary in one pass (see dictionary::bulk_builder),
+  //  appending to a non-empty array sets the elements one by one
   template <class _Iterator>
   void assign(_Iterator __first, _Iterator __last) {
     base::clear();
+    append(__first, __last);
+  }
+  template <class _Iterator>
+  void append(_Iterator __first, _Iterator __last) {
+    dictionary::bulk_builder bb(base::dict_, KeyLen);
+    unsigned idx = base::size_.get();
     for (; __first != __last; ++__first)
-      push_back(Element(*__first));
+      base::traits::add(bb, idx++, Element(*__first));
+    bb.finish();
+    base::size_ = idx;
   }
 
   void push_back(Element elem) {
@@ -45,6 +45,22 @@ public:
     return *this;
   }
 
+  // Inserts the range of {key, value} pairs, the last value of a key wins.
+  // Pairs sorted by key are built into an empty dictionary in one pass
+  //  (see dictionary::bulk_builder).
+  template<class It>
+  void insert(It first, It last) {
+    dictionary::bulk_builder bb(base::dict_, KeyLen);
+    for (; first != last; ++first) {
+      auto [key, val] = *first;
+      if constexpr (small_elem)
+        bb.add(schema::build(Element(val)).make_slice(), unsigned(key));
+      else
+        bb.addref(schema::build(Element(val)).make_cell(), unsigned(key));
+    }
+    base::size_ += bb.finish();
+  }
+
   bool contains(unsigned key) const {
     auto [slice, succ] = base::dict_.dictuget(key, KeyLen);
     return succ;
@@ -89,8 +89,7 @@ public:
   template<class It>
   dict_set(It begin, It end) {
     size_ = 0;
-    for (auto it = begin; it != end; ++it)
-      insert(*it);
+    insert(begin, end);
   }
 
   bool contains(key_type key) const {
@@ -110,6 +109,16 @@ public:
       ++size_;
   }
 
+  // Sorted keys are built into an empty dictionary in one pass
+  //  (see dictionary::bulk_builder)
+  template<class It>
+  void insert(It begin, It end) {
+    dictionary::bulk_builder bb(dict_, KeyLen);
+    for (auto it = begin; it != end; ++it)
+      bb.add(slice::create_empty(), key_type(*it).get());
+    size_ += bb.finish();
+  }
+
   void clear() {
     size_ = 0;
     dict_.clear();
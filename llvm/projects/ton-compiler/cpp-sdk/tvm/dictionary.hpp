@@ -1,19 +1,24 @@
 #pragma once
 
+#include <algorithm>
 #include <tuple>
 
 #include <tvm/cell.hpp>
 #include <tvm/slice.hpp>
 #include <tvm/builder.hpp>
+#include <tvm/tuple_stack.hpp>
 
 #include <tvm/schema/make_builder.hpp>
 #include <tvm/schema/make_parser.hpp>
 #include <tvm/assert.hpp>
+#include <tvm/error_code.hpp>
 
 namespace tvm {
 
 class dictionary {
 public:
+  class bulk_builder;
+
   dictionary() {}
   explicit dictionary(cell dict) : dict_{dict} {}
   dictionary(schema::anydict dict) : dict_{dict} {}
@@ -177,5 +182,157 @@ public:
   schema::anydict dict_;
 };
 
-} // namespace tvm
+// Batch insertion of entries with unsigned keys into a dictionary.
+// Entries added in ascending key order are assembled into the trie cells
+//  directly in a single pass: each entry creates its leaf and at most one
+//  fork cell, while DICTUSET re-creates all the cells on the path from the
+//  root. Entries out of order (including repeated keys) are kept aside and
+//  set with DICTUSET by finish(), so the last value of a key wins.
+// The trie is only built into an empty dictionary with keys shorter than
+//  255 bits: the stack of open forks is up to key_len deep and tuples are
+//  limited to 255 elements. Otherwise each entry is set with DICTUSET when
+//  it is added.
+// Labels use the shortest of hml_short / hml_long / hml_same encodings, the
+//  result is a regular dictionary for all the dictionary primitives.
+// Values are slices (add) or references (addref), a builder must not mix them.
+class dictionary::bulk_builder {
+public:
+  bulk_builder(dictionary& dict, unsigned key_len)
+    : dict_(dict), key_len_(key_len), direct_(key_len >= 255 || !dict.empty()) {}
+
+  void add(slice val, unsigned key) {
+    if (direct_) {
+      auto [old_sl, existing] = dict_.dictusetget(val, key, key_len_);
+      count_ += !existing;
+    } else if (!in_order(key, false)) {
+      aside_.dictuset(val, key, key_len_);
+    } else {
+      push_leaf(key, __builtin_tvm_cast_from_slice(val.get()));
+    }
+  }
+  void addref(cell val, unsigned key) {
+    if (direct_) {
+      auto [old_cl, existing] = dict_.dictusetgetref(val, key, key_len_);
+      count_ += !existing;
+    } else if (!in_order(key, true)) {
+      aside_.dictusetref(val, key, key_len_);
+    } else {
+      push_leaf(key, __builtin_tvm_cast_from_builder(builder().stref(val).get()));
+    }
+  }
+
+  // Puts the built trie into the dictionary, then the entries kept aside.
+  // Returns the number of keys that were not in the dictionary before.
+  unsigned finish() {
+    if (has_right_) {
+      while (!stack_.empty())
+        fork_top();
+      dict_ = dictionary(finalize(right_key_, right_depth_, right_content_, 0));
+      has_right_ = false;
+    }
+    return count_ + copy(aside_, dict_);
+  }
+private:
+  // A subtree left of an open fork and the depth of the fork
+  struct fork_entry {
+    unsigned key;
+    unsigned depth;
+    int content;
+    unsigned fork_depth;
+  };
 
+  bool in_order(unsigned key, bool refs) {
+    require((!has_right_ && aside_.empty()) || refs == refs_, error_code::bad_arguments);
+    refs_ = refs;
+    return !has_right_ || key > last_key_;
+  }
+
+  // Ascending keys extend the right spine of the trie: open forks are kept
+  //  on the stack together with their left subtrees, the rightmost subtree
+  //  is kept in right_*. A fork is closed when a key diverges above it.
+  void push_leaf(unsigned key, int content) {
+    if (has_right_) {
+      unsigned fork_depth = key_len_ - __builtin_tvm_ubitsize(last_key_ ^ key);
+      while (!stack_.empty() && stack_.top().unpack().fork_depth > fork_depth)
+        fork_top();
+      stack_.push(tuple<fork_entry>::create(
+        {right_key_, right_depth_, right_content_, fork_depth}));
+    }
+    right_key_ = key;
+    right_depth_ = key_len_;
+    right_content_ = content;
+    last_key_ = key;
+    has_right_ = true;
+    ++count_;
+  }
+
+  // Joins the subtree on top of the stack and the rightmost subtree
+  //  into a fork, which becomes the rightmost subtree
+  void fork_top() {
+    auto [key, depth, content, fork_depth] = stack_.top().unpack();
+    stack_.pop();
+    cell left = finalize(key, depth, content, fork_depth + 1);
+    cell right = finalize(right_key_, right_depth_, right_content_, fork_depth + 1);
+    right_key_ = key;
+    right_depth_ = fork_depth;
+    right_content_ = __builtin_tvm_cast_from_builder(builder().stref(left).stref(right).get());
+  }
+
+  // Creates the cell of a subtree with the label of key bits [from, depth)
+  cell finalize(unsigned key, unsigned depth, int content, unsigned from) const {
+    bool slice_leaf = depth == key_len_ && !refs_;
+    // Forks and reference leaves have no data bits yet, so the label may be
+    //  stored after the references
+    builder b = slice_leaf ? builder() : builder(__builtin_tvm_cast_to_builder(content));
+    unsigned len = depth - from;
+    unsigned bits = (key >> (key_len_ - depth)) & ((1 << len) - 1);
+    store_label(b, bits, len, key_len_ - from);
+    if (slice_leaf)
+      b.stslice(slice(__builtin_tvm_cast_to_slice(content)));
+    return b.make_cell();
+  }
+
+  static void store_label(builder& b, unsigned bits, unsigned len, unsigned max_len) {
+    unsigned len_bits = __builtin_tvm_ubitsize(max_len);
+    unsigned short_size = 2 * len + 2;
+    unsigned long_size = 2 + len_bits + len;
+    bool same = len > 0 && (bits == 0 || bits == (1 << len) - 1);
+    if (same && 3 + len_bits < std::min(short_size, long_size)) {
+      // hml_same$11 v:Bit n:(#<= m)
+      b.stu(bits ? 7 : 6, 3).stu(len, len_bits);
+    } else if (short_size <= long_size) {
+      // hml_short$0 len:(Unary ~n) s:(n * Bit)
+      b.stu(((1 << len) - 1) << 1, len + 2).stu(bits, len);
+    } else {
+      // hml_long$10 n:(#<= m) s:(n * Bit)
+      b.stu(2, 2).stu(len, len_bits).stu(bits, len);
+    }
+  }
+
+  unsigned copy(dictionary from, dictionary& to) const {
+    unsigned added = 0;
+    auto [sl, key, succ] = from.dictumin(key_len_);
+    while (succ) {
+      auto [old_sl, existing] = to.dictusetget(sl, key, key_len_);
+      if (!existing)
+        ++added;
+      auto [=sl, =key, =succ] = from.dictugetnext(key, key_len_);
+    }
+    return added;
+  }
+
+  dictionary& dict_;
+  unsigned key_len_;
+  tuple_stack<tuple<fork_entry>> stack_;
+  unsigned right_key_ = 0;
+  unsigned right_depth_ = 0;
+  int right_content_ = 0;
+  unsigned last_key_ = 0;
+  unsigned count_ = 0;
+  bool has_right_ = false;
+  bool refs_ = false;
+  bool direct_;
+  dictionary aside_;
+};
+
+} // namespace tvm
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <optional>
+
+#include <tvm/assert.hpp>
+#include <tvm/dictionary.hpp>
+#include <tvm/error_code.hpp>
+#include <tvm/schema/make_parser.hpp>
+
+namespace tvm {
+
+// Index of an element of an indexed queue, the underlying type of the
+//  persisted head and tail indexes
+using queue_index_t = decltype(schema::uint64{}.get());
+
+// Queue persisting its head and tail indexes next to the dictionary.
+// Elements are stored at contiguous keys [head_, tail_), so the front and
+//  back are accessed with DICTUGET by index and push is a single DICTUSET,
+//  instead of DICTUMIN / DICTUMAX traversals of the plain queues.
+// Elements can't be erased from the middle of the queue.
+// Traits store elements in the dictionary (in-slice or by reference):
+//  set(dict, idx, val), lookup(dict, idx), rem_min(dict) and const_iterator.
+template<class Element, class Traits>
+class indexed_queue_base {
+public:
+  static constexpr unsigned KeyLen = Traits::KeyLen;
+  using value_type = Element;
+
+  __always_inline
+  std::optional<value_type> front_opt() const {
+    if (empty())
+      return {};
+    return at(head_.get());
+  }
+
+  __always_inline
+  std::optional<std::pair<queue_index_t, value_type>> front_with_idx_opt() const {
+    if (empty())
+      return {};
+    return std::make_pair(head_.get(), at(head_.get()));
+  }
+
+  __always_inline
+  value_type front() const {
+    require(!empty(), error_code::iterator_overflow);
+    return at(head_.get());
+  }
+
+  __always_inline
+  std::pair<queue_index_t, value_type> front_with_idx() const {
+    require(!empty(), error_code::iterator_overflow);
+    return std::make_pair(head_.get(), at(head_.get()));
+  }
+
+  __always_inline
+  void change_front(value_type val) {
+    require(!empty(), error_code::iterator_overflow);
+    Traits::set(dict_, head_.get(), val);
+  }
+
+  __always_inline
+  std::optional<value_type> back_opt() const {
+    if (empty())
+      return {};
+    return at(tail_.get() - 1);
+  }
+
+  __always_inline
+  std::optional<std::pair<queue_index_t, value_type>> back_with_idx_opt() const {
+    if (empty())
+      return {};
+    return std::make_pair(tail_.get() - 1, at(tail_.get() - 1));
+  }
+
+  __always_inline
+  value_type back() const {
+    require(!empty(), error_code::iterator_overflow);
+    return at(tail_.get() - 1);
+  }
+
+  __always_inline
+  std::pair<queue_index_t, value_type> back_with_idx() const {
+    require(!empty(), error_code::iterator_overflow);
+    return std::make_pair(tail_.get() - 1, at(tail_.get() - 1));
+  }
+
+  __always_inline
+  bool empty() const { return head_.get() == tail_.get(); }
+
+  __always_inline
+  schema::uint32 size() const { return schema::uint32(tail_.get() - head_.get()); }
+
+  __always_inline
+  void push(value_type val) {
+    Traits::set(dict_, tail_.get(), val);
+    ++tail_;
+  }
+
+  // DICTUREMMIN returns the value and removes it in a single traversal,
+  //  the front is always the minimal key.
+  __always_inline
+  std::optional<value_type> pop_opt() {
+    auto val = Traits::rem_min(dict_);
+    if (val)
+      ++head_;
+    return val;
+  }
+
+  __always_inline
+  void pop() {
+    require(dict_.dictudel(head_.get(), KeyLen), error_code::iterator_overflow);
+    ++head_;
+  }
+
+  // Removes up to n elements from the front, returns the number removed
+  __always_inline
+  queue_index_t pop_n(queue_index_t n) {
+    queue_index_t count = std::min(n, tail_.get() - head_.get());
+    for (queue_index_t i = 0; i < count; ++i)
+      dict_.dictudel(head_.get() + i, KeyLen);
+    head_ = head_.get() + count;
+    if (empty())
+      clear();
+    return count;
+  }
+
+  // Removes up to n elements from the front calling fn(value) for each of
+  //  them in order, returns the number removed
+  template<class Fn>
+  __always_inline
+  queue_index_t pop_n(queue_index_t n, Fn fn) {
+    queue_index_t count = std::min(n, tail_.get() - head_.get());
+    for (queue_index_t i = 0; i < count; ++i)
+      fn(*Traits::rem_min(dict_));
+    head_ = head_.get() + count;
+    if (empty())
+      clear();
+    return count;
+  }
+
+  __always_inline
+  void clear() {
+    head_ = 0;
+    tail_ = 0;
+    dict_.clear();
+  }
+
+  using const_iterator = typename Traits::const_iterator;
+
+  __always_inline
+  const_iterator begin() const {
+    return const_iterator::create_begin(dict_);
+  }
+  __always_inline
+  const_iterator end() const {
+    return const_iterator::create_end(dict_);
+  }
+
+  schema::uint64 head_;
+  schema::uint64 tail_;
+  dictionary dict_;
+private:
+  __always_inline
+  value_type at(queue_index_t idx) const {
+    auto val = Traits::lookup(dict_, idx);
+    require(!!val, error_code::iterator_overflow);
+    return *val;
+  }
+};
+
+} // namespace tvm
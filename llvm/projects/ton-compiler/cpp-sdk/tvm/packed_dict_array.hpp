@@ -0,0 +1,141 @@
+#pragma once
+
+#include <tvm/packed_dict_traits.hpp>
+#include <tvm/packed_dict_array_iterator.hpp>
+
+namespace tvm {
+
+// Array of fixed-size elements represented in tvm dictionary, several
+//  elements per dictionary leaf (see packed_dict_traits).
+// Persistent layout is the same as of dict_array: {size, dictionary}.
+// The const iterator does a single DICTUGET per leaf, set_at and push_back
+//  re-create a shorter path from the root than dict_array does, as there
+//  are fewer leaves.
+template<class Element, unsigned ChunkSize = 0, unsigned KeyLen = 32>
+class packed_dict_array {
+public:
+  using traits = packed_dict_traits<Element, ChunkSize, KeyLen>;
+  static constexpr unsigned chunk_size = traits::chunk_size;
+
+  packed_dict_array() {}
+  packed_dict_array(schema::uint32 size, dictionary dict) : size_{size}, dict_{dict} {}
+
+  packed_dict_array(std::initializer_list<Element> il) {
+    assign(il.begin(), il.end());
+  }
+  template <class _Iterator>
+  packed_dict_array(_Iterator __first, _Iterator __last) {
+    assign(__first, __last);
+  }
+
+  packed_dict_array& operator=(std::initializer_list<Element> il) {
+    assign(il.begin(), il.end());
+    return *this;
+  }
+
+  void clear() {
+    size_ = 0;
+    dict_.clear();
+  }
+  bool empty() const { return size_.get() == 0; }
+
+  schema::uint32 size() const { return size_; }
+
+  template <class _Iterator>
+  void assign(_Iterator __first, _Iterator __last) {
+    clear();
+    append(__first, __last);
+  }
+
+  // Appends the range, building each leaf once
+  template <class _Iterator>
+  void append(_Iterator __first, _Iterator __last) {
+    unsigned idx = size_.get();
+    builder b;
+    // Continue the last leaf if it has room
+    if (traits::offset(idx))
+      b.stslice(traits::get_chunk(dict_, idx - 1));
+    bool pending = false;
+    for (; __first != __last; ++__first) {
+      b = schema::build(b, Element(*__first));
+      pending = true;
+      ++idx;
+      if (traits::offset(idx) == 0) {
+        dict_.dictuset(b.make_slice(), traits::chunk(idx - 1), KeyLen);
+        b = builder();
+        pending = false;
+      }
+    }
+    if (pending)
+      dict_.dictuset(b.make_slice(), traits::chunk(idx - 1), KeyLen);
+    size_ = idx;
+  }
+
+  void push_back(Element elem) {
+    unsigned idx = size_.get();
+    builder b;
+    if (traits::offset(idx))
+      b.stslice(traits::get_chunk(dict_, idx - 1));
+    b = schema::build(b, elem);
+    dict_.dictuset(b.make_slice(), traits::chunk(idx), KeyLen);
+    ++size_;
+  }
+  void pop_back() {
+    require(!empty(), error_code::iterator_overflow);
+    unsigned idx = size_.get() - 1;
+    if (traits::offset(idx)) {
+      parser p(traits::get_chunk(dict_, idx));
+      dict_.dictuset(p.ldslice(traits::offset(idx)), traits::chunk(idx), KeyLen);
+    } else {
+      dict_.dictudel(traits::chunk(idx), KeyLen);
+    }
+    --size_;
+  }
+
+  Element front() const {
+    return get_at(0);
+  }
+  Element back() const {
+    require(!empty(), error_code::iterator_overflow);
+    return get_at(size_.get() - 1);
+  }
+
+  void set_at(unsigned idx, Element val) {
+    require(idx < size_, error_code::iterator_overflow);
+    traits::set(dict_, idx, val);
+  }
+  Element get_at(unsigned idx) const {
+    require(idx < size_, error_code::iterator_overflow);
+    return traits::get(dict_, idx);
+  }
+
+  Element operator[](unsigned idx) const {
+    return get_at(idx);
+  }
+  using Ref = PackedElementRef<Element, ChunkSize, KeyLen>;
+  Ref operator[](unsigned idx) {
+    return Ref{dict_, size_, idx};
+  }
+
+  using const_iterator = packed_dict_array_const_iterator<Element, ChunkSize, KeyLen>;
+  const_iterator begin() const {
+    return const_iterator::create_begin(dict_, size_);
+  }
+  const_iterator end() const {
+    return const_iterator::create_end(dict_, size_);
+  }
+
+  using iterator = packed_dict_array_iterator<Element, ChunkSize, KeyLen>;
+  iterator begin() {
+    return iterator::create_begin(dict_, size_);
+  }
+  iterator end() {
+    return iterator::create_end(dict_, size_);
+  }
+
+  schema::uint32 size_;
+  dictionary dict_;
+};
+
+} // namespace tvm
+
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <tvm/packed_dict_traits.hpp>
+
+namespace tvm {
+
+// Random access iterator with the interface of dictionary_array_iterator
+template<class Element, unsigned ChunkSize, unsigned KeyLen>
+struct packed_dict_array_iterator
+    : boost::operators<packed_dict_array_iterator<Element, ChunkSize, KeyLen>> {
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = Element;
+  using difference_type = int;
+  using pointer = Element*;
+  using reference = PackedElementRef<Element, ChunkSize, KeyLen>;
+  using traits = packed_dict_traits<Element, ChunkSize, KeyLen>;
+
+  dictionary& dict_;
+  unsigned idx_;
+  schema::uint32 size_;
+
+  __always_inline Element operator*() const {
+    require(!is_end(), error_code::iterator_overflow);
+    return traits::get(dict_, idx_);
+  }
+  __always_inline reference operator*() {
+    return reference{dict_, size_, idx_};
+  }
+
+  __always_inline bool is_end() const { return idx_ >= size_.get(); }
+
+  static packed_dict_array_iterator create_begin(dictionary& dict, schema::uint32 size) {
+    return packed_dict_array_iterator{{}, dict, 0, size};
+  }
+  static packed_dict_array_iterator create_end(dictionary& dict, schema::uint32 size) {
+    return packed_dict_array_iterator{{}, dict, size.get(), size};
+  }
+
+  bool operator<(packed_dict_array_iterator x) const { return idx_ < x.idx_; }
+
+  packed_dict_array_iterator& operator+=(int v) {
+    idx_ += v;
+    return *this;
+  }
+  packed_dict_array_iterator& operator-=(int v) {
+    idx_ -= v;
+    return *this;
+  }
+  packed_dict_array_iterator& operator++() {
+    ++idx_;
+    return *this;
+  }
+  packed_dict_array_iterator& operator--() {
+    --idx_;
+    return *this;
+  }
+  bool operator==(packed_dict_array_iterator v) const {
+    bool left_end = is_end();
+    bool right_end = v.is_end();
+    return (left_end && right_end) || (!left_end && !right_end && idx_ == v.idx_);
+  }
+};
+
+// Forward iterator reading a leaf once per chunk of elements
+template<class Element, unsigned ChunkSize, unsigned KeyLen>
+struct packed_dict_array_const_iterator {
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = Element;
+  using difference_type = int;
+  using pointer = Element*;
+  using reference = Element&;
+  using traits = packed_dict_traits<Element, ChunkSize, KeyLen>;
+
+  dictionary dict_;
+  unsigned idx_;
+  unsigned size_;
+  // The rest of the current leaf, starting with the element idx_
+  parser p_;
+
+  __always_inline Element operator*() const {
+    require(!is_end(), error_code::iterator_overflow);
+    return schema::parse<Element>(p_);
+  }
+
+  __always_inline bool is_end() const { return idx_ >= size_; }
+
+  __always_inline
+  static packed_dict_array_const_iterator create_begin(dictionary dict, schema::uint32 size) {
+    parser p;
+    if (size.get())
+      p = parser(traits::get_chunk(dict, 0));
+    return packed_dict_array_const_iterator{dict, 0, size.get(), p};
+  }
+  __always_inline
+  static packed_dict_array_const_iterator create_end(dictionary dict, schema::uint32 size) {
+    return packed_dict_array_const_iterator{{}, size.get(), size.get(), {}};
+  }
+
+  __always_inline packed_dict_array_const_iterator operator++() {
+    require(!is_end(), error_code::iterator_overflow);
+    ++idx_;
+    if (is_end())
+      return *this;
+    if (traits::offset(idx_) == 0)
+      p_ = parser(traits::get_chunk(dict_, idx_));
+    else
+      p_.skip(traits::elem_bits);
+    return *this;
+  }
+  __always_inline
+  bool operator==(packed_dict_array_const_iterator v) const {
+    bool left_end = is_end();
+    bool right_end = v.is_end();
+    return (left_end && right_end) || (!left_end && !right_end && idx_ == v.idx_);
+  }
+  __always_inline
+  bool operator!=(packed_dict_array_const_iterator v) const {
+    return !(*this == v);
+  }
+};
+
+} // namespace tvm
+
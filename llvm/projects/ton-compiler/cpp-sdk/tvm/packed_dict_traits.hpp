@@ -0,0 +1,99 @@
+#pragma once
+
+#include <tvm/assert.hpp>
+#include <tvm/cell.hpp>
+#include <tvm/dictionary.hpp>
+#include <tvm/error_code.hpp>
+#include <tvm/parser.hpp>
+#include <tvm/schema/estimate_element.hpp>
+#include <tvm/schema/make_builder.hpp>
+#include <tvm/schema/make_parser.hpp>
+
+namespace tvm {
+
+// Maximum size of a dictionary leaf label (hml_long) for the given key length
+template<unsigned KeyLen>
+constexpr unsigned dict_label_max_bits() {
+  unsigned len_bits = 0;
+  while ((1u << len_bits) < KeyLen + 1)
+    ++len_bits;
+  return 2 + len_bits + KeyLen;
+}
+
+// Elements of a packed array are stored by chunks of ChunkSize elements
+//  per dictionary leaf: element `idx` is at offset (idx % ChunkSize) * bits
+//  in the leaf with key (idx / ChunkSize).
+// ChunkSize == 0 means as many elements as fit into a leaf cell.
+template<class Element, unsigned ChunkSize, unsigned KeyLen>
+struct packed_dict_traits {
+  using est_t = schema::estimate_element<Element>;
+  static_assert(est_t::min_bits == est_t::max_bits && est_t::max_refs == 0,
+                "Packed array elements must have fixed size and no references");
+
+  static constexpr unsigned elem_bits = est_t::max_bits;
+  static constexpr unsigned max_chunk_size =
+    (cell::max_bits - dict_label_max_bits<KeyLen>()) / elem_bits;
+  static constexpr unsigned chunk_size = ChunkSize ? ChunkSize : max_chunk_size;
+  static_assert(chunk_size > 0 && chunk_size <= max_chunk_size,
+                "Chunk of elements doesn't fit into a dictionary leaf");
+
+  __always_inline static unsigned chunk(unsigned idx) { return idx / chunk_size; }
+  __always_inline static unsigned offset(unsigned idx) {
+    return (idx % chunk_size) * elem_bits;
+  }
+
+  __always_inline
+  static slice get_chunk(const dictionary& dict, unsigned idx) {
+    auto [sl, succ] = dict.dictuget(chunk(idx), KeyLen);
+    require(succ, error_code::iterator_overflow);
+    return sl;
+  }
+  __always_inline
+  static Element get(const dictionary& dict, unsigned idx) {
+    parser p(get_chunk(dict, idx));
+    p.skip(offset(idx));
+    return schema::parse<Element>(p);
+  }
+  // Rebuilds the leaf with the element replaced
+  __always_inline
+  static void set(dictionary& dict, unsigned idx, Element val) {
+    parser p(get_chunk(dict, idx));
+    slice head = p.ldslice(offset(idx));
+    p.skip(elem_bits);
+    builder b = schema::build(builder().stslice(head), val);
+    dict.dictuset(b.stslice(p.sl()).make_slice(), chunk(idx), KeyLen);
+  }
+};
+
+template<class Element, unsigned ChunkSize, unsigned KeyLen>
+struct PackedElementRef {
+  using traits = packed_dict_traits<Element, ChunkSize, KeyLen>;
+
+  // Elements of a leaf are contiguous, so only existing elements may be assigned
+  __always_inline PackedElementRef& operator=(Element elem) {
+    require(idx_ < size_, error_code::iterator_overflow);
+    traits::set(dict_, idx_, elem);
+    return *this;
+  }
+  __always_inline operator Element() const {
+    require(idx_ < size_, error_code::iterator_overflow);
+    return traits::get(dict_, idx_);
+  }
+
+  dictionary& dict_;
+  schema::uint32& size_;
+  unsigned idx_;
+};
+
+template<class Element, unsigned ChunkSize, unsigned KeyLen>
+__always_inline
+void swap(PackedElementRef<Element, ChunkSize, KeyLen> ref1,
+          PackedElementRef<Element, ChunkSize, KeyLen> ref2) {
+  auto v1 = static_cast<Element>(ref1);
+  auto v2 = static_cast<Element>(ref2);
+  ref1 = v2;
+  ref2 = v1;
+}
+
+} // namespace tvm
+
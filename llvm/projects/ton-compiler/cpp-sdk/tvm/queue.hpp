@@ -2,6 +2,8 @@
 
 #include <optional>
 #include <tvm/schema/make_parser.hpp>
+#include <tvm/dictionary_const_iterator.hpp>
+#include <tvm/indexed_queue_base.hpp>
 
 namespace tvm {
 
@@ -174,5 +176,44 @@ public:
   dictionary dict_;
 };
 
+// Slice-stored elements of indexed_queue
+template<class Element>
+struct indexed_queue_traits {
+  static constexpr unsigned KeyLen = 64;
+  using const_iterator = small_dictionary_const_iterator<Element, KeyLen>;
+
+  __always_inline
+  static void set(dictionary& dict, queue_index_t idx, Element val) {
+    dict.dictuset(schema::build(val).make_slice(), idx, KeyLen);
+  }
+  __always_inline
+  static std::optional<Element> lookup(const dictionary& dict, queue_index_t idx) {
+    auto [sl, succ] = dict.dictuget(idx, KeyLen);
+    if (succ)
+      return schema::parse<Element>(sl);
+    return {};
+  }
+  __always_inline
+  static std::optional<Element> rem_min(dictionary& dict) {
+    auto [sl, idx, succ] = dict.dicturemmin(KeyLen);
+    if (succ)
+      return schema::parse<Element>(sl);
+    return {};
+  }
+};
+
+// Queue persisting its head and tail indexes, see indexed_queue_base
+template<class Element>
+class indexed_queue : public indexed_queue_base<Element, indexed_queue_traits<Element>> {
+  static constexpr unsigned HeaderLen = 12;
+  using est_t = schema::estimate_element<std::tuple<schema::uint64, Element>>;
+  static_assert(HeaderLen + est_t::max_bits < cell::max_bits,
+                "Key + Element must fit one cell");
+  static_assert(est_t::max_bits == est_t::min_bits,
+                "Key + Element must be fixed-size");
+  static_assert(est_t::max_refs == 0,
+                "Key and Element must not have references");
+};
+
 } // namespace tvm
 
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <utility>
+
+#include <tvm/cell.hpp>
+#include <tvm/schema/estimate_element.hpp>
+#include <tvm/schema/chain_tuple_printer.hpp>
+
+#include <boost/hana/take_front.hpp>
+#include <boost/hana/ext/std/tuple.hpp>
+
+namespace tvm { namespace schema {
+
+namespace hana = boost::hana;
+
+// Persistent data layout planned at compile time instead of the greedy
+//  declaration-order chain of make_chain_tuple.
+// The contract data struct opts in with
+//   using persistent_layout = schema::persistent_layout<hot field indexes...>;
+// Fields are packed into the chain of cells by first-fit decreasing size
+//  (usually fewer cells than the declaration-order chain), hot fields are
+//  placed into the root cell. Fields keep declaration order inside a cell.
+// The layout is a deterministic function of the field types and the hot
+//  list, so it stays the same until the struct or the hot list is changed.
+template<unsigned... HotFields>
+struct persistent_layout {};
+
+template<unsigned N>
+struct layout_plan {
+  // Cell of the field (0 is the root cell)
+  std::array<unsigned, N> cell_of{};
+  // Fields in the order of storing
+  std::array<unsigned, N> order{};
+  // Position of the field in order
+  std::array<unsigned, N> pos{};
+  // Position in order of the first field of the cell
+  std::array<unsigned, N + 2> cell_start{};
+  unsigned cells = 1;
+  bool hot_fit = true;
+  bool fit = true;
+};
+
+// Each cell reserves a reference for the chain continuation, as make_chain_tuple does
+template<unsigned N>
+constexpr layout_plan<N> make_layout_plan(std::array<unsigned, N> bits, std::array<unsigned, N> refs,
+                                          std::array<bool, N> hot, unsigned root_bits,
+                                          unsigned root_refs) {
+  layout_plan<N> plan;
+  std::array<unsigned, N + 1> free_bits{};
+  std::array<unsigned, N + 1> free_refs{};
+  free_bits[0] = root_bits;
+  free_refs[0] = root_refs;
+  auto fits = [&](unsigned i, unsigned c) {
+    return bits[i] <= free_bits[c] && refs[i] <= free_refs[c];
+  };
+
+  std::array<unsigned, N> sorted{};
+  unsigned count = 0;
+  for (unsigned i = 0; i < N; ++i) {
+    if (hot[i]) {
+      if (fits(i, 0)) {
+        free_bits[0] -= bits[i];
+        free_refs[0] -= refs[i];
+      } else {
+        plan.hot_fit = false;
+      }
+      plan.cell_of[i] = 0;
+      continue;
+    }
+    // Insertion sort by decreasing size, stable for equal sizes
+    unsigned j = count++;
+    for (; j > 0 && bits[sorted[j - 1]] < bits[i]; --j)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = i;
+  }
+
+  for (unsigned k = 0; k < count; ++k) {
+    unsigned i = sorted[k];
+    unsigned c = 0;
+    while (c < plan.cells && !fits(i, c))
+      ++c;
+    if (c == plan.cells) {
+      free_bits[c] = cell::max_bits;
+      free_refs[c] = cell::max_refs - 1;
+      ++plan.cells;
+      if (!fits(i, c)) {
+        plan.fit = false;
+        continue;
+      }
+    }
+    free_bits[c] -= bits[i];
+    free_refs[c] -= refs[i];
+    plan.cell_of[i] = c;
+  }
+
+  unsigned k = 0;
+  for (unsigned c = 0; c < plan.cells; ++c) {
+    plan.cell_start[c] = k;
+    for (unsigned i = 0; i < N; ++i) {
+      if (plan.cell_of[i] == c) {
+        plan.order[k] = i;
+        plan.pos[i] = k;
+        ++k;
+      }
+    }
+  }
+  plan.cell_start[plan.cells] = k;
+  return plan;
+}
+
+// Offset / RefsOffset are bits / refs already used in the root cell (header)
+template<class Tup, unsigned Offset, unsigned RefsOffset, class Layout>
+struct layout_planner {};
+
+template<class... Fields, unsigned Offset, unsigned RefsOffset, unsigned... HotFields>
+struct layout_planner<std::tuple<Fields...>, Offset, RefsOffset, persistent_layout<HotFields...>> {
+  using Tup = std::tuple<Fields...>;
+  static constexpr unsigned N = sizeof...(Fields);
+  static_assert(((HotFields < N) && ...), "Hot field index is out of range");
+
+  static constexpr std::array<bool, N> hot_mask() {
+    std::array<bool, N> mask{};
+    ((mask[HotFields] = true), ...);
+    return mask;
+  }
+
+  static constexpr layout_plan<N> plan = make_layout_plan<N>(
+    {estimate_element<Fields>::max_bits...}, {estimate_element<Fields>::max_refs...},
+    hot_mask(), cell::max_bits - Offset, cell::max_refs - 1 - RefsOffset);
+  static_assert(plan.hot_fit, "Hot persistent fields don't fit into the root cell");
+  static_assert(plan.fit, "Persistent field doesn't fit into a cell, wrap it into ref<>");
+
+  template<unsigned Cell>
+  static constexpr unsigned cell_size = plan.cell_start[Cell + 1] - plan.cell_start[Cell];
+
+  template<unsigned Cell, size_t... I>
+  __always_inline
+  static auto pack_cell(Tup tup, std::index_sequence<I...>) {
+    auto fields = std::make_tuple(std::get<plan.order[plan.cell_start[Cell] + I]>(tup)...);
+    if constexpr (Cell + 1 < plan.cells) {
+      auto next = pack_cell<Cell + 1>(tup, std::make_index_sequence<cell_size<Cell + 1>>{});
+      return std::tuple_cat(fields, std::make_tuple(ref<decltype(next)>{next}));
+    } else {
+      return fields;
+    }
+  }
+  // {a, b, c, d} => {c, a, ref{b, d}}
+  __always_inline
+  static auto pack(Tup tup) {
+    return pack_cell<0>(tup, std::make_index_sequence<cell_size<0>>{});
+  }
+  using type = decltype(pack(Tup{}));
+
+  // Planned tuple => fields in the order of storing
+  template<unsigned Cell, class CellTup>
+  __always_inline
+  static auto flatten(CellTup cell_tup) {
+    if constexpr (Cell + 1 < plan.cells) {
+      auto next = std::get<cell_size<Cell>>(cell_tup)();
+      return std::tuple_cat(hana::take_front_c<cell_size<Cell>>(cell_tup),
+                            flatten<Cell + 1>(next));
+    } else {
+      return cell_tup;
+    }
+  }
+  template<size_t... I>
+  __always_inline
+  static Tup unpack(type planned, std::index_sequence<I...>) {
+    auto flat = flatten<0>(planned);
+    return Tup(std::get<plan.pos[I]>(flat)...);
+  }
+  __always_inline
+  static Tup unpack(type planned) {
+    return unpack(planned, std::make_index_sequence<N>{});
+  }
+
+  static constexpr auto print() {
+    return make_uint<plan.cells>() + " cells: "_s + print_chain_tuple<type>();
+  }
+};
+
+}} // namespace tvm::schema
+
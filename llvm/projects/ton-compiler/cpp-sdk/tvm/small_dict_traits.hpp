@@ -21,6 +21,11 @@ struct small_dict_traits {
     dict.dictuset(schema::build(val).make_slice(), idx, KeyLen);
   }
 
+  __always_inline
+  static void add(dictionary::bulk_builder& bb, unsigned idx, Element val) {
+    bb.add(schema::build(val).make_slice(), idx);
+  }
+
   // Returns {Key, Element, Success} to match the solidity array.min() function
   //  (not {Element, Key, Success} as dictumin returns)
   __always_inline
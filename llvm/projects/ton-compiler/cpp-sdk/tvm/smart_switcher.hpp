@@ -8,6 +8,7 @@
 #include <tvm/schema/chain_tuple.hpp>
 #include <tvm/schema/chain_tuple_printer.hpp>
 #include <tvm/schema/chain_fold.hpp>
+#include <tvm/schema/layout_planner.hpp>
 #include <tvm/message_flags.hpp>
 #include <tvm/awaiting_responses_map.hpp>
 #include <tvm/resumable.hpp>
@@ -64,6 +65,11 @@ template<typename T>
 using suicide_addr_t = decltype(&T::suicide_addr);
 template<typename T>
 constexpr bool supports_suicide_addr_v = std::experimental::is_detected_v<suicide_addr_t, T>;
+// Check that contract data requests the planned persistent layout (see schema::persistent_layout)
+template<typename T>
+using persistent_layout_t = typename T::persistent_layout;
+template<typename T>
+constexpr bool has_persistent_layout_v = std::experimental::is_detected_v<persistent_layout_t, T>;
 template<typename T>
 using constructor_t = decltype(&T::constructor);
 template<typename T>
@@ -220,14 +226,27 @@ __always_inline std::tuple<persistent_data_header_t<Interface, ReplayAttackProte
     using Est = estimate_element<HeaderT>;
     static_assert(Est::max_bits == Est::min_bits, "Persistent data header can't be dynamic-size");
 
-    // Only 1 + bitsize(Header) bits to skip
-    using LinearTup = decltype(make_chain_tuple<1 + Est::max_bits, Est::max_refs>(data_tup_t{}));
-    // uncomment to print in remark:
-    __reflect_echo<print_chain_tuple<LinearTup>().c_str()>{};
-    auto linear_tup = parse<LinearTup>(persist);
-    DContract base = to_struct<DContract>(chain_fold_tup<data_tup_t>(linear_tup));
-    // DContract base = parse_chain<DContract, 1 + Est::max_bits, Est::max_refs>(persist);
-    return { *data_hdr, base };
+    if constexpr (has_persistent_layout_v<DContract>) {
+      using Planner = layout_planner<data_tup_t, 1 + Est::max_bits, Est::max_refs,
+                                     typename DContract::persistent_layout>;
+      __reflect_echo<Planner::print().c_str()>{};
+      auto planned_tup = parse<typename Planner::type>(persist);
+      return { *data_hdr, to_struct<DContract>(Planner::unpack(planned_tup)) };
+    } else {
+      // Only 1 + bitsize(Header) bits to skip
+      using LinearTup = decltype(make_chain_tuple<1 + Est::max_bits, Est::max_refs>(data_tup_t{}));
+      // uncomment to print in remark:
+      __reflect_echo<print_chain_tuple<LinearTup>().c_str()>{};
+      auto linear_tup = parse<LinearTup>(persist);
+      DContract base = to_struct<DContract>(chain_fold_tup<data_tup_t>(linear_tup));
+      // DContract base = parse_chain<DContract, 1 + Est::max_bits, Est::max_refs>(persist);
+      return { *data_hdr, base };
+    }
+  } else if constexpr (has_persistent_layout_v<DContract>) {
+    using Planner = layout_planner<data_tup_t, 1, 0, typename DContract::persistent_layout>;
+    __reflect_echo<Planner::print().c_str()>{};
+    auto planned_tup = parse<typename Planner::type>(persist);
+    return { {}, to_struct<DContract>(Planner::unpack(planned_tup)) };
   } else {
     // Only 1 bit to skip
     using LinearTup = decltype(make_chain_tuple<1, 0>(data_tup_t{}));
@@ -268,7 +287,22 @@ inline cell prepare_persistent_data(persistent_data_header_t<IContract, ReplayAt
   // First add uninitialized bit = false in tuple
   // Also add replay attack protection header if needed
   // Then store data_tup_combined into chain of cells
-  if constexpr (persistent_header_info<IContract, ReplayAttackProtection>::non_empty) {
+  if constexpr (has_persistent_layout_v<DContract>) {
+    using data_tup_t = decltype(data_tup);
+    using Layout = typename DContract::persistent_layout;
+    if constexpr (persistent_header_info<IContract, ReplayAttackProtection>::non_empty) {
+      using Est = estimate_element<decltype(hdr)>;
+      using Planner = layout_planner<data_tup_t, 1 + Est::max_bits, Est::max_refs, Layout>;
+      __reflect_echo<Planner::print().c_str()>{};
+      auto planned_tup = Planner::pack(data_tup);
+      return build(std::tuple_cat(std::make_tuple(bool_t(false), hdr), planned_tup)).make_cell();
+    } else {
+      using Planner = layout_planner<data_tup_t, 1, 0, Layout>;
+      __reflect_echo<Planner::print().c_str()>{};
+      auto planned_tup = Planner::pack(data_tup);
+      return build(std::tuple_cat(std::make_tuple(bool_t(false)), planned_tup)).make_cell();
+    }
+  } else if constexpr (persistent_header_info<IContract, ReplayAttackProtection>::non_empty) {
     auto data_tup_combined = std::tuple_cat(std::make_tuple(bool_t(false), hdr), data_tup);
     auto chain_tup = make_chain_tuple(data_tup_combined);
     // uncomment to print in remark:
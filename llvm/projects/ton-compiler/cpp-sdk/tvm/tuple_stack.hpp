@@ -2,6 +2,7 @@
 
 #include <optional>
 #include <tvm/builder.hpp>
+#include <tvm/tuple.hpp>
 #include <tvm/error_code.hpp>
 #include <tvm/assert.hpp>
 
@@ -68,5 +69,33 @@ private:
   __tvm_tuple tup_;
 };
 
+// implementation of tuple_stack for tuple elements
+template<class T>
+class tuple_stack<tuple<T>> {
+public:
+  tuple_stack() : tup_(__builtin_tvm_tuple()) {}
+  bool empty() {
+    return !top_;
+  }
+  void push(tuple<T> val) {
+    if (top_)
+      tup_ = __builtin_tvm_tpush(tup_, __builtin_tvm_cast_from_tuple(top_->get()));
+    top_ = val;
+  }
+  void pop() {
+    require(!!top_, error_code::empty_container);
+    if (__builtin_tvm_tlen(tup_)) {
+      auto [=tup_, val] = __builtin_tvm_tpop(tup_);
+      top_ = tuple<T>(__builtin_tvm_cast_to_tuple(val));
+    } else {
+      top_.reset();
+    }
+  }
+  tuple<T>& top() { return *top_; }
+private:
+  std::optional<tuple<T>> top_;
+  __tvm_tuple tup_;
+};
+
 } // namespace tvm
 
@@ -0,0 +1,225 @@
+#!/usr/bin/python
+
+# Code size report for TVM contracts, in the spirit of bloaty.
+#
+# Input files are size maps written by llc -tvm-size-map=<file> (pass
+# -mllvm -tvm-size-map=<file> to the driver). Sizes are attributed to:
+#   functions  - machine functions of the contract;
+#   sources    - source functions the code has been inlined from (requires -g);
+#   templates  - C++ SDK templates that brought the code in, e.g. all the
+#                tvm::schema::build<...> instantiations together;
+#   classes    - instruction classes (stack, arithmetic, cells, ...).
+# Several data sources may be given to break the rows down further, e.g.
+# -d templates,functions. With --base the difference between two builds is
+# reported instead.
+#
+# The sizes are estimates, not measurements of the assembled code. The bit
+# length of an instruction is derived by the backend from its gas price
+# (TVMInstrInfo::getCodeBits), which is exact for the basic price of 10 + bits
+# but approximate for instructions with special prices and immediate forms the
+# assembler picks differently. Cells are the number of 1023-bit code cells the
+# bits would fill, not the cells of the actual layout.
+
+from __future__ import print_function
+
+import argparse
+import json
+import re
+import sys
+
+CELL_BITS = 1023
+
+CLASSES = [
+    ('stack', r'(PUSH|POP|XCHG|XCPU|XC2PU|XCPUXC|XCPU2|PUXC|PUXC2|PUXCPU|'
+              r'PU2XC|PUSH2|PUSH3|BLKSWAP|BLKPUSH|BLKDROP|DROP|NIP|DUP|OVER|'
+              r'SWAP|ROT|ROTREV|TUCK|REVERSE|ROLL|ROLLREV|PICK|2DROP|2DUP|'
+              r'2SWAP|2OVER|DEPTH|CHKDEPTH|ONLYTOPX|ONLYX)(_.*)?$'),
+    ('constants', r'(CONST|PUSHINT|PUSHPOW2|PUSHNAN|PUSHNULL|PUSHSLICE|'
+                  r'PUSHREFSLICE|PUSHREF|NULL|TRUE|FALSE).*'),
+    ('dictionaries', r'(DICT|PFXDICT|SUBDICT|NEWDICT|LDDICT|PLDDICT|STDICT|'
+                     r'SKIPDICT|LDOPTREF|PLDOPTREF|STOPTREF).*'),
+    ('continuations', r'(CALL|JMP|RET|IF|PUSHCONT|PUSHREFCONT|REPEAT|WHILE|'
+                      r'UNTIL|AGAIN|THROW|TRY|EXECUTE|CONDSEL|SETCONT|'
+                      r'BLESS|POPCTR|PUSHCTR|POPC|PUSHC|SAVE|ATEXIT).*'),
+    ('cells', r'(NEWC|ENDC|ST|CTOS|ENDS|LD|PLD|SD|SKIP|SBITS|SREFS|SBITREFS|'
+              r'SCHKBITS|SCHKREFS|SEMPTY|SDEMPTY|SREMPTY|BBITS|BREFS|'
+              r'BREMBITS|BREMREFS|CDEPTH|HASHCU|HASHSU).*'),
+    ('tuples', r'(TUPLE|UNTUPLE|INDEX|SETINDEX|UNPACKFIRST|EXPLODE|TLEN|'
+               r'TPUSH|TPOP|NULLSWAP|ISNULL|ISTUPLE|QTLEN).*'),
+    ('messages', r'(SENDRAWMSG|RAWRESERVE|SETCODE|ACCEPT|SETGASLIMIT|'
+                 r'COMMIT|GETPARAM|NOW|BLOCKLT|LTIME|BALANCE|MYADDR|'
+                 r'CONFIG|CHKSIGN|SHA256).*'),
+]
+CLASSES = [(name, re.compile(regex)) for name, regex in CLASSES]
+
+DATA_SOURCES = ['functions', 'sources', 'templates', 'classes']
+
+
+def strip_template_args(name):
+    """Remove template argument lists, 'build<Foo, Bar>' -> 'build'."""
+    result = ''
+    depth = 0
+    i = 0
+    while i < len(name):
+        if name.startswith('operator', i) and (i == 0 or name[i - 1] in ': '):
+            m = re.match(r'operator\s*(<<=|<<|<=|<|>>=|>>|>=|>|\(\)|\[\]|'
+                         r'\S+)?', name[i:])
+            if depth == 0:
+                result += m.group(0)
+            i += len(m.group(0))
+            continue
+        c = name[i]
+        if c == '<':
+            depth += 1
+        elif c == '>' and depth > 0:
+            depth -= 1
+        elif depth == 0:
+            result += c
+        i += 1
+    return result
+
+
+def instruction_class(opcode):
+    for name, regex in CLASSES:
+        if regex.match(opcode):
+            return name
+    return 'arithmetic'
+
+
+class Attribution(object):
+    def __init__(self, template_regex):
+        self.template_regex = re.compile(template_regex)
+
+    def key(self, source, function, instr):
+        if source == 'functions':
+            return function['name']
+        if source == 'classes':
+            return instruction_class(instr['opcode'])
+        chain = list(instr['inlined'])
+        if 'source' in function:
+            chain.append(function['source'])
+        if source == 'sources':
+            return chain[0] if chain else function['name']
+        if source == 'templates':
+            # The outermost SDK frame is the template which brought the code.
+            for name in reversed(chain):
+                if self.template_regex.search(name):
+                    return strip_template_args(name)
+            return '[contract code]'
+        raise ValueError(source)
+
+
+def load(paths, sources, attribution):
+    """Return {row key tuple: [bits, refs]} aggregated by the data sources."""
+    sizes = {}
+    for path in paths:
+        with open(path) as f:
+            data = json.load(f)
+        for function in data['functions']:
+            for instr in function['instructions']:
+                key = tuple(attribution.key(s, function, instr)
+                            for s in sources)
+                size = sizes.setdefault(key, [0, 0])
+                size[0] += instr['bits']
+                size[1] += instr['refs']
+    return sizes
+
+
+def group(sizes, level):
+    """Aggregate rows by the first level + 1 components of their keys."""
+    result = {}
+    for key, (bits, refs) in sizes.items():
+        size = result.setdefault(key[:level + 1], [0, 0])
+        size[0] += bits
+        size[1] += refs
+    return result
+
+
+def fmt_size(bits, refs, signed):
+    cells = float(bits) / CELL_BITS
+    if signed:
+        return '%+9d %+9.1f %+6d %+7.2f' % (bits, bits / 8.0, refs, cells)
+    return '%9d %9.1f %6d %7.2f' % (bits, bits / 8.0, refs, cells)
+
+
+def report(sizes, base, sources, limit, out):
+    diff = base is not None
+    total = sum(bits for bits, _ in sizes.values())
+    total_refs = sum(refs for _, refs in sizes.values())
+    base_total = sum(bits for bits, _ in base.values()) if diff else 0
+    base_refs = sum(refs for _, refs in base.values()) if diff else 0
+    print('%9s %9s %6s %7s %7s  %s' % ('BITS', 'BYTES', 'REFS', 'CELLS',
+                                   'DELTA%' if diff else 'SIZE%',
+                                   ' / '.join(s.upper() for s in sources)),
+          file=out)
+
+    def rows(level, prefix):
+        cur = group(sizes, level)
+        old = group(base, level) if diff else {}
+        keys = set(k for k in list(cur) + list(old) if k[:level] == prefix)
+        def value(k, i):
+            size = cur.get(k, [0, 0])[i]
+            return size - old.get(k, [0, 0])[i] if diff else size
+        keys = sorted(keys, key=lambda k: (-abs(value(k, 0)), k))
+        if diff:
+            keys = [k for k in keys if value(k, 0) or value(k, 1)]
+        shown, rest = keys[:limit], keys[limit:]
+        for k in shown:
+            yield k, value(k, 0), value(k, 1), True
+        if rest:
+            yield (prefix + ('[%d others]' % len(rest),),
+                   sum(value(k, 0) for k in rest),
+                   sum(value(k, 1) for k in rest), False)
+
+    def emit(level, prefix):
+        for key, bits, refs, nested in rows(level, prefix):
+            base_bits = base_total if diff else total
+            percent = 100.0 * bits / base_bits if base_bits else 0.0
+            print('%s %s  %s%s' % (fmt_size(bits, refs, diff),
+                                    ('%+6.1f%%' if diff else '%6.1f%%') %
+                                    percent, '    ' * level, key[-1]),
+                  file=out)
+            if nested and level + 1 < len(sources):
+                emit(level + 1, key)
+
+    emit(0, ())
+    if diff:
+        print('%s %+6.1f%%  TOTAL' % (
+            fmt_size(total - base_total, total_refs - base_refs, True),
+            100.0 * (total - base_total) / base_total if base_total else 0.0),
+            file=out)
+    else:
+        print('%s %6.1f%%  TOTAL' % (fmt_size(total, total_refs, False), 100.0),
+              file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Attribute the code size of a TVM contract. Sizes are '
+        'estimates derived from instruction gas prices.')
+    parser.add_argument('maps', nargs='+', metavar='MAP',
+                        help='size map written by llc -tvm-size-map')
+    parser.add_argument('-d', dest='sources', default='functions',
+                        help='comma separated data sources: ' +
+                        ', '.join(DATA_SOURCES) + ' (default: functions)')
+    parser.add_argument('-n', dest='limit', type=int, default=20,
+                        help='rows to show per level (default: 20)')
+    parser.add_argument('--base', nargs='+', metavar='MAP',
+                        help='report the difference against these size maps')
+    parser.add_argument('--templates', default=r'^tvm::',
+                        help='regex of the SDK function names to attribute '
+                        'with -d templates (default: ^tvm::)')
+    args = parser.parse_args()
+
+    sources = args.sources.split(',')
+    for source in sources:
+        if source not in DATA_SOURCES:
+            parser.error('unknown data source: %s' % source)
+    attribution = Attribution(args.templates)
+    sizes = load(args.maps, sources, attribution)
+    base = load(args.base, sources, attribution) if args.base else None
+    report(sizes, base, sources, args.limit, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,105 @@
+; RUN: llc < %s -march=tvm -O0 -fast-isel-abort=1 -asm-verbose=false | FileCheck %s
+; -fast-isel-abort=1 fails the test if FastISel misses a non-call instruction.
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: arith:
+define i257 @arith(i257 %a, i257 %b) {
+; CHECK: ADD
+; CHECK: MUL
+; CHECK: DIV
+; CHECK: XOR
+  %s = add i257 %a, %b
+  %m = mul i257 %s, %b
+  %d = sdiv i257 %m, %a
+  %x = xor i257 %d, %a
+  ret i257 %x
+}
+
+; CHECK-LABEL: cmp_select:
+define slice @cmp_select(i257 %a, i257 %b, slice %s1, slice %s2) {
+; CHECK: LESS
+; CHECK: CONDSEL
+  %c = icmp ult i257 %a, %b
+  %r = select i1 %c, slice %s1, slice %s2
+  ret slice %r
+}
+
+; CHECK-LABEL: minmax:
+define i257 @minmax(i257 %a, i257 %b) {
+; CHECK: MAX
+; CHECK-NOT: CONDSEL
+  %c = icmp sgt i257 %a, %b
+  %r = select i1 %c, i257 %a, i257 %b
+  ret i257 %r
+}
+
+; CHECK-LABEL: bool_ext:
+define i257 @bool_ext(i257 %a, i257 %b) {
+; CHECK: EQUAL
+; CHECK: AND
+  %c = icmp eq i257 %a, %b
+  %r = zext i1 %c to i257
+  ret i257 %r
+}
+
+; CHECK-LABEL: branch:
+define i257 @branch(i257 %a) {
+entry:
+; CHECK: GREATER
+; CHECK: IFELSE
+  %c = icmp sgt i257 %a, 10
+  br i1 %c, label %then, label %else
+then:
+  %t = add i257 %a, 1
+  ret i257 %t
+else:
+  %e = sub i257 %a, 1
+  ret i257 %e
+}
+
+; CHECK-LABEL: cells:
+define cell @cells(i257 %v, slice %s) {
+; CHECK: NEWC
+; CHECK: STUX
+; CHECK: STSLICE
+; CHECK: ENDC
+  %b = call builder @llvm.tvm.newc()
+  %b1 = call builder @llvm.tvm.stu(i257 %v, builder %b, i257 32)
+  %b2 = call builder @llvm.tvm.stslice(slice %s, builder %b1)
+  %c = call cell @llvm.tvm.endc(builder %b2)
+  ret cell %c
+}
+
+; CHECK-LABEL: load_uint:
+define i257 @load_uint(slice %s) {
+; CHECK: LDUX
+; CHECK: ENDS
+  %r = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+  %v = extractvalue { i257, slice } %r, 0
+  %rest = extractvalue { i257, slice } %r, 1
+  call void @llvm.tvm.ends(slice %rest)
+  ret i257 %v
+}
+
+; CHECK-LABEL: calls:
+define i257 @calls(i257 %a) {
+; CHECK: CALL $callee$
+; CHECK: CALLREF
+  %r = call i257 @callee(i257 %a)
+  %q = call i257 @internal(i257 %r)
+  ret i257 %q
+}
+
+declare i257 @callee(i257)
+
+define internal i257 @internal(i257 %a) norecurse {
+  ret i257 %a
+}
+
+declare builder @llvm.tvm.newc()
+declare builder @llvm.tvm.stu(i257, builder, i257)
+declare builder @llvm.tvm.stslice(slice, builder)
+declare cell @llvm.tvm.endc(builder)
+declare { i257, slice } @llvm.tvm.ldu(slice, i257)
+declare void @llvm.tvm.ends(slice)
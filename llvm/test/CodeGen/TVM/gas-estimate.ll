@@ -0,0 +1,71 @@
+; RUN: llc < %s -march=tvm -tvm-gas-estimate -o /dev/null 2>&1 | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK: ===-- TVM gas estimate --===
+
+; Straight-line code: the bound and the typical value are the same.
+; CHECK: straight: max [[GAS:[0-9]+]] gas, typical [[GAS]] gas; dictionary operations: max 0, typical 0.00; cells created: max 0, typical 0.00
+define i257 @straight(i257 %a, i257 %b) {
+  %s = add i257 %a, %b
+  %m = mul i257 %s, %b
+  ret i257 %m
+}
+
+; CHECK: counted: max {{[0-9]+}} gas
+define i257 @counted(i257 %a) {
+entry:
+  br label %loop
+loop:
+  %i = phi i257 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i257 [ %a, %entry ], [ %acc.next, %loop ]
+  %acc.next = mul i257 %acc, 3
+  %i.next = add i257 %i, 1
+  %c = icmp slt i257 %i.next, 10
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i257 %acc.next
+}
+
+; CHECK: unknown: max unbounded gas
+define i257 @unknown(i257 %n) {
+entry:
+  br label %loop
+loop:
+  %x = phi i257 [ %n, %entry ], [ %x.next, %loop ]
+  %x.next = call i257 @next(i257 %x)
+  %c = icmp ne i257 %x.next, 0
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i257 %x
+}
+
+; CHECK: recursive: max unbounded gas
+define i257 @recursive(i257 %n) {
+entry:
+  %c = icmp sgt i257 %n, 0
+  br i1 %c, label %rec, label %exit
+rec:
+  %m = sub i257 %n, 1
+  %r = call i257 @recursive(i257 %m)
+  ret i257 %r
+exit:
+  ret i257 0
+}
+
+; Dictionary operations and cells are reported on their own.
+; CHECK: main_external (entry point): max {{[0-9]+}} gas, typical {{[0-9]+}} gas; dictionary operations: max 1, typical 1.00; cells created: max 1, typical 1.00
+define cell @main_external(i257 %key, cell %dict) "tvm_raw_func" {
+  %r = call { slice, i257 } @llvm.tvm.dictuget(i257 %key, cell %dict, i257 32)
+  %s = extractvalue { slice, i257 } %r, 0
+  %b = call builder @llvm.tvm.newc()
+  %b1 = call builder @llvm.tvm.stslice(slice %s, builder %b)
+  %c = call cell @llvm.tvm.endc(builder %b1)
+  ret cell %c
+}
+
+declare i257 @next(i257)
+declare { slice, i257 } @llvm.tvm.dictuget(i257, cell, i257)
+declare builder @llvm.tvm.newc()
+declare builder @llvm.tvm.stslice(slice, builder)
+declare cell @llvm.tvm.endc(builder)
@@ -1,4 +1,4 @@
-; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s
+; RUN: llc < %s -march=tvm -asm-verbose=false -tvm-combine-loads=false | FileCheck %s
 target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
 target triple = "tvm"
 
@@ -8,7 +8,7 @@ define cell @make_internal_msg_cell(i257 %to_addr, i257 %value) local_unnamed_ad
 entry:
 ; CHECK: NEWC
   %0 = call builder @llvm.tvm.newc()
-; CHECK: STU
+; CHECK: STSLICECONST x04_
   %1 = call builder @llvm.tvm.stu(i257 0, builder %0, i257 5)
 ; CHECK: STU
   %2 = call builder @llvm.tvm.stu(i257 -1, builder %1, i257 8)
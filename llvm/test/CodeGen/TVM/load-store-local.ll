@@ -6,7 +6,6 @@ define i257 @test() {
 ; CHECK:      GETGLOB 5
 ; CHECK-NEXT: ADDCONST -1
 ; CHECK-NEXT: SETGLOB 5
-; CHECK-NEXT: PUSH c0
 ; CHECK-NEXT: GETGLOB 5
 ; CHECK-NEXT: PUSHINT 18234
 ; CHECK-NEXT: GETGLOB 14 CALLX
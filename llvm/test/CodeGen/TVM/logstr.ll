@@ -1,4 +1,4 @@
-; RUN: llc -O3 -tvm-trace-calls < %s -march=tvm | FileCheck %s
+; RUN: llc -O3 < %s -march=tvm | FileCheck %s
 
 target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
 target triple = "tvm"
@@ -10,7 +10,6 @@ declare void @llvm.tvm.printstr(i257*) #1
 
 ; CHECK-LABEL: test_logstr
 define void @test_logstr(i257 %x) {
-; CHECK: LOGSTR test_logstr
 ; CHECK: LOGSTR 123456789098765
   %ptr = getelementptr inbounds [22 x i257], [22 x i257]* @.str, i257 0, i257 0
   tail call void @llvm.tvm.logstr(i257* %ptr)
@@ -19,7 +18,6 @@ define void @test_logstr(i257 %x) {
 
 ; CHECK-LABEL: test_printstr
 define void @test_printstr(i257 %x) {
-; CHECK: LOGSTR test_printstr
 ; CHECK: PRINTSTR 123456789098765
   %ptr = getelementptr inbounds [22 x i257], [22 x i257]* @.str, i257 0, i257 0
   tail call void @llvm.tvm.printstr(i257* %ptr)
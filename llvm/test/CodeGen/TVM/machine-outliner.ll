@@ -0,0 +1,80 @@
+; RUN: llc < %s -march=tvm -enable-machine-outliner -asm-verbose=false | FileCheck %s
+; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s --check-prefix=DEFAULT
+; RUN: llc < %s -march=tvm -enable-machine-outliner -tvm-code-layout-report -o /dev/null 2>&1 | FileCheck %s --check-prefix=LAYOUT
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; Repeated serialization code is outlined into a dictionary function. By
+; default only functions optimized for size are outlined from.
+
+; CHECK-LABEL: store_a:
+; CHECK: CALL $OUTLINED_FUNCTION_0$
+; CHECK-NOT: ENDC
+; DEFAULT-LABEL: store_a:
+; DEFAULT-NOT: OUTLINED_FUNCTION
+; DEFAULT: ENDC
+define cell @store_a(i257 %a, i257 %b, i257 %c) {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @llvm.tvm.stu(i257 %a, builder %b0, i257 32)
+  %b2 = call builder @llvm.tvm.stu(i257 %b, builder %b1, i257 64)
+  %b3 = call builder @llvm.tvm.stu(i257 %c, builder %b2, i257 128)
+  %b4 = call builder @llvm.tvm.stu(i257 %a, builder %b3, i257 16)
+  %b5 = call builder @llvm.tvm.stu(i257 %b, builder %b4, i257 8)
+  %b6 = call builder @llvm.tvm.stu(i257 %c, builder %b5, i257 256)
+  %r = call cell @llvm.tvm.endc(builder %b6)
+  ret cell %r
+}
+
+; CHECK-LABEL: store_b:
+; CHECK: CALL $OUTLINED_FUNCTION_0$
+; CHECK-NOT: ENDC
+; DEFAULT-LABEL: store_b:
+; DEFAULT: CALL $OUTLINED_FUNCTION_0$
+; DEFAULT-NOT: ENDC
+define cell @store_b(i257 %a, i257 %b, i257 %c) minsize {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @llvm.tvm.stu(i257 %a, builder %b0, i257 32)
+  %b2 = call builder @llvm.tvm.stu(i257 %b, builder %b1, i257 64)
+  %b3 = call builder @llvm.tvm.stu(i257 %c, builder %b2, i257 128)
+  %b4 = call builder @llvm.tvm.stu(i257 %a, builder %b3, i257 16)
+  %b5 = call builder @llvm.tvm.stu(i257 %b, builder %b4, i257 8)
+  %b6 = call builder @llvm.tvm.stu(i257 %c, builder %b5, i257 256)
+  %r = call cell @llvm.tvm.endc(builder %b6)
+  ret cell %r
+}
+
+; CHECK-LABEL: store_c:
+; CHECK: CALL $OUTLINED_FUNCTION_0$
+; CHECK-NOT: ENDC
+; DEFAULT-LABEL: store_c:
+; DEFAULT: CALL $OUTLINED_FUNCTION_0$
+; DEFAULT-NOT: ENDC
+define cell @store_c(i257 %a, i257 %b, i257 %c) minsize {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @llvm.tvm.stu(i257 %a, builder %b0, i257 32)
+  %b2 = call builder @llvm.tvm.stu(i257 %b, builder %b1, i257 64)
+  %b3 = call builder @llvm.tvm.stu(i257 %c, builder %b2, i257 128)
+  %b4 = call builder @llvm.tvm.stu(i257 %a, builder %b3, i257 16)
+  %b5 = call builder @llvm.tvm.stu(i257 %b, builder %b4, i257 8)
+  %b6 = call builder @llvm.tvm.stu(i257 %c, builder %b5, i257 256)
+  %r = call cell @llvm.tvm.endc(builder %b6)
+  ret cell %r
+}
+
+; CHECK-LABEL: OUTLINED_FUNCTION_0:
+; CHECK: NEWC
+; CHECK: ENDC
+; DEFAULT-LABEL: OUTLINED_FUNCTION_0:
+; DEFAULT: NEWC
+; DEFAULT: ENDC
+
+; Cells are laid out after outlining: the callers are left with the call, and
+; the outlined function is laid out as well.
+; LAYOUT-LABEL: ===-- TVM code layout --===
+; LAYOUT: store_a: 16 bits in 1 cells
+; LAYOUT: OUTLINED_FUNCTION_0: {{[0-9]+}} bits in 1 cells
+; LAYOUT: method store_a: hot path touches 3 cells in 2 functions
+
+declare builder @llvm.tvm.newc()
+declare builder @llvm.tvm.stu(i257, builder, i257)
+declare cell @llvm.tvm.endc(builder)
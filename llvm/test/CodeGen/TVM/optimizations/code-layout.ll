@@ -0,0 +1,107 @@
+; RUN: llc < %s -march=tvm -tvm-code-layout-report -o /dev/null 2>&1 | FileCheck %s
+; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s --check-prefix=ASM
+; RUN: llc < %s -march=tvm -asm-verbose=false -disable-tvm-code-layout | FileCheck %s --check-prefix=INLINE
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: ===-- TVM code layout --===
+; CHECK: helper: {{[0-9]+}} bits in 1 cells, hot path touches 1 cells
+; CHECK: method: {{[0-9]+}} bits in 1 cells, hot path touches 1 cells
+; CHECK: rare_return: {{[0-9]+}} bits in 2 cells, hot path touches 1 cells, {{.*}}, 1 continuations in separate cells
+; The call loads the CALLREF cell and the cell of the callee.
+; CHECK: method method: hot path touches 3 cells in 2 functions
+; CHECK-NOT: method helper
+
+define internal i257 @helper(i257 %x) noinline {
+  %y = mul i257 %x, 3
+  ret i257 %y
+}
+
+define i257 @method(i257 %x) {
+  %y = call i257 @helper(i257 %x)
+  %z = add i257 %y, 1
+  ret i257 %z
+}
+
+; The rare early return would push the hot path into the second cell. It's
+; entered by IFJMP right after its push, so the pair becomes IFJMPREF, which
+; loads the cell only if the jump is taken.
+; ASM-LABEL: rare_return:
+; ASM: ISZERO
+; ASM-NEXT: IFJMPREF
+; ASM-NEXT: {
+; ASM: }
+; ASM-NOT: PUSHCONT
+; ASM: RET
+; INLINE-LABEL: rare_return:
+; INLINE: PUSHCONT
+; INLINE: IFJMP
+; INLINE-NOT: JMPREF
+; INLINE: RET
+define i257 @rare_return(i257 %x, i257 %y) {
+entry:
+  %c = icmp eq i257 %y, 0
+  br i1 %c, label %rare, label %hot, !prof !0
+rare:
+  %r0 = mul i257 %x, %x
+  %r1 = add i257 %r0, %x
+  %r2 = xor i257 %r1, %x
+  %r3 = sub i257 %r2, %x
+  %r4 = mul i257 %r3, %x
+  %r5 = add i257 %r4, %x
+  %r6 = xor i257 %r5, %x
+  %r7 = sub i257 %r6, %x
+  %r8 = mul i257 %r7, %x
+  %r9 = add i257 %r8, %x
+  %r10 = xor i257 %r9, %x
+  %r11 = sub i257 %r10, %x
+  %r12 = mul i257 %r11, %x
+  %r13 = add i257 %r12, %x
+  %r14 = xor i257 %r13, %x
+  %r15 = sub i257 %r14, %x
+  ret i257 %r15
+hot:
+  %h0 = mul i257 %x, %y
+  %h1 = add i257 %h0, %y
+  %h2 = xor i257 %h1, %y
+  %h3 = sub i257 %h2, %y
+  %h4 = mul i257 %h3, %y
+  %h5 = add i257 %h4, %y
+  %h6 = xor i257 %h5, %y
+  %h7 = sub i257 %h6, %y
+  %h8 = mul i257 %h7, %y
+  %h9 = add i257 %h8, %y
+  %h10 = xor i257 %h9, %y
+  %h11 = sub i257 %h10, %y
+  %h12 = mul i257 %h11, %y
+  %h13 = add i257 %h12, %y
+  %h14 = xor i257 %h13, %y
+  %h15 = sub i257 %h14, %y
+  %h16 = mul i257 %h15, %y
+  %h17 = add i257 %h16, %y
+  %h18 = xor i257 %h17, %y
+  %h19 = sub i257 %h18, %y
+  %h20 = mul i257 %h19, %y
+  %h21 = add i257 %h20, %y
+  %h22 = xor i257 %h21, %y
+  %h23 = sub i257 %h22, %y
+  %h24 = mul i257 %h23, %y
+  %h25 = add i257 %h24, %y
+  %h26 = xor i257 %h25, %y
+  %h27 = sub i257 %h26, %y
+  %h28 = mul i257 %h27, %y
+  %h29 = add i257 %h28, %y
+  %h30 = xor i257 %h29, %y
+  %h31 = sub i257 %h30, %y
+  %h32 = mul i257 %h31, %y
+  %h33 = add i257 %h32, %y
+  %h34 = xor i257 %h33, %y
+  %h35 = sub i257 %h34, %y
+  %h36 = mul i257 %h35, %y
+  %h37 = add i257 %h36, %y
+  %h38 = xor i257 %h37, %y
+  %h39 = sub i257 %h38, %y
+  ret i257 %h39
+}
+
+!0 = !{!"branch_weights", i32 1, i32 1000}
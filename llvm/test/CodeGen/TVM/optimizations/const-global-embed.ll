@@ -0,0 +1,66 @@
+; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+@table = private constant [4 x i257] [i257 1, i257 2, i257 3, i257 7]
+@signed = private constant [3 x i257] [i257 -1, i257 5, i257 -3]
+@long = private constant [64 x i8] c"\00\01\02\03\04\05\06\07\08\09\0A\0B\0C\0D\0E\0F\10\11\12\13\14\15\16\17\18\19\1A\1B\1C\1D\1E\1F\20\21\22\23\24\25\26\27\28\29\2A\2B\2C\2D\2E\2F\30\31\32\33\34\35\36\37\38\39\3A\3B\3C\3D\3E\3F"
+@mutable = global [4 x i257] [i257 1, i257 2, i257 3, i257 7]
+
+; CHECK-LABEL: lookup
+define i257 @lookup(i257 %i) {
+; CHECK: PUSHSLICE x29f
+; CHECK: SDSKIPFIRST
+; CHECK-NEXT: PLDU 3
+; CHECK-NOT: GETGLOB 13
+  %p = getelementptr inbounds [4 x i257], [4 x i257]* @table, i257 0, i257 %i
+  %v = load i257, i257* %p
+  ret i257 %v
+}
+
+; CHECK-LABEL: lookup_signed
+define i257 @lookup_signed(i257 %i) {
+; CHECK: PUSHSLICE xf5d
+; CHECK: SDSKIPFIRST
+; CHECK-NEXT: PLDI 4
+; CHECK-NOT: GETGLOB 13
+  %p = getelementptr inbounds [3 x i257], [3 x i257]* @signed, i257 0, i257 %i
+  %v = load i257, i257* %p
+  ret i257 %v
+}
+
+; CHECK-LABEL: lookup_long
+define i257 @lookup_long(i257 %i) {
+; CHECK: PUSHREFSLICE x00108310518720928b30d38f41149351559761969b71d79f8218a39259a7a29aabb2dbafc31cb3d35db7e39ebbf3dfbf
+; CHECK: SDSKIPFIRST
+; CHECK-NEXT: PLDU 6
+; CHECK-NOT: GETGLOB 13
+  %p = getelementptr inbounds [64 x i8], [64 x i8]* @long, i257 0, i257 %i
+  %v = load i8, i8* %p
+  %r = zext i8 %v to i257
+  ret i257 %r
+}
+
+; CHECK-LABEL: lookup_const
+define i257 @lookup_const() {
+; CHECK: PUSHINT 3
+; CHECK-NOT: PUSHSLICE
+  %p = getelementptr inbounds [4 x i257], [4 x i257]* @table, i257 0, i257 2
+  %v = load i257, i257* %p
+  ret i257 %v
+}
+
+; CHECK-LABEL: lookup_mutable
+define i257 @lookup_mutable(i257 %i) {
+; CHECK-NOT: PUSHSLICE
+; CHECK: GETGLOB 13 CALLX
+  %p = getelementptr inbounds [4 x i257], [4 x i257]* @mutable, i257 0, i257 %i
+  %v = load i257, i257* %p
+  ret i257 %v
+}
+
+; Arrays whose loads are all embedded are not placed among the globals.
+; CHECK-NOT: table:
+; CHECK-NOT: signed:
+; CHECK-NOT: long:
+; CHECK: mutable:
@@ -0,0 +1,17 @@
+; RUN: opt -O2 -S < %s -march=tvm | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; Dictionary lookups throw on a malformed dictionary cell, so an unused
+; lookup is not erased.
+; CHECK-LABEL: unused_lookup
+; CHECK: call { slice, i257 } @llvm.tvm.dictuget(i257 %key, cell %dict, i257 32)
+; CHECK: call { slice, i257, i257 } @llvm.tvm.dictumin(cell %dict, i257 32)
+define void @unused_lookup(i257 %key, cell %dict) {
+  %r = call { slice, i257 } @llvm.tvm.dictuget(i257 %key, cell %dict, i257 32)
+  %m = call { slice, i257, i257 } @llvm.tvm.dictumin(cell %dict, i257 32)
+  ret void
+}
+
+declare { slice, i257 } @llvm.tvm.dictuget(i257, cell, i257)
+declare { slice, i257, i257 } @llvm.tvm.dictumin(cell, i257)
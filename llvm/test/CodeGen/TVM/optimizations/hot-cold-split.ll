@@ -0,0 +1,47 @@
+; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s
+; RUN: llc < %s -march=tvm -asm-verbose=false -disable-tvm-hot-cold-split | FileCheck %s --check-prefix=INLINE
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: bounce
+; CHECK: IF{{(NOT)?}}JMPREF
+; CHECK-NEXT: {
+; CHECK: SENDRAWMSG
+; CHECK: THROW 101
+; CHECK: }
+; CHECK-NOT: PUSHCONT
+; INLINE-LABEL: bounce
+; INLINE-NOT: JMPREF
+; INLINE: THROW 101
+define i257 @bounce(i257 %x, cell %msg) {
+entry:
+  %c = icmp eq i257 %x, 0
+  br i1 %c, label %fail, label %ok
+fail:
+  call void @llvm.tvm.sendrawmsg(cell %msg, i257 64)
+  call void @llvm.tvm.sendrawmsg(cell %msg, i257 1)
+  call void @llvm.tvm.sendrawmsg(cell %msg, i257 2)
+  call void @llvm.tvm.throw(i257 101)
+  unreachable
+ok:
+  %r = add i257 %x, 1
+  ret i257 %r
+}
+
+; A bare THROW is left to THROWIF.
+; CHECK-LABEL: check
+; CHECK-NOT: JMPREF
+; CHECK: THROWIF
+define i257 @check(i257 %x) {
+entry:
+  %c = icmp eq i257 %x, 0
+  br i1 %c, label %fail, label %ok
+fail:
+  call void @llvm.tvm.throw(i257 102)
+  unreachable
+ok:
+  ret i257 %x
+}
+
+declare void @llvm.tvm.sendrawmsg(cell, i257)
+declare void @llvm.tvm.throw(i257) noreturn
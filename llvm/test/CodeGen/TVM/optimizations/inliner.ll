@@ -0,0 +1,50 @@
+; RUN: opt -O2 -inline-threshold=0 -S < %s -march=tvm | FileCheck %s
+; RUN: opt -O2 -inline-threshold=0 -tvm-inliner=false -S < %s -march=tvm | FileCheck %s --check-prefix=GENERIC
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; With the threshold lowered to zero, only the gas the call boundary costs
+; (the call, four arguments and a result shuffled on the stack) pays for
+; inlining @mix. The generic inliner keeps the calls.
+
+; CHECK-LABEL: define i257 @first
+; CHECK-NOT: call
+; CHECK: ret i257
+; GENERIC-LABEL: define i257 @first
+; GENERIC: call fastcc i257 @mix(i257 %a, i257 %b, i257 %c, i257 %d)
+define i257 @first(i257 %a, i257 %b, i257 %c, i257 %d) {
+  %r = call i257 @mix(i257 %a, i257 %b, i257 %c, i257 %d)
+  ret i257 %r
+}
+
+; CHECK-LABEL: define i257 @second
+; CHECK-NOT: call
+; CHECK: ret i257
+; GENERIC-LABEL: define i257 @second
+; GENERIC: call fastcc i257 @mix(i257 %d, i257 %c, i257 %b, i257 %a)
+define i257 @second(i257 %a, i257 %b, i257 %c, i257 %d) {
+  %r = call i257 @mix(i257 %d, i257 %c, i257 %b, i257 %a)
+  ret i257 %r
+}
+
+; CHECK-NOT: define internal i257 @mix
+; GENERIC: define internal fastcc i257 @mix
+define internal i257 @mix(i257 %a, i257 %b, i257 %c, i257 %d) {
+  %v0 = mul i257 %a, %b
+  %v1 = xor i257 %v0, %c
+  %v2 = add i257 %v1, %d
+  %v3 = sub i257 %v2, %a
+  %v4 = mul i257 %v3, %b
+  %v5 = xor i257 %v4, %c
+  %v6 = add i257 %v5, %d
+  %v7 = sub i257 %v6, %a
+  %v8 = mul i257 %v7, %b
+  %v9 = xor i257 %v8, %c
+  %v10 = add i257 %v9, %d
+  %v11 = sub i257 %v10, %a
+  %v12 = mul i257 %v11, %b
+  %v13 = xor i257 %v12, %c
+  %v14 = add i257 %v13, %d
+  %v15 = sub i257 %v14, %a
+  ret i257 %v15
+}
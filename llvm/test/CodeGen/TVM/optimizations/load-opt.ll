@@ -0,0 +1,102 @@
+; RUN: opt -tvm-load-combine -S < %s -march=tvm | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: skip
+define i257 @skip(slice %s) {
+; CHECK: %[[L:[0-9]+]] = call { slice, slice } @llvm.tvm.ldslice(slice %s, i257 40)
+; CHECK-NEXT: %[[R:[0-9]+]] = extractvalue { slice, slice } %[[L]], 1
+; CHECK-NEXT: %{{[0-9]+}} = call i257 @llvm.tvm.pldu(slice %[[R]], i257 16)
+; CHECK-NEXT: ret i257
+  %1 = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+  %2 = extractvalue { i257, slice } %1, 1
+  %3 = call { i257, slice } @llvm.tvm.ldi(slice %2, i257 32)
+  %4 = extractvalue { i257, slice } %3, 1
+  %5 = call { i257, slice } @llvm.tvm.ldu(slice %4, i257 16)
+  %6 = extractvalue { i257, slice } %5, 0
+  ret i257 %6
+}
+
+; CHECK-LABEL: skip_wide
+define slice @skip_wide(slice %s) {
+; CHECK: %[[R:[0-9]+]] = call slice @llvm.tvm.sdskipfirst(slice %s, i257 384)
+; CHECK-NEXT: ret slice %[[R]]
+  %1 = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 256)
+  %2 = extractvalue { i257, slice } %1, 1
+  %3 = call { i257, slice } @llvm.tvm.ldu(slice %2, i257 128)
+  %4 = extractvalue { i257, slice } %3, 1
+  ret slice %4
+}
+
+; The unused LDI 42 and LDI 256 of the ldi test of intrinsic.ll
+; CHECK-LABEL: skip_between_variable
+define slice @skip_between_variable(slice %slice, i257 %size) {
+; CHECK: %ldi.1 = call { i257, slice } @llvm.tvm.ldi(slice %slice, i257 %size)
+; CHECK: %ldi.2 = call { i257, slice } @llvm.tvm.ldi(slice %slice.1, i257 0)
+; CHECK: %[[R:[0-9]+]] = call slice @llvm.tvm.sdskipfirst(slice %slice.2, i257 298)
+; CHECK-NEXT: %ldi.5 = call { i257, slice } @llvm.tvm.ldi(slice %[[R]], i257 257)
+  %ldi.1 = call {i257, slice} @llvm.tvm.ldi(slice %slice, i257 %size)
+  %slice.1 = extractvalue {i257, slice} %ldi.1, 1
+  %ldi.2 = call {i257, slice} @llvm.tvm.ldi(slice %slice.1, i257 0)
+  %slice.2 = extractvalue {i257, slice} %ldi.2, 1
+  %ldi.3 = call {i257, slice} @llvm.tvm.ldi(slice %slice.2, i257 42)
+  %slice.3 = extractvalue {i257, slice} %ldi.3, 1
+  %ldi.4 = call {i257, slice} @llvm.tvm.ldi(slice %slice.3, i257 256)
+  %slice.4 = extractvalue {i257, slice} %ldi.4, 1
+  %ldi.5 = call {i257, slice} @llvm.tvm.ldi(slice %slice.4, i257 257)
+  %slice.5 = extractvalue {i257, slice} %ldi.5, 1
+  ret slice %slice.5
+}
+
+; CHECK-LABEL: used
+define i257 @used(slice %s) {
+entry:
+; CHECK: call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+; CHECK: call { i257, slice } @llvm.tvm.ldu(slice %v2, i257 8)
+; CHECK: next:
+; CHECK-NEXT: call i257 @llvm.tvm.pldi(slice %v5, i257 8)
+  %v1 = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+  %v2 = extractvalue { i257, slice } %v1, 1
+  %v3 = extractvalue { i257, slice } %v1, 0
+  %v4 = call { i257, slice } @llvm.tvm.ldu(slice %v2, i257 8)
+  %v5 = extractvalue { i257, slice } %v4, 1
+  br label %next
+next:
+  %v6 = call { i257, slice } @llvm.tvm.ldi(slice %v5, i257 8)
+  %v7 = extractvalue { i257, slice } %v6, 0
+  %v8 = add i257 %v3, %v7
+  ret i257 %v8
+}
+
+; CHECK-LABEL: not_linear
+define slice @not_linear(slice %s, i1 %c) {
+entry:
+; CHECK: call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+  %v1 = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+  %v2 = extractvalue { i257, slice } %v1, 1
+  br i1 %c, label %then, label %exit
+then:
+; CHECK: call { i257, slice } @llvm.tvm.ldu(slice %v2, i257 8)
+  %v3 = call { i257, slice } @llvm.tvm.ldu(slice %v2, i257 8)
+  %v4 = extractvalue { i257, slice } %v3, 1
+  ret slice %v4
+exit:
+  ret slice %s
+}
+
+; CHECK-LABEL: across_throwif
+define slice @across_throwif(slice %s, i257 %c) {
+; CHECK: %v1 = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+; CHECK: call void @llvm.tvm.throwif(i257 %c, i257 42)
+; CHECK-NEXT: %v3 = call { i257, slice } @llvm.tvm.ldu(slice %v2, i257 8)
+  %v1 = call { i257, slice } @llvm.tvm.ldu(slice %s, i257 8)
+  %v2 = extractvalue { i257, slice } %v1, 1
+  call void @llvm.tvm.throwif(i257 %c, i257 42)
+  %v3 = call { i257, slice } @llvm.tvm.ldu(slice %v2, i257 8)
+  %v4 = extractvalue { i257, slice } %v3, 1
+  ret slice %v4
+}
+
+declare { i257, slice } @llvm.tvm.ldu(slice, i257)
+declare { i257, slice } @llvm.tvm.ldi(slice, i257)
+declare void @llvm.tvm.throwif(i257, i257)
@@ -0,0 +1,155 @@
+; RUN: opt -tvm-persistent-store-elim -S < %s -march=tvm | FileCheck %s
+; RUN: opt -O2 -S < %s -march=tvm | FileCheck %s --check-prefix=AA
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: overwritten
+define void @overwritten(cell %a, cell %b) {
+; CHECK-NOT: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK: call void @llvm.tvm.setglobal(i257 8, i257 1)
+; CHECK-NEXT: call void @llvm.tvm.set.persistent.data(cell %b)
+; CHECK-NEXT: ret void
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  call void @llvm.tvm.setglobal(i257 8, i257 1)
+  call void @llvm.tvm.set.persistent.data(cell %b)
+  ret void
+}
+
+; CHECK-LABEL: read_between
+define cell @read_between(cell %a, cell %b) {
+; CHECK: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK: call void @llvm.tvm.set.persistent.data(cell %b)
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  %d = call cell @llvm.tvm.get.persistent.data()
+  call void @llvm.tvm.set.persistent.data(cell %b)
+  ret cell %d
+}
+
+; CHECK-LABEL: committed
+define void @committed(cell %a, cell %b) {
+; CHECK: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK: call void @llvm.tvm.commit()
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  call void @llvm.tvm.commit()
+  call void @llvm.tvm.set.persistent.data(cell %b)
+  ret void
+}
+
+; CHECK-LABEL: before_throw
+define void @before_throw(cell %a) {
+; CHECK-NOT: @llvm.tvm.set.persistent.data
+; CHECK: call void @llvm.tvm.throw(i257 100)
+  call void @llvm.tvm.setreg(i257 4, i257 0)
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  call void @llvm.tvm.throw(i257 100)
+  unreachable
+}
+
+; THROW 0 terminates the transaction successfully and commits c4.
+; CHECK-LABEL: before_success_throw
+define void @before_success_throw(cell %a) {
+; CHECK: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK-NEXT: call void @llvm.tvm.throw(i257 0)
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  call void @llvm.tvm.throw(i257 0)
+  unreachable
+}
+
+; The exit code is not known to be a failure.
+; CHECK-LABEL: before_variable_throw
+define void @before_variable_throw(cell %a, i257 %code) {
+; CHECK: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK-NEXT: call void @llvm.tvm.throw(i257 %code)
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  call void @llvm.tvm.throw(i257 %code)
+  unreachable
+}
+
+; CHECK-LABEL: sink_to_exit
+define void @sink_to_exit(cell %a, i257 %x) {
+entry:
+; CHECK: entry:
+; CHECK-NOT: @llvm.tvm.set.persistent.data
+; CHECK: br i1
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  %c = icmp eq i257 %x, 0
+  br i1 %c, label %fail, label %ok
+fail:
+; CHECK: fail:
+; CHECK-NOT: @llvm.tvm.set.persistent.data
+; CHECK: call void @llvm.tvm.throw(i257 101)
+  call void @llvm.tvm.sendrawmsg(cell %a, i257 0)
+  call void @llvm.tvm.throw(i257 101)
+  unreachable
+ok:
+; CHECK: ok:
+; CHECK-NEXT: call void @llvm.tvm.set.persistent.data(cell %a)
+  ret void
+}
+
+; The store is sunk past the check and then found dead on the second one.
+; CHECK-LABEL: sink_twice
+define void @sink_twice(cell %a, i257 %x, i257 %y) {
+entry:
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  %c1 = icmp eq i257 %x, 0
+  br i1 %c1, label %fail, label %check
+check:
+; CHECK: check:
+; CHECK-NOT: @llvm.tvm.set.persistent.data
+; CHECK: br i1
+  %c2 = icmp eq i257 %y, 0
+  br i1 %c2, label %fail, label %ok
+fail:
+  call void @llvm.tvm.throw(i257 102)
+  unreachable
+ok:
+; CHECK: ok:
+; CHECK-NEXT: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK-NEXT: ret void
+  ret void
+}
+
+; The critical edge to the shared exit is split.
+; CHECK-LABEL: split_edge
+define void @split_edge(cell %a, cell %b, i257 %x, i257 %y) {
+entry:
+  %c1 = icmp eq i257 %x, 0
+  br i1 %c1, label %store, label %exit
+store:
+; CHECK: store:
+; CHECK-NOT: @llvm.tvm.set.persistent.data
+; CHECK: br i1 %c2, label %fail, label %[[EDGE:.*]]
+  call void @llvm.tvm.set.persistent.data(cell %a)
+  %c2 = icmp eq i257 %y, 0
+  br i1 %c2, label %fail, label %exit
+fail:
+  call void @llvm.tvm.throw(i257 103)
+  unreachable
+exit:
+  ret void
+; CHECK: [[EDGE]]:
+; CHECK-NEXT: call void @llvm.tvm.set.persistent.data(cell %a)
+; CHECK-NEXT: br label %exit
+}
+
+; The persistent data is not clobbered by the store of a global.
+; AA-LABEL: across_globals
+define cell @across_globals(i1 %c) {
+; AA: call cell @llvm.tvm.get.persistent.data()
+; AA-NOT: @llvm.tvm.get.persistent.data
+; AA: ret cell
+  %d1 = call cell @llvm.tvm.get.persistent.data()
+  call void @llvm.tvm.setglobal(i257 8, i257 1)
+  %d2 = call cell @llvm.tvm.get.persistent.data()
+  %r = select i1 %c, cell %d1, cell %d2
+  ret cell %r
+}
+
+declare cell @llvm.tvm.get.persistent.data()
+declare void @llvm.tvm.set.persistent.data(cell)
+declare void @llvm.tvm.setglobal(i257, i257)
+declare void @llvm.tvm.setreg(i257, i257)
+declare void @llvm.tvm.sendrawmsg(cell, i257)
+declare void @llvm.tvm.commit()
+declare void @llvm.tvm.throw(i257)
@@ -0,0 +1,50 @@
+; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; A global read is repeated in each branch instead of being carried there.
+; CHECK-LABEL: reread_cross:
+; CHECK-NOT: GETGLOB
+; CHECK: PUSHCONT
+; CHECK: GETGLOB 8
+; CHECK: IFJMP
+; CHECK: GETGLOB 8
+define i257 @reread_cross(i257 %c, i257 %x) nounwind {
+entry:
+  %g = call i257 @llvm.tvm.getglobal(i257 8)
+  %cmp = icmp eq i257 %c, 0
+  br i1 %cmp, label %then, label %else
+
+then:
+  %ra = add i257 %x, %g
+  ret i257 %ra
+
+else:
+  %rb = mul i257 %x, %g
+  ret i257 %rb
+}
+
+; The global is modified before the uses, so the read stays in place.
+; CHECK-LABEL: clobbered:
+; CHECK: GETGLOB 8
+; CHECK: SETGLOB 8
+; CHECK-NOT: GETGLOB 8
+; CHECK: IFJMP
+define i257 @clobbered(i257 %c, i257 %x) nounwind {
+entry:
+  %g = call i257 @llvm.tvm.getglobal(i257 8)
+  call void @llvm.tvm.setglobal(i257 8, i257 %x)
+  %cmp = icmp eq i257 %c, 0
+  br i1 %cmp, label %then, label %else
+
+then:
+  %ra = add i257 %x, %g
+  ret i257 %ra
+
+else:
+  %rb = mul i257 %x, %g
+  ret i257 %rb
+}
+
+declare i257 @llvm.tvm.getglobal(i257) nounwind readonly
+declare void @llvm.tvm.setglobal(i257, i257) nounwind
@@ -0,0 +1,104 @@
+; RUN: opt -tvm-specialize -S < %s -march=tvm | FileCheck %s
+; RUN: opt -O2 -debug-pass=Structure < %s -march=tvm -o /dev/null 2>&1 | FileCheck %s --check-prefix=PIPELINE
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; PIPELINE: TVM function specialization
+; PIPELINE: TVM Function Inlining
+
+; The calls with the same constant width share a specialization, the width
+; disappears from its signature.
+
+; CHECK-LABEL: define cell @two_widths
+; CHECK: call builder @[[SPEC32:store\.spec]](i257 %a, builder %b0)
+; CHECK: call builder @[[SPEC32]](i257 %a, builder %b1)
+; CHECK: call builder @[[SPEC64:store\.spec\.[0-9]+]](i257 %a, builder %b2)
+define cell @two_widths(i257 %a) {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @store(i257 %a, builder %b0, i257 32)
+  %b2 = call builder @store(i257 %a, builder %b1, i257 32)
+  %b3 = call builder @store(i257 %a, builder %b2, i257 64)
+  %c = call cell @llvm.tvm.endc(builder %b3)
+  ret cell %c
+}
+
+; A non-constant width keeps the call of the original function.
+; CHECK-LABEL: define cell @variable_width
+; CHECK: call builder @store(i257 %a, builder %b0, i257 %w)
+define cell @variable_width(i257 %a, i257 %w) {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @store(i257 %a, builder %b0, i257 %w)
+  %c = call cell @llvm.tvm.endc(builder %b1)
+  ret cell %c
+}
+
+; A function optimized for size is not cloned.
+; CHECK-LABEL: define cell @for_size
+; CHECK: call builder @store_small(i257 %a, builder %b0, i257 32)
+define cell @for_size(i257 %a) {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @store_small(i257 %a, builder %b0, i257 32)
+  %c = call cell @llvm.tvm.endc(builder %b1)
+  ret cell %c
+}
+
+; The immediate form of a single STU doesn't pay off the clone of a long
+; function.
+; CHECK-LABEL: define cell @unprofitable
+; CHECK: call builder @mix_store(i257 %a, builder %b0, i257 32)
+define cell @unprofitable(i257 %a) {
+  %b0 = call builder @llvm.tvm.newc()
+  %b1 = call builder @mix_store(i257 %a, builder %b0, i257 32)
+  %c = call cell @llvm.tvm.endc(builder %b1)
+  ret cell %c
+}
+
+define internal builder @store_small(i257 %v, builder %b, i257 %w) noinline optsize {
+  %r = call builder @llvm.tvm.stu(i257 %v, builder %b, i257 %w)
+  ret builder %r
+}
+
+define internal builder @mix_store(i257 %v, builder %b, i257 %w) noinline {
+  %x0 = add i257 %v, 1
+  %x1 = mul i257 %x0, %v
+  %x2 = add i257 %x1, %v
+  %x3 = mul i257 %x2, %v
+  %x4 = add i257 %x3, %v
+  %x5 = mul i257 %x4, %v
+  %x6 = add i257 %x5, %v
+  %x7 = mul i257 %x6, %v
+  %x8 = add i257 %x7, %v
+  %x9 = mul i257 %x8, %v
+  %x10 = add i257 %x9, %v
+  %x11 = mul i257 %x10, %v
+  %x12 = add i257 %x11, %v
+  %x13 = mul i257 %x12, %v
+  %x14 = add i257 %x13, %v
+  %x15 = mul i257 %x14, %v
+  %x16 = add i257 %x15, %v
+  %x17 = mul i257 %x16, %v
+  %x18 = add i257 %x17, %v
+  %x19 = mul i257 %x18, %v
+  %x20 = add i257 %x19, %v
+  %x21 = mul i257 %x20, %v
+  %x22 = add i257 %x21, %v
+  %x23 = mul i257 %x22, %v
+  %x24 = add i257 %x23, %v
+  %r = call builder @llvm.tvm.stu(i257 %x24, builder %b, i257 %w)
+  ret builder %r
+}
+
+; CHECK-LABEL: define internal builder @store(i257 %v, builder %b, i257 %w)
+; CHECK: define internal builder @[[SPEC32]](i257 %v, builder %b)
+; CHECK: call builder @llvm.tvm.stu(i257 %v, builder %b, i257 32)
+; CHECK: define internal builder @[[SPEC64]](i257 %v, builder %b)
+; CHECK: call builder @llvm.tvm.stu(i257 %v, builder %b, i257 64)
+; CHECK-NOT: .spec
+define internal builder @store(i257 %v, builder %b, i257 %w) noinline {
+  %r = call builder @llvm.tvm.stu(i257 %v, builder %b, i257 %w)
+  ret builder %r
+}
+
+declare builder @llvm.tvm.newc()
+declare builder @llvm.tvm.stu(i257, builder, i257)
+declare cell @llvm.tvm.endc(builder)
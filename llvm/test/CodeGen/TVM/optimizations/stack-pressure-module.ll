@@ -0,0 +1,53 @@
+; RUN: llc < %s -march=tvm | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; The caller keeps a value in GLOB 24 across a call, so the callee must not
+; use it for spills.
+; CHECK-LABEL: callee:
+; CHECK-NOT: SETGLOB 24
+; CHECK-LABEL: caller:
+define i257 @callee(i257 %a0, i257 %a1, i257 %a2, i257 %a3, i257 %a4, i257 %a5, i257 %a6, i257 %a7, i257 %a8, i257 %a9, i257 %a10, i257 %a11, i257 %a12, i257 %a13, i257 %a14, i257 %a15, i257 %a16, i257 %a17, i257 %a18, i257 %a19, i257 %n) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i257 [ 0, %entry ], [ %inc, %loop ]
+  %inc = add nsw i257 %i, 1
+  %cmp = icmp slt i257 %inc, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %r1 = add i257 %a0, %a1
+  %r2 = add i257 %r1, %a2
+  %r3 = add i257 %r2, %a3
+  %r4 = add i257 %r3, %a4
+  %r5 = add i257 %r4, %a5
+  %r6 = add i257 %r5, %a6
+  %r7 = add i257 %r6, %a7
+  %r8 = add i257 %r7, %a8
+  %r9 = add i257 %r8, %a9
+  %r10 = add i257 %r9, %a10
+  %r11 = add i257 %r10, %a11
+  %r12 = add i257 %r11, %a12
+  %r13 = add i257 %r12, %a13
+  %r14 = add i257 %r13, %a14
+  %r15 = add i257 %r14, %a15
+  %r16 = add i257 %r15, %a16
+  %r17 = add i257 %r16, %a17
+  %r18 = add i257 %r17, %a18
+  %r19 = add i257 %r18, %a19
+  %res = add i257 %r19, %inc
+  ret i257 %res
+}
+
+define i257 @caller(i257 %v, i257 %n) nounwind {
+  call void @llvm.tvm.setglobal(i257 24, i257 %v)
+  %r = call i257 @callee(i257 0, i257 1, i257 2, i257 3, i257 4, i257 5, i257 6, i257 7, i257 8, i257 9, i257 10, i257 11, i257 12, i257 13, i257 14, i257 15, i257 16, i257 17, i257 18, i257 19, i257 %n)
+  %g = call i257 @llvm.tvm.getglobal(i257 24)
+  %s = add i257 %r, %g
+  ret i257 %s
+}
+
+declare i257 @llvm.tvm.getglobal(i257) nounwind readonly
+declare void @llvm.tvm.setglobal(i257, i257) nounwind
@@ -0,0 +1,121 @@
+; RUN: opt -tvm-state-read-cse -S < %s -march=tvm | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: across_sends
+define i257 @across_sends(cell %msg) {
+; CHECK: %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+; CHECK-NOT: @llvm.tvm.getglobal
+; CHECK: add i257 %g1, %g1
+  %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  call void @llvm.tvm.sendrawmsg(cell %msg, i257 0)
+  call void @llvm.tvm.setglobal(i257 9, i257 1)
+  %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %r = add i257 %g1, %g2
+  ret i257 %r
+}
+
+; A dictionary lookup is kept, but it doesn't modify the globals.
+; CHECK-LABEL: across_lookup
+define i257 @across_lookup(i257 %key, cell %dict) {
+; CHECK: %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+; CHECK: call { slice, i257 } @llvm.tvm.dictuget
+; CHECK-NOT: @llvm.tvm.getglobal
+; CHECK: add i257 %g1, %g1
+  %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  %l = call { slice, i257 } @llvm.tvm.dictuget(i257 %key, cell %dict, i257 32)
+  %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %r = add i257 %g1, %g2
+  ret i257 %r
+}
+
+; CHECK-LABEL: forward_store
+define cell @forward_store(cell %c) {
+; CHECK: call void @llvm.tvm.set.persistent.data(cell %c)
+; CHECK-NOT: @llvm.tvm.get.persistent.data
+; CHECK: ret cell %c
+  call void @llvm.tvm.set.persistent.data(cell %c)
+  %d = call cell @llvm.tvm.get.persistent.data()
+  ret cell %d
+}
+
+; CHECK-LABEL: dominated
+define i257 @dominated(i257 %cond) {
+entry:
+; CHECK: %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  %c = icmp ne i257 %cond, 0
+  br i1 %c, label %then, label %exit
+then:
+; CHECK: then:
+; CHECK-NOT: @llvm.tvm.getglobal
+; CHECK: add i257 %g1, %g1
+  %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %s = add i257 %g1, %g2
+  ret i257 %s
+exit:
+  ret i257 %g1
+}
+
+; CHECK-LABEL: clobbered
+define i257 @clobbered(i257 %v, i257 %cond) {
+entry:
+  %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  %c = icmp ne i257 %cond, 0
+  br i1 %c, label %then, label %join
+then:
+  call void @llvm.tvm.setglobal(i257 8, i257 %v)
+  br label %join
+join:
+; CHECK: join:
+; CHECK: %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %s = add i257 %g1, %g2
+  ret i257 %s
+}
+
+; CHECK-LABEL: @setreg(
+define i257 @setreg(i257 %v) {
+; CHECK: call void @llvm.tvm.setreg(i257 7, i257 %v)
+; CHECK: %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  call void @llvm.tvm.setreg(i257 7, i257 %v)
+  %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %s = add i257 %g1, %g2
+  ret i257 %s
+}
+
+; SENDRAWMSG appends an action to c5.
+; CHECK-LABEL: @c5_across_send(
+define i257 @c5_across_send(cell %msg) {
+; CHECK: %r1 = call i257 @llvm.tvm.getreg(i257 5)
+; CHECK: call void @llvm.tvm.sendrawmsg
+; CHECK: %r2 = call i257 @llvm.tvm.getreg(i257 5)
+; CHECK: add i257 %r1, %r2
+  %r1 = call i257 @llvm.tvm.getreg(i257 5)
+  call void @llvm.tvm.sendrawmsg(cell %msg, i257 0)
+  %r2 = call i257 @llvm.tvm.getreg(i257 5)
+  %s = add i257 %r1, %r2
+  ret i257 %s
+}
+
+; CHECK-LABEL: @call(
+define i257 @call() {
+; CHECK: call void @callee()
+; CHECK: %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %g1 = call i257 @llvm.tvm.getglobal(i257 8)
+  call void @callee()
+  %g2 = call i257 @llvm.tvm.getglobal(i257 8)
+  %s = add i257 %g1, %g2
+  ret i257 %s
+}
+
+declare void @callee()
+declare i257 @llvm.tvm.getglobal(i257)
+declare void @llvm.tvm.setglobal(i257, i257)
+declare i257 @llvm.tvm.getreg(i257)
+declare void @llvm.tvm.setreg(i257, i257)
+declare cell @llvm.tvm.get.persistent.data()
+declare void @llvm.tvm.set.persistent.data(cell)
+declare void @llvm.tvm.sendrawmsg(cell, i257)
+declare { slice, i257 } @llvm.tvm.dictuget(i257, cell, i257)
@@ -13,10 +13,12 @@ define builder @test1() {
   ; CHECK: %[[VR2:[0-9]+]] = call builder @llvm.tvm.stu(i257 2690, builder %[[VR1]], i257 256)
   %6 = call builder @llvm.tvm.sti(i257 -1, builder %5, i257 1)
   %7 = call builder @llvm.tvm.stu(i257 3, builder %6, i257 2)
+  ; CHECK: %[[VR3:[0-9]+]] = call builder @llvm.tvm.stu(i257 7, builder %[[VR2]], i257 3)
+  ; -7 doesn't fit into 3 bits, so STI throws and is kept as is.
   %8 = call builder @llvm.tvm.sti(i257 -7, builder %7, i257 3)
-  ; CHECK: %[[VR3:[0-9]+]] = call builder @llvm.tvm.stu(i257 121, builder %[[VR2]], i257 6)
+  ; CHECK: %[[VR4:[0-9]+]] = call builder @llvm.tvm.sti(i257 -7, builder %[[VR3]], i257 3)
   %9 = call builder @llvm.tvm.sti(i257 -7, builder %8, i257 251)
-  ; CHECK: %{{[0-9]+}} = call builder @llvm.tvm.sti(i257 -7, builder %[[VR3]], i257 251)
+  ; CHECK: %{{[0-9]+}} = call builder @llvm.tvm.sti(i257 -7, builder %[[VR4]], i257 251)
   ret builder %9
 }
 
@@ -45,6 +47,63 @@ define builder @test3() {
   ret builder %5
 }
 
+; CHECK-LABEL: negative
+define builder @negative(builder %b) {
+  %1 = call builder @llvm.tvm.sti(i257 -2, builder %b, i257 4)
+  %2 = call builder @llvm.tvm.sti(i257 -1, builder %1, i257 4)
+  ; CHECK: %{{[0-9]+}} = call builder @llvm.tvm.stu(i257 239, builder %b, i257 8)
+  ret builder %2
+}
+
+; CHECK-LABEL: across_blocks
+define builder @across_blocks(builder %b, i257 %v) {
+entry:
+  ; CHECK: entry:
+  ; CHECK-NEXT: %[[VR:[0-9]+]] = call builder @llvm.tvm.stu(i257 11, builder %b, i257 4)
+  ; CHECK-NEXT: br label %next
+  %v1 = call builder @llvm.tvm.stu(i257 2, builder %b, i257 2)
+  br label %next
+next:
+  ; CHECK: next:
+  ; CHECK-NEXT: call builder @llvm.tvm.stu(i257 %v, builder %[[VR]], i257 8)
+  %v2 = call builder @llvm.tvm.stu(i257 3, builder %v1, i257 2)
+  %v3 = call builder @llvm.tvm.stu(i257 %v, builder %v2, i257 8)
+  ret builder %v3
+}
+
+; CHECK-LABEL: not_linear
+define builder @not_linear(builder %b, i1 %cond) {
+entry:
+  ; CHECK: call builder @llvm.tvm.stu(i257 2, builder %b, i257 2)
+  %v1 = call builder @llvm.tvm.stu(i257 2, builder %b, i257 2)
+  br i1 %cond, label %then, label %exit
+then:
+  ; CHECK: call builder @llvm.tvm.stu(i257 3, builder %v1, i257 2)
+  %v2 = call builder @llvm.tvm.stu(i257 3, builder %v1, i257 2)
+  ret builder %v2
+exit:
+  ret builder %b
+}
+
+; The second store would throw on an overflow before ACCEPT if merged.
+; CHECK-LABEL: across_accept
+define builder @across_accept(builder %b) {
+entry:
+  ; CHECK: entry:
+  ; CHECK-NEXT: %v1 = call builder @llvm.tvm.stu(i257 2, builder %b, i257 2)
+  ; CHECK-NEXT: br label %next
+  %v1 = call builder @llvm.tvm.stu(i257 2, builder %b, i257 2)
+  br label %next
+next:
+  ; CHECK: next:
+  ; CHECK-NEXT: call void @llvm.tvm.accept()
+  ; CHECK-NEXT: %v2 = call builder @llvm.tvm.stu(i257 3, builder %v1, i257 2)
+  call void @llvm.tvm.accept()
+  %v2 = call builder @llvm.tvm.stu(i257 3, builder %v1, i257 2)
+  ret builder %v2
+}
+
 declare builder @llvm.tvm.newc()
 declare builder @llvm.tvm.stu(i257, builder, i257)
 declare builder @llvm.tvm.sti(i257, builder, i257)
+declare void @llvm.tvm.accept()
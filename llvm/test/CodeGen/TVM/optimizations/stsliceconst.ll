@@ -0,0 +1,25 @@
+; RUN: llc < %s -march=tvm -asm-verbose=false | FileCheck %s
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; CHECK-LABEL: header
+define builder @header(builder %b, i257 %v) {
+; CHECK: STSLICECONST xa55_
+; CHECK-NEXT: STU 32
+; CHECK-NEXT: STSLICECONST x2a
+  %1 = call builder @llvm.tvm.stu(i257 5, builder %b, i257 3)
+  %2 = call builder @llvm.tvm.stu(i257 42, builder %1, i257 8)
+  %3 = call builder @llvm.tvm.stu(i257 %v, builder %2, i257 32)
+  %4 = call builder @llvm.tvm.stu(i257 42, builder %3, i257 8)
+  ret builder %4
+}
+
+; CHECK-LABEL: long
+define builder @long(builder %b) {
+; CHECK-NOT: STSLICECONST
+; CHECK: STU{{R?}} 64
+  %1 = call builder @llvm.tvm.stu(i257 1, builder %b, i257 64)
+  ret builder %1
+}
+
+declare builder @llvm.tvm.stu(i257, builder, i257)
@@ -0,0 +1,50 @@
+; RUN: llc < %s -march=tvm -tvm-size-map=%t.json -o /dev/null
+; RUN: FileCheck %s < %t.json
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; The size map attributes the code of every function to the instructions and
+; to the source functions they have been inlined from.
+
+; CHECK: {"functions":[{"bits":{{[0-9]+}},"entry":false,"instructions":[
+; CHECK-SAME: "inlined":["tvm::schema::build"],"opcode":"NEWC"
+; CHECK-SAME: "inlined":["tvm::schema::build"],"opcode":"STU"
+; CHECK-SAME: "inlined":[],"opcode":"ENDC"
+; CHECK-SAME: "name":"pack","refs":0,"source":"pack"}
+define cell @pack(i257 %a) !dbg !6 {
+  %b0 = call builder @llvm.tvm.newc(), !dbg !10
+  %b1 = call builder @llvm.tvm.stu(i257 %a, builder %b0, i257 32), !dbg !10
+  %c = call cell @llvm.tvm.endc(builder %b1), !dbg !11
+  ret cell %c, !dbg !11
+}
+
+; CHECK-SAME: {"bits":{{[0-9]+}},"entry":true,
+; CHECK-SAME: "name":"main_external"
+define void @main_external() #0 {
+  call void @llvm.tvm.accept()
+  ret void
+}
+
+; CHECK-SAME: ],"module":"<stdin>"}
+
+declare builder @llvm.tvm.newc()
+declare builder @llvm.tvm.stu(i257, builder, i257)
+declare cell @llvm.tvm.endc(builder)
+declare void @llvm.tvm.accept()
+
+attributes #0 = { "tvm_raw_func" }
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C_plus_plus, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug)
+!1 = !DIFile(filename: "contract.cpp", directory: "/tmp")
+!2 = !DISubroutineType(types: !{null})
+!3 = !{i32 2, !"Debug Info Version", i32 3}
+!4 = !DINamespace(name: "tvm", scope: null)
+!5 = !DINamespace(name: "schema", scope: !4)
+!6 = distinct !DISubprogram(name: "pack", scope: !1, file: !1, line: 10, type: !2, isLocal: false, isDefinition: true, unit: !0)
+!7 = distinct !DISubprogram(name: "build", scope: !5, file: !1, line: 2, type: !2, isLocal: false, isDefinition: true, unit: !0)
+!8 = !DILocation(line: 11, scope: !6)
+!10 = !DILocation(line: 3, scope: !7, inlinedAt: !8)
+!11 = !DILocation(line: 12, scope: !6)
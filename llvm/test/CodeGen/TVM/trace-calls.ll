@@ -0,0 +1,53 @@
+; RUN: llc < %s -march=tvm -asm-verbose=false -tvm-trace-calls | FileCheck %s --check-prefix=ALL
+; RUN: llc < %s -march=tvm -asm-verbose=false -tvm-trace-functions='^ca.*ee$' | FileCheck %s --check-prefix=SOME
+; RUN: not llc < %s -march=tvm -tvm-trace-functions='callee,ca[' -o /dev/null 2>&1 | FileCheck %s --check-prefix=INVALID
+target datalayout = "E-S257-i1:257:257-i8:257:257-i16:257:257-i32:257:257-i64:257:257-i257:257:257-p:257:257-a:257:257"
+target triple = "tvm"
+
+; Traced functions report their ids, the positions among the definitions of
+; the module, at the entry and at the returns. -tvm-trace-functions and the
+; tvm_trace attribute select the functions to trace.
+
+; INVALID: Invalid -tvm-trace-functions pattern 'ca[': brackets ([ ]) not balanced
+
+declare i257 @external(i257)
+
+; ALL-LABEL: callee:
+; ALL: DEBUGSTR E1
+; ALL: DEBUGSTR X1
+; SOME-LABEL: callee:
+; SOME: DEBUGSTR E1
+; SOME: DEBUGSTR X1
+define i257 @callee(i257 %a) {
+  %r = add i257 %a, 1
+  ret i257 %r
+}
+
+; ALL-LABEL: caller:
+; ALL: DEBUGSTR E2
+; ALL: CALL $callee$
+; ALL: DEBUGSTR X2
+; SOME-LABEL: caller:
+; SOME-NOT: DEBUGSTR
+; SOME: CALL $callee$
+; SOME-NOT: DEBUGSTR
+; SOME-LABEL: marked:
+define i257 @caller(i257 %a) {
+  %c = icmp sgt i257 %a, 0
+  br i1 %c, label %call, label %exit
+call:
+  %r = call i257 @callee(i257 %a)
+  ret i257 %r
+exit:
+  ret i257 0
+}
+
+; ALL-LABEL: marked:
+; ALL: DEBUGSTR E3
+; SOME: DEBUGSTR E3
+; SOME: DEBUGSTR X3
+define void @marked() #0 {
+  ret void
+}
+
+attributes #0 = { "tvm_trace" }
@@ -70,6 +70,9 @@ enum ActionKind {
 
   /// Import TVM Json Abi.
   ImportJsonAbi,
+
+  /// Export TVM Json Abi without code generation.
+  ExportJsonAbi,
   // TVM local end
 
   /// Generate LLVM IR, but do not emit anything.
@@ -271,6 +274,11 @@ public:
   /// Show timers for individual actions.
   unsigned ShowTimers : 1;
 
+  // TVM local begin
+  /// Output time trace profile.
+  unsigned TimeTrace : 1;
+  // TVM local end
+
   /// Show the -version text.
   unsigned ShowVersion : 1;
 
@@ -450,6 +458,9 @@ public:
   std::string StatsFile;
 
   // TVM local begin
+  /// Minimum time granularity (in microseconds) traced by time profiler.
+  unsigned TimeTraceGranularity;
+
   /// Name for imported interface structure
   std::string TVMJsonAbiStructName;
   // TVM local end
@@ -457,13 +468,15 @@ public:
 public:
   FrontendOptions()
       : DisableFree(false), RelocatablePCH(false), ShowHelp(false),
-        ShowStats(false), ShowTimers(false), ShowVersion(false),
+        ShowStats(false), ShowTimers(false), TimeTrace(false),
+        ShowVersion(false),
         FixWhatYouCan(false), FixOnlyWarnings(false), FixAndRecompile(false),
         FixToTemporaries(false), ARCMTMigrateEmitARCErrors(false),
         SkipFunctionBodies(false), UseGlobalModuleIndex(true),
         GenerateGlobalModuleIndex(true), ASTDumpDecls(false),
         ASTDumpLookups(false), BuildingImplicitModule(false),
-        ModulesEmbedAllFiles(false), IncludeTimestamps(true) {}
+        ModulesEmbedAllFiles(false), IncludeTimestamps(true),
+        TimeTraceGranularity(500) {}
 
   /// getInputKindForExtension - Return the appropriate input kind for a file
   /// extension. For example, "c" would return InputKind::C.
@@ -0,0 +1,39 @@
+// TVM local begin
+
+//===-- TVMExportJsonAbi.h - TVM Json Abi export ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// Defines FrontendAction for export of TVM Json Abi without code generation
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TVM_EXPORT_JSON_ABI_H
+#define LLVM_CLANG_TVM_EXPORT_JSON_ABI_H
+
+#include "clang/Frontend/FrontendAction.h"
+
+namespace clang {
+
+/// Prints the json_abi string constant (see DEFINE_JSON_ABI) evaluated
+/// by the frontend. Bodies of non-constexpr functions are skipped, so only
+/// the reflection templates the constant depends on are instantiated.
+class ExportJsonAbiAction : public ASTFrontendAction {
+  virtual void anchor();
+protected:
+  bool BeginSourceFileAction(CompilerInstance &CI) override;
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override;
+};
+
+}  // end namespace clang
+
+#endif
+
+// TVM local end
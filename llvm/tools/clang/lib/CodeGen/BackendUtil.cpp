@@ -41,6 +41,7 @@
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
@@ -743,6 +744,9 @@ bool EmitAssemblyHelper::AddEmitPasses(legacy::PassManager &CodeGenPasses,
 void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
                                       std::unique_ptr<raw_pwrite_stream> OS) {
   TimeRegion Region(FrontendTimesIsEnabled ? &CodeGenerationTime : nullptr);
+  // TVM local begin
+  llvm::TimeTraceScope TimeScope("Backend", StringRef(""));
+  // TVM local end
 
   setCommandLineOpts(CodeGenOpts);
 
@@ -835,6 +839,9 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
 
   {
     PrettyStackTraceString CrashInfo("Per-function optimization");
+    // TVM local begin
+    llvm::TimeTraceScope TimeScope("PerFunctionPasses", StringRef(""));
+    // TVM local end
 
     PerFunctionPasses.doInitialization();
     for (Function &F : *TheModule)
@@ -845,11 +852,17 @@ void EmitAssemblyHelper::EmitAssembly(BackendAction Action,
 
   {
     PrettyStackTraceString CrashInfo("Per-module optimization passes");
+    // TVM local begin
+    llvm::TimeTraceScope TimeScope("PerModulePasses", StringRef(""));
+    // TVM local end
     PerModulePasses.run(*TheModule);
   }
 
   {
     PrettyStackTraceString CrashInfo("Code generation");
+    // TVM local begin
+    llvm::TimeTraceScope TimeScope("CodeGenPasses", StringRef(""));
+    // TVM local end
     CodeGenPasses.run(*TheModule);
   }
 
@@ -898,6 +911,9 @@ static PassBuilder::OptimizationLevel mapToLevel(const CodeGenOptions &Opts) {
 void EmitAssemblyHelper::EmitAssemblyWithNewPassManager(
     BackendAction Action, std::unique_ptr<raw_pwrite_stream> OS) {
   TimeRegion Region(FrontendTimesIsEnabled ? &CodeGenerationTime : nullptr);
+  // TVM local begin
+  llvm::TimeTraceScope TimeScope("Backend", StringRef(""));
+  // TVM local end
   setCommandLineOpts(CodeGenOpts);
 
   // The new pass manager always makes a target machine available to passes
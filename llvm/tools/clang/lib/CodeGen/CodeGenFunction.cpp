@@ -37,6 +37,7 @@
 #include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Operator.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Transforms/Utils/PromoteMemToReg.h"
 using namespace clang;
 using namespace CodeGen;
@@ -1294,6 +1295,10 @@ void CodeGenFunction::GenerateCode(GlobalDecl GD, llvm::Function *Fn,
                                    const CGFunctionInfo &FnInfo) {
   const FunctionDecl *FD = cast<FunctionDecl>(GD.getDecl());
   CurGD = GD;
+  // TVM local begin
+  llvm::TimeTraceScope TimeScope("CodeGen Function",
+                                 [&]() { return FD->getQualifiedNameAsString(); });
+  // TVM local end
 
   FunctionArgList Args;
   QualType ResTy = BuildFunctionArgList(GD, Args);
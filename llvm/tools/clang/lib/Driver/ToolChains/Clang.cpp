@@ -3258,7 +3258,7 @@ void Clang::ConstructJob(Compilation &C, const JobAction &JA,
       if (A)
         CmdArgs.push_back(Args.MakeArgString(A->getAsString(Args)));
       else
-        CmdArgs.push_back("-emit-text-const=json_abi");
+        CmdArgs.push_back("-export-json-abi");
     // TVM local end
     } else if (JA.getType() == types::TY_LLVM_BC ||
                JA.getType() == types::TY_LTO_BC) {
@@ -4079,6 +4079,10 @@ void Clang::ConstructJob(Compilation &C, const JobAction &JA,
   Args.AddLastArg(CmdArgs, options::OPT_fdiagnostics_print_source_range_info);
   Args.AddLastArg(CmdArgs, options::OPT_fdiagnostics_parseable_fixits);
   Args.AddLastArg(CmdArgs, options::OPT_ftime_report);
+  // TVM local begin
+  Args.AddLastArg(CmdArgs, options::OPT_ftime_trace);
+  Args.AddLastArg(CmdArgs, options::OPT_ftime_trace_granularity_EQ);
+  // TVM local end
   Args.AddLastArg(CmdArgs, options::OPT_ftrapv);
 
   if (Arg *A = Args.getLastArg(options::OPT_ftrapv_handler_EQ)) {
@@ -1424,6 +1424,9 @@ static InputKind ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
     case OPT_emit_text_const:
       Opts.ProgramAction = frontend::EmitTextConst;
       break;
+    case OPT_export_json_abi:
+      Opts.ProgramAction = frontend::ExportJsonAbi;
+      break;
     case OPT_import_json_abi:
       Opts.ProgramAction = frontend::ImportJsonAbi;
       if (auto *Arg = Args.getLastArg(options::OPT_import_json_name))
@@ -1524,6 +1527,11 @@ static InputKind ParseFrontendArgs(FrontendOptions &Opts, ArgList &Args,
   Opts.ShowHelp = Args.hasArg(OPT_help);
   Opts.ShowStats = Args.hasArg(OPT_print_stats);
   Opts.ShowTimers = Args.hasArg(OPT_ftime_report);
+  // TVM local begin
+  Opts.TimeTrace = Args.hasArg(OPT_ftime_trace);
+  Opts.TimeTraceGranularity = getLastArgIntValue(
+      Args, OPT_ftime_trace_granularity_EQ, Opts.TimeTraceGranularity, Diags);
+  // TVM local end
   Opts.ShowVersion = Args.hasArg(OPT_version);
   Opts.ASTMergeFiles = Args.getAllArgValues(OPT_ast_merge);
   Opts.LLVMArgs = Args.getAllArgValues(OPT_mllvm);
@@ -2840,6 +2848,7 @@ static bool isStrictlyPreprocessorAction(frontend::ActionKind Action) {
   case frontend::EmitLLVM:
   // TVM local begin
   case frontend::EmitTextConst:
+  case frontend::ExportJsonAbi:
   // TVM local end
   case frontend::EmitLLVMOnly:
   case frontend::EmitCodeGenOnly:
@@ -0,0 +1,116 @@
+// TVM local begin
+
+#include "clang/Frontend/TVMExportJsonAbi.h"
+
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/Expr.h"
+#include "clang/Frontend/CompilerInstance.h"
+
+using namespace clang;
+
+void ExportJsonAbiAction::anchor() { }
+
+namespace {
+// Name of the constant defined by DEFINE_JSON_ABI
+const char JsonAbiName[] = "json_abi";
+
+// Evaluates a constant pointer to a null-terminated char array
+bool EvaluateCString(const Expr *E, const ASTContext &Ctx, std::string &Out) {
+  Expr::EvalResult Result;
+  if (!E->EvaluateAsRValue(Result, Ctx) || !Result.Val.isLValue())
+    return false;
+  const APValue &Ptr = Result.Val;
+  uint64_t Idx = 0;
+  if (Ptr.hasLValuePath() && !Ptr.getLValuePath().empty())
+    Idx = Ptr.getLValuePath().back().ArrayIndex;
+
+  APValue::LValueBase Base = Ptr.getLValueBase();
+  if (const auto *SL =
+          dyn_cast_or_null<StringLiteral>(Base.dyn_cast<const Expr *>())) {
+    for (uint64_t I = Idx, N = SL->getLength(); I < N; ++I) {
+      uint32_t Ch = SL->getCodeUnit(I);
+      if (!Ch)
+        break;
+      Out += static_cast<char>(Ch);
+    }
+    return true;
+  }
+
+  // Arrays of characters, like boost::hana::string::c_str()
+  const auto *VD =
+      dyn_cast_or_null<VarDecl>(Base.dyn_cast<const ValueDecl *>());
+  if (!VD)
+    return false;
+  const APValue *Arr = VD->evaluateValue();
+  if (!Arr || !Arr->isArray())
+    return false;
+  for (uint64_t I = Idx, N = Arr->getArraySize(); I < N; ++I) {
+    const APValue &Ch = I < Arr->getArrayInitializedElts()
+                            ? Arr->getArrayInitializedElt(I)
+                            : Arr->getArrayFiller();
+    if (!Ch.isInt())
+      return false;
+    uint64_t Val = Ch.getInt().getZExtValue();
+    if (!Val)
+      break;
+    assert(Val < 256 && "Too big");
+    Out += static_cast<char>(Val);
+  }
+  return true;
+}
+
+class ExportJsonAbiConsumer : public ASTConsumer {
+  CompilerInstance &CI;
+  std::unique_ptr<raw_pwrite_stream> OS;
+
+  void error(StringRef Msg) {
+    unsigned DiagID =
+        CI.getDiagnostics().getCustomDiagID(DiagnosticsEngine::Error, "%0");
+    CI.getDiagnostics().Report(DiagID) << Msg;
+  }
+public:
+  ExportJsonAbiConsumer(CompilerInstance &CI,
+                        std::unique_ptr<raw_pwrite_stream> OS)
+      : CI(CI), OS(std::move(OS)) {}
+
+  void HandleTranslationUnit(ASTContext &Ctx) override {
+    if (CI.getDiagnostics().hasErrorOccurred())
+      return;
+    const VarDecl *VD = nullptr;
+    for (NamedDecl *ND :
+         Ctx.getTranslationUnitDecl()->lookup(&Ctx.Idents.get(JsonAbiName)))
+      if ((VD = dyn_cast<VarDecl>(ND)))
+        break;
+    if (!VD || !VD->getAnyInitializer()) {
+      error("json abi constant is not found, use DEFINE_JSON_ABI");
+      return;
+    }
+    std::string Abi;
+    if (!EvaluateCString(VD->getAnyInitializer(), Ctx, Abi)) {
+      error("json abi constant is not a constant string");
+      return;
+    }
+    *OS << Abi;
+  }
+};
+}
+
+bool ExportJsonAbiAction::BeginSourceFileAction(CompilerInstance &CI) {
+  // Only the constant is needed: bodies of non-constexpr functions (with all
+  //  the templates they instantiate) are not parsed
+  CI.getFrontendOpts().SkipFunctionBodies = true;
+  return true;
+}
+
+std::unique_ptr<ASTConsumer>
+ExportJsonAbiAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
+  std::unique_ptr<raw_pwrite_stream> OS =
+      CI.createDefaultOutputFile(false, InFile, "abi");
+  if (!OS)
+    return nullptr;
+  return llvm::make_unique<ExportJsonAbiConsumer>(CI, std::move(OS));
+}
+
+// TVM local end
@@ -22,6 +22,7 @@
 #include "clang/Frontend/FrontendActions.h"
 #include "clang/Frontend/FrontendDiagnostic.h"
 #include "clang/Frontend/FrontendPluginRegistry.h"
+#include "clang/Frontend/TVMExportJsonAbi.h"
 #include "clang/Frontend/TVMImportJsonAbi.h"
 #include "clang/Frontend/Utils.h"
 #include "clang/Rewrite/Frontend/FrontendActions.h"
@@ -57,6 +58,7 @@ CreateFrontendBaseAction(CompilerInstance &CI) {
   // TVM local begin
   case EmitTextConst:          return llvm::make_unique<EmitTextConstAction>();
   case ImportJsonAbi:          return llvm::make_unique<ImportJsonAbiAction>();
+  case ExportJsonAbi:          return llvm::make_unique<ExportJsonAbiAction>();
   // TVM local end
   case EmitLLVMOnly:           return llvm::make_unique<EmitLLVMOnlyAction>();
   case EmitCodeGenOnly:        return llvm::make_unique<EmitCodeGenOnlyAction>();
@@ -0,0 +1,35 @@
+// RUN: %clang -target tvm -export-json-abi %s --sysroot=%S/../../../../../projects/ton-compiler/cpp-sdk/ -o - | FileCheck %s
+// REQUIRES: tvm-registered-target
+
+// The abi is produced by the frontend only: bodies of regular functions
+//  are not parsed and templates used there are not instantiated.
+
+// CHECK: "functions":
+// CHECK: "name": "get_value"
+// CHECK: "name": "set_value"
+
+#include <tvm/schema/json-abi-gen.hpp>
+
+namespace tvm { namespace schema {
+
+struct IStore {
+  uint_t<64> get_value() = 1;
+  void set_value(uint_t<64> value) = 2;
+};
+
+struct DStore {};
+
+struct EStore {};
+
+}} // namespace tvm::schema
+
+template<class T>
+void not_instantiated() {
+  static_assert(sizeof(T) == 0, "must not be instantiated");
+}
+
+void contract_code() {
+  not_instantiated<int>();
+}
+
+DEFINE_JSON_ABI(tvm::schema::IStore, tvm::schema::DStore, tvm::schema::EStore);
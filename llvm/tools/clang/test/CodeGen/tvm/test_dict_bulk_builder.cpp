@@ -0,0 +1,102 @@
+// RUN: %clang -O3 -S -c -emit-llvm -target tvm %s --sysroot=%S/../../../../../projects/ton-compiler/cpp-sdk/ -o -
+// REQUIRES: tvm-registered-target
+
+#include <tvm/dict_array.hpp>
+#include <tvm/dict_map.hpp>
+#include <tvm/dict_set.hpp>
+
+using namespace tvm;
+using namespace schema;
+
+// Doesn't fit into a dictionary leaf, stored by reference
+struct big_elem {
+  uint256 a;
+  uint256 b;
+  uint256 c;
+  uint256 d;
+};
+
+// Small elements are added as slices, big ones as references
+unsigned map_insert() {
+  dict_map<uint32, uint32> src{ {1, 10}, {2, 20}, {7, 70}, {100, 1000} };
+  dict_map<uint32, uint32> dict;
+  dict.insert(src.begin(), src.end());
+  return dict.size().get();
+}
+
+unsigned map_insert_big() {
+  dict_map<uint32, big_elem> src;
+  src.set_at(1, big_elem{ 1, 2, 3, 4 });
+  src.set_at(7, big_elem{ 5, 6, 7, 8 });
+  dict_map<uint32, big_elem> dict;
+  dict.set_at(5, big_elem{ 0, 0, 0, 0 });
+  dict.insert(src.begin(), src.end());
+  return dict.size().get();
+}
+
+unsigned set_range() {
+  dict_array<uint32, 32> keys{ 3, 1, 4, 1, 5, 9, 2, 6 };
+  dict_set<uint32> set(keys.begin(), keys.end());
+  return set.size().get();
+}
+
+unsigned array_append() {
+  dict_array<uint32, 32> src{ 1, 2, 3, 4, 10, 20 };
+  dict_array<uint32, 32> arr;
+  arr.assign(src.begin(), src.end());
+  arr.append(src.begin(), src.end());
+  return arr.size().get();
+}
+
+unsigned array_assign_big() {
+  dict_array<big_elem, 32> src;
+  src.push_back(big_elem{ 1, 2, 3, 4 });
+  src.push_back(big_elem{ 5, 6, 7, 8 });
+  dict_array<big_elem, 32> arr;
+  arr.push_back(big_elem{ 0, 0, 0, 0 });
+  arr.assign(src.begin(), src.end());
+  return arr.size().get();
+}
+
+// ----------------- main entry functions ---------------------- //
+
+__attribute__((tvm_raw_func)) int main_external(__tvm_cell msg, __tvm_slice msg_body) {
+  cell msg_v(msg);
+  slice msg_body_v(msg_body);
+  parser msg_parser(msg_body_v);
+  auto func_id = msg_parser.ldu(32);
+  switch (func_id) {
+  case 1:
+    return map_insert();
+  case 2:
+    return map_insert_big();
+  case 3:
+    return set_range();
+  case 4:
+    return array_append();
+  case 5:
+    return array_assign_big();
+  }
+  tvm_throw(error_code::wrong_public_call);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_internal(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_ticktock(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_split(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_merge(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
@@ -0,0 +1,85 @@
+// RUN: %clang -O3 -S -c -emit-llvm -target tvm %s --sysroot=%S/../../../../../projects/ton-compiler/cpp-sdk/ -o -
+// REQUIRES: tvm-registered-target
+
+#include <tvm/queue.hpp>
+#include <tvm/big_queue.hpp>
+
+using namespace tvm;
+using namespace schema;
+
+struct big_elem {
+  uint256 a;
+  uint256 b;
+  uint256 c;
+  uint256 d;
+};
+
+unsigned small() {
+  indexed_queue<uint32> q;
+  q.push(uint32(1));
+  q.push(uint32(2));
+  q.push(uint32(3));
+  q.push(uint32(4));
+  q.change_front(uint32(10));
+  auto [idx, back] = q.back_with_idx();
+  unsigned sum = idx + back.get() + q.front().get();
+  q.pop();
+  if (auto val = q.pop_opt())
+    sum += val->get();
+  for (auto elem : q)
+    sum += elem.get();
+  sum += q.pop_n(1);
+  sum += q.pop_n(10, [&](uint32 val) { sum += val.get(); });
+  return sum + q.size().get();
+}
+
+unsigned big() {
+  indexed_big_queue<big_elem> q;
+  q.push(big_elem{ 1, 2, 3, 4 });
+  q.push(big_elem{ 5, 6, 7, 8 });
+  q.push(big_elem{ 9, 10, 11, 12 });
+  auto [idx, front] = q.front_with_idx();
+  unsigned sum = idx + front.a.get() + q.back().d.get();
+  if (auto val = q.back_opt())
+    sum += val->b.get();
+  sum += q.pop_n(2, [&](big_elem val) { sum += val.c.get(); });
+  q.pop();
+  return sum + q.empty();
+}
+
+// ----------------- main entry functions ---------------------- //
+
+__attribute__((tvm_raw_func)) int main_external(__tvm_cell msg, __tvm_slice msg_body) {
+  cell msg_v(msg);
+  slice msg_body_v(msg_body);
+  parser msg_parser(msg_body_v);
+  auto func_id = msg_parser.ldu(32);
+  switch (func_id) {
+  case 1:
+    return small();
+  case 2:
+    return big();
+  }
+  tvm_throw(error_code::wrong_public_call);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_internal(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_ticktock(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_split(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_merge(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
@@ -0,0 +1,81 @@
+// RUN: %clang -O3 -S -c -emit-llvm -target tvm %s --sysroot=%S/../../../../../projects/ton-compiler/cpp-sdk/ -o -
+// REQUIRES: tvm-registered-target
+
+#include <tvm/packed_dict_array.hpp>
+#include <tvm/dict_array.hpp>
+#include <numeric>
+
+using namespace tvm;
+using namespace schema;
+
+uint32 test1(packed_dict_array<uint32> dict) {
+  const auto& cdict = dict;
+  uint32 sum(0);
+  for (auto elem : cdict) {
+    sum += elem;
+  }
+  return sum;
+}
+
+int32 test2(packed_dict_array<int32, 4> dict) {
+  std::reverse(dict.begin(), dict.end());
+  std::iter_swap(dict.begin(), dict.begin() + 1);
+  const auto& cdict = dict;
+  return std::accumulate(cdict.begin(), cdict.end(), int32(1000),
+                         [](int32 l, int32 r){ return l - r; });
+}
+
+unsigned foo() {
+  dict_array<uint32, 32> src { 1, 2, 3, 4, 10, 20 };
+  packed_dict_array<uint32> dict(src.begin(), src.end());
+  dict.push_back(uint32(30));
+  dict.set_at(2, uint32(5));
+  dict[3] = uint32(6);
+  return test1(dict).get();
+}
+
+unsigned bar() {
+  dict_array<int32, 32> src { -19, 2, 3, 4, 10, 20 };
+  packed_dict_array<int32, 4> dict;
+  dict.assign(src.begin(), src.end());
+  dict.append(src.begin(), src.end());
+  dict.pop_back();
+  return test2(dict).get();
+}
+
+// ----------------- main entry functions ---------------------- //
+
+__attribute__((tvm_raw_func)) int main_external(__tvm_cell msg, __tvm_slice msg_body) {
+  cell msg_v(msg);
+  slice msg_body_v(msg_body);
+  parser msg_parser(msg_body_v);
+  auto func_id = msg_parser.ldu(32);
+  switch (func_id) {
+  case 1:
+    return foo();
+  case 2:
+    return bar();
+  }
+  tvm_throw(error_code::wrong_public_call);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_internal(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_ticktock(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_split(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
+
+__attribute__((tvm_raw_func)) int main_merge(__tvm_cell msg, __tvm_slice msg_body) {
+  tvm_throw(error_code::unsupported_call_method);
+  return 0;
+}
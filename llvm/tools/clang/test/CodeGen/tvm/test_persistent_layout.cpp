@@ -0,0 +1,69 @@
+// RUN: %clang -O3 -S -c -emit-llvm -target tvm %s --sysroot=%S/../../../../../projects/ton-compiler/cpp-sdk/ -o /dev/null 2>&1 | FileCheck %s
+// REQUIRES: tvm-registered-target
+
+#include <tvm/contract.hpp>
+#include <tvm/smart_switcher.hpp>
+#include <tvm/msg_address.inline.hpp>
+
+using namespace tvm::schema;
+using namespace tvm;
+
+namespace tvm { namespace schema {
+
+__interface ICounter {
+  __attribute__((external))
+  void constructor() = 1;
+
+  __attribute__((external))
+  void inc() = 2;
+};
+
+// In declaration order d and counter would be moved into the second cell,
+//  the hot counter is planned into the root cell instead.
+// CHECK: remark: 2 cells: u256,u256,u256,u8,ref<u256>
+struct DCounter {
+  uint_t<256> a;
+  uint_t<256> b;
+  uint_t<256> c;
+  uint_t<256> d;
+  uint_t<8> counter;
+
+  using persistent_layout = schema::persistent_layout<4>;
+};
+
+struct ECounter {};
+
+}} // namespace tvm::schema
+
+class Counter final : public smart_interface<ICounter>, public DCounter {
+public:
+  __always_inline void constructor() final;
+  __always_inline void inc() final;
+
+  // Function is called in case of unparsed or unsupported func_id
+  static __always_inline int _fallback(cell msg, slice msg_body);
+};
+DEFINE_JSON_ABI(ICounter, DCounter, ECounter);
+
+// -------------------------- Public calls --------------------------------- //
+void Counter::constructor() {
+  tvm_accept();
+  a = 1;
+  b = 2;
+  c = 3;
+  d = 4;
+  counter = 0;
+}
+
+void Counter::inc() {
+  tvm_accept();
+  counter = counter.get() + 1;
+}
+
+// Fallback function
+int Counter::_fallback(cell msg, slice msg_body) {
+  return 0;
+}
+
+// ----------------------------- Main entry functions ---------------------- //
+DEFAULT_MAIN_ENTRY_FUNCTIONS(Counter, ICounter, DCounter, 100)
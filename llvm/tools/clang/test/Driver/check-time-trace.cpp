@@ -0,0 +1,18 @@
+// REQUIRES: tvm-registered-target
+// RUN: %clangxx -S -emit-llvm -target tvm -ftime-trace -ftime-trace-granularity=0 -o %t.ll %s
+// RUN: cat %t.json | FileCheck %s
+
+// CHECK: "traceEvents": [
+// CHECK: "name": "InstantiateClass"
+// CHECK: "name": "Total InstantiateClass"
+// CHECK: "name": "process_name"
+
+template <typename T>
+struct Struct {
+  T Num;
+};
+
+int main() {
+  Struct<int> S;
+  return 0;
+}
@@ -33,9 +33,12 @@
 #include "llvm/Option/OptTable.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cstdio>
@@ -214,8 +217,31 @@ int cc1_main(ArrayRef<const char *> Argv, const char *Argv0, void *MainAddr) {
   if (!Success)
     return 1;
 
+  // TVM local begin
+  if (Clang->getFrontendOpts().TimeTrace)
+    llvm::timeTraceProfilerInitialize(
+        Clang->getFrontendOpts().TimeTraceGranularity);
+
   // Execute the frontend actions.
-  Success = ExecuteCompilerInvocation(Clang.get());
+  {
+    llvm::TimeTraceScope TimeScope("ExecuteCompiler", StringRef(""));
+    Success = ExecuteCompilerInvocation(Clang.get());
+  }
+
+  // The trace is written next to the output file: foo.o => foo.json
+  if (llvm::timeTraceProfilerEnabled()) {
+    SmallString<128> Path(Clang->getFrontendOpts().OutputFile);
+    llvm::sys::path::replace_extension(Path, "json");
+    std::error_code EC;
+    llvm::raw_fd_ostream ProfilerOutput(Path, EC, llvm::sys::fs::F_Text);
+    if (EC)
+      Clang->getDiagnostics().Report(diag::err_fe_unable_to_open_output)
+          << Path << EC.message();
+    else
+      llvm::timeTraceProfilerWrite(ProfilerOutput);
+    llvm::timeTraceProfilerCleanup();
+  }
+  // TVM local end
 
   // If any timers were active but haven't been destroyed yet, print their
   // results now.  This happens in -disable-free mode.
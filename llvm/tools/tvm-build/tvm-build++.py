@@ -1,7 +1,9 @@
 #!/usr/bin/env python
 
 import os
+import re
 import glob
+import hashlib
 import shutil
 import argparse
 import json
@@ -65,6 +67,11 @@ parser.add_argument('--linker', help='path to TVM linker executable')
 parser.add_argument('--stdlib', help='path to standard library directory')
 parser.add_argument('--include', help='path to standard include directory')
 parser.add_argument('--sysroot', help='path to standard include directory')
+parser.add_argument('--pch', action='store_true', default=False,
+                    help='use cached precompiled SDK headers')
+parser.add_argument('--pch-cache', help='precompiled headers cache directory')
+parser.add_argument('--pch-headers',
+                    help='comma-separated SDK headers to precompile')
 
 args = parser.parse_args()
 
@@ -106,10 +113,103 @@ cxxflags = ['-O3']
 if args.cxxflags:
   cxxflags += args.cxxflags.split()
 
+# Precompiled SDK headers (--pch).
+# The SDK headers are parsed once into a PCH shared by all the translation
+# units of the build and reused by later builds: the cache entry is keyed by
+# the compiler, target, flags, headers list and the SDK sources.
+# The PCH is included before the first line of a source, so configuration
+# macros the source defines ahead of the SDK includes would be ignored. Such
+# sources are built without the PCH.
+pch_config_macros = [
+  'TVM_NO_QUEUE_REINDEX',
+  'DEFAULT_EQUAL',
+  'DEFAULT_PROXY_OPERATORS',
+]
+pch_headers = [
+  'tvm/contract.hpp',
+  'tvm/contract_handle.hpp',
+  'tvm/smart_switcher.hpp',
+  'tvm/default_support_functions.hpp',
+  'tvm/replay_attack_protection/timestamp.hpp',
+]
+if args.pch_headers:
+  pch_headers = args.pch_headers.split(',')
+
+def defines_config_macro(filename):
+  pattern = re.compile(r'^\s*#\s*(define|undef)\s+({})\b'.format(
+    '|'.join(pch_config_macros)), re.MULTILINE)
+  with open(filename) as f:
+    return pattern.search(f.read()) is not None
+
+def sdk_fingerprint(digest):
+  for subdir in ['tvm', 'std', 'boost']:
+    for root, dirs, files in os.walk(os.path.join(tvm_sysroot, subdir)):
+      dirs.sort()
+      for fname in sorted(files):
+        path = os.path.join(root, fname)
+        st = os.stat(path)
+        digest.update('{} {} {}\n'.format(path, st.st_size,
+          int(st.st_mtime)).encode())
+
+def get_pch(clangxx):
+  cache = args.pch_cache or os.environ.get('TVM_PCH_CACHE') or \
+    os.path.join(os.path.expanduser('~'), '.cache', 'tvm-build', 'pch')
+  cmdline = [clangxx, '-target', 'tvm'] + cxxflags + \
+    ['--sysroot=' + os.path.abspath(tvm_sysroot)]
+  digest = hashlib.sha256()
+  st = os.stat(clangxx)
+  digest.update('{} {} {}\n'.format(os.path.realpath(clangxx), st.st_size,
+    int(st.st_mtime)).encode())
+  digest.update(' '.join(cmdline + pch_headers).encode())
+  sdk_fingerprint(digest)
+  key = digest.hexdigest()[:32]
+  pch = os.path.join(cache, key + '.pch')
+  if os.path.exists(pch):
+    if args.verbose:
+      print('Using precompiled headers ' + pch)
+    return pch
+
+  if not os.path.isdir(cache):
+    os.makedirs(cache)
+  prefix = os.path.join(cache, key + '.hpp')
+  with open(prefix, 'w') as f:
+    for header in pch_headers:
+      f.write('#include <{}>\n'.format(header))
+  # Concurrent builds may create the same entry: build into a temporary
+  #  file and rename it atomically.
+  fd, tmp_pch = tempfile.mkstemp(dir=cache, suffix='.pch.tmp')
+  os.close(fd)
+  cmdline += ['-x', 'c++-header', prefix, '-o', tmp_pch]
+  if args.verbose:
+    print(' '.join(cmdline))
+  try:
+    subprocess.check_output(cmdline, stderr=subprocess.STDOUT)
+  except subprocess.CalledProcessError as e:
+    print('Warning: precompiling SDK headers failed, building without them')
+    if args.verbose:
+      print(e.output)
+    os.remove(tmp_pch)
+    return None
+  os.rename(tmp_pch, pch)
+  return pch
+
+clangxx = os.path.join(tvm_llvm_bin, 'clang++')
+pch_flags = []
+if input_cpp and args.pch:
+  pch = get_pch(clangxx)
+  if pch:
+    pch_flags = ['-include-pch', pch]
+
 for filename in input_cpp:
+  file_pch_flags = pch_flags
+  if pch_flags and defines_config_macro(filename):
+    if args.verbose:
+      print('{} configures the SDK, building it without precompiled '
+        'headers'.format(filename))
+    file_pch_flags = []
   _, tmp_file = tempfile.mkstemp()
-  execute([os.path.join(tvm_llvm_bin, 'clang++'), '-target', 'tvm'] +
-    cxxflags + ['-S', '-emit-llvm', filename, '-o', tmp_file, '--sysroot=' + tvm_sysroot], args.verbose)
+  execute([clangxx, '-target', 'tvm'] + cxxflags + file_pch_flags +
+    ['-S', '-emit-llvm', filename, '-o', tmp_file, '--sysroot=' + os.path.abspath(tvm_sysroot)], args.verbose)
   input_bc += [tmp_file]
 
 cflags = ['-O1']
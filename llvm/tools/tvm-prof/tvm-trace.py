@@ -0,0 +1,186 @@
+#!/usr/bin/python
+
+# Decoder of the call traces of TVM contracts compiled with -tvm-trace-calls,
+# -tvm-trace-functions=<regex> or functions marked with the tvm_trace
+# attribute. A traced function executes DEBUGSTR E<id> at the entry and
+# DEBUGSTR X<id> at the returns. The ids are mapped back to the function names
+# with the assembly of the contract, the call tree with the gas consumed by
+# each call is rebuilt from the execution log (tvm_linker trace).
+#
+# An id is the position of the function in its LLVM module, ids of separately
+# compiled modules collide. A contract is linked into a single module by
+# tvm-build++.py, so the assembly is a single file.
+
+from __future__ import print_function
+
+import argparse
+import re
+import sys
+
+FUNCTION_RE = re.compile(r'^\s*(?:\.macro\s+|\.internal\s+:)(\S+)|'
+                         r'^([A-Za-z_$.][\w$.]*):')
+EVENT_RE = re.compile(r'DEBUGSTR\s+(?:([EX])(\d+)\b|x\{?([0-9A-Fa-f]+)_?\}?)')
+
+
+def decode_event(text):
+    """Return (kind, id) of a trace event in an instruction, or None."""
+    m = EVENT_RE.search(text)
+    if not m:
+        return None
+    if m.group(1):
+        return m.group(1), int(m.group(2))
+    # The disassembler may print the payload as hex bytes.
+    payload = m.group(3)
+    if len(payload) % 2:
+        return None
+    try:
+        payload = bytearray.fromhex(payload).decode('ascii')
+    except (ValueError, UnicodeDecodeError):
+        return None
+    m = re.match(r'([EX])(\d+)$', payload)
+    return (m.group(1), int(m.group(2))) if m else None
+
+
+def load_names(path):
+    """Map the trace ids to the functions they are emitted in."""
+    names = {}
+    function = None
+    with open(path) as f:
+        for line in f:
+            code = line.split(';', 1)[0]
+            m = FUNCTION_RE.match(code)
+            if m:
+                function = m.group(1) or m.group(2)
+                continue
+            event = decode_event(code)
+            if event and event[0] == 'E' and function:
+                names[event[1]] = function
+    return names
+
+
+class Call(object):
+    def __init__(self, ident, gas):
+        self.ident = ident
+        self.start = gas
+        self.gas = 0
+        self.children = []
+        self.unwound = False
+        self.finished = False
+
+    def self_gas(self):
+        return self.gas - sum(c.gas for c in self.children)
+
+
+def read_trace(path):
+    """Yield (event, gas consumed before the event) from an execution log."""
+    consumed = 0
+    with open(path) as f:
+        lines = [l.rstrip('\n') for l in f]
+    for i, line in enumerate(lines):
+        m = re.match(r'Gas\: (\d+) \((\d+)\)', line)
+        if m:
+            consumed += int(m.group(2))
+            continue
+        m = re.match(r'(\d+)\: (.+)', line)
+        if m:
+            event = decode_event(m.group(2))
+            if event:
+                yield event, consumed
+    yield None, consumed
+
+
+def build_tree(path):
+    root = Call(None, 0)
+    stack = [root]
+    for event, gas in read_trace(path):
+        if event is None:
+            # Calls left by the end of the execution.
+            while len(stack) > 1:
+                call = stack.pop()
+                call.gas = gas - call.start
+            root.gas = gas
+            break
+        kind, ident = event
+        if kind == 'E':
+            call = Call(ident, gas)
+            stack[-1].children.append(call)
+            stack.append(call)
+            continue
+        if not any(c.ident == ident for c in stack[1:]):
+            print('warning: exit of %d without entry' % ident, file=sys.stderr)
+            continue
+        # Calls without exits have been unwound by an exception.
+        while stack[-1].ident != ident:
+            call = stack.pop()
+            call.gas = gas - call.start
+            call.unwound = True
+        call = stack.pop()
+        call.gas = gas - call.start
+        call.finished = True
+    return root
+
+
+def name_of(ident, names):
+    return names.get(ident, '<id %d>' % ident)
+
+
+def print_tree(call, names, depth, max_depth, out):
+    for child in call.children:
+        note = ''
+        if child.unwound:
+            note = ' (unwound)'
+        elif not child.finished:
+            note = ' (unfinished)'
+        print('%9d %9d  %s%s%s' % (child.gas, child.self_gas(), '  ' * depth,
+                                   name_of(child.ident, names), note),
+              file=out)
+        if max_depth is None or depth + 1 < max_depth:
+            print_tree(child, names, depth + 1, max_depth, out)
+
+
+def print_summary(root, names, out):
+    stats = {}
+
+    def visit(call, active):
+        for child in call.children:
+            s = stats.setdefault(child.ident, [0, 0, 0])
+            s[0] += 1
+            # Recursive calls are counted once in the inclusive gas.
+            if child.ident not in active:
+                s[1] += child.gas
+            s[2] += child.self_gas()
+            visit(child, active | {child.ident})
+
+    visit(root, frozenset())
+    print('%9s %9s %9s  %s' % ('CALLS', 'GAS', 'SELF', 'FUNCTION'), file=out)
+    for ident, (calls, gas, self_gas) in sorted(stats.items(),
+                                                key=lambda i: -i[1][1]):
+        print('%9d %9d %9d  %s' % (calls, gas, self_gas,
+                                   name_of(ident, names)), file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Rebuild the call tree of a traced TVM contract.')
+    parser.add_argument('--exec-log', required=True,
+                        help='TVM execution log (tvm_linker trace)')
+    parser.add_argument('--asm',
+                        help='assembly of the contract, maps ids to names')
+    parser.add_argument('--depth', type=int,
+                        help='maximal depth of the printed call tree')
+    parser.add_argument('--summary', action='store_true',
+                        help='print gas per function instead of the tree')
+    args = parser.parse_args()
+
+    names = load_names(args.asm) if args.asm else {}
+    root = build_tree(args.exec_log)
+    if args.summary:
+        print_summary(root, names, sys.stdout)
+        return
+    print('%9s %9s  %s' % ('GAS', 'SELF', 'CALL'))
+    print_tree(root, names, 0, args.depth, sys.stdout)
+    print('%9d %9d  TOTAL' % (root.gas, root.self_gas()))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,82 @@
+#!/bin/sh
+
+# Micro-benchmark of llc on large TVM functions: report the best wall time
+# and the peak memory of compiling every file.
+# Without files the largest tests of test/CodeGen/TVM are taken.
+# Flags given with -f are passed to llc, e.g. -f "-O0 -fast-isel=false".
+
+usage() {
+   echo "Usage: $(basename $0) -l <llc> [-n <runs>] [-c <count of files>] [-f <llc flags>] [file.ll [...]]"
+}
+
+runs=5
+count=5
+while [ -n "$1" ]; do
+   case "$1" in
+   -l)
+      llc=$(realpath $2)
+      shift
+      ;;
+   -n)
+      runs=$2
+      shift
+      ;;
+   -c)
+      count=$2
+      shift
+      ;;
+   -f)
+      flags=$2
+      shift
+      ;;
+   -h)
+      usage
+      exit 0
+      ;;
+   *) break ;;
+
+   esac
+   shift
+done
+
+if [ -z "$llc" ] || [ ! -x "$llc" ]; then
+   echo "llc is not present"
+   usage
+   exit 1
+fi
+
+if [ ! -x /usr/bin/time ]; then
+   echo "/usr/bin/time is required to measure peak memory"
+   exit 2
+fi
+
+files="$@"
+if [ -z "$files" ]; then
+   tests=$(dirname $(realpath $0))/../../test/CodeGen/TVM
+   files=$(find $tests -name "*.ll" -exec ls -S {} + | head -n $count)
+fi
+
+printf "%-48s %10s %12s\n" "file" "time, s" "peak, KiB"
+stats=$(mktemp)
+for file in $files; do
+   best=""
+   peak=0
+   i=0
+   while [ $i -lt $runs ]; do
+      /usr/bin/time -f "%e %M" -o $stats $llc -march=tvm $flags $file \
+         -o /dev/null 2>/dev/null
+      # The last line holds the stats even if llc failed.
+      set -- $(tail -n 1 $stats)
+      time=$1
+      mem=$2
+      if [ -z "$best" ] || [ $(echo "$time < $best" | bc) -eq 1 ]; then
+         best=$time
+      fi
+      if [ $mem -gt $peak ]; then
+         peak=$mem
+      fi
+      i=$((i + 1))
+   done
+   printf "%-48s %10s %12s\n" $(basename $file) $best $peak
+done
+rm -f $stats